@@ -0,0 +1,218 @@
+/*
+ Reports the memory used per line by DialogueCompactScript against the same nodes held as DialogueNodes,
+ checks that every node survives the round trip, directly and through the serialized form, and measures the cost of expanding a node.
+ See README.md for build instructions.
+ */
+
+#include "DialogueBinaryIO.h"
+#include "DialogueCompactScript.h"
+#include "DialogueLineParser.h"
+#include "DialogueNode.h"
+#include "IDialogueResolver.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class NullResolver : public IDialogueResolver
+    {
+    public:
+        bool resolveVariable(const std::string&, std::string&) const override
+        {
+            return false;
+        }
+
+        bool resolveAction(const std::string&, const std::vector<std::string>&) const override
+        {
+            return false;
+        }
+    };
+
+    const size_t k_nodeCount = 2000;
+    const size_t k_linesPerNode = 20;
+    const char* k_actors[] = { "Guard", "Merchant", "Player", "Innkeeper" };
+
+    //a script shaped like shipped dialogue: mostly plain lines, with the occasional condition, action, option, markup and % group
+    std::string makeBody(size_t _node)
+    {
+        std::string body;
+        for(size_t i = 0; i < k_linesPerNode; ++i)
+        {
+            const std::string actor = k_actors[(_node + i) % 4];
+            const std::string text = "line " + std::to_string(i) + " of node " + std::to_string(_node) + ", a sentence of ordinary length";
+            switch(i % 10)
+            {
+                case 3:
+                    body += actor + ": " + text + " <<if $(gold) > 10>>\n";
+                    break;
+                case 5:
+                    body += actor + ": [b]" + text + "[/b] <<set $(met) true>>\n";
+                    break;
+                case 7:
+                    body += "% " + actor + ": " + text + "\n% " + actor + ": another take on " + text + "\n";
+                    break;
+                default:
+                    body += actor + ": " + text + "\n";
+                    break;
+            }
+        }
+        body += "[[Continue|Node" + std::to_string(_node + 1) + "]]\n";
+        body += "[[Leave|Node" + std::to_string(_node / 2) + "]]\n";
+        return body;
+    }
+
+    bool equals(const std::vector<DialogueNode::Condition>& _a, const std::vector<DialogueNode::Condition>& _b)
+    {
+        if(_a.size() != _b.size()) return false;
+        for(size_t i = 0; i < _a.size(); ++i)
+        {
+            if(_a[i].source != _b[i].source || _a[i].op != _b[i].op) return false;
+        }
+        return true;
+    }
+
+    bool equals(const std::vector<DialogueNode::Action>& _a, const std::vector<DialogueNode::Action>& _b)
+    {
+        if(_a.size() != _b.size()) return false;
+        for(size_t i = 0; i < _a.size(); ++i)
+        {
+            if(_a[i].name != _b[i].name || _a[i].params != _b[i].params) return false;
+        }
+        return true;
+    }
+
+    bool equals(const std::vector<DialogueNode::Markup>& _a, const std::vector<DialogueNode::Markup>& _b)
+    {
+        if(_a.size() != _b.size()) return false;
+        for(size_t i = 0; i < _a.size(); ++i)
+        {
+            if(_a[i].name != _b[i].name || _a[i].value != _b[i].value
+               || _a[i].start != _b[i].start || _a[i].length != _b[i].length) return false;
+        }
+        return true;
+    }
+
+    bool equals(const DialogueNode::Line& _a, const DialogueNode::Line& _b)
+    {
+        if(_a.actorKey != _b.actorKey || _a.content != _b.content || _a.lineId != _b.lineId
+           || _a.gotoNode != _b.gotoNode || _a.weight != _b.weight
+           || equals(_a.markup, _b.markup) == false || equals(_a.conditions, _b.conditions) == false
+           || equals(_a.actions, _b.actions) == false
+           || _a.options.size() != _b.options.size() || _a.variants.size() != _b.variants.size())
+        {
+            return false;
+        }
+        for(size_t i = 0; i < _a.options.size(); ++i)
+        {
+            const auto& a = _a.options[i];
+            const auto& b = _b.options[i];
+            if(a.content != b.content || a.gotoNode != b.gotoNode || a.isShortcut != b.isShortcut || a.lineId != b.lineId
+               || equals(a.markup, b.markup) == false || equals(a.conditions, b.conditions) == false
+               || equals(a.actions, b.actions) == false)
+            {
+                return false;
+            }
+        }
+        for(size_t i = 0; i < _a.variants.size(); ++i)
+        {
+            if(equals(_a.variants[i], _b.variants[i]) == false) return false;
+        }
+        return true;
+    }
+
+    bool equals(const DialogueNode& _a, const DialogueNode& _b)
+    {
+        if(_a.name != _b.name || _a.parent != _b.parent || _a.tags != _b.tags || _a.lines.size() != _b.lines.size())
+        {
+            return false;
+        }
+        for(size_t i = 0; i < _a.lines.size(); ++i)
+        {
+            if(equals(_a.lines[i], _b.lines[i]) == false) return false;
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    NullResolver resolver;
+    DialogueLineParser parser(&resolver);
+    parser.setMarkupEnabled(true);
+
+    std::vector<DialogueNode> nodes;
+    for(size_t i = 0; i < k_nodeCount; ++i)
+    {
+        parser.parse("Node" + std::to_string(i), "", makeBody(i), 0, nodes);
+    }
+
+    DialogueCompactScript script;
+    for(const auto& node : nodes)
+    {
+        script.add(node);
+    }
+    script.shrinkToFit();
+
+    DialogueCompactScript::MemoryReport report;
+    script.getMemoryReport(report);
+
+    size_t parsedBytes = 0;
+    for(const auto& node : nodes)
+    {
+        parsedBytes += DialogueCompactScript::getExpandedSize(node);
+    }
+
+    printf("%zu nodes, %zu lines\n", report.nodeCount, report.lineCount);
+    printf("parsed   %10zu bytes  %7.1f bytes/line\n", parsedBytes, static_cast<double>(parsedBytes) / report.lineCount);
+    printf("expanded %10zu bytes  %7.1f bytes/line\n", report.expandedBytes, report.getExpandedBytesPerLine());
+    printf("compact  %10zu bytes  %7.1f bytes/line  %.1fx smaller than parsed\n",
+           report.compactBytes, report.getCompactBytesPerLine(), static_cast<double>(parsedBytes) / report.compactBytes);
+
+    size_t mismatches = 0;
+    DialogueNode expanded;
+    for(DialogueCompactScript::NodeIndex i = 0; i < nodes.size(); ++i)
+    {
+        script.expand(i, expanded);
+        if(equals(nodes[i], expanded) == false)
+        {
+            ++mismatches;
+        }
+    }
+    printf("round trip: %zu of %zu nodes differ\n", mismatches, nodes.size());
+
+    //the serialized form, as stored in node archives and the parse cache
+    std::vector<uint8_t> data;
+    DialogueBinaryWriter writer(data);
+    script.write(writer);
+    DialogueBinaryReader reader(data.data(), data.size());
+    DialogueCompactScript readScript;
+    size_t readMismatches = 0;
+    if(readScript.read(reader) == false || reader.isAtEnd() == false || readScript.getNodeCount() != nodes.size())
+    {
+        readMismatches = nodes.size();
+    }
+    for(DialogueCompactScript::NodeIndex i = 0; i < readScript.getNodeCount(); ++i)
+    {
+        readScript.expand(i, expanded);
+        if(equals(nodes[i], expanded) == false)
+        {
+            ++readMismatches;
+        }
+    }
+    printf("serialized %8zu bytes  %7.1f bytes/line, %zu of %zu nodes differ after reading\n",
+           data.size(), static_cast<double>(data.size()) / report.lineCount, readMismatches, nodes.size());
+    mismatches += readMismatches;
+
+    const auto start = std::chrono::steady_clock::now();
+    for(DialogueCompactScript::NodeIndex i = 0; i < nodes.size(); ++i)
+    {
+        script.expand(i, expanded);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    printf("expand: %.0f ns/node\n", std::chrono::duration<double, std::nano>(end - start).count() / nodes.size());
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+/*
+ Benchmarks parsing, adding nodes, condition resolution, variable substitution and running dialogue
+ over a script from DialogueScriptGenerator. Results are written as JSON so runs can be compared across commits,
+ with a summary on stderr. See README.md for build instructions and options.
+ */
+
+#include "DialogueScriptGenerator.h"
+
+#include "DialogueContent.h"
+#include "DialogueController.h"
+#include "DialogueLineParser.h"
+#include "DialogueNode.h"
+#include "DialogueVariableStore.h"
+#include "IDialogueDelegate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        DialogueScriptGenerator::Settings script;
+        size_t steps = 20000;     //dialogue steps per progressDialogue/selectOption sample
+        size_t repetitions = 5;   //samples per benchmark, the median is reported
+        std::string filter;       //only run benchmarks whose name contains this
+        std::string outputPath;   //stdout if empty
+    };
+
+    struct Sample
+    {
+        size_t operations = 0;
+        double nanoseconds = 0;
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::string unit;
+        size_t operations;
+        double medianNsPerOp;
+        double minNsPerOp;
+    };
+
+    class CountingDelegate : public IDialogueDelegate
+    {
+    public:
+        size_t optionCount = 0;
+        bool hasEnded = false;
+
+        void onProgress(const DialogueContent& _content) override
+        {
+            optionCount = _content.options.size();
+            hasEnded = false;
+        }
+
+        void onEnd() override
+        {
+            optionCount = 0;
+            hasEnded = true;
+        }
+
+        void onPaused() override
+        {
+        }
+    };
+
+    volatile size_t s_sink = 0;
+
+    double getTime()
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Sample time(size_t _operations, const std::function<void()>& _func)
+    {
+        Sample sample;
+        const double start = getTime();
+        _func();
+        sample.nanoseconds = getTime() - start;
+        sample.operations = _operations;
+        return sample;
+    }
+
+    void fillStore(DialogueVariableStore& out_store, const DialogueScriptGenerator::Settings& _settings)
+    {
+        for(size_t i = 0; i < _settings.variableCount; ++i)
+        {
+            out_store.setValue(DialogueScriptGenerator::getVariableName(i), DialogueValue::fromNumber(static_cast<double>(i % 10)));
+        }
+    }
+
+    void addNodes(DialogueController& _controller, const std::vector<DialogueNode>& _nodes)
+    {
+        for(const auto& node : _nodes)
+        {
+            _controller.addNode(node);
+        }
+    }
+
+    //start somewhere new once dialogue ends, options are picked at random
+    struct DialogueRunner
+    {
+        DialogueRandom random;
+        size_t nodeCount;
+
+        void restart(DialogueController& _controller, CountingDelegate& _delegate)
+        {
+            _delegate.hasEnded = false;
+            _delegate.optionCount = 0;
+            _controller.start(DialogueScriptGenerator::getNodeName(random.nextIndex(static_cast<uint32_t>(nodeCount))));
+        }
+    };
+
+    bool parseSize(const char* _text, size_t& out_value)
+    {
+        char* end = nullptr;
+        const auto value = strtoull(_text, &end, 10);
+        if(end == _text || *end != 0) return false;
+        out_value = static_cast<size_t>(value);
+        return true;
+    }
+
+    bool parseFloat(const char* _text, float& out_value)
+    {
+        char* end = nullptr;
+        out_value = strtof(_text, &end);
+        return end != _text && *end == 0;
+    }
+
+    bool parseOptions(int _argc, char** _argv, Options& out_options)
+    {
+        auto& script = out_options.script;
+        for(int i = 1; i + 1 < _argc; i += 2)
+        {
+            const std::string name = _argv[i];
+            const char* value = _argv[i + 1];
+            size_t number = 0;
+            bool isValid = true;
+            if(name == "--seed") { isValid = parseSize(value, number); script.seed = number; }
+            else if(name == "--nodes") { isValid = parseSize(value, script.nodeCount) && script.nodeCount > 0; }
+            else if(name == "--lines") { isValid = parseSize(value, script.linesPerNode); }
+            else if(name == "--depth") { isValid = parseSize(value, number); script.maxDepth = static_cast<unsigned>(number); }
+            else if(name == "--fanout") { isValid = parseSize(value, number) && number > 0; script.optionFanOut = static_cast<unsigned>(number); }
+            else if(name == "--choices") { isValid = parseFloat(value, script.choiceDensity); }
+            else if(name == "--variants") { isValid = parseFloat(value, script.variantDensity); }
+            else if(name == "--variables") { isValid = parseFloat(value, script.variableDensity); }
+            else if(name == "--variable-count") { isValid = parseSize(value, script.variableCount) && script.variableCount > 0; }
+            else if(name == "--steps") { isValid = parseSize(value, out_options.steps) && out_options.steps > 0; }
+            else if(name == "--repetitions") { isValid = parseSize(value, out_options.repetitions) && out_options.repetitions > 0; }
+            else if(name == "--filter") { out_options.filter = value; }
+            else if(name == "--out") { out_options.outputPath = value; }
+            else { isValid = false; }
+
+            if(isValid == false)
+            {
+                fprintf(stderr, "Invalid option %s %s\n", name.c_str(), value);
+                return false;
+            }
+        }
+        if(_argc % 2 == 0)
+        {
+            fprintf(stderr, "Missing value for %s\n", _argv[_argc - 1]);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int _argc, char** _argv)
+{
+    Options options;
+    if(parseOptions(_argc, _argv, options) == false)
+    {
+        fprintf(stderr, "Usage: %s [--seed N] [--nodes N] [--lines N] [--depth N] [--fanout N] [--choices F] [--variants F]\n"
+                        "       [--variables F] [--variable-count N] [--steps N] [--repetitions N] [--filter name] [--out file.json]\n", _argv[0]);
+        return 1;
+    }
+    const auto& settings = options.script;
+
+    std::vector<DialogueController::NodeSource> sources;
+    DialogueScriptGenerator::generate(settings, sources);
+
+    DialogueVariableStore store;
+    fillStore(store, settings);
+
+    //parse once up front for the benchmarks that take parsed input
+    std::vector<DialogueNode> nodes;
+    {
+        DialogueLineParser parser(&store);
+        for(const auto& source : sources)
+        {
+            parser.parse(source.name, source.tags, source.body, 0, nodes);
+        }
+    }
+    std::vector<DialogueNode::Condition> conditions;
+    std::vector<std::string> texts;
+    size_t lineCount = 0, scriptBytes = 0;
+    for(const auto& source : sources)
+    {
+        scriptBytes += source.body.size();
+    }
+    for(const auto& node : nodes)
+    {
+        for(const auto& line : node.lines)
+        {
+            const auto& variants = line.variants.empty() ? std::vector<DialogueNode::Line>(1, line) : line.variants;
+            for(const auto& variant : variants)
+            {
+                ++lineCount;
+                conditions.insert(conditions.end(), variant.conditions.begin(), variant.conditions.end());
+                for(const auto& option : variant.options)
+                {
+                    conditions.insert(conditions.end(), option.conditions.begin(), option.conditions.end());
+                }
+                if(variant.content.find("$(") != std::string::npos)
+                {
+                    texts.push_back(variant.content);
+                }
+            }
+        }
+    }
+
+    struct Benchmark
+    {
+        const char* name;
+        const char* unit;
+        std::function<Sample()> run;
+    };
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({ "parse", "node", [&]()
+    {
+        DialogueLineParser parser(&store);
+        std::vector<DialogueNode> parsed;
+        return time(sources.size(), [&]()
+        {
+            for(const auto& source : sources)
+            {
+                parser.parse(source.name, source.tags, source.body, 0, parsed);
+            }
+        });
+    }});
+
+    benchmarks.push_back({ "addNode", "node", [&]()
+    {
+        DialogueController controller(nullptr, &store);
+        return time(sources.size(), [&]()
+        {
+            for(const auto& source : sources)
+            {
+                controller.addNode(source.name, source.tags, source.body, 0);
+            }
+        });
+    }});
+
+    benchmarks.push_back({ "addParsedNode", "node", [&]()
+    {
+        DialogueController controller(nullptr, &store);
+        return time(nodes.size(), [&]() { addNodes(controller, nodes); });
+    }});
+
+    benchmarks.push_back({ "resolveCondition", "condition", [&]()
+    {
+        DialogueLineParser parser(&store);
+        const size_t passes = std::max<size_t>(1, 200000 / std::max<size_t>(1, conditions.size()));
+        return time(passes * conditions.size(), [&]()
+        {
+            for(size_t pass = 0; pass < passes; ++pass)
+            {
+                for(const auto& condition : conditions)
+                {
+                    s_sink += parser.resolveCondition(condition);
+                }
+            }
+        });
+    }});
+
+    benchmarks.push_back({ "substituteVariables", "line", [&]()
+    {
+        DialogueLineParser parser(&store);
+        std::string result;
+        const size_t passes = std::max<size_t>(1, 100000 / std::max<size_t>(1, texts.size()));
+        return time(passes * texts.size(), [&]()
+        {
+            for(size_t pass = 0; pass < passes; ++pass)
+            {
+                for(const auto& text : texts)
+                {
+                    result.clear();
+                    parser.substituteVariables(text, result);
+                    s_sink += result.size();
+                }
+            }
+        });
+    }});
+
+    //progressDialogue and selectOption are measured from the same run, each call timed on its own
+    Sample progressSample, selectSample;
+    const auto runDialogue = [&]()
+    {
+        CountingDelegate delegate;
+        DialogueController controller(&delegate, &store);
+        addNodes(controller, nodes);
+        DialogueRunner runner = { DialogueRandom(settings.seed), sources.size() };
+        DialogueRandom choices(settings.seed + 1);
+        progressSample = Sample();
+        selectSample = Sample();
+        runner.restart(controller, delegate);
+        for(size_t step = 0; step < options.steps; ++step)
+        {
+            if(delegate.hasEnded)
+            {
+                runner.restart(controller, delegate);
+            }
+            else if(delegate.optionCount > 0)
+            {
+                const auto index = choices.nextIndex(static_cast<uint32_t>(delegate.optionCount));
+                const double start = getTime();
+                controller.selectOption(index);
+                selectSample.nanoseconds += getTime() - start;
+                ++selectSample.operations;
+            }
+            else
+            {
+                const double start = getTime();
+                controller.progressDialogue();
+                progressSample.nanoseconds += getTime() - start;
+                ++progressSample.operations;
+            }
+        }
+    };
+    benchmarks.push_back({ "progressDialogue", "step", [&]() { runDialogue(); return progressSample; } });
+    benchmarks.push_back({ "selectOption", "step", [&]() { runDialogue(); return selectSample; } });
+
+    benchmarks.push_back({ "skipDialogue", "skip", [&]()
+    {
+        CountingDelegate delegate;
+        DialogueController controller(&delegate, &store);
+        addNodes(controller, nodes);
+        DialogueRunner runner = { DialogueRandom(settings.seed), sources.size() };
+        Sample sample;
+        for(size_t skip = 0; skip < options.steps / 10 + 1; ++skip)
+        {
+            runner.restart(controller, delegate);
+            const double start = getTime();
+            controller.skipDialogue();
+            sample.nanoseconds += getTime() - start;
+            ++sample.operations;
+        }
+        return sample;
+    }});
+
+    std::vector<Result> results;
+    for(const auto& benchmark : benchmarks)
+    {
+        if(options.filter.empty() == false && strstr(benchmark.name, options.filter.c_str()) == nullptr)
+        {
+            continue;
+        }
+
+        std::vector<double> nsPerOp;
+        size_t operations = 0;
+        for(size_t repetition = 0; repetition < options.repetitions; ++repetition)
+        {
+            const auto sample = benchmark.run();
+            operations = sample.operations;
+            nsPerOp.push_back(sample.operations > 0 ? sample.nanoseconds / sample.operations : 0.0);
+        }
+        std::sort(nsPerOp.begin(), nsPerOp.end());
+        results.push_back({ benchmark.name, benchmark.unit, operations, nsPerOp[nsPerOp.size() / 2], nsPerOp.front() });
+        fprintf(stderr, "%-20s %12.1f ns/%-9s (min %.1f, %zu ops)\n", benchmark.name, results.back().medianNsPerOp,
+                benchmark.unit, results.back().minNsPerOp, operations);
+    }
+
+    FILE* output = options.outputPath.empty() ? stdout : fopen(options.outputPath.c_str(), "w");
+    if(output == nullptr)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", options.outputPath.c_str());
+        return 1;
+    }
+    fprintf(output, "{\n  \"settings\": {\"seed\": %llu, \"nodes\": %zu, \"linesPerNode\": %zu, \"maxDepth\": %u, \"optionFanOut\": %u,"
+                    " \"choiceDensity\": %g, \"variantDensity\": %g, \"variableDensity\": %g, \"variableCount\": %zu,"
+                    " \"steps\": %zu, \"repetitions\": %zu},\n",
+            static_cast<unsigned long long>(settings.seed), settings.nodeCount, settings.linesPerNode, settings.maxDepth,
+            settings.optionFanOut, settings.choiceDensity, settings.variantDensity, settings.variableDensity, settings.variableCount,
+            options.steps, options.repetitions);
+    fprintf(output, "  \"script\": {\"nodes\": %zu, \"lines\": %zu, \"conditions\": %zu, \"bytes\": %zu},\n",
+            nodes.size(), lineCount, conditions.size(), scriptBytes);
+    fprintf(output, "  \"benchmarks\": [");
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        fprintf(output, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"operations\": %zu, \"nsPerOp\": %.2f, \"minNsPerOp\": %.2f}",
+                i > 0 ? "," : "", result.name.c_str(), result.unit.c_str(), result.operations, result.medianNsPerOp, result.minNsPerOp);
+    }
+    fprintf(output, "\n  ]\n}\n");
+    if(output != stdout)
+    {
+        fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+/*
+ Seeded generator of synthetic Yarn scripts for benchmarks. The same settings always produce the same script.
+ Nodes mix plain lines, % groups, lines reading and setting variables, nested -> choices and [[Option|Node]] links to other nodes,
+ so dialogue started anywhere can keep running by selecting options.
+ */
+
+#include "DialogueController.h"
+#include "DialogueRandom.h"
+
+#include <string>
+#include <vector>
+
+class DialogueScriptGenerator
+{
+public:
+    struct Settings
+    {
+        uint64_t seed = 1;
+        size_t nodeCount = 500;
+        size_t linesPerNode = 20;      //top level lines, excluding the lines inside choices
+        unsigned maxDepth = 2;         //how deeply -> choices nest inside each other
+        unsigned optionFanOut = 3;     //options per -> choice
+        float choiceDensity = 0.1f;    //fraction of lines followed by a -> choice
+        float variantDensity = 0.1f;   //fraction of lines that are % groups
+        float variableDensity = 0.2f;  //fraction of lines substituting, testing or setting a variable
+        size_t variableCount = 64;
+    };
+
+    static const char* getVariableName(size_t _index)
+    {
+        static std::vector<std::string> s_names;
+        while(s_names.size() <= _index)
+        {
+            s_names.push_back("var" + std::to_string(s_names.size()));
+        }
+        return s_names[_index].c_str();
+    }
+
+    static std::string getNodeName(size_t _index)
+    {
+        return "Node" + std::to_string(_index);
+    }
+
+    static void generate(const Settings& _settings, std::vector<DialogueController::NodeSource>& out_sources)
+    {
+        DialogueScriptGenerator generator(_settings);
+        out_sources.clear();
+        out_sources.reserve(_settings.nodeCount);
+        for(size_t node = 0; node < _settings.nodeCount; ++node)
+        {
+            out_sources.push_back({ getNodeName(node), generator.makeTags(), generator.makeBody(node) });
+        }
+    }
+
+protected:
+    const Settings& m_settings;
+    DialogueRandom m_random;
+    std::string m_body;
+
+    DialogueScriptGenerator(const Settings& _settings)
+    : m_settings(_settings)
+    , m_random(_settings.seed)
+    {
+    }
+
+    bool roll(float _chance)
+    {
+        return m_random.next() < static_cast<uint32_t>(_chance * 4294967295.0f);
+    }
+
+    size_t pick(size_t _count)
+    {
+        return m_random.nextIndex(static_cast<uint32_t>(_count));
+    }
+
+    std::string makeTags()
+    {
+        static const char* s_tags[] = { "town", "forest", "quest", "merchant", "guard", "night" };
+        return std::string(s_tags[pick(6)]) + " " + s_tags[pick(6)];
+    }
+
+    std::string makeVariable()
+    {
+        return std::string("$(") + getVariableName(pick(m_settings.variableCount)) + ")";
+    }
+
+    void appendIndent(unsigned _depth)
+    {
+        m_body.append(_depth * 4, ' ');
+    }
+
+    void appendText()
+    {
+        static const char* s_words[] = { "the", "road", "north", "is", "closed", "since", "winter", "and", "nobody", "knows", "why",
+                                         "you", "should", "ask", "at", "inn", "about", "old", "mill" };
+        const size_t wordCount = 6 + pick(10);
+        for(size_t i = 0; i < wordCount; ++i)
+        {
+            if(i > 0) m_body += ' ';
+            if(roll(m_settings.variableDensity / wordCount))
+            {
+                m_body += makeVariable();
+            }
+            else
+            {
+                m_body += s_words[pick(sizeof(s_words) / sizeof(s_words[0]))];
+            }
+        }
+    }
+
+    void appendLine(unsigned _depth, const char* _prefix)
+    {
+        static const char* s_actors[] = { "Guard", "Merchant", "Player", "Innkeeper", "Stranger" };
+        appendIndent(_depth);
+        m_body += _prefix;
+        m_body += s_actors[pick(5)];
+        m_body += ": ";
+        appendText();
+        if(roll(m_settings.variableDensity / 2))
+        {
+            m_body += " <<if " + makeVariable() + " >= " + std::to_string(pick(10)) + ">>";
+        }
+        if(roll(m_settings.variableDensity / 4))
+        {
+            m_body += std::string(" <<set|") + getVariableName(pick(m_settings.variableCount)) + "|" + std::to_string(pick(10)) + ">>";
+        }
+        m_body += '\n';
+    }
+
+    void appendChoice(unsigned _depth)
+    {
+        for(unsigned option = 0; option < m_settings.optionFanOut; ++option)
+        {
+            appendIndent(_depth);
+            m_body += "->";
+            appendText();
+            m_body += '\n';
+            const size_t lineCount = 1 + pick(3);
+            for(size_t line = 0; line < lineCount; ++line)
+            {
+                appendLine(_depth + 1, "");
+            }
+            if(_depth + 1 < m_settings.maxDepth && roll(0.5f))
+            {
+                appendLine(_depth + 1, "");
+                appendChoice(_depth + 1);
+            }
+        }
+    }
+
+    std::string makeBody(size_t _node)
+    {
+        m_body.clear();
+        for(size_t line = 0; line < m_settings.linesPerNode; ++line)
+        {
+            if(roll(m_settings.variantDensity))
+            {
+                const size_t variantCount = 2 + pick(3);
+                for(size_t variant = 0; variant < variantCount; ++variant)
+                {
+                    appendLine(0, "% ");
+                }
+            }
+            else
+            {
+                appendLine(0, "");
+                if(m_settings.maxDepth > 0 && roll(m_settings.choiceDensity))
+                {
+                    appendChoice(0);
+                }
+            }
+        }
+
+        //always offer a way on so dialogue can run indefinitely
+        m_body += "Player: where now? [[Continue|" + getNodeName((_node + 1) % m_settings.nodeCount) + "]]";
+        m_body += " [[Elsewhere|" + getNodeName(pick(m_settings.nodeCount)) + "]]\n";
+        return m_body;
+    }
+};
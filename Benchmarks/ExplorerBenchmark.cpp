@@ -0,0 +1,145 @@
+/*
+ Measures how much of a script from DialogueScriptGenerator DialogueExplorer covers within a state budget, and how long it takes.
+ Defaults to 2500 nodes, about 50k top level lines. Results are written as JSON so runs can be compared across commits,
+ with a summary on stderr. See README.md for build instructions and options.
+ */
+
+#include "DialogueScriptGenerator.h"
+
+#include "DialogueExplorer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        DialogueScriptGenerator::Settings script;
+        size_t maxStates = 4000000;
+        unsigned threadCount = 0; //0 for one per hardware thread
+        std::string outputPath;   //stdout if empty
+    };
+
+    bool parseSize(const char* _text, size_t& out_value)
+    {
+        char* end = nullptr;
+        const auto value = strtoull(_text, &end, 10);
+        if(end == _text || *end != 0) return false;
+        out_value = static_cast<size_t>(value);
+        return true;
+    }
+
+    bool parseFloat(const char* _text, float& out_value)
+    {
+        char* end = nullptr;
+        out_value = strtof(_text, &end);
+        return end != _text && *end == 0;
+    }
+
+    bool parseOptions(int _argc, char** _argv, Options& out_options)
+    {
+        auto& script = out_options.script;
+        for(int i = 1; i + 1 < _argc; i += 2)
+        {
+            const std::string name = _argv[i];
+            const char* value = _argv[i + 1];
+            size_t number = 0;
+            bool isValid = true;
+            if(name == "--seed") { isValid = parseSize(value, number); script.seed = number; }
+            else if(name == "--nodes") { isValid = parseSize(value, script.nodeCount) && script.nodeCount > 0; }
+            else if(name == "--lines") { isValid = parseSize(value, script.linesPerNode); }
+            else if(name == "--depth") { isValid = parseSize(value, number); script.maxDepth = static_cast<unsigned>(number); }
+            else if(name == "--fanout") { isValid = parseSize(value, number) && number > 0; script.optionFanOut = static_cast<unsigned>(number); }
+            else if(name == "--choices") { isValid = parseFloat(value, script.choiceDensity); }
+            else if(name == "--variants") { isValid = parseFloat(value, script.variantDensity); }
+            else if(name == "--variables") { isValid = parseFloat(value, script.variableDensity); }
+            else if(name == "--variable-count") { isValid = parseSize(value, script.variableCount) && script.variableCount > 0; }
+            else if(name == "--max-states") { isValid = parseSize(value, out_options.maxStates) && out_options.maxStates > 0; }
+            else if(name == "--threads") { isValid = parseSize(value, number); out_options.threadCount = static_cast<unsigned>(number); }
+            else if(name == "--out") { out_options.outputPath = value; }
+            else { isValid = false; }
+
+            if(isValid == false)
+            {
+                fprintf(stderr, "Invalid option %s %s\n", name.c_str(), value);
+                return false;
+            }
+        }
+        if(_argc % 2 == 0)
+        {
+            fprintf(stderr, "Missing value for %s\n", _argv[_argc - 1]);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int _argc, char** _argv)
+{
+    Options options;
+    options.script.nodeCount = 2500;
+    if(parseOptions(_argc, _argv, options) == false)
+    {
+        fprintf(stderr, "Usage: %s [--seed N] [--nodes N] [--lines N] [--depth N] [--fanout N] [--choices F] [--variants F]\n"
+                        "       [--variables F] [--variable-count N] [--max-states N] [--threads N] [--out file.json]\n", _argv[0]);
+        return 1;
+    }
+    const auto& settings = options.script;
+
+    std::vector<DialogueController::NodeSource> sources;
+    DialogueScriptGenerator::generate(settings, sources);
+
+    DialogueExplorer explorer;
+    DialogueExplorer::Settings exploreSettings;
+    exploreSettings.maxStates = options.maxStates;
+    exploreSettings.threadCount = options.threadCount;
+    const auto start = std::chrono::steady_clock::now();
+    if(explorer.explore(sources, exploreSettings) == false)
+    {
+        fprintf(stderr, "Failed to explore the script\n");
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const auto& report = explorer.getReport();
+    size_t coveredLines = 0, coveredOptions = 0;
+    for(const auto& line : report.lines)
+    {
+        coveredLines += line.states > 0 ? 1 : 0;
+    }
+    for(const auto& option : report.options)
+    {
+        coveredOptions += option.states > 0 ? 1 : 0;
+    }
+    fprintf(stderr, "lines %zu/%zu (%.2f%%), options %zu/%zu, %llu states, %llu steps, %.1f s%s\n",
+            coveredLines, report.lines.size(), report.lines.empty() ? 0.0 : 100.0 * coveredLines / report.lines.size(),
+            coveredOptions, report.options.size(), static_cast<unsigned long long>(report.states),
+            static_cast<unsigned long long>(report.steps), seconds, report.isComplete ? "" : ", cut off at --max-states");
+
+    FILE* output = options.outputPath.empty() ? stdout : fopen(options.outputPath.c_str(), "w");
+    if(output == nullptr)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", options.outputPath.c_str());
+        return 1;
+    }
+    fprintf(output, "{\n  \"settings\": {\"seed\": %llu, \"nodes\": %zu, \"linesPerNode\": %zu, \"maxDepth\": %u, \"optionFanOut\": %u,"
+                    " \"choiceDensity\": %g, \"variantDensity\": %g, \"variableDensity\": %g, \"variableCount\": %zu,"
+                    " \"maxStates\": %zu, \"threads\": %u},\n",
+            static_cast<unsigned long long>(settings.seed), settings.nodeCount, settings.linesPerNode, settings.maxDepth,
+            settings.optionFanOut, settings.choiceDensity, settings.variantDensity, settings.variableDensity, settings.variableCount,
+            options.maxStates, options.threadCount);
+    fprintf(output, "  \"coverage\": {\"nodes\": %zu, \"lines\": %zu, \"coveredLines\": %zu, \"options\": %zu, \"coveredOptions\": %zu,"
+                    " \"states\": %llu, \"steps\": %llu, \"seconds\": %.3f, \"complete\": %s}\n}\n",
+            report.nodeNames.size(), report.lines.size(), coveredLines, report.options.size(), coveredOptions,
+            static_cast<unsigned long long>(report.states), static_cast<unsigned long long>(report.steps), seconds,
+            report.isComplete ? "true" : "false");
+    if(output != stdout)
+    {
+        fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ Compares DialogueVariableStore against a naive std::map based IDialogueResolver
+ on the two hot resolver paths: condition resolution and variable substitution.
+ See README.md for build instructions.
+ */
+
+#include "DialogueLineParser.h"
+#include "DialogueNode.h"
+#include "DialogueVariableStore.h"
+#include "IDialogueResolver.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class MapResolver : public IDialogueResolver
+    {
+    public:
+        std::map<std::string, std::string> variables;
+
+        bool resolveVariable(const std::string& _varName, std::string& out_value) const override
+        {
+            auto it = variables.find(_varName);
+            if(it == variables.end()) return false;
+            out_value = it->second;
+            return true;
+        }
+
+        bool resolveAction(const std::string&, const std::vector<std::string>&) const override
+        {
+            return false;
+        }
+    };
+
+    const size_t k_variableCount = 2000;
+    const size_t k_iterations = 200000;
+
+    volatile size_t s_sink = 0;
+
+    template <typename F>
+    double measure(F _func)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < k_iterations; ++i)
+        {
+            _func(i);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / k_iterations;
+    }
+
+    void run(const char* _name, const IDialogueResolver& _resolver)
+    {
+        DialogueLineParser parser(&_resolver);
+
+        std::vector<DialogueNode::Condition> conditions(16);
+        for(size_t i = 0; i < conditions.size(); ++i)
+        {
+            DialogueLineParser::compileCondition("$(var" + std::to_string(i * 97 % k_variableCount) + ") >= 10", conditions[i]);
+        }
+        const std::string text = "Hello $(name), you have $(gold) gold, $(var17) gems and $(var1234) keys.";
+
+        const double conditionNs = measure([&](size_t i) { s_sink += parser.resolveCondition(conditions[i % conditions.size()]); });
+        const double substituteNs = measure([&](size_t) { s_sink += parser.substituteVariables(text).size(); });
+
+        printf("%-12s condition %8.1f ns   substitute %8.1f ns\n", _name, conditionNs, substituteNs);
+    }
+}
+
+int main()
+{
+    MapResolver mapResolver;
+    DialogueVariableStore store;
+    for(size_t i = 0; i < k_variableCount; ++i)
+    {
+        const auto name = "var" + std::to_string(i);
+        mapResolver.variables[name] = std::to_string(i);
+        store.setValue(name, DialogueValue::fromNumber(static_cast<double>(i)));
+    }
+    mapResolver.variables["name"] = "Ada";
+    mapResolver.variables["gold"] = "250";
+    store.setValue("name", DialogueValue::fromString("Ada"));
+    store.setValue("gold", DialogueValue::fromNumber(250));
+
+    printf("%zu variables, %zu iterations\n", k_variableCount, k_iterations);
+    run("std::map", mapResolver);
+    run("VariableStore", store);
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ Fuzz target for DialogueLineParser::parse, the DialogueController run loop and DialogueLookahead.
+ The input is split into node bodies on lines containing only ===, named Start, N1, N2 and so on, so bodies can goto each other.
+ Built with libFuzzer it defines LLVMFuzzerTestOneInput. Built with DIALOGUE_FUZZ_STANDALONE it runs files or directories of inputs,
+ such as Fuzz/corpus, and flags inputs whose parse and run time grows faster than their size.
+ See README.md for build instructions.
+ */
+
+#include "DialogueContent.h"
+#include "DialogueController.h"
+#include "DialogueLineParser.h"
+#include "DialogueLookahead.h"
+#include "DialogueNode.h"
+#include "DialogueVariableStore.h"
+#include "IDialogueDelegate.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const std::string k_nodeSeparator = "\n===\n";
+    const size_t k_maxSteps = 256; //dialogue steps per input, bodies can link to each other indefinitely
+    const size_t k_historyCapacity = 8;
+    const size_t k_lookaheadSteps = 4;
+    const size_t k_lookaheadUpdates = 8; //an update can walk the rest of a node past conditional lines, so only the first steps look ahead
+
+    class FuzzDelegate : public IDialogueDelegate
+    {
+    public:
+        size_t optionCount = 0;
+        bool hasEnded = false;
+
+        void onProgress(const DialogueContent& _content) override
+        {
+            optionCount = _content.options.size();
+        }
+
+        void onEnd() override
+        {
+            optionCount = 0;
+            hasEnded = true;
+        }
+
+        void onPaused() override
+        {
+        }
+    };
+
+    std::string getNodeName(size_t _index)
+    {
+        return _index == 0 ? "Start" : "N" + std::to_string(_index);
+    }
+
+    void splitNodes(const std::string& _input, std::vector<std::string>& out_bodies)
+    {
+        size_t start = 0;
+        auto end = _input.find(k_nodeSeparator);
+        while(end != std::string::npos)
+        {
+            out_bodies.push_back(_input.substr(start, end - start));
+            start = end + k_nodeSeparator.size();
+            end = _input.find(k_nodeSeparator, start);
+        }
+        out_bodies.push_back(_input.substr(start));
+    }
+
+    void addNodes(DialogueController& _controller, const std::vector<std::string>& _bodies)
+    {
+        _controller.setMarkupEnabled(true);
+        for(size_t i = 0; i < _bodies.size(); ++i)
+        {
+            _controller.addNode(getNodeName(i), "", _bodies[i], static_cast<unsigned>(i));
+        }
+    }
+
+    //@param _isRewinding also saves and restores the state and rewinds every few steps
+    void runDialogue(DialogueController& _controller, FuzzDelegate& _delegate, const IDialogueResolver& _resolver, size_t _optionSeed, bool _isRewinding)
+    {
+        DialogueController::StateBuffer state;
+        DialogueLookahead lookahead(_controller);
+        _controller.start();
+        for(size_t step = 0; step < k_maxSteps && _delegate.hasEnded == false; ++step)
+        {
+            //looks through the branches the controller won't take, with and without evaluating conditions
+            if(step < k_lookaheadUpdates)
+            {
+                lookahead.update(*_controller.getNodeStack(), k_lookaheadSteps, step % 2 == 0 ? &_resolver : nullptr);
+            }
+
+            if(_isRewinding && step % 8 == 3)
+            {
+                _controller.saveState(state);
+                _controller.restoreState(state);
+            }
+            else if(_isRewinding && step % 8 == 7)
+            {
+                _controller.rewind(1 + (_optionSeed + step) % 2);
+            }
+            const bool didProgress = _delegate.optionCount > 0 ? _controller.selectOption((_optionSeed + step) % _delegate.optionCount)
+                                                               : _controller.progressDialogue();
+            if(didProgress == false && _delegate.optionCount == 0) break;
+        }
+        _controller.skipDialogue();
+    }
+
+    void runInput(const std::string& _input)
+    {
+        std::vector<std::string> bodies;
+        splitNodes(_input, bodies);
+
+        //the selected option index is taken from the input so different options get explored
+        const size_t optionSeed = _input.empty() ? 0 : static_cast<unsigned char>(_input.back());
+
+        DialogueVariableStore variables;
+        {
+            DialogueLineParser parser(&variables);
+            parser.setMarkupEnabled(true);
+            std::vector<DialogueNode> nodes;
+            for(size_t i = 0; i < bodies.size(); ++i)
+            {
+                parser.parse(getNodeName(i), "", bodies[i], static_cast<unsigned>(i), nodes);
+            }
+            for(const auto& node : nodes)
+            {
+                for(const auto& line : node.lines)
+                {
+                    std::string text;
+                    parser.substituteVariables(line.content, text);
+                    for(const auto& variant : line.variants)
+                    {
+                        parser.substituteVariables(variant.content, text);
+                    }
+                }
+            }
+        }
+
+        {
+            FuzzDelegate delegate;
+            DialogueController controller(&delegate, &variables);
+            addNodes(controller, bodies);
+            runDialogue(controller, delegate, variables, optionSeed, false);
+        }
+
+        //again on a pool resource with history, saving, restoring and rewinding
+        std::pmr::unsynchronized_pool_resource pool;
+        FuzzDelegate delegate;
+        DialogueController controller(&delegate, &variables, &pool);
+        controller.setHistoryCapacity(k_historyCapacity);
+        addNodes(controller, bodies);
+        runDialogue(controller, delegate, variables, optionSeed, true);
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* _data, size_t _size)
+{
+    runInput(std::string(reinterpret_cast<const char*>(_data), _size));
+    return 0;
+}
+
+#ifdef DIALOGUE_FUZZ_STANDALONE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const size_t k_scalingBaseSize = 4096;  //inputs are repeated to at least this size before timing, smaller runs are mostly noise
+    const size_t k_scalingFactor = 16;      //the base is then compared against this many copies of itself
+    const double k_scalingSlack = 4.0;      //allowed excess over linear growth, for cache effects and timer noise
+    const size_t k_timingRuns = 3;          //the fastest run is used
+
+    double timeInput(const std::string& _input)
+    {
+        double best = 0;
+        for(size_t run = 0; run < k_timingRuns; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            runInput(_input);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = run == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    }
+
+    std::string repeat(const std::string& _input, size_t _count)
+    {
+        std::string result;
+        result.reserve(_input.size() * _count);
+        for(size_t i = 0; i < _count; ++i)
+        {
+            result += _input;
+        }
+        return result;
+    }
+
+    //@return false if the input grew super-linearly
+    bool checkScaling(const std::string& _path, const std::string& _input)
+    {
+        if(_input.empty()) return true;
+
+        const auto base = repeat(_input, (k_scalingBaseSize + _input.size() - 1) / _input.size());
+        const double baseTime = timeInput(base);
+        const double scaledTime = timeInput(repeat(base, k_scalingFactor));
+        const double ratio = scaledTime / std::max(baseTime, 1e-6);
+        if(ratio > k_scalingFactor * k_scalingSlack)
+        {
+            fprintf(stderr, "SUPERLINEAR %s: %zu bytes took %.3f ms, %zux took %.3f ms (%.1fx)\n",
+                    _path.c_str(), base.size(), baseTime * 1000, k_scalingFactor, scaledTime * 1000, ratio);
+            return false;
+        }
+        return true;
+    }
+
+    bool readFile(const std::string& _path, std::string& out_data)
+    {
+        std::ifstream file(_path, std::ios::binary);
+        if(file.fail()) return false;
+        out_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+}
+
+int main(int _argc, char** _argv)
+{
+    if(_argc < 2)
+    {
+        fprintf(stderr, "Usage: %s input|directory...\n", _argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    for(int i = 1; i < _argc; ++i)
+    {
+        if(std::filesystem::is_directory(_argv[i]))
+        {
+            for(const auto& entry : std::filesystem::directory_iterator(_argv[i]))
+            {
+                if(entry.is_regular_file()) paths.push_back(entry.path().string());
+            }
+        }
+        else
+        {
+            paths.push_back(_argv[i]);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    size_t failures = 0;
+    for(const auto& path : paths)
+    {
+        std::string input;
+        if(readFile(path, input) == false)
+        {
+            fprintf(stderr, "Failed to read '%s'\n", path.c_str());
+            failures++;
+            continue;
+        }
+        runInput(input);
+        if(checkScaling(path, input) == false)
+        {
+            failures++;
+        }
+    }
+    fprintf(stderr, "%zu inputs, %zu failed\n", paths.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "DialogueActionRegistry.h"
+
+#include "DialogueMacros.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    std::string toLower(const std::string& _string)
+    {
+        std::string lower(_string);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return lower;
+    }
+}
+
+DialogueActionRegistry::HandlerId DialogueActionRegistry::registerAction(const std::string& _name,
+                                                                        const std::vector<DialogueValue::Type>& _parameterTypes,
+                                                                        const Handler& _handler,
+                                                                        bool _isVariadic)
+{
+    const auto key = toLower(_name);
+    if(m_handlerIds.find(key) != m_handlerIds.end())
+    {
+        LOGERROR("Failed to register action '%s': name already in use", _name.c_str());
+        return k_invalidId;
+    }
+
+    const auto id = static_cast<HandlerId>(m_handlers.size());
+    m_handlers.push_back({ _name, _parameterTypes, _handler, _isVariadic });
+    m_handlerIds.insert(std::make_pair(key, id));
+    return id;
+}
+
+DialogueActionRegistry::HandlerId DialogueActionRegistry::find(const std::string& _name) const
+{
+    auto it = m_handlerIds.find(toLower(_name));
+    if(it != m_handlerIds.end())
+    {
+        return it->second;
+    }
+    return k_invalidId;
+}
+
+const std::vector<DialogueValue::Type>& DialogueActionRegistry::getParameterTypes(HandlerId _id) const
+{
+    return m_handlers[_id].parameterTypes;
+}
+
+bool DialogueActionRegistry::isVariadic(HandlerId _id) const
+{
+    return m_handlers[_id].isVariadic;
+}
+
+void DialogueActionRegistry::invoke(HandlerId _id, const DialogueValue* _args, size_t _count) const
+{
+    if(_id < m_handlers.size())
+    {
+        m_handlers[_id].handler(_args, _count);
+    }
+    else
+    {
+        LOGERROR("Failed to invoke action: invalid handler id (%u)", _id);
+    }
+}
+
+bool DialogueActionRegistry::convert(const std::string& _text, DialogueValue::Type _type, DialogueValue& out_value)
+{
+    switch(_type)
+    {
+        case DialogueValue::Type::Bool:
+        case DialogueValue::Type::Number:
+        {
+            const auto value = DialogueValue::parse(_text);
+            if(value.type != DialogueValue::Type::Bool && value.type != DialogueValue::Type::Number)
+            {
+                return false;
+            }
+            out_value = _type == DialogueValue::Type::Bool ? DialogueValue::fromBool(value.asBool()) : DialogueValue::fromNumber(value.asNumber());
+            return true;
+        }
+        case DialogueValue::Type::String:
+        default:
+            out_value = DialogueValue::fromString(_text);
+            return true;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "DialogueValue.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*! Registry of action handlers with typed parameters.
+ DialogueController binds every <<action|param|...>> to a handler when a node is added: names and parameter types are
+ resolved once, constant parameters are converted up front and only parameters containing $(variables) are resolved when run */
+class DialogueActionRegistry
+{
+public:
+    typedef unsigned HandlerId;
+    static constexpr HandlerId k_invalidId = ~0u;
+
+    /*! Untyped handler, receives the arguments as values */
+    typedef std::function<void(const DialogueValue* _args, size_t _count)> Handler;
+
+    /*! Conversion from an argument value to a handler parameter type */
+    template <typename T> struct Argument;
+
+public:
+    /*! Register a handler taking typed parameters (bool, int, float, double or std::string).
+     Parameters are converted from text when the action is linked
+     @param _name action name, matched case insensitively
+     @return the handler id or k_invalidId if the name is already registered */
+    template <typename... Args>
+    HandlerId registerAction(const std::string& _name, std::function<void(Args...)> _handler)
+    {
+        return registerAction(_name, { Argument<typename std::decay<Args>::type>::k_type... },
+                              makeHandler(std::move(_handler), std::index_sequence_for<Args...>()));
+    }
+
+    /*! Register a handler for any callable with a void return, deducing its parameter types */
+    template <typename F>
+    HandlerId registerAction(const std::string& _name, F _handler)
+    {
+        return registerAction(_name, std::function<typename Signature<decltype(&F::operator())>::Type>(std::move(_handler)));
+    }
+
+    /*! Register an untyped handler
+     @param _parameterTypes the expected parameter types, params are converted to these when linked
+     @param _isVariadic if true any number of parameters is accepted and passed as text */
+    HandlerId registerAction(const std::string& _name, const std::vector<DialogueValue::Type>& _parameterTypes, const Handler& _handler, bool _isVariadic = false);
+
+    /*! @return the handler for an action name or k_invalidId */
+    HandlerId find(const std::string& _name) const;
+
+    const std::vector<DialogueValue::Type>& getParameterTypes(HandlerId _id) const;
+    bool isVariadic(HandlerId _id) const;
+
+    void invoke(HandlerId _id, const DialogueValue* _args, size_t _count) const;
+
+    /*! Convert parameter text to the given type
+     @return false if the text cannot be represented as that type */
+    static bool convert(const std::string& _text, DialogueValue::Type _type, DialogueValue& out_value);
+
+protected:
+    struct Entry
+    {
+        std::string name;
+        std::vector<DialogueValue::Type> parameterTypes;
+        Handler handler;
+        bool isVariadic;
+    };
+    std::vector<Entry> m_handlers;
+    std::map<std::string, HandlerId> m_handlerIds; //keyed by lower case name
+
+    template <typename T> struct Signature;
+    template <typename C, typename... Args> struct Signature<void (C::*)(Args...) const> { typedef void Type(Args...); };
+    template <typename C, typename... Args> struct Signature<void (C::*)(Args...)> { typedef void Type(Args...); };
+
+    template <typename... Args, size_t... Indices>
+    static Handler makeHandler(std::function<void(Args...)> _handler, std::index_sequence<Indices...>)
+    {
+        return [_handler](const DialogueValue* _args, size_t)
+        {
+            _handler(Argument<typename std::decay<Args>::type>::get(_args[Indices])...);
+        };
+    }
+};
+
+template <> struct DialogueActionRegistry::Argument<bool>
+{
+    static constexpr DialogueValue::Type k_type = DialogueValue::Type::Bool;
+    static bool get(const DialogueValue& _value) { return _value.asBool(); }
+};
+
+template <> struct DialogueActionRegistry::Argument<int>
+{
+    static constexpr DialogueValue::Type k_type = DialogueValue::Type::Number;
+    static int get(const DialogueValue& _value) { return static_cast<int>(_value.asNumber()); }
+};
+
+template <> struct DialogueActionRegistry::Argument<float>
+{
+    static constexpr DialogueValue::Type k_type = DialogueValue::Type::Number;
+    static float get(const DialogueValue& _value) { return static_cast<float>(_value.asNumber()); }
+};
+
+template <> struct DialogueActionRegistry::Argument<double>
+{
+    static constexpr DialogueValue::Type k_type = DialogueValue::Type::Number;
+    static double get(const DialogueValue& _value) { return _value.asNumber(); }
+};
+
+template <> struct DialogueActionRegistry::Argument<std::string>
+{
+    static constexpr DialogueValue::Type k_type = DialogueValue::Type::String;
+    static const std::string& get(const DialogueValue& _value) { return _value.string; }
+};
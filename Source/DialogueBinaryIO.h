@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*! Appends little-endian fixed width values and LEB128 varints to a byte buffer.
+ Used for state snapshots and any other compact binary data the dialogue system writes */
+class DialogueBinaryWriter
+{
+public:
+    DialogueBinaryWriter(std::vector<uint8_t>& out_buffer)
+    : m_buffer(out_buffer)
+    {
+    }
+
+    void writeUInt8(uint8_t _value)
+    {
+        m_buffer.push_back(_value);
+    }
+
+    void writeUInt32(uint32_t _value)
+    {
+        for(unsigned i = 0; i < 4; ++i)
+        {
+            m_buffer.push_back(static_cast<uint8_t>(_value >> (i * 8)));
+        }
+    }
+
+    void writeUInt64(uint64_t _value)
+    {
+        for(unsigned i = 0; i < 8; ++i)
+        {
+            m_buffer.push_back(static_cast<uint8_t>(_value >> (i * 8)));
+        }
+    }
+
+    void writeVarUInt(uint64_t _value)
+    {
+        while(_value >= 0x80)
+        {
+            m_buffer.push_back(static_cast<uint8_t>(_value | 0x80));
+            _value >>= 7;
+        }
+        m_buffer.push_back(static_cast<uint8_t>(_value));
+    }
+
+    void writeBytes(const void* _data, size_t _size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(_data);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + _size);
+    }
+
+    void writeString(const std::string& _value)
+    {
+        writeVarUInt(_value.size());
+        writeBytes(_value.data(), _value.size());
+    }
+
+    size_t getSize() const
+    {
+        return m_buffer.size();
+    }
+
+protected:
+    std::vector<uint8_t>& m_buffer;
+};
+
+/*! Reads values written by DialogueBinaryWriter.
+ Every read is bounds checked and returns false once the data is exhausted or malformed */
+class DialogueBinaryReader
+{
+public:
+    DialogueBinaryReader(const uint8_t* _data, size_t _size)
+    : m_data(_data)
+    , m_size(_size)
+    , m_offset(0)
+    {
+    }
+
+    bool readUInt8(uint8_t& out_value)
+    {
+        if(m_offset + 1 > m_size) return false;
+        out_value = m_data[m_offset++];
+        return true;
+    }
+
+    bool readUInt32(uint32_t& out_value)
+    {
+        if(m_offset + 4 > m_size) return false;
+        out_value = 0;
+        for(unsigned i = 0; i < 4; ++i)
+        {
+            out_value |= static_cast<uint32_t>(m_data[m_offset++]) << (i * 8);
+        }
+        return true;
+    }
+
+    bool readUInt64(uint64_t& out_value)
+    {
+        if(m_offset + 8 > m_size) return false;
+        out_value = 0;
+        for(unsigned i = 0; i < 8; ++i)
+        {
+            out_value |= static_cast<uint64_t>(m_data[m_offset++]) << (i * 8);
+        }
+        return true;
+    }
+
+    bool readVarUInt(uint64_t& out_value)
+    {
+        out_value = 0;
+        for(unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if(m_offset >= m_size) return false;
+            const uint8_t byte = m_data[m_offset++];
+            out_value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if((byte & 0x80) == 0) return true;
+        }
+        return false; //overlong encoding
+    }
+
+    bool readBytes(void* out_data, size_t _size)
+    {
+        if(_size > m_size - m_offset) return false;
+        memcpy(out_data, m_data + m_offset, _size);
+        m_offset += _size;
+        return true;
+    }
+
+    bool readString(std::string& out_value)
+    {
+        uint64_t size = 0;
+        if(readVarUInt(size) == false || size > m_size - m_offset) return false;
+        out_value.assign(reinterpret_cast<const char*>(m_data + m_offset), static_cast<size_t>(size));
+        m_offset += static_cast<size_t>(size);
+        return true;
+    }
+
+    bool isAtEnd() const
+    {
+        return m_offset == m_size;
+    }
+
+    size_t getOffset() const
+    {
+        return m_offset;
+    }
+
+    size_t getRemaining() const
+    {
+        return m_size - m_offset;
+    }
+
+protected:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset;
+};
@@ -0,0 +1,771 @@
+#include "DialogueCompactScript.h"
+
+#include "DialogueBinaryIO.h"
+#include "DialogueHash.h"
+#include "DialogueLineParser.h"
+
+#include <cstring>
+
+namespace
+{
+    //every element takes at least a byte, so a count larger than the remaining data is malformed and never allocated
+    bool readCount(DialogueBinaryReader& _reader, size_t& out_count)
+    {
+        uint64_t count = 0;
+        if(_reader.readVarUInt(count) == false || count > _reader.getRemaining()) return false;
+        out_count = static_cast<size_t>(count);
+        return true;
+    }
+
+    bool readVarUInt32(DialogueBinaryReader& _reader, uint32_t& out_value)
+    {
+        uint64_t value = 0;
+        if(_reader.readVarUInt(value) == false || value > UINT32_MAX) return false;
+        out_value = static_cast<uint32_t>(value);
+        return true;
+    }
+
+    size_t getStringHeapSize(const std::string& _string)
+    {
+        //capacity beyond the small string buffer means the string owns an allocation
+        return _string.capacity() > std::string().capacity() ? _string.capacity() + 1 : 0;
+    }
+
+    template <typename T>
+    size_t getVectorHeapSize(const std::vector<T>& _vector)
+    {
+        return _vector.capacity() * sizeof(T);
+    }
+
+    size_t getHeapSize(const std::vector<DialogueNode::Markup>& _markup)
+    {
+        size_t size = getVectorHeapSize(_markup);
+        for(const auto& markup : _markup)
+        {
+            size += getStringHeapSize(markup.name) + getStringHeapSize(markup.value);
+        }
+        return size;
+    }
+
+    size_t getHeapSize(const std::vector<DialogueNode::Condition>& _conditions)
+    {
+        size_t size = getVectorHeapSize(_conditions);
+        for(const auto& condition : _conditions)
+        {
+            size += getStringHeapSize(condition.source)
+                  + getStringHeapSize(condition.lvalue.value)
+                  + getStringHeapSize(condition.rvalue.value)
+                  + getVectorHeapSize(condition.variables);
+            for(const auto& variable : condition.variables)
+            {
+                size += getStringHeapSize(variable);
+            }
+        }
+        return size;
+    }
+
+    size_t getHeapSize(const std::vector<DialogueNode::Action>& _actions)
+    {
+        size_t size = getVectorHeapSize(_actions);
+        for(const auto& action : _actions)
+        {
+            size += getStringHeapSize(action.name)
+                  + getVectorHeapSize(action.params)
+                  + getVectorHeapSize(action.handlerParams)
+                  + getVectorHeapSize(action.args)
+                  + getVectorHeapSize(action.dynamicParams);
+            for(const auto& param : action.params)
+            {
+                size += getStringHeapSize(param);
+            }
+            for(const auto& param : action.handlerParams)
+            {
+                size += getStringHeapSize(param);
+            }
+        }
+        return size;
+    }
+
+    size_t getHeapSize(const DialogueNode::Line& _line)
+    {
+        size_t size = getStringHeapSize(_line.actorKey)
+                    + getStringHeapSize(_line.content)
+                    + getStringHeapSize(_line.gotoNode)
+                    + getHeapSize(_line.markup)
+                    + getHeapSize(_line.conditions)
+                    + getHeapSize(_line.actions)
+                    + getVectorHeapSize(_line.options)
+                    + getVectorHeapSize(_line.variants);
+        for(const auto& option : _line.options)
+        {
+            size += getStringHeapSize(option.content)
+                  + getStringHeapSize(option.gotoNode)
+                  + getHeapSize(option.markup)
+                  + getHeapSize(option.conditions)
+                  + getHeapSize(option.actions);
+        }
+        for(const auto& variant : _line.variants)
+        {
+            size += getHeapSize(variant);
+        }
+        return size;
+    }
+}
+
+double DialogueCompactScript::MemoryReport::getCompactBytesPerLine() const
+{
+    return lineCount > 0 ? static_cast<double>(compactBytes) / lineCount : 0.0;
+}
+
+double DialogueCompactScript::MemoryReport::getExpandedBytesPerLine() const
+{
+    return lineCount > 0 ? static_cast<double>(expandedBytes) / lineCount : 0.0;
+}
+
+DialogueCompactScript::DialogueCompactScript()
+: m_lineCount(0)
+{
+}
+
+DialogueCompactScript::NodeIndex DialogueCompactScript::add(const DialogueNode& _node)
+{
+    NodeRecord record;
+    record.name = intern(_node.name);
+    record.parent = intern(_node.parent);
+    record.tags = intern(_node.tags);
+
+    //reserve the node's lines first so they stay contiguous, variants are appended after them
+    record.lines.begin = static_cast<uint32_t>(m_lines.size());
+    record.lines.count = static_cast<uint32_t>(_node.lines.size());
+    m_lines.resize(m_lines.size() + _node.lines.size());
+    for(size_t i = 0; i < _node.lines.size(); ++i)
+    {
+        addLine(_node.lines[i], record.lines.begin + static_cast<uint32_t>(i));
+    }
+
+    const auto index = static_cast<NodeIndex>(m_nodes.size());
+    m_nodes.push_back(record);
+    return index;
+}
+
+bool DialogueCompactScript::expand(NodeIndex _index, DialogueNode& out_node) const
+{
+    if(_index >= m_nodes.size())
+    {
+        return false;
+    }
+
+    const auto& record = m_nodes[_index];
+    out_node = DialogueNode();
+    out_node.name = getString(record.name);
+    out_node.parent = getString(record.parent);
+    out_node.tags = getString(record.tags);
+    out_node.lines.resize(record.lines.count);
+    std::string source;
+    for(uint32_t i = 0; i < record.lines.count; ++i)
+    {
+        expandLine(m_lines[record.lines.begin + i], source, out_node.lines[i]);
+    }
+    return true;
+}
+
+std::string_view DialogueCompactScript::getNodeName(NodeIndex _index) const
+{
+    return _index < m_nodes.size() ? getString(m_nodes[_index].name) : std::string_view();
+}
+
+size_t DialogueCompactScript::getNodeCount() const
+{
+    return m_nodes.size();
+}
+
+size_t DialogueCompactScript::getLineCount() const
+{
+    return m_lineCount;
+}
+
+std::string_view DialogueCompactScript::getString(StringId _id) const
+{
+    if(_id >= m_strings.size())
+    {
+        return std::string_view();
+    }
+    const auto& range = m_strings[_id];
+    return std::string_view(m_pool.data() + range.begin, range.count);
+}
+
+void DialogueCompactScript::clear()
+{
+    m_pool.clear();
+    m_strings.clear();
+    m_nodes.clear();
+    m_lines.clear();
+    m_lineExtras.clear();
+    m_options.clear();
+    m_actions.clear();
+    m_markup.clear();
+    m_conditions.clear();
+    m_params.clear();
+    m_stringIndex.clear();
+    m_lineCount = 0;
+}
+
+void DialogueCompactScript::shrinkToFit()
+{
+    m_pool.shrink_to_fit();
+    m_strings.shrink_to_fit();
+    m_nodes.shrink_to_fit();
+    m_lines.shrink_to_fit();
+    m_lineExtras.shrink_to_fit();
+    m_options.shrink_to_fit();
+    m_actions.shrink_to_fit();
+    m_markup.shrink_to_fit();
+    m_conditions.shrink_to_fit();
+    m_params.shrink_to_fit();
+    std::unordered_multimap<uint64_t, StringId>().swap(m_stringIndex);
+}
+
+size_t DialogueCompactScript::getSize() const
+{
+    //approximate a node based hash map as one allocation per entry plus the bucket array
+    const size_t indexSize = m_stringIndex.size() * (sizeof(std::pair<const uint64_t, StringId>) + 2 * sizeof(void*))
+                           + m_stringIndex.bucket_count() * sizeof(void*);
+
+    return sizeof(*this)
+         + m_pool.capacity()
+         + getVectorHeapSize(m_strings)
+         + getVectorHeapSize(m_nodes)
+         + getVectorHeapSize(m_lines)
+         + getVectorHeapSize(m_lineExtras)
+         + getVectorHeapSize(m_options)
+         + getVectorHeapSize(m_actions)
+         + getVectorHeapSize(m_markup)
+         + getVectorHeapSize(m_conditions)
+         + getVectorHeapSize(m_params)
+         + indexSize;
+}
+
+void DialogueCompactScript::write(DialogueBinaryWriter& _writer) const
+{
+    const auto writeRange = [&_writer](Range _range)
+    {
+        _writer.writeVarUInt(_range.begin);
+        _writer.writeVarUInt(_range.count);
+    };
+
+    _writer.writeString(m_pool);
+    _writer.writeVarUInt(m_strings.size());
+    for(const auto& range : m_strings)
+    {
+        writeRange(range);
+    }
+
+    _writer.writeVarUInt(m_nodes.size());
+    for(const auto& record : m_nodes)
+    {
+        _writer.writeVarUInt(record.name);
+        _writer.writeVarUInt(record.parent);
+        _writer.writeVarUInt(record.tags);
+        writeRange(record.lines);
+    }
+
+    //extra indices are written +1 so k_none wraps to 0
+    _writer.writeVarUInt(m_lines.size());
+    for(const auto& record : m_lines)
+    {
+        _writer.writeUInt64(record.lineId);
+        _writer.writeVarUInt(record.actorKey);
+        _writer.writeVarUInt(record.content);
+        _writer.writeVarUInt(static_cast<uint32_t>(record.extra + 1));
+    }
+
+    _writer.writeVarUInt(m_lineExtras.size());
+    for(const auto& extra : m_lineExtras)
+    {
+        writeRange(extra.markup);
+        writeRange(extra.conditions);
+        writeRange(extra.options);
+        writeRange(extra.actions);
+        writeRange(extra.variants);
+        _writer.writeVarUInt(extra.gotoNode);
+        uint32_t weight = 0;
+        static_assert(sizeof(weight) == sizeof(extra.weight), "weight is stored as its bits");
+        memcpy(&weight, &extra.weight, sizeof(weight));
+        _writer.writeUInt32(weight);
+    }
+
+    _writer.writeVarUInt(m_options.size());
+    for(const auto& record : m_options)
+    {
+        _writer.writeUInt64(record.lineId);
+        _writer.writeVarUInt(record.content);
+        _writer.writeVarUInt(record.gotoNode);
+        writeRange(record.markup);
+        writeRange(record.conditions);
+        writeRange(record.actions);
+        _writer.writeUInt8(record.isShortcut ? 1 : 0);
+    }
+
+    _writer.writeVarUInt(m_actions.size());
+    for(const auto& record : m_actions)
+    {
+        _writer.writeVarUInt(record.name);
+        writeRange(record.params);
+    }
+
+    _writer.writeVarUInt(m_markup.size());
+    for(const auto& record : m_markup)
+    {
+        _writer.writeVarUInt(record.name);
+        _writer.writeVarUInt(record.value);
+        _writer.writeVarUInt(record.start);
+        _writer.writeVarUInt(record.length);
+    }
+
+    _writer.writeVarUInt(m_conditions.size());
+    for(const auto id : m_conditions)
+    {
+        _writer.writeVarUInt(id);
+    }
+    _writer.writeVarUInt(m_params.size());
+    for(const auto id : m_params)
+    {
+        _writer.writeVarUInt(id);
+    }
+}
+
+bool DialogueCompactScript::read(DialogueBinaryReader& _reader)
+{
+    clear();
+
+    const auto readRange = [&_reader](Range& out_range)
+    {
+        return readVarUInt32(_reader, out_range.begin) && readVarUInt32(_reader, out_range.count);
+    };
+    const auto readIds = [&_reader](std::vector<StringId>& out_ids)
+    {
+        size_t count = 0;
+        if(readCount(_reader, count) == false) return false;
+        out_ids.resize(count);
+        for(auto& id : out_ids)
+        {
+            if(readVarUInt32(_reader, id) == false) return false;
+        }
+        return true;
+    };
+
+    size_t count = 0;
+    bool isRead = _reader.readString(m_pool) && readCount(_reader, count);
+    m_strings.resize(isRead ? count : 0);
+    for(auto& range : m_strings)
+    {
+        isRead = isRead && readRange(range);
+    }
+
+    isRead = isRead && readCount(_reader, count);
+    m_nodes.resize(isRead ? count : 0);
+    for(auto& record : m_nodes)
+    {
+        isRead = isRead && readVarUInt32(_reader, record.name) && readVarUInt32(_reader, record.parent)
+                 && readVarUInt32(_reader, record.tags) && readRange(record.lines);
+    }
+
+    isRead = isRead && readCount(_reader, count);
+    m_lines.resize(isRead ? count : 0);
+    for(auto& record : m_lines)
+    {
+        uint32_t extra = 0;
+        isRead = isRead && _reader.readUInt64(record.lineId) && readVarUInt32(_reader, record.actorKey)
+                 && readVarUInt32(_reader, record.content) && readVarUInt32(_reader, extra);
+        record.extra = extra - 1;
+    }
+
+    isRead = isRead && readCount(_reader, count);
+    m_lineExtras.resize(isRead ? count : 0);
+    for(auto& extra : m_lineExtras)
+    {
+        uint32_t weight = 0;
+        isRead = isRead && readRange(extra.markup) && readRange(extra.conditions) && readRange(extra.options)
+                 && readRange(extra.actions) && readRange(extra.variants) && readVarUInt32(_reader, extra.gotoNode)
+                 && _reader.readUInt32(weight);
+        memcpy(&extra.weight, &weight, sizeof(weight));
+    }
+
+    isRead = isRead && readCount(_reader, count);
+    m_options.resize(isRead ? count : 0);
+    for(auto& record : m_options)
+    {
+        uint8_t isShortcut = 0;
+        isRead = isRead && _reader.readUInt64(record.lineId) && readVarUInt32(_reader, record.content)
+                 && readVarUInt32(_reader, record.gotoNode) && readRange(record.markup) && readRange(record.conditions)
+                 && readRange(record.actions) && _reader.readUInt8(isShortcut);
+        record.isShortcut = isShortcut != 0;
+    }
+
+    isRead = isRead && readCount(_reader, count);
+    m_actions.resize(isRead ? count : 0);
+    for(auto& record : m_actions)
+    {
+        isRead = isRead && readVarUInt32(_reader, record.name) && readRange(record.params);
+    }
+
+    isRead = isRead && readCount(_reader, count);
+    m_markup.resize(isRead ? count : 0);
+    for(auto& record : m_markup)
+    {
+        isRead = isRead && readVarUInt32(_reader, record.name) && readVarUInt32(_reader, record.value)
+                 && readVarUInt32(_reader, record.start) && readVarUInt32(_reader, record.length);
+    }
+
+    isRead = isRead && readIds(m_conditions) && readIds(m_params);
+    if(isRead == false || isValid() == false)
+    {
+        clear();
+        return false;
+    }
+    m_lineCount = m_lines.size();
+    return true;
+}
+
+void DialogueCompactScript::getMemoryReport(MemoryReport& out_report) const
+{
+    out_report = MemoryReport();
+    out_report.nodeCount = m_nodes.size();
+    out_report.lineCount = m_lineCount;
+    out_report.compactBytes = getSize();
+
+    DialogueNode node;
+    for(NodeIndex i = 0; i < m_nodes.size(); ++i)
+    {
+        expand(i, node);
+        out_report.expandedBytes += getExpandedSize(node);
+    }
+}
+
+size_t DialogueCompactScript::getExpandedSize(const DialogueNode& _node)
+{
+    size_t size = sizeof(DialogueNode)
+                + getStringHeapSize(_node.name)
+                + getStringHeapSize(_node.parent)
+                + getStringHeapSize(_node.tags)
+                + getVectorHeapSize(_node.tagIds)
+                + getVectorHeapSize(_node.actorIds)
+                + getVectorHeapSize(_node.lines);
+    for(const auto& line : _node.lines)
+    {
+        size += getHeapSize(line);
+    }
+    return size;
+}
+
+//----
+//Internal Helpers
+bool DialogueCompactScript::isValid() const
+{
+    const auto isRangeIn = [](Range _range, size_t _size)
+    {
+        return _range.begin <= _size && _range.count <= _size - _range.begin;
+    };
+    const auto isString = [this](StringId _id)
+    {
+        return _id < m_strings.size();
+    };
+    const auto areStrings = [&](const std::vector<StringId>& _ids, Range _range)
+    {
+        for(uint32_t i = 0; i < _range.count; ++i)
+        {
+            if(isString(_ids[_range.begin + i]) == false) return false;
+        }
+        return true;
+    };
+    const auto areMarkup = [&](Range _range)
+    {
+        return isRangeIn(_range, m_markup.size());
+    };
+    const auto areConditions = [&](Range _range)
+    {
+        return isRangeIn(_range, m_conditions.size()) && areStrings(m_conditions, _range);
+    };
+    const auto areActions = [&](Range _range)
+    {
+        return isRangeIn(_range, m_actions.size());
+    };
+
+    for(const auto& range : m_strings)
+    {
+        if(isRangeIn(range, m_pool.size()) == false) return false;
+    }
+    for(const auto& record : m_markup)
+    {
+        if(isString(record.name) == false || isString(record.value) == false) return false;
+    }
+    for(const auto& record : m_actions)
+    {
+        if(isString(record.name) == false || isRangeIn(record.params, m_params.size()) == false
+           || areStrings(m_params, record.params) == false)
+        {
+            return false;
+        }
+    }
+    for(const auto& record : m_options)
+    {
+        if(isString(record.content) == false || isString(record.gotoNode) == false || areMarkup(record.markup) == false
+           || areConditions(record.conditions) == false || areActions(record.actions) == false)
+        {
+            return false;
+        }
+    }
+    for(const auto& record : m_lines)
+    {
+        if(isString(record.actorKey) == false || isString(record.content) == false
+           || (record.extra != k_none && record.extra >= m_lineExtras.size()))
+        {
+            return false;
+        }
+    }
+    //variants never have variants of their own, so expanding recurses one level deep whatever the data says
+    for(const auto& extra : m_lineExtras)
+    {
+        if(areMarkup(extra.markup) == false || areConditions(extra.conditions) == false
+           || isRangeIn(extra.options, m_options.size()) == false || areActions(extra.actions) == false
+           || isRangeIn(extra.variants, m_lines.size()) == false || isString(extra.gotoNode) == false)
+        {
+            return false;
+        }
+        for(uint32_t i = 0; i < extra.variants.count; ++i)
+        {
+            const auto variantExtra = m_lines[extra.variants.begin + i].extra;
+            if(variantExtra != k_none && m_lineExtras[variantExtra].variants.count > 0) return false;
+        }
+    }
+    for(const auto& record : m_nodes)
+    {
+        if(isString(record.name) == false || isString(record.parent) == false || isString(record.tags) == false
+           || isRangeIn(record.lines, m_lines.size()) == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+DialogueCompactScript::StringId DialogueCompactScript::intern(const std::string& _string)
+{
+    if(m_stringIndex.empty() && m_strings.empty() == false)
+    {
+        //released by shrinkToFit
+        for(StringId id = 0; id < m_strings.size(); ++id)
+        {
+            const auto string = getString(id);
+            m_stringIndex.insert(std::make_pair(hashDialogueData(string.data(), string.size()), id));
+        }
+    }
+
+    const auto hash = hashDialogueString(_string);
+    auto range = m_stringIndex.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        if(getString(it->second) == _string)
+        {
+            return it->second;
+        }
+    }
+
+    const auto id = static_cast<StringId>(m_strings.size());
+    Range stringRange;
+    stringRange.begin = static_cast<uint32_t>(m_pool.size());
+    stringRange.count = static_cast<uint32_t>(_string.size());
+    m_pool.append(_string);
+    m_strings.push_back(stringRange);
+    m_stringIndex.insert(std::make_pair(hash, id));
+    return id;
+}
+
+void DialogueCompactScript::addLine(const DialogueNode::Line& _line, uint32_t _index)
+{
+    ++m_lineCount;
+
+    LineRecord record;
+    record.lineId = _line.lineId;
+    record.actorKey = intern(_line.actorKey);
+    record.content = intern(_line.content);
+    record.extra = k_none;
+
+    const bool hasExtra = _line.markup.empty() == false || _line.conditions.empty() == false
+                       || _line.options.empty() == false || _line.actions.empty() == false
+                       || _line.variants.empty() == false || _line.gotoNode.empty() == false
+                       || _line.weight != 1;
+    if(hasExtra)
+    {
+        LineExtra extra;
+        extra.markup = addMarkup(_line.markup);
+        extra.conditions = addConditions(_line.conditions);
+        extra.actions = addActions(_line.actions);
+        extra.gotoNode = intern(_line.gotoNode);
+        extra.weight = _line.weight;
+
+        //options are contiguous, so their nested ranges are built before the records are appended
+        std::vector<OptionRecord> options;
+        options.reserve(_line.options.size());
+        for(const auto& option : _line.options)
+        {
+            OptionRecord optionRecord;
+            optionRecord.lineId = option.lineId;
+            optionRecord.content = intern(option.content);
+            optionRecord.gotoNode = intern(option.gotoNode);
+            optionRecord.markup = addMarkup(option.markup);
+            optionRecord.conditions = addConditions(option.conditions);
+            optionRecord.actions = addActions(option.actions);
+            optionRecord.isShortcut = option.isShortcut;
+            options.push_back(optionRecord);
+        }
+        extra.options.begin = static_cast<uint32_t>(m_options.size());
+        extra.options.count = static_cast<uint32_t>(options.size());
+        m_options.insert(m_options.end(), options.begin(), options.end());
+
+        extra.variants.begin = static_cast<uint32_t>(m_lines.size());
+        extra.variants.count = static_cast<uint32_t>(_line.variants.size());
+        m_lines.resize(m_lines.size() + _line.variants.size());
+        for(size_t i = 0; i < _line.variants.size(); ++i)
+        {
+            addLine(_line.variants[i], extra.variants.begin + static_cast<uint32_t>(i));
+        }
+
+        record.extra = static_cast<uint32_t>(m_lineExtras.size());
+        m_lineExtras.push_back(extra);
+    }
+
+    m_lines[_index] = record;
+}
+
+DialogueCompactScript::Range DialogueCompactScript::addMarkup(const std::vector<DialogueNode::Markup>& _markup)
+{
+    Range range;
+    range.begin = static_cast<uint32_t>(m_markup.size());
+    range.count = static_cast<uint32_t>(_markup.size());
+    for(const auto& markup : _markup)
+    {
+        MarkupRecord record;
+        record.name = intern(markup.name);
+        record.value = intern(markup.value);
+        record.start = markup.start;
+        record.length = markup.length;
+        m_markup.push_back(record);
+    }
+    return range;
+}
+
+DialogueCompactScript::Range DialogueCompactScript::addConditions(const std::vector<DialogueNode::Condition>& _conditions)
+{
+    Range range;
+    range.begin = static_cast<uint32_t>(m_conditions.size());
+    range.count = static_cast<uint32_t>(_conditions.size());
+    for(const auto& condition : _conditions)
+    {
+        m_conditions.push_back(intern(condition.source));
+    }
+    return range;
+}
+
+DialogueCompactScript::Range DialogueCompactScript::addActions(const std::vector<DialogueNode::Action>& _actions)
+{
+    //params first so each action's params are contiguous
+    std::vector<ActionRecord> actions;
+    actions.reserve(_actions.size());
+    for(const auto& action : _actions)
+    {
+        ActionRecord record;
+        record.name = intern(action.name);
+        record.params.begin = static_cast<uint32_t>(m_params.size());
+        record.params.count = static_cast<uint32_t>(action.params.size());
+        for(const auto& param : action.params)
+        {
+            m_params.push_back(intern(param));
+        }
+        actions.push_back(record);
+    }
+
+    Range range;
+    range.begin = static_cast<uint32_t>(m_actions.size());
+    range.count = static_cast<uint32_t>(actions.size());
+    m_actions.insert(m_actions.end(), actions.begin(), actions.end());
+    return range;
+}
+
+void DialogueCompactScript::expandLine(const LineRecord& _record, std::string& _source, DialogueNode::Line& out_line) const
+{
+    out_line.actorKey = getString(_record.actorKey);
+    out_line.content = getString(_record.content);
+    out_line.lineId = _record.lineId;
+    if(_record.extra == k_none)
+    {
+        return;
+    }
+
+    const auto& extra = m_lineExtras[_record.extra];
+    expandMarkup(extra.markup, out_line.markup);
+    expandConditions(extra.conditions, _source, out_line.conditions);
+    expandActions(extra.actions, out_line.actions);
+    out_line.gotoNode = getString(extra.gotoNode);
+    out_line.weight = extra.weight;
+
+    out_line.options.resize(extra.options.count);
+    for(uint32_t i = 0; i < extra.options.count; ++i)
+    {
+        const auto& record = m_options[extra.options.begin + i];
+        auto& option = out_line.options[i];
+        option.content = getString(record.content);
+        option.gotoNode = getString(record.gotoNode);
+        option.isShortcut = record.isShortcut;
+        option.lineId = record.lineId;
+        expandMarkup(record.markup, option.markup);
+        expandConditions(record.conditions, _source, option.conditions);
+        expandActions(record.actions, option.actions);
+    }
+
+    out_line.variants.resize(extra.variants.count);
+    for(uint32_t i = 0; i < extra.variants.count; ++i)
+    {
+        expandLine(m_lines[extra.variants.begin + i], _source, out_line.variants[i]);
+    }
+}
+
+void DialogueCompactScript::expandMarkup(Range _range, std::vector<DialogueNode::Markup>& out_markup) const
+{
+    out_markup.resize(_range.count);
+    for(uint32_t i = 0; i < _range.count; ++i)
+    {
+        const auto& record = m_markup[_range.begin + i];
+        auto& markup = out_markup[i];
+        markup.name = getString(record.name);
+        markup.value = getString(record.value);
+        markup.start = record.start;
+        markup.length = record.length;
+    }
+}
+
+void DialogueCompactScript::expandConditions(Range _range, std::string& _source, std::vector<DialogueNode::Condition>& out_conditions) const
+{
+    out_conditions.resize(_range.count);
+    for(uint32_t i = 0; i < _range.count; ++i)
+    {
+        _source = getString(m_conditions[_range.begin + i]);
+        DialogueLineParser::compileCondition(_source, out_conditions[i]);
+    }
+}
+
+void DialogueCompactScript::expandActions(Range _range, std::vector<DialogueNode::Action>& out_actions) const
+{
+    out_actions.resize(_range.count);
+    for(uint32_t i = 0; i < _range.count; ++i)
+    {
+        const auto& record = m_actions[_range.begin + i];
+        auto& action = out_actions[i];
+        action.name = getString(record.name);
+        action.params.resize(record.params.count);
+        for(uint32_t j = 0; j < record.params.count; ++j)
+        {
+            action.params[j] = getString(m_params[record.params.begin + j]);
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "DialogueNode.h"
+
+class DialogueBinaryWriter;
+class DialogueBinaryReader;
+
+/*! Packed read only encoding of parsed nodes, for scripts that are kept resident but only partly played.
+ Every string is stored once in a shared pool and referenced by a 32bit id, lines are fixed size records,
+ and the collections most lines don't have (conditions, options, actions, markup, gotos, % variants)
+ live in shared arrays referenced by offset ranges from an optional per line extra record.
+ Conditions are stored as their source and recompiled by expand, link time data isn't stored at all.
+ Use expand to turn a node back into a DialogueNode that can be given to DialogueController::addNode.
+ write and read serialize the encoding, DialogueNodeArchive and DialogueParseCache store nodes this way */
+class DialogueCompactScript
+{
+public:
+    typedef uint32_t NodeIndex;
+    typedef uint32_t StringId;
+    static constexpr uint32_t k_none = ~0u;
+
+    struct MemoryReport
+    {
+        size_t nodeCount = 0;
+        size_t lineCount = 0; //including % variants
+        size_t compactBytes = 0; //size of this encoding
+        size_t expandedBytes = 0; //size of the same nodes as DialogueNode, see getExpandedSize
+
+        double getCompactBytesPerLine() const;
+        double getExpandedBytesPerLine() const;
+    };
+
+public:
+    DialogueCompactScript();
+
+    /*! Encode a node. Link time data (ids, actor ids, condition cache slots, action bindings) isn't stored
+     @return the index to expand it with */
+    NodeIndex add(const DialogueNode& _node);
+
+    /*! Decode a node added with add. The result has no id and is unlinked, as if just parsed
+     @return false if the index is invalid */
+    bool expand(NodeIndex _index, DialogueNode& out_node) const;
+
+    std::string_view getNodeName(NodeIndex _index) const;
+    size_t getNodeCount() const;
+    size_t getLineCount() const;
+
+    /*! @return the string for an id, or an empty view if the id is invalid */
+    std::string_view getString(StringId _id) const;
+
+    void clear();
+
+    /*! Release spare capacity and the index used to deduplicate strings while adding.
+     Adding after this still works, the index is rebuilt on demand */
+    void shrinkToFit();
+
+    /*! @return bytes used by the encoding, including the dedup index if it hasn't been released */
+    size_t getSize() const;
+
+    /*! Serialize the encoding, strings once in their pool followed by the records */
+    void write(DialogueBinaryWriter& _writer) const;
+
+    /*! Replace the contents with data written by write. Every range and string id is checked, so expand is safe on any input
+     @return false if the data is malformed, the script is left empty */
+    bool read(DialogueBinaryReader& _reader);
+
+    /*! Measure the encoding against expanded DialogueNodes, expanding each node once to do so */
+    void getMemoryReport(MemoryReport& out_report) const;
+
+    /*! @return approximate heap and inline bytes of a node, assuming strings longer than the small string buffer own an allocation */
+    static size_t getExpandedSize(const DialogueNode& _node);
+
+protected:
+    struct Range
+    {
+        uint32_t begin = 0;
+        uint32_t count = 0;
+    };
+
+    struct NodeRecord
+    {
+        StringId name;
+        StringId parent;
+        StringId tags;
+        Range lines;
+    };
+
+    struct LineRecord
+    {
+        uint64_t lineId;
+        StringId actorKey;
+        StringId content;
+        uint32_t extra; //index into m_lineExtras or k_none
+    };
+
+    struct LineExtra
+    {
+        Range markup;
+        Range conditions; //into m_conditions
+        Range options;
+        Range actions;
+        Range variants; //into m_lines
+        StringId gotoNode;
+        float weight;
+    };
+
+    struct OptionRecord
+    {
+        uint64_t lineId;
+        StringId content;
+        StringId gotoNode;
+        Range markup;
+        Range conditions;
+        Range actions;
+        bool isShortcut;
+    };
+
+    struct ActionRecord
+    {
+        StringId name;
+        Range params; //into m_params
+    };
+
+    struct MarkupRecord
+    {
+        StringId name;
+        StringId value;
+        uint32_t start;
+        uint32_t length;
+    };
+
+    std::string m_pool;
+    std::vector<Range> m_strings; //offsets into m_pool
+    std::vector<NodeRecord> m_nodes;
+    std::vector<LineRecord> m_lines;
+    std::vector<LineExtra> m_lineExtras;
+    std::vector<OptionRecord> m_options;
+    std::vector<ActionRecord> m_actions;
+    std::vector<MarkupRecord> m_markup;
+    std::vector<StringId> m_conditions; //condition sources
+    std::vector<StringId> m_params;
+    std::unordered_multimap<uint64_t, StringId> m_stringIndex; //hash to id, build only
+    size_t m_lineCount;
+
+    //----
+    //Internal Helpers
+    StringId intern(const std::string& _string);
+    void addLine(const DialogueNode::Line& _line, uint32_t _index);
+    Range addMarkup(const std::vector<DialogueNode::Markup>& _markup);
+    Range addConditions(const std::vector<DialogueNode::Condition>& _conditions);
+    Range addActions(const std::vector<DialogueNode::Action>& _actions);
+
+    bool isValid() const;
+
+    //_source is scratch storage for condition sources, reused across the whole node
+    void expandLine(const LineRecord& _record, std::string& _source, DialogueNode::Line& out_line) const;
+    void expandMarkup(Range _range, std::vector<DialogueNode::Markup>& out_markup) const;
+    void expandConditions(Range _range, std::string& _source, std::vector<DialogueNode::Condition>& out_conditions) const;
+    void expandActions(Range _range, std::vector<DialogueNode::Action>& out_actions) const;
+};
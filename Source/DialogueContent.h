@@ -3,15 +3,35 @@
 #include <string>
 #include <vector>
 
+#include "DialogueNode.h"
+
 struct DialogueOption
 {
     bool isConditionMet;
     std::string content;
+    uint64_t lineId;
+    std::vector<DialogueNode::Markup> markup; //spans over content
 };
 
 struct DialogueContent
 {
+    DialogueNode::ActorId actorId; //DialogueNode::k_invalidId if the line has no actor
     std::string actorKey;
+    uint64_t lineId; //stable id of the line, e.g. to play voice over
     std::string speech;
+    std::vector<DialogueNode::Markup> markup; //spans over speech, sorted by start
     std::vector<DialogueOption> options;
 };
+
+/*! A single resolved line, filled by DialogueController::evaluateLine.
+ Reuse the same instance across calls so speech keeps its capacity */
+struct DialogueLineContent
+{
+    DialogueNode::Id nodeId;
+    size_t lineIndex;
+    DialogueNode::ActorId actorId;
+    std::string actorKey;
+    uint64_t lineId;
+    std::string speech;
+    std::vector<DialogueNode::Markup> markup;
+};
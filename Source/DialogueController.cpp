@@ -9,17 +9,136 @@
 #include "IDialogueDelegate.h"
 #include "IDialogueResolver.h"
 
+#include "DialogueBinaryIO.h"
+#include "DialogueHash.h"
+#include "DialogueHistory.h"
+#include "DialogueActionRegistry.h"
+#include "DialogueLocaleTable.h"
+#include "DialogueNodeArchive.h"
+#include "DialogueParseCache.h"
+#include "DialogueMemory.h"
+#include "DialogueTrace.h"
+#include "DialogueMetrics.h"
+#include "DialogueRecorder.h"
+#include "DialogueCompactScript.h"
+
 #include <algorithm>
+#include <cstdint>
 #include <numeric>
 
+#if DIALOGUE_METRICS
+    #define METRICS(statement) do { if(m_metrics) { m_metrics->statement; } } while(false)
+    #define METRICS_TIME_DELEGATE() const DialogueMetrics::ScopedDelegateTimer metricsTimer(m_metrics)
+#else
+    #define METRICS(statement) ((void)0)
+    #define METRICS_TIME_DELEGATE() ((void)0)
+#endif
+
+namespace
+{
+    const size_t k_notPaged = SIZE_MAX;
+
+    //skipping a script whose gotos loop back without an option, e.g. a line followed by [[Self]], would never stop
+    const size_t k_maxSkippedLines = 10000;
+
+    uint64_t hashNodeSource(const std::string& _tags, const std::string& _body)
+    {
+        const char separator = 0;
+        auto hash = hashDialogueString(_tags);
+        hash = hashDialogueData(&separator, 1, hash);
+        return hashDialogueString(_body, hash);
+    }
+
+    struct ScopedIncrement
+    {
+        ScopedIncrement(unsigned& _value)
+        : value(_value)
+        {
+            ++value;
+        }
+
+        ~ScopedIncrement()
+        {
+            --value;
+        }
+
+        unsigned& value;
+    };
+
+    /*! Pick one of a line's % variants by weight, considering only those whose conditions pass.
+     Single pass weighted reservoir selection, so no storage is needed for the eligible set
+     @param _avoid variant to pick only if no other is eligible, or k_noVariant
+     @return the variant index or k_noVariant if none are eligible */
+    template <typename ConditionsMetFunc>
+    unsigned pickVariant(const DialogueNode::Line& _line, DialogueRandom& _random, unsigned _avoid, const ConditionsMetFunc& _conditionsMet)
+    {
+        unsigned picked = DialogueNode::k_noVariant;
+        bool isAvoidedEligible = false;
+        double totalWeight = 0;
+        for(unsigned i = 0; i < _line.variants.size(); ++i)
+        {
+            const auto& variant = _line.variants[i];
+            if(variant.weight <= 0 || _conditionsMet(variant) == false)
+            {
+                continue;
+            }
+            if(i == _avoid)
+            {
+                isAvoidedEligible = true;
+                continue;
+            }
+            totalWeight += variant.weight;
+            if(_random.next() * (totalWeight / 4294967296.0) < variant.weight)
+            {
+                picked = i;
+            }
+        }
+        return (picked == DialogueNode::k_noVariant && isAvoidedEligible) ? _avoid : picked;
+    }
+
+    //a % group line only holds its variants, it is identified by its first
+    uint64_t getGroupLineId(const DialogueNode::Line& _line)
+    {
+        return _line.variants.empty() ? _line.lineId : _line.variants.front().lineId;
+    }
+}
+
 DialogueController::DialogueController(IDialogueDelegate* _dialogueDelegate,
-                                       const IDialogueResolver* _dialogueResolver)
-    : m_dialogueDelegate(_dialogueDelegate)
+                                       const IDialogueResolver* _dialogueResolver,
+                                       std::pmr::memory_resource* _memoryResource)
+    : m_memoryResource(_memoryResource ? _memoryResource : std::pmr::get_default_resource())
+    , m_countingResource(dynamic_cast<DialogueCountingResource*>(m_memoryResource))
+    , m_dialogueDelegate(_dialogueDelegate)
     , m_dialogueResolver(_dialogueResolver)
+    , m_actionRegistry(nullptr)
+    , m_localeTable(nullptr)
+    , m_isMarkupEnabled(false)
+    , m_localizedText(m_memoryResource)
+    , m_parseCache(nullptr)
+    , m_metrics(nullptr)
+    , m_recorder(nullptr)
+    , m_runtimeResolver(_dialogueResolver)
+    , m_nodeIds(m_memoryResource)
+    , m_nodes(m_memoryResource)
+    , m_sourceHashes(m_memoryResource)
+    , m_nodeTableHash(static_cast<uint32_t>(k_dialogueHashBasis))
+    , m_presentedOptions(m_memoryResource)
+    , m_avoidRepeatedVariants(false)
+    , m_lastVariants(m_memoryResource)
+    , m_historyDropCount(0)
+    , m_conditionCache(m_memoryResource)
+    , m_freeConditionSlots(m_memoryResource)
     , m_isSkipping(false)
     , m_isProgressing(false)
     , m_isPaused(false)
     , m_pendingStop(false)
+    , m_stepDepth(0)
+    , m_parserDepth(0)
+    , m_nodesWithoutLine(0)
+    , m_nodeArchive(nullptr)
+    , m_nodeBudget(0)
+    , m_pages(m_memoryResource)
+    , m_residentPages(m_memoryResource)
 {
 
 }
@@ -37,8 +156,19 @@ bool DialogueController::addNode(const std::string &_name, const std::string &_t
     if(m_dialogueResolver)
     {
         DialogueLineParser parser(m_dialogueResolver);
+        parser.setMarkupEnabled(m_isMarkupEnabled);
         std::vector<DialogueNode> nodes;
-        parser.parse(_name, _tags, _body, _seed, nodes);
+        {
+            const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Parse);
+            if(m_parseCache)
+            {
+                m_parseCache->parse(parser, _name, _tags, _body, _seed, nodes);
+            }
+            else
+            {
+                parser.parse(_name, _tags, _body, _seed, nodes);
+            }
+        }
         for(const auto& parsedNode : nodes)
         {
             if(addNode(parsedNode) == false)
@@ -46,6 +176,7 @@ bool DialogueController::addNode(const std::string &_name, const std::string &_t
                 return false;
             }
         }
+        setSourceHash(getNodeId(_name), hashNodeSource(_tags, _body));
         return true;
     }
     else
@@ -57,10 +188,26 @@ bool DialogueController::addNode(const std::string &_name, const std::string &_t
 
 bool DialogueController::addNode(const DialogueNode& _node)
 {
-    auto it = m_nodes.find(_node.name);
-    if (it == m_nodes.end())
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Link);
+    const auto id = reserveNodeId(_node.name);
+    if (m_nodes[id] == nullptr)
     {
-        m_nodes.insert(std::make_pair(_node.name, new DialogueNode(_node)));
+        //replaces the archived node, which is never paged in again
+        if(isPaged(id))
+        {
+            std::vector<unsigned> tagIds;
+            if(m_nodeArchive->getEntry(m_pages[id].archiveIndex).parent.empty())
+            {
+                internTags(m_nodeArchive->getEntry(m_pages[id].archiveIndex).tags, tagIds);
+                m_tags.removeNode(id, tagIds);
+            }
+            m_pages[id].archiveIndex = k_notPaged;
+        }
+
+        auto node = createNode(_node);
+        node->id = id;
+        linkNode(*node);
+        m_nodes[id] = node;
         return true;
     }
     else
@@ -70,249 +217,1773 @@ bool DialogueController::addNode(const DialogueNode& _node)
     }
 }
 
+bool DialogueController::removeNode(const std::string& _name)
+{
+    //archived nodes are removed without paging them in
+    const auto id = getNodeId(_name);
+    auto node = getNodeById(id);
+    if (node || isPaged(id))
+    {
+        for(const auto& state : m_nodeStack)
+        {
+            if(state.nodeId == id)
+            {
+                //a step in progress still reads the node through its stack, it can only be removed between steps
+                if(m_isProgressing || m_stepDepth > 0)
+                {
+                    LOGERROR("Failed to remove node '%s': in use by the dialogue being progressed", _name.c_str());
+                    return false;
+                }
+                LOG("Removing node '%s' while in use, stopping dialogue", _name.c_str());
+                stop();
+                break;
+            }
+        }
+        if(isPaged(id))
+        {
+            //removed for good, archived tags are indexed for as long as the node is paged
+            evictNode(id);
+            std::vector<unsigned> tagIds;
+            if(m_nodeArchive->getEntry(m_pages[id].archiveIndex).parent.empty())
+            {
+                internTags(m_nodeArchive->getEntry(m_pages[id].archiveIndex).tags, tagIds);
+                m_tags.removeNode(id, tagIds);
+            }
+            m_pages[id].archiveIndex = k_notPaged;
+            return true;
+        }
+        unlinkNode(*node);
+        m_nodes[id] = nullptr;
+        setSourceHash(id, 0);
+        destroyNode(node);
+        return true;
+    }
+    else
+    {
+        LOG("Failed to remove node: Invalid name '%s'", _name.c_str());
+        return false;
+    }
+}
+
 void DialogueController::clearNodes()
 {
-    for (auto& pair : m_nodes)
+    for (auto& node : m_nodes)
+    {
+        destroyNode(node);
+        node = nullptr;
+    }
+    for (auto& lines : m_actorLines)
     {
-        delete pair.second;
+        lines.clear();
     }
-    m_nodes.clear();
+    m_tags.clear();
     m_nodeStack.clear();
+    m_presentedOptions.clear();
+    m_sourceHashes.clear();
+    m_conditionCache.clear();
+    m_freeConditionSlots.clear();
+    m_nodeArchive = nullptr;
+    m_pages.clear();
+    m_residentPages.clear();
+    m_pagingStats.residentNodes = 0;
+    m_pagingStats.residentBytes = 0;
+}
+
+bool DialogueController::reloadNodes(const std::vector<NodeSource>& _sources, bool _removeMissing)
+{
+    if(m_isProgressing)
+    {
+        LOGERROR("Failed to reload nodes: dialogue is progressing");
+        return false;
+    }
+    if(m_nodeArchive)
+    {
+        LOGERROR("Failed to reload nodes: not available in paged mode");
+        return false;
+    }
+    if(m_dialogueResolver == nullptr)
+    {
+        LOGERROR("Failed to reload nodes: Invalid Dialogue Resolver");
+        return false;
+    }
+
+    //diff by source hash, nodes added without a source always count as changed
+    std::vector<const NodeSource*> changedSources;
+    std::vector<uint64_t> changedHashes;
+    std::vector<bool> isKept(m_nodes.size(), false);
+    for(const auto& source : _sources)
+    {
+        const auto hash = hashNodeSource(source.tags, source.body);
+        const auto id = getNodeId(source.name);
+        if(id < m_nodes.size() && m_nodes[id] && id < m_sourceHashes.size() && m_sourceHashes[id] == hash)
+        {
+            isKept[id] = true;
+        }
+        else
+        {
+            changedSources.push_back(&source);
+            changedHashes.push_back(hash);
+        }
+    }
+
+    //top level nodes being replaced or removed, their generated nodes go with them
+    std::vector<bool> isReplaced(m_nodes.size(), false);
+    for(const auto source : changedSources)
+    {
+        const auto id = getNodeId(source->name);
+        if(id < m_nodes.size())
+        {
+            isReplaced[id] = true;
+        }
+    }
+    if(_removeMissing)
+    {
+        for(const auto node : m_nodes)
+        {
+            if(node && node->parent.empty() && isKept[node->id] == false)
+            {
+                isReplaced[node->id] = true;
+            }
+        }
+    }
+    std::vector<DialogueNode*> oldNodes;
+    std::vector<bool> isOld(m_nodes.size(), false);
+    for(const auto node : m_nodes)
+    {
+        if(node == nullptr) continue;
+        const auto parentId = node->parent.empty() ? node->id : getNodeId(node->parent);
+        if(parentId < isReplaced.size() && isReplaced[parentId])
+        {
+            oldNodes.push_back(node);
+            isOld[node->id] = true;
+        }
+    }
+    if(oldNodes.empty() && changedSources.empty())
+    {
+        return true;
+    }
+
+    //parse everything before replacing anything
+    DialogueLineParser parser(m_dialogueResolver);
+    parser.setMarkupEnabled(m_isMarkupEnabled);
+    std::vector<DialogueNode> newNodes;
+    std::vector<size_t> sourceEnds; //end of each source's nodes in newNodes
+    {
+        const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Parse);
+        for(const auto source : changedSources)
+        {
+            if(m_parseCache)
+            {
+                m_parseCache->parse(parser, source->name, source->tags, source->body, 0, newNodes);
+            }
+            else
+            {
+                parser.parse(source->name, source->tags, source->body, 0, newNodes);
+            }
+            sourceEnds.push_back(newNodes.size());
+        }
+    }
+    std::map<std::string, size_t> newNames;
+    for(size_t i = 0; i < newNodes.size(); ++i)
+    {
+        const auto id = getNodeId(newNodes[i].name);
+        const bool isInUse = id < m_nodes.size() && m_nodes[id] && isOld[id] == false;
+        if(isInUse || newNames.insert(std::make_pair(newNodes[i].name, i)).second == false)
+        {
+            LOGERROR("Failed to reload nodes: name '%s' already in use", newNodes[i].name.c_str());
+            return false;
+        }
+    }
+
+    //remember which line each frame in a replaced node was on, by line id
+    struct FrameLine
+    {
+        bool isReplaced;
+        uint64_t lineId;
+        uint64_t variantLineId;
+    };
+    std::vector<FrameLine> frameLines;
+    for(const auto& state : m_nodeStack)
+    {
+        const auto node = m_nodes[state.nodeId];
+        FrameLine frameLine = { isOld[state.nodeId], 0, 0 };
+        if(frameLine.isReplaced && state.lineIndex < node->lines.size())
+        {
+            frameLine.lineId = getGroupLineId(node->lines[state.lineIndex]);
+            frameLine.variantLineId = getLine(*node, state).lineId;
+        }
+        frameLines.push_back(frameLine);
+    }
+    const bool isTopReplaced = frameLines.empty() == false && frameLines.back().isReplaced;
+
+    //swap
+    for(const auto node : oldNodes)
+    {
+        unlinkNode(*node);
+        m_nodes[node->id] = nullptr;
+        setSourceHash(node->id, 0);
+        destroyNode(node);
+    }
+    for(const auto& node : newNodes)
+    {
+        addNode(node);
+    }
+    for(size_t i = 0; i < changedSources.size(); ++i)
+    {
+        setSourceHash(getNodeId(changedSources[i]->name), changedHashes[i]);
+    }
+    TRACE_INFO(NodesReloaded, static_cast<uint32_t>(newNodes.size()), static_cast<uint32_t>(oldNodes.size()));
+
+    for(auto it = m_lastVariants.begin(); it != m_lastVariants.end();)
+    {
+        const auto node = getNodeById(it->first.first);
+        it = (node == nullptr || newNames.count(node->name) > 0) ? m_lastVariants.erase(it) : std::next(it);
+    }
+    if(m_history)
+    {
+        m_history->clear();
+    }
+
+    //remap the stack by index and id: the line with the frame's id nearest its old index, so a frame on one of several
+    //lines sharing an id stays on its own copy rather than jumping to the first
+    const auto findNearest = [](size_t _count, size_t _index, uint64_t _lineId, const auto& _getId)
+    {
+        for(size_t distance = 0; distance <= _index || _index + distance < _count; ++distance)
+        {
+            if(distance <= _index && _index - distance < _count && _getId(_index - distance) == _lineId) return _index - distance;
+            if(distance > 0 && _index + distance < _count && _getId(_index + distance) == _lineId) return _index + distance;
+        }
+        return _count;
+    };
+    for(size_t i = 0; i < m_nodeStack.size(); ++i)
+    {
+        if(frameLines[i].isReplaced == false)
+        {
+            continue;
+        }
+
+        auto& state = m_nodeStack[i];
+        const auto node = getNodeById(state.nodeId);
+        if(node == nullptr)
+        {
+            LOG("Reloaded node (%u) on the stack was removed, stopping dialogue", state.nodeId);
+            onDialogueEnded();
+            return true;
+        }
+
+        const auto& lines = node->lines;
+        const auto lineIndex = frameLines[i].lineId == 0 ? lines.size()
+                             : findNearest(lines.size(), state.lineIndex, frameLines[i].lineId, [&lines](size_t _index) { return getGroupLineId(lines[_index]); });
+        if(lineIndex < lines.size())
+        {
+            const auto& variants = lines[lineIndex].variants;
+            const auto variantIndex = state.variantIndex == DialogueNode::k_noVariant ? variants.size()
+                                    : findNearest(variants.size(), state.variantIndex, frameLines[i].variantLineId, [&variants](size_t _index) { return variants[_index].lineId; });
+            state.lineIndex = lineIndex;
+            state.variantIndex = variantIndex < variants.size() ? static_cast<unsigned>(variantIndex) : DialogueNode::k_noVariant;
+        }
+        else
+        {
+            state.lineIndex = std::min(state.lineIndex, lines.size());
+            state.variantIndex = DialogueNode::k_noVariant;
+        }
+    }
+
+    //show the edited line. Options are presented again even while paused, nothing else would present them once cleared
+    if(isTopReplaced)
+    {
+        const bool hadOptions = m_presentedOptions.empty() == false;
+        m_presentedOptions.clear();
+        const auto& top = m_nodeStack.back();
+        const auto topNode = getNodeById(top.nodeId);
+        if((m_isPaused == false || hadOptions) && topNode && top.lineIndex < topNode->lines.size())
+        {
+            present(*topNode, top.lineIndex);
+        }
+    }
+    return true;
 }
 
 DialogueNode* DialogueController::getNodeByName(const std::string& _name) const
 {
-    auto it = m_nodes.find(_name);
-    if (it != m_nodes.end())
+    return getNodeById(getNodeId(_name));
+}
+
+DialogueNode* DialogueController::getNodeById(DialogueNode::Id _id) const
+{
+    if (_id < m_nodes.size())
     {
-        return it->second;
+        return m_nodes[_id];
     }
     return nullptr;
 }
 
+DialogueNode* DialogueController::loadNodeByName(const std::string& _name)
+{
+    return loadNodeById(getNodeId(_name));
+}
+
+DialogueNode* DialogueController::loadNodeById(DialogueNode::Id _id)
+{
+    if(isPaged(_id))
+    {
+        return pageNode(_id);
+    }
+    return getNodeById(_id);
+}
+
+DialogueNode::Id DialogueController::getNodeId(const std::string& _name) const
+{
+    auto it = m_nodeIds.find(_name);
+    if (it != m_nodeIds.end())
+    {
+        return it->second;
+    }
+    return DialogueNode::k_invalidId;
+}
+
+void DialogueController::getNodeNames(std::vector<std::string>& out_names) const
+{
+    out_names.assign(m_nodeIds.size(), std::string());
+    for(const auto& entry : m_nodeIds)
+    {
+        if(entry.second < out_names.size())
+        {
+            out_names[entry.second] = entry.first;
+        }
+    }
+}
+
 void DialogueController::getActors(std::vector<std::string>& out_actorKeys) const
 {
-    for(const auto& node : m_nodes)
+    for(DialogueNode::ActorId actorId = 0; actorId < m_actorLines.size(); ++actorId)
     {
-        for(const auto& line : node.second->lines)
+        if(m_actorLines[actorId].empty() == false)
         {
-            if(std::find(out_actorKeys.begin(), out_actorKeys.end(), line.actorKey) == out_actorKeys.end())
-            {
-                out_actorKeys.push_back(line.actorKey);
-            }
+            out_actorKeys.push_back(m_actors.getString(actorId));
         }
     }
 }
 
-//-------------------------------------------------------------------------------------------------------------------
-//Dialogue Control
-//-------------------------------------------------------------------------------------------------------------------
+DialogueNode::ActorId DialogueController::getActorId(const std::string& _actorKey) const
+{
+    return m_actors.find(_actorKey);
+}
 
-bool DialogueController::start(const std::string& _startNode, unsigned _lineIndex, bool _forceStart)
+const std::string& DialogueController::getActorKey(DialogueNode::ActorId _actorId) const
 {
-    if(m_nodeStack.empty() == false)
+    return m_actors.getString(_actorId);
+}
+
+size_t DialogueController::getActorCount() const
+{
+    return m_actors.getSize();
+}
+
+const std::vector<DialogueController::NodeState>& DialogueController::getActorLines(DialogueNode::ActorId _actorId) const
+{
+    static const std::vector<NodeState> s_noLines;
+    return _actorId < m_actorLines.size() ? m_actorLines[_actorId] : s_noLines;
+}
+
+void DialogueController::getActorsInNodes(const std::vector<DialogueNode::Id>& _nodeIds, std::vector<DialogueNode::ActorId>& out_actorIds) const
+{
+    out_actorIds.clear();
+    for(const auto nodeId : _nodeIds)
     {
-        if(_forceStart)
+        if(auto node = getNodeById(nodeId))
         {
-            onDialogueEnded();
+            out_actorIds.insert(out_actorIds.end(), node->actorIds.begin(), node->actorIds.end());
         }
-        else
+    }
+    std::sort(out_actorIds.begin(), out_actorIds.end());
+    out_actorIds.erase(std::unique(out_actorIds.begin(), out_actorIds.end()), out_actorIds.end());
+}
+
+void DialogueController::findNodesByTags(const std::vector<std::string>& _all,
+                                         const std::vector<std::string>& _any,
+                                         const std::vector<std::string>& _none,
+                                         std::vector<DialogueNode::Id>& out_nodeIds) const
+{
+    DialogueTagIndex::Query query;
+    for(const auto& tag : _all)
+    {
+        const auto tagId = m_tags.find(tag);
+        if(tagId == DialogueStringTable::k_invalidId)
         {
-            LOG("Failed to start Dialogue: dialogue already running");
-            return false;
+            //no node has this tag so nothing can match
+            out_nodeIds.clear();
+            return;
         }
+        query.all.push_back(tagId);
     }
-    if(_startNode.empty())
+    for(const auto& tag : _any)
     {
-        const static std::string s_defaultStartNode = "Start";
-        LOG("Starting Dialogue at default: '%s':%u", s_defaultStartNode.c_str(), _lineIndex);
-        return enterNode(s_defaultStartNode, _lineIndex);
+        query.any.push_back(m_tags.find(tag));
     }
-    else
+    for(const auto& tag : _none)
     {
-        LOG("Starting Dialogue at: '%s':%u", _startNode.c_str(), _lineIndex);
-        return enterNode(_startNode, _lineIndex);
+        query.none.push_back(m_tags.find(tag));
     }
+    m_tags.query(query, out_nodeIds);
 }
 
-bool DialogueController::start(const NodeStack &_nodeStack, bool _forceStart)
+const DialogueTagIndex& DialogueController::getTagIndex() const
 {
-    if(m_nodeStack.empty() == false)
+    return m_tags;
+}
+
+bool DialogueController::evaluateLine(DialogueNode::Id _nodeId, DialogueRandom& _random, const IDialogueResolver* _resolver, DialogueLineContent& out_line) const
+{
+    ScopedParser scopedParser(*this, _resolver, &m_visits);
+    DialogueLineParser& parser = scopedParser;
+    const auto conditionsMet = [&parser](const DialogueNode::Line& _line)
     {
-        if(_forceStart)
+        for(const auto& condition : _line.conditions)
         {
-            onDialogueEnded();
+            if(parser.resolveCondition(condition) == false)
+            {
+                return false;
+            }
         }
-        else
+        return true;
+    };
+
+    //bound the number of gotos followed so cycles of empty lines terminate
+    const DialogueNode* node = getNodeById(_nodeId);
+    for(size_t gotoCount = 0; node != nullptr && gotoCount <= m_nodes.size(); ++gotoCount)
+    {
+        const DialogueNode* gotoNode = nullptr;
+        for(size_t lineIndex = 0; lineIndex < node->lines.size() && gotoNode == nullptr; ++lineIndex)
         {
-            LOG("Failed to start Dialogue: dialogue already running");
-            return false;
+            const auto* line = &node->lines[lineIndex];
+            if(line->variants.empty() == false)
+            {
+                const auto variantIndex = pickVariant(*line, _random, DialogueNode::k_noVariant, conditionsMet);
+                if(variantIndex == DialogueNode::k_noVariant)
+                {
+                    continue;
+                }
+                line = &line->variants[variantIndex];
+            }
+            else if(conditionsMet(*line) == false)
+            {
+                continue;
+            }
+
+            //nothing to present, follow the goto if there is one
+            if(line->actorId == DialogueNode::k_invalidId && line->content.empty())
+            {
+                if(line->gotoNode.empty() == false)
+                {
+                    gotoNode = getNodeByName(line->gotoNode);
+                    if(gotoNode == nullptr)
+                    {
+                        return false;
+                    }
+                }
+                continue;
+            }
+
+            out_line.nodeId = node->id;
+            out_line.lineIndex = lineIndex;
+            out_line.actorId = line->actorId;
+            out_line.actorKey = m_actors.getString(line->actorId);
+            out_line.lineId = line->lineId;
+            resolveText(parser, line->lineId, line->content, line->markup, out_line.speech, out_line.markup);
+            return true;
+        }
+        node = gotoNode;
+    }
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Paging
+//-------------------------------------------------------------------------------------------------------------------
+
+bool DialogueController::setNodeArchive(DialogueNodeArchive* _archive, size_t _budgetBytes)
+{
+    if(_archive && _archive->isOpen() == false)
+    {
+        LOGERROR("Failed to set node archive: archive is not open");
+        return false;
+    }
+
+    clearNodes();
+    m_nodeArchive = _archive;
+    m_nodeBudget = _budgetBytes;
+    if(m_nodeArchive == nullptr)
+    {
+        return true;
+    }
+
+    std::vector<unsigned> tagIds;
+    for(size_t i = 0; i < m_nodeArchive->getNodeCount(); ++i)
+    {
+        const auto& entry = m_nodeArchive->getEntry(i);
+        const auto id = reserveNodeId(entry.name);
+        if(m_nodes[id] || isPaged(id))
+        {
+            LOG("Failed to page node: name '%s' already in use", entry.name.c_str());
+            continue;
+        }
+        if(id >= m_pages.size())
+        {
+            m_pages.resize(id + 1, { k_notPaged, 0, m_residentPages.end() });
+        }
+        m_pages[id].archiveIndex = i;
+
+        if(entry.parent.empty())
+        {
+            internTags(entry.tags, tagIds);
+            m_tags.addNode(id, tagIds);
+        }
+    }
+    return true;
+}
+
+const DialogueNodeArchive* DialogueController::getNodeArchive() const
+{
+    return m_nodeArchive;
+}
+
+void DialogueController::setNodeBudget(size_t _budgetBytes)
+{
+    m_nodeBudget = _budgetBytes;
+}
+
+size_t DialogueController::getNodeBudget() const
+{
+    return m_nodeBudget;
+}
+
+void DialogueController::trimNodes()
+{
+    if(m_stepDepth > 0)
+    {
+        return;
+    }
+
+    auto it = m_residentPages.end();
+    while(m_pagingStats.residentBytes > m_nodeBudget && it != m_residentPages.begin())
+    {
+        --it;
+        const auto id = *it;
+        const bool isPinned = std::any_of(m_nodeStack.begin(), m_nodeStack.end(), [id](const NodeState& _state) { return _state.nodeId == id; });
+        if(isPinned == false)
+        {
+            //erases the entry, so step past it first
+            ++it;
+            evictNode(id);
+            ++m_pagingStats.evictions;
+        }
+    }
+}
+
+const DialogueController::PagingStats& DialogueController::getPagingStats() const
+{
+    return m_pagingStats;
+}
+
+void DialogueController::resetPagingStats()
+{
+    m_pagingStats.hits = 0;
+    m_pagingStats.misses = 0;
+    m_pagingStats.evictions = 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Dialogue Control
+//-------------------------------------------------------------------------------------------------------------------
+
+bool DialogueController::start(const std::string& _startNode, unsigned _lineIndex, bool _forceStart)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::Start, _startNode, _lineIndex, _forceStart);
+    trimNodes();
+    ScopedIncrement step(m_stepDepth);
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Run);
+
+    if(m_nodeStack.empty() == false)
+    {
+        if(_forceStart)
+        {
+            onDialogueEnded();
+        }
+        else
+        {
+            LOG("Failed to start Dialogue: dialogue already running");
+            return false;
+        }
+    }
+    if(_startNode.empty())
+    {
+        const static std::string s_defaultStartNode = "Start";
+        m_nodesWithoutLine = 0;
+        return finishStep(enterNode(s_defaultStartNode, _lineIndex));
+    }
+    else
+    {
+        m_nodesWithoutLine = 0;
+        return finishStep(enterNode(_startNode, _lineIndex));
+    }
+}
+
+bool DialogueController::start(const NodeStack &_nodeStack, bool _forceStart)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::StartStack, _nodeStack, _forceStart);
+    trimNodes();
+    ScopedIncrement step(m_stepDepth);
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Run);
+
+    if(m_nodeStack.empty() == false)
+    {
+        if(_forceStart)
+        {
+            onDialogueEnded();
+        }
+        else
+        {
+            LOG("Failed to start Dialogue: dialogue already running");
+            return false;
         }
     }
     if(_nodeStack.empty() == false)
     {
+        DialogueNode* top = nullptr;
+        for(const auto& state : _nodeStack)
+        {
+            top = loadNodeById(state.nodeId);
+            if(top == nullptr)
+            {
+                LOGERROR("Failed to start Dialogue: invalid node id (%u) in stack", state.nodeId);
+                return false;
+            }
+        }
         m_nodeStack = _nodeStack;
-        if(present(*m_nodeStack.back().node, m_nodeStack.back().lineIndex) == false)
+        m_nodesWithoutLine = 0;
+        TRACE_INFO(DialogueStarted, m_nodeStack.front().nodeId, static_cast<uint32_t>(m_nodeStack.front().lineIndex));
+        if(present(*top, m_nodeStack.back().lineIndex) == false)
+        {
+            return finishStep(advanceLine());
+        }
+        return true;
+    }
+    else
+    {
+        LOG("Failed to start Dialogue: empty stack given");
+        return false;
+    }
+}
+
+bool DialogueController::stop()
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::Stop);
+    if(m_isProgressing)
+    {
+        m_pendingStop = true;
+        return true;
+    }
+    else if(m_nodeStack.empty() == false)
+    {
+        onDialogueEnded();
+        return true;
+    }
+    else
+    {
+        LOGERROR("Failed to stop Dialogue: not running");
+        return false;
+    }
+}
+
+void DialogueController::setIsPaused(bool _isPaused)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::SetIsPaused, _isPaused);
+    if(_isPaused != m_isPaused)
+    {
+        m_isPaused = _isPaused;
+        if(m_isPaused)
+        {
+            const DialogueRecorder::ScopedCallback callback(m_recorder, DialogueRecorder::Event::Paused);
+            if(m_dialogueDelegate)
+            {
+                METRICS_TIME_DELEGATE();
+                m_dialogueDelegate->onPaused();
+            }
+        }
+        else
+        {
+            progressDialogue();
+        }
+    }
+}
+
+bool DialogueController::getIsPaused() const
+{
+    return m_isPaused;
+}
+
+bool DialogueController::selectOption(size_t _index)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::SelectOption, _index);
+    if(m_isPaused) return false;
+    trimNodes();
+    ScopedIncrement step(m_stepDepth);
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Run);
+
+    if(m_presentedOptions.empty() == false)
+    {
+        if(_index < m_presentedOptions.size())
+        {
+            const auto presentedOption = m_presentedOptions[_index];
+            m_presentedOptions.clear();
+            TRACE_INFO(OptionSelected, static_cast<uint32_t>(_index));
+
+            auto node = loadNodeById(presentedOption.nodeId);
+            if(node == nullptr)
+            {
+                LOGERROR("Failed to select option: node (%u) no longer exists", presentedOption.nodeId);
+                return false;
+            }
+            if(presentedOption.lineIndex >= node->lines.size()
+               || presentedOption.optionIndex >= getLine(*node, { presentedOption.nodeId, presentedOption.lineIndex, presentedOption.variantIndex }).options.size())
+            {
+                LOGERROR("Failed to select option: node '%s' no longer has option %zu at line %zu",
+                         node->name.c_str(), presentedOption.optionIndex, presentedOption.lineIndex);
+                return false;
+            }
+            METRICS(setContext(presentedOption.nodeId, presentedOption.lineIndex));
+            const auto& option = getLine(*node, { presentedOption.nodeId, presentedOption.lineIndex, presentedOption.variantIndex }).options[presentedOption.optionIndex];
+
+            //resolve actions for option
+            for(const auto& action : option.actions)
+            {
+                resolveAction(action);
+            }
+
+            //progress to next node if any
+            if(!m_isPaused && !m_pendingStop && option.gotoNode.empty() == false)
+            {
+                return finishStep(enterNode(option.gotoNode));
+            }
+            else //progress dialogue as normal
+            {
+                return run();
+            }
+        }
+        else
+        {
+            LOGERROR("Failed to select option: invalid index (%zu)", _index);
+            TRACE_ERROR(InvalidOption, static_cast<uint32_t>(_index), static_cast<uint32_t>(m_presentedOptions.size()));
+            return false;
+        }
+    }
+    else
+    {
+        LOGERROR("Failed to select option: no options avaialble");
+        return false;
+    }
+}
+
+bool DialogueController::progressDialogue()
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::ProgressDialogue);
+    if(m_isPaused) return false;
+    trimNodes();
+    ScopedIncrement step(m_stepDepth);
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Run);
+    return run();
+}
+
+void DialogueController::skipDialogue()
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::SkipDialogue);
+    if(m_isPaused) return;
+
+    if (m_nodeStack.empty() == false)
+    {
+        m_isSkipping = true;
+        size_t skippedLines = 0;
+        while (m_isSkipping)
+        {
+            if(++skippedLines > k_maxSkippedLines)
+            {
+                LOGERROR("Failed to skip dialogue: No option or end within %zu lines, stopping at the current line", k_maxSkippedLines);
+                m_isSkipping = false;
+                break;
+            }
+            m_isSkipping = progressDialogue();
+        }
+    }
+    else
+    {
+        LOGERROR("Failed to skip dialogue: Empty node stack");
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//State Snapshots
+//-------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+    const uint8_t k_stateVersion = 2;
+
+    enum StateFlags : uint8_t
+    {
+        k_stateFlagPaused = 1 << 0,
+    };
+}
+
+void DialogueController::saveState(StateBuffer& out_state) const
+{
+    out_state.clear();
+    DialogueBinaryWriter writer(out_state);
+
+    writer.writeUInt8(k_stateVersion);
+    writer.writeUInt32(m_nodeTableHash);
+    writer.writeUInt8(m_isPaused ? k_stateFlagPaused : 0);
+    writer.writeUInt64(m_random.seed);
+    writer.writeVarUInt(m_random.counter);
+
+    //variant indices are written +1 so k_noVariant wraps to 0
+    writer.writeVarUInt(m_nodeStack.size());
+    for(const auto& state : m_nodeStack)
+    {
+        writer.writeVarUInt(state.nodeId);
+        writer.writeVarUInt(state.lineIndex);
+        writer.writeVarUInt(static_cast<uint32_t>(state.variantIndex + 1));
+    }
+
+    //presented options always belong to the line at the top of the stack
+    writer.writeVarUInt(m_presentedOptions.size());
+
+    writer.writeVarUInt(m_lastVariants.size());
+    for(const auto& lastVariant : m_lastVariants)
+    {
+        writer.writeVarUInt(lastVariant.first.first);
+        writer.writeVarUInt(lastVariant.first.second);
+        writer.writeVarUInt(lastVariant.second);
+    }
+}
+
+bool DialogueController::restoreState(const StateBuffer& _state, bool _notifyDelegate)
+{
+    return restoreState(_state.data(), _state.size(), _notifyDelegate);
+}
+
+bool DialogueController::restoreState(const uint8_t* _data, size_t _size, bool _notifyDelegate)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::RestoreState, DialogueRecorder::Bytes{ _data, _size }, _notifyDelegate);
+    if(m_isProgressing)
+    {
+        LOGERROR("Failed to restore state: dialogue is progressing");
+        return false;
+    }
+    trimNodes();
+    ScopedIncrement step(m_stepDepth);
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Run);
+
+    DialogueBinaryReader reader(_data, _size);
+
+    uint8_t version = 0, flags = 0;
+    uint32_t nodeTableHash = 0;
+    DialogueRandom random;
+    uint64_t depth = 0;
+    if(reader.readUInt8(version) == false || version != k_stateVersion)
+    {
+        LOGERROR("Failed to restore state: unsupported version (%u)", version);
+        return false;
+    }
+    if(reader.readUInt32(nodeTableHash) == false || nodeTableHash != m_nodeTableHash)
+    {
+        LOGERROR("Failed to restore state: node table does not match");
+        return false;
+    }
+    if(reader.readUInt8(flags) == false
+       || reader.readUInt64(random.seed) == false
+       || reader.readVarUInt(random.counter) == false
+       || reader.readVarUInt(depth) == false
+       || depth > _size) //every frame takes at least two bytes, so this only guards against garbage
+    {
+        LOGERROR("Failed to restore state: truncated data");
+        return false;
+    }
+
+    NodeStack nodeStack;
+    nodeStack.reserve(static_cast<size_t>(depth));
+    for(uint64_t i = 0; i < depth; ++i)
+    {
+        uint64_t nodeId = 0, lineIndex = 0, variant = 0;
+        if(reader.readVarUInt(nodeId) == false || reader.readVarUInt(lineIndex) == false || reader.readVarUInt(variant) == false)
+        {
+            LOGERROR("Failed to restore state: truncated data");
+            return false;
+        }
+        auto node = loadNodeById(static_cast<DialogueNode::Id>(nodeId));
+        if(node == nullptr || lineIndex > node->lines.size()
+           || (variant > 0 && (lineIndex == node->lines.size() || variant > node->lines[lineIndex].variants.size())))
+        {
+            LOGERROR("Failed to restore state: invalid node state (%u:%u)", static_cast<unsigned>(nodeId), static_cast<unsigned>(lineIndex));
+            return false;
+        }
+        nodeStack.push_back({ node->id, static_cast<size_t>(lineIndex), static_cast<unsigned>(variant - 1) });
+    }
+
+    uint64_t optionCount = 0, lastVariantCount = 0;
+    if(reader.readVarUInt(optionCount) == false || reader.readVarUInt(lastVariantCount) == false || lastVariantCount > _size)
+    {
+        LOGERROR("Failed to restore state: truncated data");
+        return false;
+    }
+    if(optionCount > 0)
+    {
+        const auto top = nodeStack.empty() ? nullptr : loadNodeById(nodeStack.back().nodeId);
+        if(top == nullptr
+           || nodeStack.back().lineIndex >= top->lines.size()
+           || optionCount > getLine(*top, nodeStack.back()).options.size())
+        {
+            LOGERROR("Failed to restore state: invalid presented options");
+            return false;
+        }
+    }
+
+    //unknown lines are kept, they only influence which variant is picked
+    std::pmr::map<std::pair<DialogueNode::Id, size_t>, unsigned> lastVariants(m_memoryResource);
+    for(uint64_t i = 0; i < lastVariantCount; ++i)
+    {
+        uint64_t nodeId = 0, lineIndex = 0, variant = 0;
+        if(reader.readVarUInt(nodeId) == false || reader.readVarUInt(lineIndex) == false || reader.readVarUInt(variant) == false)
+        {
+            LOGERROR("Failed to restore state: truncated data");
+            return false;
+        }
+        lastVariants[{ static_cast<DialogueNode::Id>(nodeId), static_cast<size_t>(lineIndex) }] = static_cast<unsigned>(variant);
+    }
+    if(reader.isAtEnd() == false)
+    {
+        LOGERROR("Failed to restore state: malformed data");
+        return false;
+    }
+
+    //everything is valid, apply
+    m_nodeStack = std::move(nodeStack);
+    m_presentedOptions.clear();
+    for(size_t i = 0; i < optionCount; ++i)
+    {
+        const auto& top = m_nodeStack.back();
+        m_presentedOptions.push_back({ top.nodeId, top.lineIndex, top.variantIndex, i });
+    }
+    m_lastVariants.swap(lastVariants);
+    m_random = random;
+    m_isPaused = (flags & k_stateFlagPaused) != 0;
+    m_isSkipping = false;
+    m_pendingStop = false;
+    if(m_history)
+    {
+        m_history->clear();
+    }
+
+    if(_notifyDelegate && m_isPaused == false && m_nodeStack.empty() == false)
+    {
+        const auto& top = m_nodeStack.back();
+        if(const auto topNode = loadNodeById(top.nodeId))
+        {
+            present(*topNode, top.lineIndex);
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//History
+//-------------------------------------------------------------------------------------------------------------------
+
+void DialogueController::setHistoryCapacity(size_t _capacity)
+{
+    if(_capacity == 0)
+    {
+        m_history.reset();
+    }
+    else if(m_history)
+    {
+        m_history->setCapacity(_capacity);
+    }
+    else
+    {
+        m_history.reset(new DialogueHistory(_capacity, m_memoryResource));
+    }
+}
+
+size_t DialogueController::getHistorySize() const
+{
+    return m_history ? m_history->getSize() : 0;
+}
+
+bool DialogueController::rewind(size_t _steps)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::Rewind, _steps);
+    if(m_isPaused || m_isProgressing) return false;
+    trimNodes();
+    ScopedIncrement step(m_stepDepth);
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Run);
+
+    const DialogueHistory::Entry* entry = m_history ? m_history->getEntry(_steps) : nullptr;
+    if(entry == nullptr)
+    {
+        LOGERROR("Failed to rewind %zu lines: not enough history", _steps);
+        return false;
+    }
+
+    NodeStack nodeStack;
+    DialogueHistory::toNodeStack(*entry, nodeStack);
+    DialogueNode* topNode = nullptr;
+    for(const auto& state : nodeStack)
+    {
+        topNode = loadNodeById(state.nodeId);
+        if(topNode == nullptr)
+        {
+            LOGERROR("Failed to rewind: node (%u) no longer exists", state.nodeId);
+            return false;
+        }
+    }
+    const auto randomCounter = m_random.counter;
+    m_random.counter = entry->randomCounter;
+
+    //the target entry replaces the history after it when presented, nothing changes if it can't be presented
+    const auto presentedOptions = m_presentedOptions;
+    auto previousStack = std::move(m_nodeStack);
+    m_nodeStack = std::move(nodeStack);
+    m_historyDropCount = _steps + 1;
+    if(present(*topNode, m_nodeStack.back().lineIndex) == false)
+    {
+        LOGERROR("Failed to rewind %zu lines: the line can no longer be presented", _steps);
+        m_historyDropCount = 0;
+        m_nodeStack = std::move(previousStack);
+        m_presentedOptions.assign(presentedOptions.begin(), presentedOptions.end());
+        m_random.counter = randomCounter;
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Visits
+//-------------------------------------------------------------------------------------------------------------------
+
+const DialogueVisitTracker& DialogueController::getVisits() const
+{
+    return m_visits;
+}
+
+void DialogueController::resetVisits()
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::ResetVisits);
+    m_visits.reset();
+}
+
+void DialogueController::saveVisits(StateBuffer& out_state) const
+{
+    out_state.clear();
+    DialogueBinaryWriter writer(out_state);
+    writer.writeUInt32(m_nodeTableHash);
+    m_visits.save(out_state);
+}
+
+bool DialogueController::restoreVisits(const StateBuffer& _state)
+{
+    return restoreVisits(_state.data(), _state.size());
+}
+
+bool DialogueController::restoreVisits(const uint8_t* _data, size_t _size)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::RestoreVisits, DialogueRecorder::Bytes{ _data, _size });
+    DialogueBinaryReader reader(_data, _size);
+    uint32_t nodeTableHash = 0;
+    if(reader.readUInt32(nodeTableHash) == false || nodeTableHash != m_nodeTableHash)
+    {
+        LOGERROR("Failed to restore visits: node table does not match");
+        return false;
+    }
+    if(m_visits.restore(_data + reader.getOffset(), _size - reader.getOffset()) == false)
+    {
+        LOGERROR("Failed to restore visits: malformed data");
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Accessors
+//-------------------------------------------------------------------------------------------------------------------
+
+void DialogueController::setDialogueResolver(const IDialogueResolver *_resolver)
+{
+    m_dialogueResolver = _resolver;
+    updateRuntimeResolver();
+    for(auto& entry : m_conditionCache)
+    {
+        entry.isValid = false;
+    }
+}
+
+const IDialogueResolver* DialogueController::getDialogueResolver() const
+{
+    return m_dialogueResolver;
+}
+
+void DialogueController::setDialogueDelegate(IDialogueDelegate* _delegate)
+{
+    m_dialogueDelegate = _delegate;
+}
+
+IDialogueDelegate* DialogueController::getDialogueDelegate() const
+{
+    return m_dialogueDelegate;
+}
+
+void DialogueController::setActionRegistry(const DialogueActionRegistry* _registry)
+{
+    m_actionRegistry = _registry;
+    for(auto node : m_nodes)
+    {
+        if(node == nullptr) continue;
+        const auto relinkLine = [this, node](DialogueNode::Line& _line)
+        {
+            for(auto& action : _line.actions)
+            {
+                linkAction(*node, action);
+            }
+            for(auto& option : _line.options)
+            {
+                for(auto& action : option.actions)
+                {
+                    linkAction(*node, action);
+                }
+            }
+        };
+        for(auto& line : node->lines)
+        {
+            relinkLine(line);
+            for(auto& variant : line.variants)
+            {
+                relinkLine(variant);
+            }
+        }
+    }
+}
+
+const DialogueActionRegistry* DialogueController::getActionRegistry() const
+{
+    return m_actionRegistry;
+}
+
+const DialogueController::NodeState* DialogueController::getCurrentNodeState() const
+{
+    if(m_nodeStack.empty())
+    {
+        return nullptr;
+    }
+    else
+    {
+        return &m_nodeStack.back();
+    }
+}
+
+const DialogueController::NodeStack* DialogueController::getNodeStack() const
+{
+    return &m_nodeStack;
+}
+
+void DialogueController::setParseCache(DialogueParseCache* _cache)
+{
+    m_parseCache = _cache;
+}
+
+DialogueParseCache* DialogueController::getParseCache() const
+{
+    return m_parseCache;
+}
+
+bool DialogueController::setMetrics(DialogueMetrics* _metrics)
+{
+#if DIALOGUE_METRICS
+    m_metrics = _metrics;
+    updateRuntimeResolver();
+    return true;
+#else
+    if(_metrics)
+    {
+        LOGERROR("Failed to set metrics: built without DIALOGUE_METRICS");
+    }
+    return _metrics == nullptr;
+#endif
+}
+
+DialogueMetrics* DialogueController::getMetrics() const
+{
+    return m_metrics;
+}
+
+bool DialogueController::setRecorder(DialogueRecorder* _recorder)
+{
+    if(m_isProgressing || m_stepDepth > 0)
+    {
+        LOGERROR("Failed to set recorder: dialogue is progressing");
+        return false;
+    }
+    m_recorder = _recorder;
+    if(m_recorder)
+    {
+        StateBuffer state, visits;
+        saveState(state);
+        saveVisits(visits);
+        m_recorder->begin(state, visits, m_history ? m_history->getCapacity() : 0, m_avoidRepeatedVariants);
+
+        //replays start without cached conditions, so the recording has to as well
+        for(auto& entry : m_conditionCache)
+        {
+            entry.isValid = false;
+        }
+    }
+    updateRuntimeResolver();
+    return true;
+}
+
+DialogueRecorder* DialogueController::getRecorder() const
+{
+    return m_recorder;
+}
+
+void DialogueController::setRandomSeed(uint64_t _seed)
+{
+    const DialogueRecorder::ScopedCall call(m_recorder, DialogueRecorder::Event::SetRandomSeed, _seed);
+    m_random = DialogueRandom(_seed);
+}
+
+const DialogueRandom& DialogueController::getRandom() const
+{
+    return m_random;
+}
+
+void DialogueController::setLocaleTable(const DialogueLocaleTable* _table)
+{
+    m_localeTable = _table;
+    m_localizedText.clear();
+}
+
+const DialogueLocaleTable* DialogueController::getLocaleTable() const
+{
+    return m_localeTable;
+}
+
+std::string_view DialogueController::getLocalizedText(uint64_t _lineId, const std::string& _content) const
+{
+    std::string_view text;
+    if(m_localeTable && _lineId != 0 && m_localeTable->find(_lineId, text))
+    {
+        return text;
+    }
+    return _content;
+}
+
+void DialogueController::resolveText(DialogueLineParser& _parser,
+                                     uint64_t _lineId,
+                                     const std::string& _content,
+                                     const std::vector<DialogueNode::Markup>& _markup,
+                                     std::string& out_text,
+                                     std::vector<DialogueNode::Markup>& out_markup) const
+{
+    const auto text = getLocalizedText(_lineId, _content);
+    if(text.data() == _content.data())
+    {
+        _parser.substituteVariables(text, _markup, out_text, out_markup);
+        return;
+    }
+    if(m_isMarkupEnabled == false)
+    {
+        static const std::vector<DialogueNode::Markup> k_noMarkup;
+        _parser.substituteVariables(text, k_noMarkup, out_text, out_markup);
+        return;
+    }
+
+    auto localized = m_localizedText.find(_lineId);
+    if(localized == m_localizedText.end())
+    {
+        localized = m_localizedText.emplace(_lineId, LocalizedText{ std::string(text), {} }).first;
+        DialogueLineParser::parseMarkup(localized->second.text, localized->second.markup);
+    }
+    _parser.substituteVariables(localized->second.text, localized->second.markup, out_text, out_markup);
+}
+
+void DialogueController::setAvoidRepeatedVariants(bool _avoidRepeats)
+{
+    m_avoidRepeatedVariants = _avoidRepeats;
+    if(m_avoidRepeatedVariants == false)
+    {
+        m_lastVariants.clear();
+    }
+}
+
+bool DialogueController::getAvoidRepeatedVariants() const
+{
+    return m_avoidRepeatedVariants;
+}
+
+void DialogueController::setMarkupEnabled(bool _isEnabled)
+{
+    m_isMarkupEnabled = _isEnabled;
+    m_localizedText.clear();
+}
+
+bool DialogueController::isMarkupEnabled() const
+{
+    return m_isMarkupEnabled;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Internal Helpers
+//-------------------------------------------------------------------------------------------------------------------
+
+bool DialogueController::readConditionVersions(const DialogueNode::Condition& _condition, std::vector<uint64_t>& out_versions) const
+{
+    out_versions.clear();
+    for(const auto& variable : _condition.variables)
+    {
+        uint64_t version = 0;
+        if(m_runtimeResolver == nullptr || m_runtimeResolver->getVariableVersion(variable, version) == false)
+        {
+            return false;
+        }
+        out_versions.push_back(version);
+    }
+    for(auto operand : { &_condition.lvalue, &_condition.rvalue })
+    {
+        if(operand->type != DialogueNode::Condition::Operand::Type::Text)
+        {
+            out_versions.push_back(m_visits.getVisitCount(operand->nodeId));
+        }
+    }
+    return true;
+}
+
+bool DialogueController::resolveCondition(DialogueLineParser& _parser, const DialogueNode::Condition& _condition)
+{
+    const bool result = resolveCachedCondition(_parser, _condition);
+    METRICS(recordCondition(result));
+    return result;
+}
+
+bool DialogueController::resolveCachedCondition(DialogueLineParser& _parser, const DialogueNode::Condition& _condition)
+{
+    if(_condition.cacheIndex >= m_conditionCache.size())
+    {
+        return _parser.resolveCondition(_condition);
+    }
+
+    auto& entry = m_conditionCache[_condition.cacheIndex];
+    const uint64_t variablesVersion = m_runtimeResolver ? m_runtimeResolver->getVariablesVersion() : 0;
+    if(entry.isValid)
+    {
+        //nothing at all has changed
+        const bool hasVisitOperand = _condition.lvalue.type != DialogueNode::Condition::Operand::Type::Text
+                                  || _condition.rvalue.type != DialogueNode::Condition::Operand::Type::Text;
+        if(variablesVersion != 0 && variablesVersion == entry.variablesVersion && hasVisitOperand == false)
         {
-            return advanceLine();
+            TRACE_VERBOSE(ConditionCacheHit, _condition.cacheIndex, entry.result);
+            return entry.result;
+        }
+
+        //check the versions of the dependencies
+        static thread_local std::vector<uint64_t> s_versions;
+        if(readConditionVersions(_condition, s_versions) && s_versions == entry.versions)
+        {
+            entry.variablesVersion = variablesVersion;
+            TRACE_VERBOSE(ConditionCacheHit, _condition.cacheIndex, entry.result);
+            return entry.result;
         }
-        return true;
     }
-    else
+
+    entry.result = _parser.resolveCondition(_condition);
+    entry.isValid = readConditionVersions(_condition, entry.versions);
+    entry.variablesVersion = variablesVersion;
+    return entry.result;
+}
+
+DialogueController::ScopedParser::ScopedParser(const DialogueController& _controller, const IDialogueResolver* _resolver, const DialogueVisitTracker* _visits)
+: m_controller(_controller)
+, m_parser(nullptr)
+{
+    auto& parsers = m_controller.m_parsers;
+    if(m_controller.m_parserDepth == parsers.size())
     {
-        LOG("Failed to start Dialogue: empty stack given");
-        return false;
+        parsers.emplace_back(new DialogueLineParser(_resolver, _visits));
     }
+    m_parser = parsers[m_controller.m_parserDepth++].get();
+    m_parser->setResolver(_resolver, _visits);
 }
 
-bool DialogueController::stop()
+DialogueController::ScopedParser::~ScopedParser()
 {
-    if(m_isProgressing)
+    m_controller.m_parserDepth--;
+}
+
+DialogueController::ScopedParser::operator DialogueLineParser&()
+{
+    return *m_parser;
+}
+
+DialogueNode::Id DialogueController::reserveNodeId(const std::string& _name)
+{
+    auto it = m_nodeIds.find(_name);
+    if (it != m_nodeIds.end())
     {
-        m_pendingStop = true;
-        return true;
+        return it->second;
     }
-    else if(m_nodeStack.empty() == false)
+
+    const auto id = static_cast<DialogueNode::Id>(m_nodes.size());
+    m_nodeIds.emplace(_name, id);
+    m_nodes.push_back(nullptr);
+
+    //fold the name into the table hash so snapshots can detect a different set of nodes
+    const auto hash = hashDialogueString(_name, m_nodeTableHash);
+    m_nodeTableHash = static_cast<uint32_t>(hash ^ (hash >> 32));
+    return id;
+}
+
+void DialogueController::linkNode(DialogueNode& _node)
+{
+    //resolve node names referenced by conditions to ids so visit queries are a single lookup
+    const auto linkConditions = [this](std::vector<DialogueNode::Condition>& _conditions)
     {
-        onDialogueEnded();
-        return true;
-    }
-    else
+        for(auto& condition : _conditions)
+        {
+            if(m_freeConditionSlots.empty())
+            {
+                condition.cacheIndex = static_cast<unsigned>(m_conditionCache.size());
+                m_conditionCache.push_back({ false, false, 0, {} });
+            }
+            else
+            {
+                condition.cacheIndex = m_freeConditionSlots.back();
+                m_freeConditionSlots.pop_back();
+                m_conditionCache[condition.cacheIndex] = { false, false, 0, {} };
+            }
+
+            for(auto operand : { &condition.lvalue, &condition.rvalue })
+            {
+                if(operand->type != DialogueNode::Condition::Operand::Type::Text)
+                {
+                    operand->nodeId = reserveNodeId(operand->value);
+                }
+            }
+        }
+    };
+
+    //parse and index tags, only top level nodes are indexed. Paged nodes are indexed for as long as they are archived
+    _node.tagIds.clear();
+    if(_node.parent.empty())
     {
-        LOGERROR("Failed to stop Dialogue: not running");
-        return false;
+        internTags(_node.tags, _node.tagIds);
+        if(isPaged(_node.id) == false)
+        {
+            m_tags.addNode(_node.id, _node.tagIds);
+        }
     }
-}
 
-void DialogueController::setIsPaused(bool _isPaused)
-{
-    if(_isPaused != m_isPaused)
+    const auto linkLine = [&](DialogueNode::Line& _line, size_t _lineIndex)
     {
-        m_isPaused = _isPaused;
-        if(m_isPaused)
+        //intern the actor and index the line, once per actor when % variants share an index. The table keeps the key,
+        //a line linked before, e.g. when relinking for a new action registry, only has its id
+        if(_line.actorKey.empty() == false)
         {
-            if(m_dialogueDelegate)
+            _line.actorId = m_actors.intern(_line.actorKey);
+            std::string().swap(_line.actorKey);
+        }
+        if(_line.actorId != DialogueNode::k_invalidId)
+        {
+            if(_line.actorId >= m_actorLines.size())
             {
-                m_dialogueDelegate->onPaused();
+                m_actorLines.resize(_line.actorId + 1);
+            }
+            auto& actorLines = m_actorLines[_line.actorId];
+            if(actorLines.empty() || actorLines.back().nodeId != _node.id || actorLines.back().lineIndex != _lineIndex)
+            {
+                actorLines.push_back({ _node.id, _lineIndex });
             }
+            _node.actorIds.push_back(_line.actorId);
         }
-        else
+
+        linkConditions(_line.conditions);
+        for(auto& action : _line.actions)
         {
-            progressDialogue();
+            linkAction(_node, action);
+        }
+        for(auto& option : _line.options)
+        {
+            linkConditions(option.conditions);
+            for(auto& action : option.actions)
+            {
+                linkAction(_node, action);
+            }
+        }
+    };
+
+    _node.actorIds.clear();
+    for(size_t lineIndex = 0; lineIndex < _node.lines.size(); ++lineIndex)
+    {
+        auto& line = _node.lines[lineIndex];
+        linkLine(line, lineIndex);
+        for(auto& variant : line.variants)
+        {
+            linkLine(variant, lineIndex);
         }
     }
+
+    std::sort(_node.actorIds.begin(), _node.actorIds.end());
+    _node.actorIds.erase(std::unique(_node.actorIds.begin(), _node.actorIds.end()), _node.actorIds.end());
 }
 
-bool DialogueController::getIsPaused() const
+const DialogueNode::Line& DialogueController::getLine(const DialogueNode& _node, const NodeState& _state)
 {
-    return m_isPaused;
+    const auto& line = _node.lines[_state.lineIndex];
+    if(_state.variantIndex < line.variants.size())
+    {
+        return line.variants[_state.variantIndex];
+    }
+    return line;
 }
 
-bool DialogueController::selectOption(size_t _index)
+void DialogueController::unlinkNode(const DialogueNode& _node)
 {
-    if(m_isPaused) return false;
+    if(_node.parent.empty() && isPaged(_node.id) == false)
+    {
+        m_tags.removeNode(_node.id, _node.tagIds);
+    }
 
-    if(m_presentedOptions.empty() == false)
+    const auto releaseConditions = [this](const std::vector<DialogueNode::Condition>& _conditions)
     {
-        if(_index < m_presentedOptions.size())
+        for(const auto& condition : _conditions)
         {
-            const auto option = m_presentedOptions[_index];
-            m_presentedOptions.clear();
-
-            //resolve actions for option
-            if(option.resolveActions) { option.resolveActions(); }
-
-            //progress to next node if any
-            if(!m_isPaused && !m_pendingStop && option.nextNode.empty() == false)
-            {
-                return enterNode(option.nextNode);
-            }
-            else //progress dialogue as normal
+            if(condition.cacheIndex < m_conditionCache.size())
             {
-                return run();
+                m_freeConditionSlots.push_back(condition.cacheIndex);
             }
         }
-        else
+    };
+    const auto releaseLine = [&](const DialogueNode::Line& _line)
+    {
+        releaseConditions(_line.conditions);
+        for(const auto& option : _line.options)
         {
-            LOGERROR("Failed to select option: invalid index (%zu)", _index);
-            return false;
+            releaseConditions(option.conditions);
+        }
+    };
+    for(const auto& line : _node.lines)
+    {
+        releaseLine(line);
+        for(const auto& variant : line.variants)
+        {
+            releaseLine(variant);
         }
     }
-    else
+
+    for(const auto actorId : _node.actorIds)
     {
-        LOGERROR("Failed to select option: no options avaialble");
-        return false;
+        auto& lines = m_actorLines[actorId];
+        lines.erase(std::remove_if(lines.begin(), lines.end(), [&_node](const NodeState& _line) { return _line.nodeId == _node.id; }), lines.end());
     }
 }
 
-bool DialogueController::progressDialogue()
+void DialogueController::internTags(const std::string& _tags, std::vector<unsigned>& out_tagIds)
 {
-    if(m_isPaused) return false;
-    return run();
+    out_tagIds.clear();
+    std::vector<std::string> tags;
+    DialogueTagIndex::parseTags(_tags, tags);
+    for(const auto& tag : tags)
+    {
+        out_tagIds.push_back(m_tags.intern(tag));
+    }
+    std::sort(out_tagIds.begin(), out_tagIds.end());
+    out_tagIds.erase(std::unique(out_tagIds.begin(), out_tagIds.end()), out_tagIds.end());
 }
 
-void DialogueController::skipDialogue()
+void DialogueController::setSourceHash(DialogueNode::Id _id, uint64_t _hash)
 {
-    if(m_isPaused) return;
-
-    if (m_nodeStack.empty() == false)
+    if(_id == DialogueNode::k_invalidId)
     {
-        m_isSkipping = true;
-        while (m_isSkipping)
-        {
-            m_isSkipping = progressDialogue();
-        }
+        return;
     }
-    else
+    if(_id >= m_sourceHashes.size())
     {
-        LOGERROR("Failed to skip dialogue: Empty node stack");
+        if(_hash == 0) return;
+        m_sourceHashes.resize(_id + 1, 0);
     }
+    m_sourceHashes[_id] = _hash;
 }
 
-//-------------------------------------------------------------------------------------------------------------------
-//Accessors
-//-------------------------------------------------------------------------------------------------------------------
-
-void DialogueController::setDialogueResolver(const IDialogueResolver *_resolver)
+void DialogueController::updateRuntimeResolver()
 {
-    m_dialogueResolver = _resolver;
+    const IDialogueResolver* resolver = m_recorder && m_dialogueResolver ? m_recorder->wrapResolver(m_dialogueResolver) : m_dialogueResolver;
+    m_timedResolver.set(resolver, m_metrics);
+    m_runtimeResolver = m_metrics && resolver ? &m_timedResolver : resolver;
 }
 
-const IDialogueResolver* DialogueController::getDialogueResolver() const
+DialogueNode* DialogueController::createNode(DialogueNode _node)
 {
-    return m_dialogueResolver;
+    std::pmr::polymorphic_allocator<DialogueNode> allocator(m_memoryResource);
+    auto node = allocator.allocate(1);
+    allocator.construct(node, std::move(_node));
+    return node;
 }
 
-void DialogueController::setDialogueDelegate(IDialogueDelegate* _delegate)
+void DialogueController::destroyNode(DialogueNode* _node)
 {
-    m_dialogueDelegate = _delegate;
+    if(_node)
+    {
+        std::pmr::polymorphic_allocator<DialogueNode> allocator(m_memoryResource);
+        allocator.destroy(_node);
+        allocator.deallocate(_node, 1);
+    }
 }
 
-IDialogueDelegate* DialogueController::getDialogueDelegate() const
+bool DialogueController::isPaged(DialogueNode::Id _id) const
 {
-    return m_dialogueDelegate;
+    return _id < m_pages.size() && m_pages[_id].archiveIndex != k_notPaged;
 }
 
-const DialogueController::NodeState* DialogueController::getCurrentNodeState() const
+DialogueNode* DialogueController::pageNode(DialogueNode::Id _id)
 {
-    if(m_nodeStack.empty())
+    const DialogueCountingResource::ScopedPhase phase(m_countingResource, DialogueCountingResource::Phase::Link);
+    auto& page = m_pages[_id];
+    if(m_nodes[_id])
     {
-        return nullptr;
+        ++m_pagingStats.hits;
+        m_residentPages.splice(m_residentPages.begin(), m_residentPages, page.position);
+        return m_nodes[_id];
     }
-    else
+
+    ++m_pagingStats.misses;
+    auto node = createNode(DialogueNode());
+    if(m_nodeArchive->loadNode(page.archiveIndex, *node) == false)
     {
-        return &m_nodeStack.back();
+        destroyNode(node);
+        return nullptr;
     }
+    node->id = _id;
+    linkNode(*node);
+    m_nodes[_id] = node;
+
+    page.bytes = DialogueCompactScript::getExpandedSize(*node);
+    m_residentPages.push_front(_id);
+    page.position = m_residentPages.begin();
+    ++m_pagingStats.residentNodes;
+    m_pagingStats.residentBytes += page.bytes;
+    TRACE_INFO(NodePagedIn, _id, static_cast<uint32_t>(page.bytes));
+    return node;
 }
 
-const DialogueController::NodeStack* DialogueController::getNodeStack() const
+void DialogueController::evictNode(DialogueNode::Id _id)
 {
-    return &m_nodeStack;
+    auto node = m_nodes[_id];
+    if(node == nullptr)
+    {
+        return;
+    }
+
+    auto& page = m_pages[_id];
+    unlinkNode(*node);
+    m_nodes[_id] = nullptr;
+    destroyNode(node);
+    m_residentPages.erase(page.position);
+    page.position = m_residentPages.end();
+    --m_pagingStats.residentNodes;
+    m_pagingStats.residentBytes -= page.bytes;
+    TRACE_INFO(NodeEvicted, _id);
 }
 
-//-------------------------------------------------------------------------------------------------------------------
-//Internal Helpers
-//-------------------------------------------------------------------------------------------------------------------
+void DialogueController::linkAction(const DialogueNode& _node, DialogueNode::Action& _action) const
+{
+    static_cast<void>(_node); //only logged
+
+    //name and params are left as parsed so relinking, e.g. after setActionRegistry, starts from the source
+    _action.handlerParams.clear();
+    _action.args.clear();
+    _action.dynamicParams.clear();
+    _action.handlerId = DialogueActionRegistry::k_invalidId;
+
+    auto nameLower(_action.name);
+    std::transform(nameLower.begin(), nameLower.end(), nameLower.begin(), ::tolower);
+    if(nameLower == "stop" || nameLower == "end" || nameLower == "fin" || nameLower == "exit")
+    {
+        _action.binding = DialogueNode::Action::Binding::Stop;
+        return;
+    }
+
+    for(unsigned i = 0; i < _action.params.size(); ++i)
+    {
+        if(_action.params[i].find("$(") != std::string::npos)
+        {
+            _action.dynamicParams.push_back(i);
+        }
+    }
+
+    _action.binding = DialogueNode::Action::Binding::Resolver;
+    if(m_actionRegistry == nullptr)
+    {
+        return;
+    }
+
+    //<<name arguments>> forms are matched on the first word, with the rest passed as the first param
+    auto handlerId = m_actionRegistry->find(_action.name);
+    std::vector<std::string> params(_action.params);
+    if(handlerId == DialogueActionRegistry::k_invalidId)
+    {
+        const auto nameEnd = _action.name.find_first_of(" \t");
+        if(nameEnd != std::string::npos)
+        {
+            handlerId = m_actionRegistry->find(_action.name.substr(0, nameEnd));
+            params.insert(params.begin(), _action.name.substr(_action.name.find_first_not_of(" \t", nameEnd)));
+        }
+    }
+    if(handlerId == DialogueActionRegistry::k_invalidId)
+    {
+        LOGERROR("Unknown action '%s' in node '%s', falling back to the resolver", _action.name.c_str(), _node.name.c_str());
+        return;
+    }
+
+    const auto& types = m_actionRegistry->getParameterTypes(handlerId);
+    const bool isVariadic = m_actionRegistry->isVariadic(handlerId);
+    if(isVariadic == false && params.size() != types.size())
+    {
+        LOGERROR("Action '%s' in node '%s' expects %zu params but has %zu, falling back to the resolver",
+                 _action.name.c_str(), _node.name.c_str(), types.size(), params.size());
+        return;
+    }
+
+    std::vector<DialogueValue> args(params.size());
+    std::vector<unsigned> dynamicParams;
+    for(unsigned i = 0; i < params.size(); ++i)
+    {
+        const auto type = i < types.size() ? types[i] : DialogueValue::Type::String;
+        if(params[i].find("$(") != std::string::npos)
+        {
+            dynamicParams.push_back(i);
+        }
+        else if(DialogueActionRegistry::convert(params[i], type, args[i]) == false)
+        {
+            LOGERROR("Action '%s' in node '%s': param %u '%s' has the wrong type, falling back to the resolver",
+                     _action.name.c_str(), _node.name.c_str(), i, params[i].c_str());
+            return;
+        }
+    }
+
+    _action.binding = DialogueNode::Action::Binding::Handler;
+    _action.handlerId = handlerId;
+    _action.handlerParams.swap(params);
+    _action.args.swap(args);
+    _action.dynamicParams.swap(dynamicParams);
+}
 
 bool DialogueController::run()
 {
@@ -344,7 +2015,8 @@ bool DialogueController::run()
 
 bool DialogueController::advanceLine()
 {
-    DialogueLineParser parser(m_dialogueResolver);
+    ScopedParser scopedParser(*this, m_runtimeResolver, &m_visits);
+    DialogueLineParser& parser = scopedParser;
 
     bool wasProgressing = m_isProgressing;
     m_isProgressing = true;
@@ -352,19 +2024,27 @@ bool DialogueController::advanceLine()
     bool didAdvance = false;
     while(m_isPaused == false && m_pendingStop == false && didAdvance == false && m_nodeStack.empty() == false)
     {
-        auto& activeNode = m_nodeStack.back().node;
+        auto activeNode = loadNodeById(m_nodeStack.back().nodeId);
+        if(activeNode == nullptr)
+        {
+            LOGERROR("Failed to progress dialogue: node (%u) couldn't be loaded, stopping dialogue", m_nodeStack.back().nodeId);
+            m_pendingStop = true;
+            break;
+        }
         auto& lineIndex = m_nodeStack.back().lineIndex;
+        METRICS(setContext(activeNode->id, lineIndex));
 
         //process exiting the current line
         if (lineIndex < activeNode->lines.size())
         {
-            auto& currentLine = activeNode->lines[lineIndex];
+            const auto& currentLine = getLine(*activeNode, m_nodeStack.back());
 
-            //resolve line conditions
-            bool conditionFailed = false;
+            //resolve line conditions, a % group is skipped if none of its variants could be presented
+            bool conditionFailed = activeNode->lines[lineIndex].variants.empty() == false
+                                   && m_nodeStack.back().variantIndex == DialogueNode::k_noVariant;
             for(const auto& condition : currentLine.conditions)
             {
-                if(parser.resolveCondition(condition) == false)
+                if(resolveCondition(parser, condition) == false)
                 {
                     conditionFailed = true;
                     break;
@@ -373,13 +2053,14 @@ bool DialogueController::advanceLine()
             if(conditionFailed)
             {
                 lineIndex++;
+                m_nodeStack.back().variantIndex = DialogueNode::k_noVariant;
                 continue;
             }
 
             //resolve line actions
             for(const auto& action : currentLine.actions)
             {
-                resolveAction(action.name, action.params);
+                resolveAction(action);
                 if(m_isPaused || m_pendingStop)
                 {
                     continue;
@@ -389,7 +2070,12 @@ bool DialogueController::advanceLine()
             //resolve goto
             if (currentLine.gotoNode.empty() == false)
             {
-                didAdvance = enterNode(currentLine.gotoNode);
+                const auto depth = m_nodeStack.size();
+                didAdvance = enterNode(currentLine.gotoNode, 0, false);
+                if(m_pendingStop || m_nodeStack.size() > depth)
+                {
+                    continue; //entering stopped dialogue or pushed a node to continue with, the stack moved under lineIndex
+                }
             }
         }
         else
@@ -407,7 +2093,8 @@ bool DialogueController::advanceLine()
         if (lineIndex + 1 < activeNode->lines.size())
         {
             lineIndex++;
-            didAdvance = present(*activeNode, lineIndex);
+            m_nodeStack.back().variantIndex = DialogueNode::k_noVariant;
+            didAdvance = present(*activeNode, lineIndex, false);
         }
         else
         {
@@ -420,34 +2107,68 @@ bool DialogueController::advanceLine()
     return didAdvance;
 }
 
-bool DialogueController::present(const DialogueNode& _node, size_t _index)
+bool DialogueController::present(const DialogueNode& _node, size_t _index, bool _advance)
 {
     if(_index >= _node.lines.size())
     {
         LOGERROR("Failed to present %s:%zu: Invalid line index", _node.name.c_str(), _index);
+        TRACE_ERROR(InvalidLineIndex, _node.id, static_cast<uint32_t>(_index));
         return false;
     }
 
-    const auto& line = _node.lines[_index];
+    ScopedParser scopedParser(*this, m_runtimeResolver, &m_visits);
+    DialogueLineParser& parser = scopedParser;
+    METRICS(setContext(_node.id, _index));
 
-    DialogueLineParser parser(m_dialogueResolver);
+    //pick a % variant unless one was already presented here, e.g. when rewinding
+    const auto* linePtr = &_node.lines[_index];
+    if(linePtr->variants.empty() == false)
+    {
+        auto& state = m_nodeStack.back();
+        if(state.variantIndex >= linePtr->variants.size())
+        {
+            const auto key = std::make_pair(_node.id, _index);
+            const auto lastVariant = m_avoidRepeatedVariants ? m_lastVariants.find(key) : m_lastVariants.end();
+            state.variantIndex = pickVariant(*linePtr,
+                                             m_random,
+                                             lastVariant != m_lastVariants.end() ? lastVariant->second : DialogueNode::k_noVariant,
+                                             [this, &parser](const DialogueNode::Line& _variant)
+            {
+                for(const auto& condition : _variant.conditions)
+                {
+                    if(resolveCondition(parser, condition) == false) return false;
+                }
+                return true;
+            });
+            if(state.variantIndex == DialogueNode::k_noVariant)
+            {
+                return false;
+            }
+            if(m_avoidRepeatedVariants)
+            {
+                m_lastVariants[key] = state.variantIndex;
+            }
+        }
+        linePtr = &linePtr->variants[state.variantIndex];
+    }
+    const auto& line = *linePtr;
 
     //resolve line conditions
     for(const auto& condition : line.conditions)
     {
-        if(parser.resolveCondition(condition) == false)
+        if(resolveCondition(parser, condition) == false)
         {
             return false; //return false if a condition fails
         }
     }
 
     //handle nothing to present
-    if(line.actorKey.empty() && line.content.empty())
+    if(line.actorId == DialogueNode::k_invalidId && line.content.empty())
     {
         //goto another node if necessary
         if(line.gotoNode.empty() == false)
         {
-            return enterNode(line.gotoNode);
+            return enterNode(line.gotoNode, 0, _advance);
         }
         else //else return false - nothing to present
         {
@@ -457,20 +2178,23 @@ bool DialogueController::present(const DialogueNode& _node, size_t _index)
 
     //resolve content
     DialogueContent dialogueContent;
-    dialogueContent.actorKey = line.actorKey;
-    dialogueContent.speech = parser.substituteVariables(line.content);
+    dialogueContent.actorId = line.actorId;
+    dialogueContent.actorKey = m_actors.getString(line.actorId);
+    dialogueContent.lineId = line.lineId;
+    resolveText(parser, line.lineId, line.content, line.markup, dialogueContent.speech, dialogueContent.markup);
 
     //add options
     m_presentedOptions.clear();
-    for(const auto& option : line.options)
+    for(size_t optionIndex = 0; optionIndex < line.options.size(); ++optionIndex)
     {
+        const auto& option = line.options[optionIndex];
         bool conditionsMet = true;
-        std::string optionContent(option.content);
+        DialogueOption dialogueOption;
 
         //resolve conditions
         for(const auto& condition : option.conditions)
         {
-            if(parser.resolveCondition(condition) == false)
+            if(resolveCondition(parser, condition) == false)
             {
                 conditionsMet = false;
                 break;
@@ -478,78 +2202,148 @@ bool DialogueController::present(const DialogueNode& _node, size_t _index)
         }
 
         //parse out variables
-        optionContent = parser.substituteVariables(optionContent);
+        resolveText(parser, option.lineId, option.content, option.markup, dialogueOption.content, dialogueOption.markup);
+        dialogueOption.isConditionMet = conditionsMet;
+        dialogueOption.lineId = option.lineId;
 
-        dialogueContent.options.push_back({conditionsMet, optionContent});
-        m_presentedOptions.push_back({option.gotoNode, [this, option]
-            {
-                for(const auto& action : option.actions)
-                {
-                    resolveAction(action.name, action.params);
-                }
-            }});
+        dialogueContent.options.push_back(std::move(dialogueOption));
+        m_presentedOptions.push_back({_node.id, _index, m_nodeStack.back().variantIndex, optionIndex});
+    }
+
+    if(m_history)
+    {
+        if(m_historyDropCount > 0)
+        {
+            m_history->drop(m_historyDropCount);
+        }
+        m_history->record(m_nodeStack, m_presentedOptions.size(), m_random.counter);
     }
+    m_historyDropCount = 0;
+
+    m_nodesWithoutLine = 0;
+    TRACE_INFO(LinePresented, _node.id, static_cast<uint32_t>(_index), static_cast<uint32_t>(m_presentedOptions.size()));
+
+    METRICS(recordPresentation());
 
     //notify delegate
+    const DialogueRecorder::ScopedCallback callback(m_recorder, DialogueRecorder::Event::Progress, dialogueContent.lineId, dialogueContent.options.size());
     if(m_dialogueDelegate)
     {
+        METRICS_TIME_DELEGATE();
         m_dialogueDelegate->onProgress(dialogueContent);
     }
 
     return true;
 }
 
-void DialogueController::resolveAction(const std::string& _actionName, const std::vector<std::string>& _params)
+void DialogueController::resolveAction(const DialogueNode::Action& _action)
 {
-    auto nameLower(_actionName);
-    std::transform(_actionName.begin(), _actionName.end(), nameLower.begin(), ::tolower);
-    if(nameLower == "stop" || nameLower == "end" || nameLower == "fin" || nameLower == "exit")
+    if(_action.binding == DialogueNode::Action::Binding::Unlinked)
+    {
+        DialogueNode::Action action(_action);
+        linkAction(DialogueNode(), action);
+        resolveAction(action);
+        return;
+    }
+    if(_action.binding == DialogueNode::Action::Binding::Stop)
     {
         stop();
         return;
     }
 
-    DialogueLineParser parser(m_dialogueResolver);
-    auto parsedParams = _params;
-    for(auto& param : parsedParams)
+    METRICS(recordAction());
+    ScopedParser scopedParser(*this, m_runtimeResolver, nullptr);
+    DialogueLineParser& parser = scopedParser;
+
+    if(_action.binding == DialogueNode::Action::Binding::Handler)
+    {
+        if(_action.dynamicParams.empty())
+        {
+            const DialogueRecorder::ScopedCallback callback(m_recorder, DialogueRecorder::Event::Action, _action.name);
+            m_actionRegistry->invoke(_action.handlerId, _action.args.data(), _action.args.size());
+            return;
+        }
+
+        //only params referencing variables need resolving. The arguments are local to the call, handlers may run dialogue that runs actions
+        std::vector<DialogueValue> args(_action.args);
+        const auto& types = m_actionRegistry->getParameterTypes(_action.handlerId);
+        for(const auto index : _action.dynamicParams)
+        {
+            const auto type = index < types.size() ? types[index] : DialogueValue::Type::String;
+            const auto param = parser.substituteVariables(_action.handlerParams[index]);
+            if(DialogueActionRegistry::convert(param, type, args[index]) == false)
+            {
+                LOGERROR("Failed to resolve action '%s': param %u '%s' has the wrong type", _action.name.c_str(), index, param.c_str());
+                return;
+            }
+        }
+        const DialogueRecorder::ScopedCallback callback(m_recorder, DialogueRecorder::Event::Action, _action.name);
+        m_actionRegistry->invoke(_action.handlerId, args.data(), args.size());
+        return;
+    }
+
+    //local to the call, as above
+    const std::vector<std::string>* params = &_action.params;
+    std::vector<std::string> resolvedParams;
+    if(_action.dynamicParams.empty() == false)
     {
-        param = parser.substituteVariables(param);
+        resolvedParams = _action.params;
+        for(const auto index : _action.dynamicParams)
+        {
+            resolvedParams[index] = parser.substituteVariables(resolvedParams[index]);
+        }
+        params = &resolvedParams;
     }
-#define ACC_VEC(v) (v.empty() ? "" : std::accumulate(v.begin()+1, v.end(), std::string(v.front()), [](std::string& a, std::string& b) {return a + ',' + b;}).c_str())
+#define ACC_VEC(v) (v.empty() ? "" : std::accumulate(v.begin()+1, v.end(), std::string(v.front()), [](const std::string& a, const std::string& b) {return a + ',' + b;}).c_str())
 
-    if(m_dialogueResolver)
+    if(m_runtimeResolver)
     {
-        if(m_dialogueResolver->resolveAction(_actionName, parsedParams) == false)
+        if(m_runtimeResolver->resolveAction(_action.name, *params) == false)
         {
-            LOGERROR("Failed to resolve action '%s(%s): unhandled", _actionName.c_str(), ACC_VEC(parsedParams));
+            LOGERROR("Failed to resolve action '%s(%s): unhandled", _action.name.c_str(), ACC_VEC((*params)));
         }
     }
     else
     {
-        LOGERROR("Failed to resolve action '%s(%s)': invalid DialogueResolver", _actionName.c_str(), ACC_VEC(parsedParams));
+        LOGERROR("Failed to resolve action '%s(%s)': invalid DialogueResolver", _action.name.c_str(), ACC_VEC((*params)));
     }
 }
 
-bool DialogueController::enterNode(const std::string& _nodeName, unsigned _lineIndex)
+bool DialogueController::enterNode(const std::string& _nodeName, unsigned _lineIndex, bool _advance)
 {
-    auto node = getNodeByName(_nodeName);
+    auto node = loadNodeByName(_nodeName);
+    if(node && ++m_nodesWithoutLine > k_maxNodesWithoutLine)
+    {
+        LOGERROR("Failed to push back node '%s': %u nodes entered and not exited without presenting a line, stopping dialogue", _nodeName.c_str(), k_maxNodesWithoutLine);
+        m_pendingStop = true;
+        return false;
+    }
     if (node)
     {
         //increment previous node so we start at the next line after we exit the new node
         if(m_nodeStack.empty() == false)
         {
             m_nodeStack.back().lineIndex++;
+            m_nodeStack.back().variantIndex = DialogueNode::k_noVariant;
         }
 
         if(node->lines.empty() == false)
         {
-            m_nodeStack.push_back( { node, _lineIndex} );
+            //the span starts once there is a node to end, so a start that fails leaves nothing open
+            if(m_nodeStack.empty())
+            {
+                TRACE_INFO(DialogueStarted, node->id, _lineIndex);
+            }
+            m_nodeStack.push_back( { node->id, _lineIndex} );
+            m_visits.markVisited(node->id);
+            METRICS(recordVisit(node->id));
+            TRACE_INFO(NodeEntered, node->id, _lineIndex);
 
             //attempt to present the line
-            if(present(*node, _lineIndex) == false)
+            if(present(*node, _lineIndex, _advance) == false)
             {
-                //if presentiation fails then advance the line
-                return advanceLine();
+                //if presentiation fails then advance the line, or leave it to the advanceLine loop we were called from
+                return _advance ? advanceLine() : false;
             }
             return true;
         }
@@ -569,12 +2363,23 @@ bool DialogueController::exitNode()
 {
     if (m_nodeStack.empty() == false)
     {
+        TRACE_INFO(NodeExited, m_nodeStack.back().nodeId);
         m_nodeStack.pop_back();
+        if(m_nodesWithoutLine > 0)
+        {
+            m_nodesWithoutLine--;
+        }
         if(m_nodeStack.empty() == false)
         {
-            auto& activeNode = m_nodeStack.back().node;
+            auto activeNode = loadNodeById(m_nodeStack.back().nodeId);
+            if(activeNode == nullptr)
+            {
+                LOGERROR("Failed to pop node: node (%u) couldn't be loaded, stopping dialogue", m_nodeStack.back().nodeId);
+                m_pendingStop = true;
+                return false;
+            }
             auto& lineIndex = m_nodeStack.back().lineIndex;
-            return present(*activeNode, lineIndex);
+            return present(*activeNode, lineIndex, false);
         }
         return true;
     }
@@ -585,9 +2390,20 @@ bool DialogueController::exitNode()
     return false;
 }
 
+bool DialogueController::finishStep(bool _didProgress)
+{
+    //a stop requested while progressing is handled by run(), steps that don't go through it handle it here
+    if(m_pendingStop && m_isProgressing == false && m_nodeStack.empty() == false)
+    {
+        onDialogueEnded();
+        return false;
+    }
+    return _didProgress;
+}
+
 void DialogueController::onDialogueEnded()
 {
-    LOG("Dialogue ended");
+    TRACE_INFO(DialogueEnded);
 
     //ensure everything is cleaned up
     m_nodeStack.clear();
@@ -596,10 +2412,16 @@ void DialogueController::onDialogueEnded()
     m_isSkipping = false;
     m_isPaused = false;
     m_pendingStop = false;
+    if(m_history)
+    {
+        m_history->clear();
+    }
 
     //notify delegate
+    const DialogueRecorder::ScopedCallback callback(m_recorder, DialogueRecorder::Event::End);
     if(m_dialogueDelegate)
     {
+        METRICS_TIME_DELEGATE();
         m_dialogueDelegate->onEnd();
     }
 }
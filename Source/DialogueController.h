@@ -2,55 +2,198 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <functional>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+#include <string_view>
+
+#include "DialogueNode.h"
+#include "DialogueRandom.h"
+#include "DialogueVisitTracker.h"
+#include "DialogueStringTable.h"
+#include "DialogueTagIndex.h"
+#include "DialogueMetrics.h"
 
 struct DialogueTreeConfig;
-struct DialogueNode;
 class IDialogueResolver;
 class IDialogueDelegate;
+class DialogueHistory;
+class DialogueLineParser;
+class DialogueActionRegistry;
+class DialogueLocaleTable;
+class DialogueNodeArchive;
+class DialogueParseCache;
+class DialogueCountingResource;
+class DialogueRecorder;
+struct DialogueLineContent;
 
 class DialogueController
 {
 public:
     struct NodeState
     {
-        DialogueNode* node;
+        DialogueNode::Id nodeId;
         size_t lineIndex;
+        unsigned variantIndex = DialogueNode::k_noVariant; //% variant presented at lineIndex, picked when presented if not set
     };
     typedef std::vector<NodeState> NodeStack;
+    typedef std::vector<uint8_t> StateBuffer;
+
+    /*! Dialogue stops once this many nodes were entered, and not exited, without presenting a line, e.g. a node that is just [[Self]] */
+    static constexpr unsigned k_maxNodesWithoutLine = 64;
+
+    /*! Unparsed node, as given to addNode */
+    struct NodeSource
+    {
+        std::string name;
+        std::string tags;
+        std::string body;
+    };
+
+    struct PagingStats
+    {
+        uint64_t hits = 0; //lookups of archived nodes that were resident
+        uint64_t misses = 0; //lookups that loaded the node from the archive
+        uint64_t evictions = 0;
+        size_t residentNodes = 0;
+        size_t residentBytes = 0; //approximate, see DialogueCompactScript::getExpandedSize
+    };
 public:
     virtual ~DialogueController();
     /*! ctor
      @param _dialogueResolver resolver used to handle actions, variables, etc
-     @param _seed seed used for random content */
+     @param _memoryResource resource for node objects and the controller's internal tables, including node names, paging and history,
+     e.g. a monotonic arena per level or a pool per conversation. It must outlive the controller.
+     Not covered yet, left for a follow-up: DialogueNode's strings and vectors, DialogueLineParser's scratch storage,
+     and the node stack and actor lines, which are returned as std::vector.
+     If it is a DialogueCountingResource the controller switches its phase around parsing, linking and running dialogue */
     DialogueController(IDialogueDelegate* _dialogueDelegate = nullptr,
-                       const IDialogueResolver* _dialogueResolver = nullptr);
+                       const IDialogueResolver* _dialogueResolver = nullptr,
+                       std::pmr::memory_resource* _memoryResource = nullptr);
 
     //-------------------------------------------
     //Dialogue Configuration
 
     /*! Add a node with given title, tags and body. Body is parsed into lines.
+     @param _seed unused, % variants are picked when presented using the controller's random state (see setRandomSeed)
      @return true if the body was successfully parsed and name is unique */
     bool addNode(const std::string& _name, const std::string& _tags, const std::string& _body, unsigned _seed);
 
-    /*! Add Dialogue Node
+    /*! Add Dialogue Node, as parsed. Nodes read back from a controller have their actor keys moved to its actor table and can't be added to another
      @return true if name is unique */
     bool addNode(const DialogueNode& _node);
 
-    /*! Remove node by name
+    /*! Remove node by name. Removing a node in the running dialogue's stack stops the dialogue, and fails during a step, e.g. from an action
      @return true if the node was successfully removed*/
     bool removeNode(const std::string& name);
 
     /*! Remove all added nodes. Calling this during active dialogue may cause the dialogue to stop */
     void clearNodes();
 
-    /*! Retrieve node by name (title)
+    /*! Hot reload nodes, e.g. after editing a script during a playtest. Sources are diffed by a hash of their tags and body
+     against what was last added, and only new or changed nodes are reparsed, replacing the old node and its generated Name:N nodes.
+     Everything is parsed before anything is replaced. Node ids stay the same, and stack frames in replaced nodes are moved to
+     the line with the same line id nearest their old index, or kept at their index if it no longer exists. Dialogue stops if a node on the stack is removed.
+     If the current line's node changed it is presented again so the delegate shows the edited line, and while paused only if it was showing options.
+     History is cleared when anything changes. Not available in paged mode or while dialogue is progressing
+     @param _sources the edited top level nodes, or every top level node of the script if _removeMissing is true
+     @param _removeMissing if true top level nodes not in _sources are removed
+     @return false if nodes couldn't be reloaded, nothing is changed in that case */
+    bool reloadNodes(const std::vector<NodeSource>& _sources, bool _removeMissing = false);
+
+    /*! Retrieve node by name (title). In paged mode only resident nodes are returned, see loadNodeByName
      @return a pointer to the node or nullptr if not found*/
     DialogueNode* getNodeByName(const std::string& _name) const;
 
+    /*! Retrieve node by id. In paged mode only resident nodes are returned, see loadNodeById
+     @return a pointer to the node or nullptr if no node with that id is currently added*/
+    DialogueNode* getNodeById(DialogueNode::Id _id) const;
+
+    /*! Retrieve node by name, paging it in from the archive in paged mode (see setNodeArchive).
+     Paging moves the node to the front of the least recently used order and updates the paging stats
+     @return a pointer to the node or nullptr if not found or its archive record couldn't be read */
+    DialogueNode* loadNodeByName(const std::string& _name);
+
+    /*! Retrieve node by id, paging it in from the archive in paged mode
+     @return a pointer to the node or nullptr if no node with that id is currently added or its archive record couldn't be read */
+    DialogueNode* loadNodeById(DialogueNode::Id _id);
+
+    /*! @return the line for a node state, the presented variant for % groups. The line index must be valid */
+    static const DialogueNode::Line& getLine(const DialogueNode& _node, const NodeState& _state);
+
+    /*! Retrieve the id reserved for a node name
+     @return the id or DialogueNode::k_invalidId if the name has never been seen*/
+    DialogueNode::Id getNodeId(const std::string& _name) const;
+
+    /*! @param out_names receives the name reserved for each node id, indexed by id */
+    void getNodeNames(std::vector<std::string>& out_names) const;
+
     /*! Retrieve list of unique actors reference by all added nodes */
     void getActors(std::vector<std::string>& out_actorKeys) const;
 
+    /*! Actor keys are interned into a table as nodes are added
+     @return the id for an actor key or DialogueNode::k_invalidId if no line uses it */
+    DialogueNode::ActorId getActorId(const std::string& _actorKey) const;
+    const std::string& getActorKey(DialogueNode::ActorId _actorId) const;
+    size_t getActorCount() const;
+
+    /*! @return every line spoken by an actor, in the order nodes were added */
+    const std::vector<NodeState>& getActorLines(DialogueNode::ActorId _actorId) const;
+
+    /*! Retrieve the unique actors speaking in any of the given nodes, e.g. to preload assets for a scene. In paged mode only resident nodes are read
+     @param out_actorIds receives the actor ids, sorted */
+    void getActorsInNodes(const std::vector<DialogueNode::Id>& _nodeIds, std::vector<DialogueNode::ActorId>& out_actorIds) const;
+
+    /*! Find top level nodes by tag (generated Name:N nodes are not indexed). Tags are parsed from the node's tag string when added
+     @param _all nodes must have all of these tags
+     @param _any nodes must have at least one of these tags, ignored if empty
+     @param _none nodes must have none of these tags
+     @param out_nodeIds receives the matching node ids, sorted */
+    void findNodesByTags(const std::vector<std::string>& _all,
+                         const std::vector<std::string>& _any,
+                         const std::vector<std::string>& _none,
+                         std::vector<DialogueNode::Id>& out_nodeIds) const;
+
+    /*! Access the tag index directly to build queries from tag ids */
+    const DialogueTagIndex& getTagIndex() const;
+
+    /*! Resolve the line a node would present without starting dialogue, e.g. for ambient barks.
+     Lines are tried in order, skipping those whose conditions fail, and % variants are picked with _random.
+     Unconditional gotos on empty lines are followed. Actions are not run, options are ignored and no state is changed.
+     In paged mode only resident nodes are read, see loadNodeById
+     @param _nodeId the node to evaluate
+     @param _random random state used to pick between % variants
+     @param _resolver resolver used for conditions and variables, may differ from the controller's
+     @param out_line receives the line, its speech buffer is reused
+     @return true if a line was found */
+    bool evaluateLine(DialogueNode::Id _nodeId, DialogueRandom& _random, const IDialogueResolver* _resolver, DialogueLineContent& out_line) const;
+
+    //-------------------------------------------
+    //Paging
+
+    /*! Page nodes in from an archive on demand instead of keeping the whole script resident. Clears all nodes, then reserves ids
+     for every archived node in archive order and indexes their tags, so name lookups and tag queries don't load anything.
+     Nodes are loaded when dialogue reaches them or through loadNodeById and loadNodeByName, const lookups never load.
+     The least recently used are evicted once more than _budgetBytes are resident.
+     Nodes on the node stack are pinned, and eviction only happens when a step begins (start, selectOption, progressDialogue,
+     restoreState, rewind) so node pointers stay valid until the next step. Nodes added with addNode are never evicted.
+     getActorLines only sees resident nodes. The archive must stay open and outlive the controller, nullptr to leave paged mode
+     @return false if the archive isn't open */
+    bool setNodeArchive(DialogueNodeArchive* _archive, size_t _budgetBytes);
+    const DialogueNodeArchive* getNodeArchive() const;
+
+    void setNodeBudget(size_t _budgetBytes);
+    size_t getNodeBudget() const;
+
+    /*! Evict least recently used unpinned nodes until within budget. Does nothing while a step is running, e.g. from a delegate callback */
+    void trimNodes();
+
+    const PagingStats& getPagingStats() const;
+    void resetPagingStats();
+
     //-------------------------------------------
     //Dialogue Control
 
@@ -89,9 +232,54 @@ public:
      @return true if progression was successful. False if there are options to select (call selectOption)*/
     bool progressDialogue();
 
-    /*! Skip dialogue until next option selection or end of dialogue */
+    /*! Skip dialogue until next option selection or end of dialogue. Stops with an error after a fixed number of lines, so scripts that loop without options can't hang it */
     void skipDialogue();
 
+    //-------------------------------------------
+    //State Snapshots
+
+    /*! Write the conversation state (node ids, line indices and presented % variants, pending options, pause flag and random state) to a compact binary buffer.
+     Cost is proportional to the node stack depth. The buffer is cleared first so it can be reused between calls.
+     @param out_state buffer to write to */
+    void saveState(StateBuffer& out_state) const;
+
+    /*! Restore a conversation state written by saveState. Nodes are referenced by id so the same node names must have been added (in the same order) as when the state was saved.
+     No actions are run and the state is validated in full before anything is changed
+     @param _notifyDelegate if true the current line is presented again so the delegate receives onProgress
+     @return true if the state was valid and restored*/
+    bool restoreState(const uint8_t* _data, size_t _size, bool _notifyDelegate = false);
+    bool restoreState(const StateBuffer& _state, bool _notifyDelegate = false);
+
+    //-------------------------------------------
+    //History
+
+    /*! Keep a history of up to _capacity presented lines so the conversation can be rewound. 0 disables history (the default) */
+    void setHistoryCapacity(size_t _capacity);
+
+    /*! @return the number of presented lines that can be rewound to, including the current one */
+    size_t getHistorySize() const;
+
+    /*! Return to a previously presented line without re-running any actions. The line is presented again via the delegate
+     @param _steps number of lines to step back
+     @return true if the history held enough entries and the line was presented. On failure the conversation and history are unchanged*/
+    bool rewind(size_t _steps = 1);
+
+    //-------------------------------------------
+    //Visits
+
+    /*! Nodes are marked visited each time they are entered. Visits persist across conversations and can be queried from conditions via visited("Node") and visits("Node") */
+    const DialogueVisitTracker& getVisits() const;
+    void resetVisits();
+
+    /*! Write visit state to a buffer. Cost is proportional to the number of node ids, use alongside saveState
+     @param out_state buffer to write to, cleared first */
+    void saveVisits(StateBuffer& out_state) const;
+
+    /*! Restore visit state written by saveVisits. The same node names must have been added (in the same order) as when it was saved
+     @return true if the state was valid and restored*/
+    bool restoreVisits(const uint8_t* _data, size_t _size);
+    bool restoreVisits(const StateBuffer& _state);
+
     //-------------------------------------------
     //Accessors
     void setDialogueResolver(const IDialogueResolver* _resolver);
@@ -100,38 +288,188 @@ public:
     void setDialogueDelegate(IDialogueDelegate* _delegate);
     IDialogueDelegate* getDialogueDelegate() const;
 
+    /*! Actions are bound to registry handlers when nodes are added, unknown actions are reported then and fall back to the resolver.
+     Setting a registry relinks all added nodes. The registry must outlive the controller */
+    void setActionRegistry(const DialogueActionRegistry* _registry);
+    const DialogueActionRegistry* getActionRegistry() const;
+
     const NodeState* getCurrentNodeState() const;
     const NodeStack* getNodeStack() const;
 
+    /*! Line and option text is looked up in the table by line id, falling back to the parsed text if missing.
+     Switching language is just setting another table, nodes aren't reparsed. The table must outlive the controller, nullptr to use parsed text */
+    void setLocaleTable(const DialogueLocaleTable* _table);
+    const DialogueLocaleTable* getLocaleTable() const;
+
+    /*! @return the localized text for a line id, or _content if there is no table or it has no entry */
+    std::string_view getLocalizedText(uint64_t _lineId, const std::string& _content) const;
+
+    /*! Localize text, substitute variables and remap markup spans to the result.
+     Localized text is looked up raw, so if markup is enabled it is parsed the first time each line is shown and kept until the table changes */
+    void resolveText(DialogueLineParser& _parser,
+                     uint64_t _lineId,
+                     const std::string& _content,
+                     const std::vector<DialogueNode::Markup>& _markup,
+                     std::string& out_text,
+                     std::vector<DialogueNode::Markup>& out_markup) const;
+
+    /*! Node bodies given to addNode and reloadNodes are parsed through the cache, so unchanged nodes are loaded instead of parsed.
+     The cache must outlive the controller, nullptr to always parse */
+    void setParseCache(DialogueParseCache* _cache);
+    DialogueParseCache* getParseCache() const;
+
+    /*! Record visits, conditions, actions and time spent in resolver and delegate callbacks per node and line, see DialogueMetrics.
+     Only available when built with DIALOGUE_METRICS=1, otherwise the hooks are compiled out.
+     The metrics must outlive the controller, nullptr to stop recording
+     @return false if metrics aren't compiled in */
+    bool setMetrics(DialogueMetrics* _metrics);
+    DialogueMetrics* getMetrics() const;
+
+    /*! Record the session so it can be replayed without the game, e.g. as a benchmark, see DialogueRecorder and DialogueReplay.
+     The recorder starts from the current conversation state and visits, then logs the calls the game makes and every resolver result.
+     Rewinding past the start of a recording isn't replayable. Not available while dialogue is progressing.
+     The recorder must outlive the controller, nullptr to stop recording
+     @return false if dialogue is progressing */
+    bool setRecorder(DialogueRecorder* _recorder);
+    DialogueRecorder* getRecorder() const;
+
+    /*! Seed the random state used for content selection. Resets the draw counter */
+    void setRandomSeed(uint64_t _seed);
+    const DialogueRandom& getRandom() const;
+
+    /*! If true a % group won't present the same variant twice in a row, unless it is the only one whose conditions pass */
+    void setAvoidRepeatedVariants(bool _avoidRepeats);
+    bool getAvoidRepeatedVariants() const;
+
+    /*! If true inline markup such as [b]text[/b] is split out of the text of nodes added afterwards and of localized text,
+     see DialogueLineParser::parseMarkup. Off by default so [brackets] and backslashes in scripts without markup stay as text */
+    void setMarkupEnabled(bool _isEnabled);
+    bool isMarkupEnabled() const;
+
 protected:
 
     //-------------------------------------------
     //Dialogue Configuration
+    std::pmr::memory_resource* m_memoryResource;
+    DialogueCountingResource* m_countingResource; //m_memoryResource if it counts, else nullptr
     IDialogueDelegate* m_dialogueDelegate;
     const IDialogueResolver* m_dialogueResolver;
-    std::map<std::string, DialogueNode*> m_nodes;
+    const DialogueActionRegistry* m_actionRegistry;
+    const DialogueLocaleTable* m_localeTable;
+    bool m_isMarkupEnabled;
+    struct LocalizedText
+    {
+        std::string text;
+        std::vector<DialogueNode::Markup> markup;
+    };
+    mutable std::pmr::map<uint64_t, LocalizedText> m_localizedText; //localized text with markup parsed out, by line id. Cleared with the table
+    DialogueParseCache* m_parseCache;
+    DialogueMetrics* m_metrics;
+    DialogueMetrics::TimedResolver m_timedResolver;
+    DialogueRecorder* m_recorder;
+    const IDialogueResolver* m_runtimeResolver; //used while running dialogue, wrapped by the recorder and m_timedResolver when set
+    struct NameLess //looks names up without copying them into the resource
+    {
+        typedef void is_transparent;
+        bool operator()(std::string_view _a, std::string_view _b) const { return _a < _b; }
+    };
+    std::pmr::map<std::pmr::string, DialogueNode::Id, NameLess> m_nodeIds;
+    std::pmr::vector<DialogueNode*> m_nodes; //indexed by id, nullptr if not added
+    std::pmr::vector<uint64_t> m_sourceHashes; //indexed by id, hash of the tags and body top level nodes were parsed from, 0 if unknown
+    uint32_t m_nodeTableHash; //hash of all reserved names in id order, used to validate snapshots
 
     //-------------------------------------------
     //Dialogue State
     NodeStack m_nodeStack;
     struct Option
     {
-        std::string nextNode;
-        std::function<void(void)> resolveActions;
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned variantIndex;
+        size_t optionIndex;
+    };
+    std::pmr::vector<Option> m_presentedOptions;
+    DialogueRandom m_random;
+    bool m_avoidRepeatedVariants;
+    std::pmr::map<std::pair<DialogueNode::Id, size_t>, unsigned> m_lastVariants; //last variant presented per % line, if avoiding repeats
+    std::unique_ptr<DialogueHistory> m_history; //nullptr unless enabled
+    size_t m_historyDropCount; //entries a rewind replaces once its line is presented
+    DialogueVisitTracker m_visits;
+    DialogueStringTable m_actors;
+    std::vector<std::vector<NodeState>> m_actorLines; //indexed by actor id
+    DialogueTagIndex m_tags;
+
+    //condition results, valid until a variable or visit count they depend on changes version
+    struct ConditionCacheEntry
+    {
+        bool isValid;
+        bool result;
+        uint64_t variablesVersion;
+        std::vector<uint64_t> versions; //one per condition variable followed by one per visit operand
     };
-    std::vector<Option> m_presentedOptions;
+    std::pmr::vector<ConditionCacheEntry> m_conditionCache;
+    std::pmr::vector<unsigned> m_freeConditionSlots; //released by unlinked nodes
     bool m_isSkipping;
     bool m_isProgressing;
     bool m_isPaused;
     bool m_pendingStop;
+    unsigned m_stepDepth; //nested start/selectOption/progressDialogue calls, nodes are only evicted outside of them
+
+    //parsers used to resolve conditions and text, one per nesting depth so calls made from callbacks don't share scratch storage
+    class ScopedParser
+    {
+    public:
+        ScopedParser(const DialogueController& _controller, const IDialogueResolver* _resolver, const DialogueVisitTracker* _visits);
+        ~ScopedParser();
+        operator DialogueLineParser&();
+
+    protected:
+        const DialogueController& m_controller;
+        DialogueLineParser* m_parser;
+    };
+    mutable std::vector<std::unique_ptr<DialogueLineParser>> m_parsers;
+    mutable size_t m_parserDepth;
+    unsigned m_nodesWithoutLine; //nodes entered and not yet exited since a line was last presented
+
+    //-------------------------------------------
+    //Paging
+    struct Page
+    {
+        size_t archiveIndex; //k_notPaged if the id isn't backed by the archive
+        size_t bytes;
+        std::pmr::list<DialogueNode::Id>::iterator position; //in m_residentPages, if resident
+    };
+    DialogueNodeArchive* m_nodeArchive;
+    size_t m_nodeBudget;
+    std::pmr::vector<Page> m_pages; //indexed by id
+    std::pmr::list<DialogueNode::Id> m_residentPages; //most recently used first
+    PagingStats m_pagingStats;
 
     //-------------------------------------------
     //Internal Helpers
+    DialogueNode::Id reserveNodeId(const std::string& _name);
+    void linkNode(DialogueNode& _node);
+    void unlinkNode(const DialogueNode& _node);
+    void setSourceHash(DialogueNode::Id _id, uint64_t _hash);
+    void updateRuntimeResolver();
+    DialogueNode* createNode(DialogueNode _node);
+    void destroyNode(DialogueNode* _node);
+    void internTags(const std::string& _tags, std::vector<unsigned>& out_tagIds);
+    bool isPaged(DialogueNode::Id _id) const;
+    DialogueNode* pageNode(DialogueNode::Id _id);
+    void evictNode(DialogueNode::Id _id);
+    void linkAction(const DialogueNode& _node, DialogueNode::Action& _action) const;
+    bool resolveCondition(DialogueLineParser& _parser, const DialogueNode::Condition& _condition);
+    bool resolveCachedCondition(DialogueLineParser& _parser, const DialogueNode::Condition& _condition);
+    bool readConditionVersions(const DialogueNode::Condition& _condition, std::vector<uint64_t>& out_versions) const;
     bool run();
     bool advanceLine();
-    bool present(const DialogueNode& _node, size_t _index);
-    void resolveAction(const std::string& _actionName, const std::vector<std::string>& params);
-    bool enterNode(const std::string& _nodeName, unsigned _lineIndex = 0);
+    //_advance: if false a node entered without presenting its first line is left for the calling advanceLine loop to continue,
+    //rather than advancing it recursively, so the C++ stack doesn't grow with every node entered
+    bool present(const DialogueNode& _node, size_t _index, bool _advance = true);
+    void resolveAction(const DialogueNode::Action& _action);
+    bool enterNode(const std::string& _nodeName, unsigned _lineIndex = 0, bool _advance = true);
+    bool finishStep(bool _didProgress);
     bool exitNode();
     void onDialogueEnded();
 };
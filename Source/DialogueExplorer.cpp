@@ -0,0 +1,1608 @@
+#include "DialogueExplorer.h"
+
+#include "DialogueBinaryIO.h"
+#include "DialogueContent.h"
+#include "DialogueHash.h"
+#include "DialogueMacros.h"
+#include "DialogueVariableStore.h"
+#include "IDialogueDelegate.h"
+#include "IDialogueResolver.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <thread>
+
+namespace
+{
+    typedef DialogueNode::Condition::Operand Operand;
+    typedef std::vector<std::pair<uint32_t, DialogueValue>> Variables; //by variable index
+    typedef std::vector<std::pair<uint32_t, uint32_t>> Visits; //count by visited node index
+
+    const char* const k_whitespace = " \t";
+    const size_t k_maxBatch = 64; //items a thread takes from the frontier at once
+    const uint32_t k_priorityCount = 32;
+
+    std::string trimmed(const std::string& _string)
+    {
+        const auto begin = _string.find_first_not_of(k_whitespace);
+        if(begin == std::string::npos) return std::string();
+        return _string.substr(begin, _string.find_last_not_of(k_whitespace) - begin + 1);
+    }
+
+    //0 for items from lines no state presented before, then one more each time the count doubles
+    uint32_t getPriority(uint64_t _states)
+    {
+        uint32_t priority = 0;
+        for(; _states > 0 && priority + 1 < k_priorityCount; _states >>= 1)
+        {
+            priority++;
+        }
+        return priority;
+    }
+
+    bool isBitSet(const uint64_t* _bits, size_t _index)
+    {
+        return ((_bits[_index / 64] >> (_index % 64)) & 1) != 0;
+    }
+
+    //@return true if _to gained bits
+    bool mergeBits(uint64_t* _to, const uint64_t* _from, size_t _words)
+    {
+        bool isChanged = false;
+        for(size_t word = 0; word < _words; ++word)
+        {
+            const auto merged = _to[word] | _from[word];
+            isChanged = isChanged || merged != _to[word];
+            _to[word] = merged;
+        }
+        return isChanged;
+    }
+
+    //"$(name)", "$name" or "name"
+    std::string stripVariable(const std::string& _token)
+    {
+        if(_token.size() > 3 && _token.compare(0, 2, "$(") == 0 && _token.back() == ')')
+        {
+            return _token.substr(2, _token.size() - 3);
+        }
+        return _token.empty() == false && _token[0] == '$' ? _token.substr(1) : _token;
+    }
+
+    //an operand that is exactly one variable, e.g. "$(gold)"
+    bool getSingleVariable(const Operand& _operand, std::string& out_name)
+    {
+        if(_operand.type != Operand::Type::Text) return false;
+        const auto text = trimmed(_operand.value);
+        if(text.size() < 4 || text.compare(0, 2, "$(") != 0 || text.back() != ')') return false;
+        out_name = text.substr(2, text.size() - 3);
+        return out_name.find_first_of("$()") == std::string::npos;
+    }
+
+    //an operand without variables
+    bool getLiteral(const Operand& _operand, std::string& out_text)
+    {
+        if(_operand.type != Operand::Type::Text || _operand.value.find("$(") != std::string::npos) return false;
+        out_text = trimmed(_operand.value);
+        return true;
+    }
+
+    //the assignment of a <<set>> action, in the form DialogueVariableStore::executeSet takes
+    bool getAssignment(const DialogueNode::Action& _action, std::string& out_assignment)
+    {
+        const auto& name = _action.name;
+        const bool isSet = name.size() >= 3
+            && tolower(static_cast<unsigned char>(name[0])) == 's'
+            && tolower(static_cast<unsigned char>(name[1])) == 'e'
+            && tolower(static_cast<unsigned char>(name[2])) == 't'
+            && (name.size() == 3 || isspace(static_cast<unsigned char>(name[3])));
+        if(isSet == false) return false;
+
+        if(name.size() > 3)
+        {
+            out_assignment = name.substr(4);
+        }
+        else if(_action.params.size() == 1)
+        {
+            out_assignment = _action.params[0];
+        }
+        else if(_action.params.size() == 2)
+        {
+            out_assignment = "$" + stripVariable(_action.params[0]) + " = " + _action.params[1];
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    /*! Split an assignment into its target and the variables its expression reads
+     @param out_isExpression true if the value is computed rather than a literal */
+    bool parseAssignment(const std::string& _assignment, std::string& out_target, std::vector<std::string>& out_sources, bool& out_isExpression)
+    {
+        const auto assignment = trimmed(_assignment);
+        const auto nameEnd = assignment.find_first_of(" \t=");
+        if(nameEnd == std::string::npos || nameEnd == 0) return false;
+        out_target = stripVariable(assignment.substr(0, nameEnd));
+
+        auto pos = assignment.find_first_not_of(k_whitespace, nameEnd);
+        if(pos == std::string::npos) return false;
+        if(assignment[pos] == '=') pos++;
+        else if(assignment.compare(pos, 2, "to") == 0) pos += 2;
+        else return false;
+
+        out_sources.clear();
+        out_isExpression = false;
+        while((pos = assignment.find_first_not_of(k_whitespace, pos)) != std::string::npos)
+        {
+            const auto end = std::min(assignment.find_first_of(k_whitespace, pos), assignment.size());
+            const auto token = assignment.substr(pos, end - pos);
+            if(token == "+" || token == "-" || token == "*" || token == "/")
+            {
+                out_isExpression = true;
+            }
+            else if(token[0] == '$')
+            {
+                out_sources.push_back(stripVariable(token));
+                out_isExpression = true;
+            }
+            pos = end;
+        }
+        return true;
+    }
+
+    //calls _function for every line, or every variant of % groups, of every added node
+    template <typename Function>
+    void forEachLine(const DialogueController& _controller, Function _function)
+    {
+        std::vector<std::string> names;
+        _controller.getNodeNames(names);
+        for(DialogueNode::Id id = 0; id < names.size(); ++id)
+        {
+            const auto node = _controller.getNodeById(id);
+            if(node == nullptr) continue;
+
+            for(size_t lineIndex = 0; lineIndex < node->lines.size(); ++lineIndex)
+            {
+                const auto& line = node->lines[lineIndex];
+                if(line.variants.empty())
+                {
+                    _function(*node, lineIndex, DialogueNode::k_noVariant, line);
+                }
+                for(unsigned variant = 0; variant < line.variants.size(); ++variant)
+                {
+                    _function(*node, lineIndex, variant, line.variants[variant]);
+                }
+            }
+        }
+    }
+
+    template <typename Function>
+    void forEachCondition(const DialogueNode::Line& _line, Function _function)
+    {
+        for(const auto& condition : _line.conditions) _function(condition);
+        for(const auto& option : _line.options)
+        {
+            for(const auto& condition : option.conditions) _function(condition);
+        }
+    }
+
+    template <typename Function>
+    void forEachAction(const DialogueNode::Line& _line, Function _function)
+    {
+        for(const auto& action : _line.actions) _function(action);
+        for(const auto& option : _line.options)
+        {
+            for(const auto& action : option.actions) _function(action);
+        }
+    }
+
+    void writeValue(DialogueBinaryWriter& _writer, const DialogueValue& _value)
+    {
+        _writer.writeUInt8(static_cast<uint8_t>(_value.type));
+        switch(_value.type)
+        {
+            case DialogueValue::Type::Bool: _writer.writeUInt8(_value.boolValue ? 1 : 0); break;
+            case DialogueValue::Type::Number: _writer.writeBytes(&_value.number, sizeof(_value.number)); break;
+            case DialogueValue::Type::String: _writer.writeString(_value.string); break;
+            default: break;
+        }
+    }
+
+    bool readValue(DialogueBinaryReader& _reader, DialogueValue& out_value)
+    {
+        uint8_t type = 0, flag = 0;
+        if(_reader.readUInt8(type) == false) return false;
+        out_value = DialogueValue();
+        out_value.type = static_cast<DialogueValue::Type>(type);
+        switch(out_value.type)
+        {
+            case DialogueValue::Type::None: return true;
+            case DialogueValue::Type::Bool: if(_reader.readUInt8(flag) == false) return false; out_value.boolValue = flag != 0; return true;
+            case DialogueValue::Type::Number: return _reader.readBytes(&out_value.number, sizeof(out_value.number));
+            case DialogueValue::Type::String: return _reader.readString(out_value.string);
+            default: return false;
+        }
+    }
+
+    void encodeWorld(const Variables& _variables, const Visits& _visits, std::vector<uint8_t>& out_world)
+    {
+        out_world.clear();
+        DialogueBinaryWriter writer(out_world);
+        writer.writeVarUInt(_variables.size());
+        for(const auto& variable : _variables)
+        {
+            writer.writeVarUInt(variable.first);
+            writeValue(writer, variable.second);
+        }
+        writer.writeVarUInt(_visits.size());
+        for(const auto& visit : _visits)
+        {
+            writer.writeVarUInt(visit.first);
+            writer.writeVarUInt(visit.second);
+        }
+    }
+
+    bool decodeWorld(const std::vector<uint8_t>& _world, Variables& out_variables, Visits& out_visits)
+    {
+        out_variables.clear();
+        out_visits.clear();
+        if(_world.empty()) return true;
+
+        DialogueBinaryReader reader(_world.data(), _world.size());
+        uint64_t count = 0, index = 0, visits = 0;
+        if(reader.readVarUInt(count) == false) return false;
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            DialogueValue value;
+            if(reader.readVarUInt(index) == false || readValue(reader, value) == false) return false;
+            out_variables.emplace_back(static_cast<uint32_t>(index), std::move(value));
+        }
+        if(reader.readVarUInt(count) == false) return false;
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            if(reader.readVarUInt(index) == false || reader.readVarUInt(visits) == false) return false;
+            out_visits.emplace_back(static_cast<uint32_t>(index), static_cast<uint32_t>(visits));
+        }
+        return true;
+    }
+
+    void appendJsonString(std::string& out_text, const std::string& _string)
+    {
+        out_text += '"';
+        for(const char c : _string)
+        {
+            if(c == '"' || c == '\\')
+            {
+                out_text += '\\';
+                out_text += c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                out_text += escaped;
+            }
+            else
+            {
+                out_text += c;
+            }
+        }
+        out_text += '"';
+    }
+
+    void appendCsvString(std::string& out_text, const std::string& _string)
+    {
+        if(_string.find_first_of(",\"\n\r") == std::string::npos)
+        {
+            out_text += _string;
+            return;
+        }
+        out_text += '"';
+        for(const char c : _string)
+        {
+            if(c == '"') out_text += '"';
+            out_text += c;
+        }
+        out_text += '"';
+    }
+
+    //"node":0,"name":"Start","line":2 and "variant" for % groups
+    void appendJsonLocation(std::string& out_text, const std::vector<std::string>& _names, DialogueNode::Id _nodeId, size_t _lineIndex, unsigned _variantIndex)
+    {
+        out_text += "\"node\":" + std::to_string(_nodeId) + ",\"name\":";
+        appendJsonString(out_text, _nodeId < _names.size() ? _names[_nodeId] : std::to_string(_nodeId));
+        out_text += ",\"line\":" + std::to_string(_lineIndex);
+        if(_variantIndex != DialogueNode::k_noVariant)
+        {
+            out_text += ",\"variant\":" + std::to_string(_variantIndex);
+        }
+    }
+}
+
+//-------------------------------------------
+//Worker
+
+/*! A controller and variable store exploring on one thread. It is the store's fallback resolver, picking values for variables read
+ before being set, and the controller's delegate, observing what each step presented */
+class DialogueExplorer::Worker : public IDialogueResolver, public IDialogueDelegate
+{
+public:
+    Worker(DialogueExplorer& _explorer);
+
+    void load(const Loader& _loader);
+    bool isLoaded() const;
+
+    /*! Intern the explored variables, after the script was analyzed
+     @return false if the store already held other variables */
+    bool prepare();
+
+    /*! Run an item's action from its state
+     @param out_items receives the items to explore from the resulting state, if it is new, and items for the other values of variables read */
+    void process(const Item& _item, std::vector<Item>& out_items);
+
+    DialogueController& getController();
+    void addCoverage(Report& _report) const;
+
+    //IDialogueResolver
+    bool resolveVariable(const std::string& _varName, std::string& out_value) const override;
+    bool resolveAction(const std::string& _name, const std::vector<std::string>& _params) const override;
+
+    //IDialogueDelegate
+    void onProgress(const DialogueContent& _content) override;
+    void onEnd() override;
+    void onPaused() override;
+
+protected:
+    DialogueExplorer& m_explorer;
+    DialogueVariableStore m_store;
+    DialogueController m_controller;
+    bool m_isLoaded;
+    std::vector<uint64_t> m_live; //what may still be read from the item's state, variables nothing reads aren't picked
+
+    //visit counts are restored through a tracker, saveVisits writes the node table hash followed by DialogueVisitTracker::save
+    DialogueVisitTracker m_visits;
+    DialogueController::StateBuffer m_visitsHeader;
+    DialogueController::StateBuffer m_visitsBuffer;
+
+    //the item being processed
+    const Item* m_item;
+    std::vector<Item>* m_items;
+    Variables m_worldVariables;
+    Visits m_worldVisits;
+    Variables m_picks; //values picked by this step for variables read before being set
+    std::vector<uint32_t> m_assigned; //variables with a value or picked unset
+    std::vector<uint8_t> m_isAssigned; //by variable index
+    std::vector<uint8_t> m_isUnset; //by variable index, picked unset
+    bool m_isRestoring;
+    bool m_isPresented;
+    bool m_isEnded;
+    std::vector<uint8_t> m_isOptionMet;
+    std::vector<uint8_t> m_key;
+
+    //coverage, by slot and by option. States presenting each slot are counted by the explorer
+    std::vector<uint64_t> m_noOptionStates;
+    std::vector<uint64_t> m_stuckStates;
+    std::vector<uint64_t> m_optionStates;
+    uint64_t m_steps;
+
+    bool restore(const State& _state);
+    void markAssigned(uint32_t _index);
+    bool pick(uint32_t _index, const std::string& _name, std::string& out_value);
+    void branch(uint32_t _index, const DialogueValue& _value);
+    void dropFinishedFrames();
+    void expand(const Item& _item);
+    uint32_t getSlot(const DialogueController::NodeState& _state) const;
+};
+
+DialogueExplorer::Worker::Worker(DialogueExplorer& _explorer)
+: m_explorer(_explorer)
+, m_store(this)
+, m_controller(this, &m_store)
+, m_isLoaded(false)
+, m_item(nullptr)
+, m_items(nullptr)
+, m_isRestoring(false)
+, m_isPresented(false)
+, m_isEnded(false)
+, m_steps(0)
+{
+}
+
+void DialogueExplorer::Worker::load(const Loader& _loader)
+{
+    m_isLoaded = _loader(m_controller);
+    m_controller.setAvoidRepeatedVariants(false); //every variant is explored, remembering the last would only grow states
+    m_controller.saveVisits(m_visitsHeader);
+    m_visitsHeader.resize(std::min<size_t>(m_visitsHeader.size(), sizeof(uint32_t)));
+}
+
+bool DialogueExplorer::Worker::isLoaded() const
+{
+    return m_isLoaded;
+}
+
+bool DialogueExplorer::Worker::prepare()
+{
+    const auto& variables = m_explorer.m_variables;
+    for(uint32_t index = 0; index < variables.size(); ++index)
+    {
+        if(m_store.intern(variables[index].name) != index)
+        {
+            LOGERROR("Failed to explore: variables were set while loading the script");
+            return false;
+        }
+    }
+    m_store.addChangeListener([this](DialogueVariableStore::VariableId _id, const DialogueValue&)
+    {
+        if(m_isRestoring == false && _id < m_explorer.m_variables.size())
+        {
+            markAssigned(_id);
+        }
+    });
+    m_isAssigned.assign(variables.size(), 0);
+    m_isUnset.assign(variables.size(), 0);
+    m_noOptionStates.assign(m_explorer.m_slots.size(), 0);
+    m_stuckStates.assign(m_explorer.m_slots.size(), 0);
+    m_optionStates.assign(m_explorer.m_report.options.size(), 0);
+    return true;
+}
+
+DialogueController& DialogueExplorer::Worker::getController()
+{
+    return m_controller;
+}
+
+void DialogueExplorer::Worker::addCoverage(Report& _report) const
+{
+    for(size_t slot = 0; slot < m_explorer.m_slots.size(); ++slot)
+    {
+        const auto line = m_explorer.m_slots[slot].lineCoverage;
+        if(line == k_notCovered) continue;
+
+        _report.lines[line].noOptionStates += m_noOptionStates[slot];
+        _report.lines[line].stuckStates += m_stuckStates[slot];
+    }
+    for(size_t option = 0; option < m_optionStates.size(); ++option)
+    {
+        _report.options[option].states += m_optionStates[option];
+    }
+    _report.steps += m_steps;
+}
+
+void DialogueExplorer::Worker::process(const Item& _item, std::vector<Item>& out_items)
+{
+    m_item = &_item;
+    m_items = &out_items;
+    if(restore(*_item.state) == false)
+    {
+        return;
+    }
+    if(_item.action == Action::Start)
+    {
+        const auto node = m_controller.getNodeByName(m_explorer.m_startNodes[_item.argument]);
+        m_live.assign(m_explorer.getLive(node->id, 0), m_explorer.getLive(node->id, 0) + m_explorer.m_liveWords);
+    }
+    else
+    {
+        m_explorer.getLive(*m_controller.getNodeStack(), m_live);
+    }
+
+    m_isPresented = false;
+    m_isEnded = false;
+    m_steps++;
+    switch(_item.action)
+    {
+        case Action::Start:
+            m_controller.start(m_explorer.m_startNodes[_item.argument], 0, true);
+            break;
+        case Action::Progress:
+            m_controller.progressDialogue();
+            break;
+        case Action::SelectOption:
+            m_controller.selectOption(_item.argument);
+            break;
+        case Action::PresentVariant:
+        {
+            //present the line again with the variant set, it was presented if the frame is still there and wasn't advanced
+            auto nodeStack = *m_controller.getNodeStack();
+            const auto depth = nodeStack.size() - 1;
+            auto expected = nodeStack.back();
+            expected.variantIndex = _item.argument;
+            nodeStack.back() = expected;
+            m_controller.start(nodeStack, true);
+
+            const auto current = m_controller.getNodeStack();
+            if(m_isEnded || current->size() <= depth
+               || (*current)[depth].nodeId != expected.nodeId
+               || (*current)[depth].lineIndex != expected.lineIndex
+               || (*current)[depth].variantIndex != expected.variantIndex)
+            {
+                return;
+            }
+            break;
+        }
+    }
+
+    if(m_isEnded)
+    {
+        return;
+    }
+    const auto current = m_controller.getCurrentNodeState();
+    if(m_isPresented == false)
+    {
+        if(_item.action == Action::Progress && current)
+        {
+            m_stuckStates[getSlot(*current)]++;
+        }
+        return;
+    }
+    dropFinishedFrames();
+    expand(_item);
+}
+
+bool DialogueExplorer::Worker::restore(const State& _state)
+{
+    m_isRestoring = true;
+    for(const auto index : m_assigned)
+    {
+        m_store.setValue(index, DialogueValue());
+        m_isAssigned[index] = 0;
+        m_isUnset[index] = 0;
+    }
+    m_assigned.clear();
+    m_picks.clear();
+    m_isRestoring = false;
+
+    if(decodeWorld(_state.world, m_worldVariables, m_worldVisits) == false)
+    {
+        LOGERROR("Failed to explore: malformed state");
+        return false;
+    }
+    for(const auto& variable : m_worldVariables)
+    {
+        if(variable.second.type == DialogueValue::Type::None)
+        {
+            m_isUnset[variable.first] = 1;
+            markAssigned(variable.first);
+        }
+        else
+        {
+            m_store.setValue(variable.first, variable.second);
+            markAssigned(variable.first);
+        }
+    }
+
+    if(m_explorer.m_visitedNodes.empty() == false)
+    {
+        m_visits.reset();
+        for(const auto& visit : m_worldVisits)
+        {
+            for(uint32_t i = 0; i < visit.second; ++i)
+            {
+                m_visits.markVisited(m_explorer.m_visitedNodes[visit.first].nodeId);
+            }
+        }
+        m_visitsBuffer = m_visitsHeader;
+        m_visits.save(m_visitsBuffer);
+        if(m_controller.restoreVisits(m_visitsBuffer) == false)
+        {
+            return false;
+        }
+    }
+
+    if(_state.conversation.empty())
+    {
+        if(m_controller.getCurrentNodeState() != nullptr)
+        {
+            m_controller.stop();
+        }
+        return true;
+    }
+    return m_controller.restoreState(_state.conversation);
+}
+
+void DialogueExplorer::Worker::markAssigned(uint32_t _index)
+{
+    if(m_isAssigned[_index] == 0)
+    {
+        m_isAssigned[_index] = 1;
+        m_assigned.push_back(_index);
+    }
+}
+
+bool DialogueExplorer::Worker::pick(uint32_t _index, const std::string& _name, std::string& out_value)
+{
+    const auto& candidates = m_explorer.m_variables[_index].candidates;
+    for(size_t i = 1; i < candidates.size(); ++i)
+    {
+        branch(_index, candidates[i]);
+    }
+
+    const auto value = candidates.empty() ? DialogueValue() : candidates[0];
+    m_picks.emplace_back(_index, value);
+    if(value.type == DialogueValue::Type::None)
+    {
+        m_isUnset[_index] = 1;
+        markAssigned(_index);
+        return false;
+    }
+    m_store.setValue(_index, value);
+    return m_store.resolveVariable(_name, out_value);
+}
+
+void DialogueExplorer::Worker::branch(uint32_t _index, const DialogueValue& _value)
+{
+    //the same step from the same state, as if the variable always held the other value
+    Variables variables = m_worldVariables;
+    variables.insert(variables.end(), m_picks.begin(), m_picks.end());
+    variables.emplace_back(_index, _value);
+
+    auto state = std::make_shared<State>();
+    state->conversation = m_item->state->conversation;
+    encodeWorld(variables, m_worldVisits, state->world);
+
+    //after the step taking the first value, otherwise every combination of values read along the way is tried before any later line
+    m_items->push_back({ std::move(state), m_item->action, m_item->argument, std::min(m_item->priority + 1, k_priorityCount - 1) });
+}
+
+void DialogueExplorer::Worker::dropFinishedFrames()
+{
+    //a frame below the top past its node's last line only exits when returned to, so it doesn't change what can be reached
+    const auto& nodeStack = *m_controller.getNodeStack();
+    const auto isFinished = [this](const DialogueController::NodeState& _state)
+    {
+        return _state.lineIndex >= m_controller.getNodeById(_state.nodeId)->lines.size();
+    };
+    if(nodeStack.size() < 2 || std::none_of(nodeStack.begin(), nodeStack.end() - 1, isFinished))
+    {
+        return;
+    }
+
+    //presents the top line again, its variant and the variables are unchanged so it presents the same
+    auto trimmed = nodeStack;
+    trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end() - 1, isFinished), trimmed.end() - 1);
+    m_controller.start(trimmed, true);
+}
+
+void DialogueExplorer::Worker::expand(const Item& _item)
+{
+    const auto& current = *m_controller.getCurrentNodeState();
+    const auto& nodeStack = *m_controller.getNodeStack();
+
+    //current variables and visits, those no condition reachable from here reads can't tell states apart
+    m_explorer.getLive(nodeStack, m_live);
+    std::sort(m_assigned.begin(), m_assigned.end());
+    Variables variables;
+    variables.reserve(m_assigned.size());
+    for(const auto index : m_assigned)
+    {
+        if(isBitSet(m_live.data(), index) == false) continue;
+        const auto value = m_isUnset[index] ? nullptr : m_store.getValue(index);
+        variables.emplace_back(index, value ? *value : DialogueValue());
+    }
+    Visits visits;
+    for(uint32_t index = 0; index < m_explorer.m_visitedNodes.size(); ++index)
+    {
+        const auto& visitedNode = m_explorer.m_visitedNodes[index];
+        const auto count = std::min(m_controller.getVisits().getVisitCount(visitedNode.nodeId), visitedNode.maxCount);
+        if(count > 0 && isBitSet(m_live.data(), m_explorer.m_variables.size() + index))
+        {
+            visits.emplace_back(index, count);
+        }
+    }
+
+    //the state as far as the script can tell, numbers between the same bounds look alike
+    m_key.clear();
+    DialogueBinaryWriter writer(m_key);
+    writer.writeVarUInt(nodeStack.size());
+    for(const auto& frame : nodeStack)
+    {
+        writer.writeVarUInt(frame.nodeId);
+        writer.writeVarUInt(frame.lineIndex);
+        writer.writeVarUInt(static_cast<uint32_t>(frame.variantIndex + 1));
+    }
+    for(const auto& variable : variables)
+    {
+        const auto& info = m_explorer.m_variables[variable.first];
+        writer.writeVarUInt(variable.first);
+        if(variable.second.type == DialogueValue::Type::Number && info.isExact == false)
+        {
+            const auto bound = std::lower_bound(info.bounds.begin(), info.bounds.end(), variable.second.number);
+            const bool isBound = bound != info.bounds.end() && *bound == variable.second.number;
+            writer.writeUInt8(0xff);
+            writer.writeVarUInt(static_cast<uint64_t>(bound - info.bounds.begin()) * 2 + (isBound ? 1 : 0));
+        }
+        else
+        {
+            writeValue(writer, variable.second);
+        }
+    }
+    for(const auto& visit : visits)
+    {
+        writer.writeVarUInt(visit.first);
+        writer.writeVarUInt(visit.second);
+    }
+    if(m_explorer.insertState(hashDialogueData(m_key.data(), m_key.size())) == false)
+    {
+        return;
+    }
+
+    auto state = std::make_shared<State>();
+    m_controller.saveState(state->conversation);
+    encodeWorld(variables, visits, state->world);
+
+    const auto slot = getSlot(current);
+    const auto priority = getPriority(m_explorer.m_slotStates[slot]++);
+    if(m_isOptionMet.empty())
+    {
+        m_items->push_back({ state, Action::Progress, 0, priority });
+    }
+    else
+    {
+        bool isAnyMet = false;
+        for(uint32_t option = 0; option < m_isOptionMet.size(); ++option)
+        {
+            if(m_isOptionMet[option])
+            {
+                isAnyMet = true;
+                const auto optionStates = m_optionStates[m_explorer.m_slots[slot].optionBegin + option]++;
+                m_items->push_back({ state, Action::SelectOption, option, getPriority(optionStates) });
+            }
+        }
+        if(isAnyMet == false)
+        {
+            m_noOptionStates[slot]++;
+        }
+    }
+
+    //the other variants the line could have presented
+    if(_item.action != Action::PresentVariant && current.variantIndex != DialogueNode::k_noVariant)
+    {
+        const auto variantCount = m_controller.getNodeById(current.nodeId)->lines[current.lineIndex].variants.size();
+        for(uint32_t variant = 0; variant < variantCount; ++variant)
+        {
+            if(variant != current.variantIndex)
+            {
+                const auto variantPriority = getPriority(m_explorer.m_slotStates[slot - current.variantIndex + variant]);
+                m_items->push_back({ state, Action::PresentVariant, variant, variantPriority });
+            }
+        }
+    }
+}
+
+uint32_t DialogueExplorer::Worker::getSlot(const DialogueController::NodeState& _state) const
+{
+    const auto first = m_explorer.m_lineSlots[_state.nodeId][_state.lineIndex];
+    return _state.variantIndex == DialogueNode::k_noVariant ? first : first + _state.variantIndex;
+}
+
+bool DialogueExplorer::Worker::resolveVariable(const std::string& _varName, std::string& out_value) const
+{
+    //only called by the store for variables it holds no value for. resolveVariable is const in the interface, but picking is what it is for.
+    //a variable no condition reads from here on, e.g. only substituted into text, can't change what is reached and isn't picked.
+    //text substituting it on a line that doesn't test it leaves it to the condition that does, so text doesn't branch paths leading to the same lines
+    auto worker = const_cast<Worker*>(this);
+    const auto index = m_store.find(_varName);
+    const auto current = m_controller.getCurrentNodeState();
+    if(index >= m_explorer.m_variables.size() || m_isUnset[index] || isBitSet(m_live.data(), index) == false
+       || (current && m_explorer.isRead(current->nodeId, current->lineIndex, index) == false))
+    {
+        return false;
+    }
+    return worker->pick(index, _varName, out_value);
+}
+
+bool DialogueExplorer::Worker::resolveAction(const std::string& /*_name*/, const std::vector<std::string>& /*_params*/) const
+{
+    return true;
+}
+
+void DialogueExplorer::Worker::onProgress(const DialogueContent& _content)
+{
+    m_isPresented = true;
+    m_isEnded = false;
+    m_isOptionMet.clear();
+    for(const auto& option : _content.options)
+    {
+        m_isOptionMet.push_back(option.isConditionMet ? 1 : 0);
+    }
+}
+
+void DialogueExplorer::Worker::onEnd()
+{
+    m_isEnded = true;
+}
+
+void DialogueExplorer::Worker::onPaused()
+{
+}
+
+//-------------------------------------------
+//EnumeratedDomain
+
+void DialogueExplorer::EnumeratedDomain::setValues(const std::string& _name, const std::vector<DialogueValue>& _values)
+{
+    m_values[_name] = _values;
+}
+
+void DialogueExplorer::EnumeratedDomain::setDefaultValues(const std::vector<DialogueValue>& _values)
+{
+    m_defaultValues = _values;
+}
+
+void DialogueExplorer::EnumeratedDomain::getValues(const std::string& _name, std::vector<DialogueValue>& out_values) const
+{
+    const auto values = m_values.find(_name);
+    out_values = values != m_values.end() ? values->second : m_defaultValues;
+}
+
+//-------------------------------------------
+//ConditionDomain
+
+DialogueExplorer::ConditionDomain::ConditionDomain(const DialogueController& _controller)
+{
+    forEachLine(_controller, [this](const DialogueNode&, size_t, unsigned, const DialogueNode::Line& _line)
+    {
+        forEachCondition(_line, [this](const DialogueNode::Condition& _condition)
+        {
+            for(const auto& variable : _condition.variables)
+            {
+                m_constants[variable];
+            }
+
+            std::string name, text;
+            if(_condition.op == DialogueNode::Condition::Operator::None)
+            {
+                if(getSingleVariable(_condition.lvalue, name))
+                {
+                    m_constants[name].isTruthTested = true;
+                }
+                return;
+            }
+            for(const auto& operands : { std::make_pair(&_condition.lvalue, &_condition.rvalue), std::make_pair(&_condition.rvalue, &_condition.lvalue) })
+            {
+                if(getSingleVariable(*operands.first, name) && getLiteral(*operands.second, text))
+                {
+                    const auto value = DialogueValue::parse(text);
+                    auto& constants = m_constants[name];
+                    if(value.type == DialogueValue::Type::Number)
+                    {
+                        constants.numbers.push_back(value.number);
+                    }
+                    else
+                    {
+                        constants.texts.push_back(text);
+                    }
+                }
+            }
+        });
+    });
+}
+
+void DialogueExplorer::ConditionDomain::getValues(const std::string& _name, std::vector<DialogueValue>& out_values) const
+{
+    out_values.clear();
+    const auto it = m_constants.find(_name);
+    if(it == m_constants.end())
+    {
+        //only read by <<set>> expressions
+        out_values.push_back(DialogueValue::fromNumber(0));
+        return;
+    }
+    const auto& constants = it->second;
+
+    std::set<double> numbers;
+    for(const auto number : constants.numbers)
+    {
+        numbers.insert({ number - 1, number, number + 1 });
+    }
+    if(constants.isTruthTested && (constants.numbers.empty() == false || constants.texts.empty() == false))
+    {
+        numbers.insert(0);
+    }
+    for(const auto number : numbers)
+    {
+        out_values.push_back(DialogueValue::fromNumber(number));
+    }
+
+    const std::set<std::string> texts(constants.texts.begin(), constants.texts.end());
+    for(const auto& text : texts)
+    {
+        out_values.push_back(DialogueValue::parse(text));
+    }
+    if(texts.empty() == false)
+    {
+        out_values.push_back(DialogueValue());
+    }
+
+    if(out_values.empty())
+    {
+        if(constants.isTruthTested)
+        {
+            out_values = { DialogueValue::fromBool(false), DialogueValue::fromBool(true) };
+        }
+        else
+        {
+            out_values = { DialogueValue::fromNumber(0), DialogueValue::fromNumber(1) };
+        }
+    }
+}
+
+//-------------------------------------------
+//DialogueExplorer
+
+DialogueExplorer::DialogueExplorer()
+: m_liveWords(0)
+, m_maxStates(0)
+, m_threadCount(0)
+, m_queuedCount(0)
+, m_activeWorkers(0)
+, m_stateCount(0)
+, m_isTruncated(false)
+{
+}
+
+DialogueExplorer::~DialogueExplorer()
+{
+}
+
+bool DialogueExplorer::explore(const std::vector<DialogueController::NodeSource>& _sources, const Settings& _settings)
+{
+    return explore([&_sources](DialogueController& _controller)
+    {
+        for(const auto& source : _sources)
+        {
+            if(_controller.addNode(source.name, source.tags, source.body, 0) == false)
+            {
+                return false;
+            }
+        }
+        return true;
+    }, _settings);
+}
+
+bool DialogueExplorer::explore(const Loader& _loader, const Settings& _settings)
+{
+    m_report = Report();
+    m_queues.assign(k_priorityCount, std::deque<Item>());
+    m_queuedCount = 0;
+    m_activeWorkers = 0;
+    m_stateCount = 0;
+    m_isTruncated = false;
+    m_maxStates = _settings.maxStates;
+
+    m_threadCount = _settings.threadCount > 0 ? _settings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::unique_ptr<Worker>> workers;
+    for(unsigned i = 0; i < m_threadCount; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this));
+    }
+
+    //every thread parses its own copy of the script
+    {
+        std::vector<std::thread> threads;
+        for(auto& worker : workers)
+        {
+            threads.emplace_back([&_loader, &worker]() { worker->load(_loader); });
+        }
+        for(auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    for(auto& worker : workers)
+    {
+        if(worker->isLoaded() == false)
+        {
+            LOGERROR("Failed to explore: the script couldn't be loaded");
+            return false;
+        }
+        std::vector<std::string> names;
+        worker->getController().getNodeNames(names);
+        if(worker == workers.front())
+        {
+            m_report.nodeNames = std::move(names);
+        }
+        else if(names != m_report.nodeNames)
+        {
+            LOGERROR("Failed to explore: the loader added different nodes on each thread");
+            return false;
+        }
+    }
+    if(analyze(workers.front()->getController(), _settings) == false)
+    {
+        return false;
+    }
+    for(auto& worker : workers)
+    {
+        if(worker->prepare() == false)
+        {
+            return false;
+        }
+    }
+    std::vector<std::atomic<uint64_t>>(m_slots.size()).swap(m_slotStates);
+
+    const auto start = std::make_shared<const State>();
+    for(uint32_t startNode = 0; startNode < m_startNodes.size(); ++startNode)
+    {
+        m_queues.front().push_back({ start, Action::Start, startNode, 0 });
+    }
+    m_queuedCount = m_startNodes.size();
+    {
+        std::vector<std::thread> threads;
+        for(auto& worker : workers)
+        {
+            threads.emplace_back([this, &worker]() { run(*worker); });
+        }
+        for(auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    for(size_t slot = 0; slot < m_slots.size(); ++slot)
+    {
+        if(m_slots[slot].lineCoverage != k_notCovered)
+        {
+            m_report.lines[m_slots[slot].lineCoverage].states = m_slotStates[slot];
+        }
+    }
+    for(const auto& worker : workers)
+    {
+        worker->addCoverage(m_report);
+    }
+    m_report.states = m_stateCount;
+    m_report.isComplete = m_isTruncated == false;
+    for(auto& shard : m_shards)
+    {
+        std::unordered_set<uint64_t>().swap(shard.hashes);
+    }
+    std::vector<std::atomic<uint64_t>>().swap(m_slotStates);
+    return true;
+}
+
+const DialogueExplorer::Report& DialogueExplorer::getReport() const
+{
+    return m_report;
+}
+
+void DialogueExplorer::writeJson(std::string& out_text) const
+{
+    const auto& names = m_report.nodeNames;
+    const auto separate = [&out_text](bool& _isFirst)
+    {
+        out_text += _isFirst ? "\n" : ",\n";
+        _isFirst = false;
+    };
+
+    struct NodeTotals
+    {
+        size_t lines = 0;
+        size_t coveredLines = 0;
+        size_t options = 0;
+        size_t coveredOptions = 0;
+    };
+    std::vector<NodeTotals> totals(names.size());
+    for(const auto& line : m_report.lines)
+    {
+        totals[line.nodeId].lines++;
+        totals[line.nodeId].coveredLines += line.states > 0 ? 1 : 0;
+    }
+    for(const auto& option : m_report.options)
+    {
+        totals[option.nodeId].options++;
+        totals[option.nodeId].coveredOptions += option.states > 0 ? 1 : 0;
+    }
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "{\"states\":%" PRIu64 ",\"steps\":%" PRIu64 ",\"complete\":%s,\n\"nodes\":[",
+             m_report.states, m_report.steps, m_report.isComplete ? "true" : "false");
+    out_text += buffer;
+    bool isFirst = true;
+    for(DialogueNode::Id id = 0; id < totals.size(); ++id)
+    {
+        const auto& node = totals[id];
+        if(node.lines == 0 && node.options == 0) continue;
+
+        separate(isFirst);
+        out_text += "{\"id\":" + std::to_string(id) + ",\"name\":";
+        appendJsonString(out_text, names[id]);
+        snprintf(buffer, sizeof(buffer), ",\"lines\":%zu,\"coveredLines\":%zu,\"options\":%zu,\"coveredOptions\":%zu}",
+                 node.lines, node.coveredLines, node.options, node.coveredOptions);
+        out_text += buffer;
+    }
+
+    out_text += "\n],\n\"lines\":[";
+    isFirst = true;
+    for(const auto& line : m_report.lines)
+    {
+        separate(isFirst);
+        out_text += '{';
+        appendJsonLocation(out_text, names, line.nodeId, line.lineIndex, line.variantIndex);
+        out_text += ",\"states\":" + std::to_string(line.states) + '}';
+    }
+
+    out_text += "\n],\n\"unreachableLines\":[";
+    isFirst = true;
+    for(const auto& line : m_report.lines)
+    {
+        if(line.states > 0) continue;
+        separate(isFirst);
+        out_text += '{';
+        appendJsonLocation(out_text, names, line.nodeId, line.lineIndex, line.variantIndex);
+        out_text += '}';
+    }
+
+    out_text += "\n],\n\"unreachableOptions\":[";
+    isFirst = true;
+    for(const auto& option : m_report.options)
+    {
+        if(option.states > 0) continue;
+        separate(isFirst);
+        out_text += '{';
+        appendJsonLocation(out_text, names, option.nodeId, option.lineIndex, option.variantIndex);
+        out_text += ",\"option\":" + std::to_string(option.optionIndex) + '}';
+    }
+
+    out_text += "\n],\n\"deadEnds\":[";
+    isFirst = true;
+    for(const auto& line : m_report.lines)
+    {
+        for(const auto& deadEnd : { std::make_pair("NoOption", line.noOptionStates), std::make_pair("Stuck", line.stuckStates) })
+        {
+            if(deadEnd.second == 0) continue;
+            separate(isFirst);
+            out_text += '{';
+            appendJsonLocation(out_text, names, line.nodeId, line.lineIndex, line.variantIndex);
+            out_text += ",\"kind\":\"" + std::string(deadEnd.first) + "\",\"states\":" + std::to_string(deadEnd.second) + '}';
+        }
+    }
+    out_text += "\n]}\n";
+}
+
+void DialogueExplorer::writeCsv(std::string& out_text) const
+{
+    const auto& names = m_report.nodeNames;
+    const auto appendLocation = [&out_text, &names](DialogueNode::Id _nodeId, size_t _lineIndex, unsigned _variantIndex)
+    {
+        out_text += std::to_string(_nodeId) + ',';
+        appendCsvString(out_text, _nodeId < names.size() ? names[_nodeId] : std::to_string(_nodeId));
+        out_text += ',' + std::to_string(_lineIndex) + ',';
+        if(_variantIndex != DialogueNode::k_noVariant)
+        {
+            out_text += std::to_string(_variantIndex);
+        }
+        out_text += ',';
+    };
+
+    out_text += "id,name,line,variant,option,states,noOptionStates,stuckStates\n";
+    for(const auto& line : m_report.lines)
+    {
+        appendLocation(line.nodeId, line.lineIndex, line.variantIndex);
+        out_text += ',' + std::to_string(line.states) + ',' + std::to_string(line.noOptionStates) + ',' + std::to_string(line.stuckStates) + '\n';
+    }
+    for(const auto& option : m_report.options)
+    {
+        appendLocation(option.nodeId, option.lineIndex, option.variantIndex);
+        out_text += std::to_string(option.optionIndex) + ',' + std::to_string(option.states) + ",,\n";
+    }
+}
+
+//----
+//Internal Helpers
+bool DialogueExplorer::analyze(const DialogueController& _controller, const Settings& _settings)
+{
+    typedef DialogueNode::Condition::Operator Operator;
+
+    m_variables.clear();
+    m_visitedNodes.clear();
+    m_slots.clear();
+    m_lineSlots.assign(m_report.nodeNames.size(), std::vector<uint32_t>());
+    m_startNodes.clear();
+
+    //start nodes
+    if(_settings.startNodes.empty())
+    {
+        std::set<std::string> targets;
+        forEachLine(_controller, [&targets](const DialogueNode&, size_t, unsigned, const DialogueNode::Line& _line)
+        {
+            if(_line.gotoNode.empty() == false) targets.insert(_line.gotoNode);
+            for(const auto& option : _line.options)
+            {
+                if(option.gotoNode.empty() == false) targets.insert(option.gotoNode);
+            }
+        });
+        std::vector<std::string> topLevelNodes;
+        for(DialogueNode::Id id = 0; id < m_report.nodeNames.size(); ++id)
+        {
+            const auto node = _controller.getNodeById(id);
+            if(node && node->parent.empty())
+            {
+                topLevelNodes.push_back(node->name);
+                if(targets.count(node->name) == 0)
+                {
+                    m_startNodes.push_back(node->name);
+                }
+            }
+        }
+        if(m_startNodes.empty())
+        {
+            m_startNodes = std::move(topLevelNodes);
+        }
+    }
+    else
+    {
+        for(const auto& name : _settings.startNodes)
+        {
+            if(_controller.getNodeByName(name) == nullptr)
+            {
+                LOGERROR("Failed to explore: unknown start node '%s'", name.c_str());
+                return false;
+            }
+        }
+        m_startNodes = _settings.startNodes;
+    }
+
+    //variables and visit counts the conditions depend on
+    struct Assignment
+    {
+        std::string target;
+        std::vector<std::string> sources;
+        bool isExpression;
+    };
+    std::map<std::string, Variable> variables;
+    std::map<DialogueNode::Id, uint32_t> visitedNodes;
+    std::vector<Assignment> assignments;
+    forEachLine(_controller, [&](const DialogueNode&, size_t, unsigned, const DialogueNode::Line& _line)
+    {
+        forEachCondition(_line, [&](const DialogueNode::Condition& _condition)
+        {
+            for(const auto& name : _condition.variables)
+            {
+                variables[name].name = name;
+            }
+
+            std::string name, text;
+            bool isSimple = false;
+            for(const auto& operands : { std::make_pair(&_condition.lvalue, &_condition.rvalue), std::make_pair(&_condition.rvalue, &_condition.lvalue) })
+            {
+                const auto& operand = *operands.first;
+                if(operand.type != Operand::Type::Text)
+                {
+                    if(operand.nodeId == DialogueNode::k_invalidId) continue;
+
+                    //visited() and truth tests only tell 0 from more, comparisons against a number can't tell counts above it apart
+                    uint32_t maxCount = _settings.maxVisitCount;
+                    if(operand.type == Operand::Type::Visited || _condition.op == Operator::None)
+                    {
+                        maxCount = 1;
+                    }
+                    else if(getLiteral(*operands.second, text))
+                    {
+                        const auto value = DialogueValue::parse(text);
+                        if(value.type == DialogueValue::Type::Number)
+                        {
+                            maxCount = static_cast<uint32_t>(std::max(0.0, std::floor(value.number))) + 1;
+                        }
+                    }
+                    auto& visitedNode = visitedNodes[operand.nodeId];
+                    visitedNode = std::max(visitedNode, maxCount);
+                }
+                else if(getSingleVariable(operand, name))
+                {
+                    if(_condition.op == Operator::None)
+                    {
+                        variables[name].bounds.push_back(0);
+                        isSimple = true;
+                    }
+                    else if(getLiteral(*operands.second, text))
+                    {
+                        const auto value = DialogueValue::parse(text);
+                        if(value.type == DialogueValue::Type::Number)
+                        {
+                            variables[name].bounds.push_back(value.number);
+                        }
+                        isSimple = true;
+                    }
+                }
+            }
+            if(isSimple == false)
+            {
+                for(const auto& variable : _condition.variables)
+                {
+                    variables[variable].isExact = true;
+                }
+            }
+        });
+
+        forEachAction(_line, [&assignments](const DialogueNode::Action& _action)
+        {
+            std::string text;
+            Assignment assignment;
+            if(getAssignment(_action, text) && parseAssignment(text, assignment.target, assignment.sources, assignment.isExpression))
+            {
+                assignments.push_back(std::move(assignment));
+            }
+        });
+    });
+
+    //a computed variable depends on what it is computed from
+    for(bool isChanged = true; isChanged;)
+    {
+        isChanged = false;
+        for(const auto& assignment : assignments)
+        {
+            const auto target = variables.find(assignment.target);
+            if(target == variables.end() || assignment.isExpression == false) continue;
+
+            target->second.isExact = true;
+            for(const auto& source : assignment.sources)
+            {
+                auto& variable = variables[source];
+                if(variable.name.empty() || variable.isExact == false)
+                {
+                    variable.name = source;
+                    variable.isExact = true;
+                    isChanged = true;
+                }
+            }
+        }
+    }
+
+    std::unique_ptr<ConditionDomain> conditionDomain;
+    const IVariableDomain* domain = _settings.domain;
+    if(domain == nullptr)
+    {
+        conditionDomain = std::make_unique<ConditionDomain>(_controller);
+        domain = conditionDomain.get();
+    }
+    for(auto& entry : variables)
+    {
+        auto& variable = entry.second;
+        std::sort(variable.bounds.begin(), variable.bounds.end());
+        variable.bounds.erase(std::unique(variable.bounds.begin(), variable.bounds.end()), variable.bounds.end());
+        domain->getValues(variable.name, variable.candidates);
+        m_variables.push_back(std::move(variable));
+    }
+    for(const auto& visitedNode : visitedNodes)
+    {
+        m_visitedNodes.push_back({ visitedNode.first, visitedNode.second });
+    }
+
+    //a coverage slot per line, or per variant of % groups
+    forEachLine(_controller, [this](const DialogueNode& _node, size_t _lineIndex, unsigned _variantIndex, const DialogueNode::Line& _line)
+    {
+        auto& lineSlots = m_lineSlots[_node.id];
+        if(_variantIndex == 0 || _variantIndex == DialogueNode::k_noVariant)
+        {
+            lineSlots.resize(std::max(lineSlots.size(), _lineIndex + 1));
+            lineSlots[_lineIndex] = static_cast<uint32_t>(m_slots.size());
+        }
+
+        const bool isPresentable = _line.actorId != DialogueNode::k_invalidId || _line.content.empty() == false;
+        m_slots.push_back({ _node.id, _lineIndex, _variantIndex, _line.lineId, m_report.options.size(), isPresentable ? m_report.lines.size() : k_notCovered });
+        if(isPresentable)
+        {
+            m_report.lines.push_back({ _node.id, _lineIndex, _variantIndex, _line.lineId });
+        }
+        for(size_t option = 0; option < _line.options.size(); ++option)
+        {
+            m_report.options.push_back({ _node.id, _lineIndex, _variantIndex, option });
+        }
+    });
+
+    analyzeLiveness(_controller);
+    return true;
+}
+
+void DialogueExplorer::analyzeLiveness(const DialogueController& _controller)
+{
+    //a line reads what its own, its variants' and its options' conditions and <<set>> expressions read, then whatever the lines after it
+    //and the nodes it leads to read. Lines returned to after a node exits are read through their own frames, so a node's end reads nothing
+    std::map<std::string, size_t> variableBits;
+    for(size_t index = 0; index < m_variables.size(); ++index)
+    {
+        variableBits[m_variables[index].name] = index;
+    }
+    std::map<DialogueNode::Id, size_t> visitedBits;
+    for(size_t index = 0; index < m_visitedNodes.size(); ++index)
+    {
+        visitedBits[m_visitedNodes[index].nodeId] = m_variables.size() + index;
+    }
+
+    const auto nodeCount = m_report.nodeNames.size();
+    m_liveWords = (m_variables.size() + m_visitedNodes.size() + 63) / 64;
+    m_liveLines.assign(nodeCount + 1, 0);
+    for(DialogueNode::Id id = 0; id < nodeCount; ++id)
+    {
+        const auto node = _controller.getNodeById(id);
+        m_liveLines[id + 1] = m_liveLines[id] + (node ? node->lines.size() : 0) + 1;
+    }
+    m_liveBits.assign(m_liveLines[nodeCount] * m_liveWords, 0);
+
+    //what each line reads itself and the nodes it leads to
+    std::vector<std::vector<std::pair<size_t, DialogueNode::Id>>> targets(nodeCount); //line index and node, in line order
+    std::vector<std::vector<DialogueNode::Id>> sources(nodeCount); //nodes leading to each node
+    const auto setBit = [this](size_t _line, size_t _bit)
+    {
+        m_liveBits[_line * m_liveWords + _bit / 64] |= uint64_t(1) << (_bit % 64);
+    };
+    forEachLine(_controller, [&](const DialogueNode& _node, size_t _lineIndex, unsigned, const DialogueNode::Line& _line)
+    {
+        const auto line = m_liveLines[_node.id] + _lineIndex;
+        const auto readVariable = [&](const std::string& _name)
+        {
+            const auto bit = variableBits.find(_name);
+            if(bit != variableBits.end()) setBit(line, bit->second);
+        };
+        forEachCondition(_line, [&](const DialogueNode::Condition& _condition)
+        {
+            for(const auto& name : _condition.variables)
+            {
+                readVariable(name);
+            }
+            for(const auto operand : { &_condition.lvalue, &_condition.rvalue })
+            {
+                const auto bit = visitedBits.find(operand->nodeId);
+                if(operand->type != Operand::Type::Text && bit != visitedBits.end()) setBit(line, bit->second);
+            }
+        });
+        forEachAction(_line, [&](const DialogueNode::Action& _action)
+        {
+            std::string text, target;
+            std::vector<std::string> names;
+            bool isExpression = false;
+            if(getAssignment(_action, text) && parseAssignment(text, target, names, isExpression))
+            {
+                for(const auto& name : names)
+                {
+                    readVariable(name);
+                }
+            }
+        });
+
+        const auto addTarget = [&](const std::string& _name)
+        {
+            const auto node = _name.empty() ? nullptr : _controller.getNodeByName(_name);
+            if(node == nullptr || node->id >= nodeCount) return;
+            targets[_node.id].emplace_back(_lineIndex, node->id);
+            sources[node->id].push_back(_node.id);
+        };
+        addTarget(_line.gotoNode);
+        for(const auto& option : _line.options)
+        {
+            addTarget(option.gotoNode);
+        }
+    });
+
+    m_readBits = m_liveBits;
+
+    //propagate backwards, a node is revisited whenever what a node it leads to reads from its first line grows
+    std::vector<DialogueNode::Id> pending;
+    std::vector<uint8_t> isPending(nodeCount, 1);
+    for(DialogueNode::Id id = 0; id < nodeCount; ++id)
+    {
+        pending.push_back(id);
+    }
+    while(pending.empty() == false)
+    {
+        const auto id = pending.back();
+        pending.pop_back();
+        isPending[id] = 0;
+
+        bool isChanged = false;
+        auto target = targets[id].rbegin();
+        for(size_t line = m_liveLines[id + 1] - 1; line-- > m_liveLines[id];)
+        {
+            const auto live = m_liveBits.data() + line * m_liveWords;
+            isChanged = mergeBits(live, live + m_liveWords, m_liveWords) || isChanged;
+            for(; target != targets[id].rend() && m_liveLines[id] + target->first == line; ++target)
+            {
+                isChanged = mergeBits(live, getLive(target->second, 0), m_liveWords) || isChanged;
+            }
+        }
+        if(isChanged == false) continue;
+
+        //a change to any line may have reached the first, only that is read through other nodes
+        for(const auto source : sources[id])
+        {
+            if(isPending[source] == 0)
+            {
+                isPending[source] = 1;
+                pending.push_back(source);
+            }
+        }
+    }
+}
+
+void DialogueExplorer::getLive(const DialogueController::NodeStack& _nodeStack, std::vector<uint64_t>& out_live) const
+{
+    out_live.assign(m_liveWords, 0);
+    for(const auto& frame : _nodeStack)
+    {
+        mergeBits(out_live.data(), getLive(frame.nodeId, frame.lineIndex), m_liveWords);
+    }
+}
+
+const uint64_t* DialogueExplorer::getLive(DialogueNode::Id _nodeId, size_t _lineIndex) const
+{
+    const auto line = m_liveLines[_nodeId] + std::min(_lineIndex, m_liveLines[_nodeId + 1] - m_liveLines[_nodeId] - 1);
+    return m_liveBits.data() + line * m_liveWords;
+}
+
+bool DialogueExplorer::isRead(DialogueNode::Id _nodeId, size_t _lineIndex, size_t _bit) const
+{
+    const auto line = m_liveLines[_nodeId] + std::min(_lineIndex, m_liveLines[_nodeId + 1] - m_liveLines[_nodeId] - 1);
+    return isBitSet(m_readBits.data() + line * m_liveWords, _bit);
+}
+
+void DialogueExplorer::run(Worker& _worker)
+{
+    std::vector<Item> batch, items;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    while(true)
+    {
+        m_queueChanged.wait(lock, [this]() { return m_queuedCount > 0 || m_activeWorkers == 0; });
+        if(m_queuedCount == 0)
+        {
+            break; //nothing queued and no thread can queue more
+        }
+
+        //take a share of the frontier so threads don't contend on the queue for every item, from the first queue with any
+        auto& queue = *std::find_if(m_queues.begin(), m_queues.end(), [](const std::deque<Item>& _queue) { return _queue.empty() == false; });
+        const auto count = std::min(queue.size(), std::max<size_t>(1, std::min(k_maxBatch, m_queuedCount / m_threadCount)));
+        batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + count));
+        queue.erase(queue.begin(), queue.begin() + count);
+        m_queuedCount -= count;
+        m_activeWorkers++;
+        lock.unlock();
+
+        items.clear();
+        for(const auto& item : batch)
+        {
+            _worker.process(item, items);
+        }
+        batch.clear();
+
+        lock.lock();
+        m_activeWorkers--;
+        if(m_isTruncated)
+        {
+            m_queues.assign(k_priorityCount, std::deque<Item>());
+            m_queuedCount = 0;
+        }
+        else
+        {
+            for(auto& item : items)
+            {
+                m_queues[item.priority].push_back(std::move(item));
+            }
+            m_queuedCount += items.size();
+        }
+        m_queueChanged.notify_all();
+    }
+}
+
+bool DialogueExplorer::insertState(uint64_t _hash)
+{
+    auto& shard = m_shards[_hash % k_shardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if(shard.hashes.count(_hash) != 0)
+    {
+        return false;
+    }
+    if(m_stateCount.fetch_add(1) >= m_maxStates)
+    {
+        m_stateCount--;
+        m_isTruncated = true;
+        return false;
+    }
+    shard.hashes.insert(_hash);
+    return true;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "DialogueController.h"
+#include "DialogueNode.h"
+#include "DialogueValue.h"
+
+/*! Explores every path through a script for QA coverage, without the game attached.
+ Dialogue runs on a DialogueController per thread. From each start node every option whose conditions pass is selected, every other
+ line is progressed and every % variant whose conditions pass is presented. Variables live in a DialogueVariableStore per thread so
+ <<set>> works, other actions succeed and do nothing. A variable read before the script sets it takes each value from an IVariableDomain,
+ branching the path where a condition or <<set>> expression first reads it, so only variables a path actually tests multiply its states.
+ Text substituting it before then shows it unset.
+
+ Only variables conditions depend on, directly or through the <<set>> expressions assigning them, are kept between steps, and only while
+ a condition or <<set>> expression reachable from the state may still read them, others read as unset.
+ A state is the node stack, those variables and the visit counts of nodes tested by visited() and visits() later on. Each state is expanded once,
+ states are remembered by a 64 bit hash of them. Numbers that every condition treats the same, e.g. 12 and 15 when the only comparison is
+ against 10, count as the same state, and visit counts are clamped above the largest count compared against. Frames below the top that are
+ past their node's last line, e.g. left by a [[Continue|Node]] option at the end of a node, would only exit when returned to and are dropped.
+ The random state isn't part of a state since every variant is explored.
+ States presenting lines that fewer states presented are expanded first, and a variable's other values after the first, so most lines are
+ covered early when Settings::maxStates cuts exploring off. Scripts whose variables can take unbounded values, e.g. a counter incremented
+ in a loop, or that read many variables along every path are cut off by it */
+class DialogueExplorer
+{
+public:
+    /*! Values a variable is assumed to hold when a path reads it before the script sets it. Queried once per variable before exploring */
+    class IVariableDomain
+    {
+    public:
+        virtual ~IVariableDomain() {};
+
+        /*! @param out_values the values to try, in order. A value of type None tries the variable unset. Empty to leave it unset */
+        virtual void getValues(const std::string& _name, std::vector<DialogueValue>& out_values) const = 0;
+    };
+
+    /*! Values given per variable, with defaults for the rest */
+    class EnumeratedDomain : public IVariableDomain
+    {
+    public:
+        void setValues(const std::string& _name, const std::vector<DialogueValue>& _values);
+        void setDefaultValues(const std::vector<DialogueValue>& _values);
+
+        void getValues(const std::string& _name, std::vector<DialogueValue>& out_values) const override;
+
+    protected:
+        std::map<std::string, std::vector<DialogueValue>> m_values;
+        std::vector<DialogueValue> m_defaultValues;
+    };
+
+    /*! Values derived from the script's conditions, so every condition can pass and fail: each number a variable is compared against
+     and the numbers either side of it, each text it is compared against plus unset, and 0 and 1 for variables only tested for truth.
+     Used when Settings::domain is nullptr */
+    class ConditionDomain : public IVariableDomain
+    {
+    public:
+        /*! Collect the constants compared against in every condition of the controller's nodes */
+        ConditionDomain(const DialogueController& _controller);
+
+        void getValues(const std::string& _name, std::vector<DialogueValue>& out_values) const override;
+
+    protected:
+        struct Constants
+        {
+            std::vector<double> numbers;
+            std::vector<std::string> texts;
+            bool isTruthTested = false;
+        };
+        std::map<std::string, Constants> m_constants;
+    };
+
+    /*! Populate a thread's controller. Called once per thread, concurrently, and must add the same nodes in the same order every time */
+    typedef std::function<bool(DialogueController& _controller)> Loader;
+
+    struct Settings
+    {
+        std::vector<std::string> startNodes; //empty to start from every top level node no goto or option leads to, or every top level node if there are none
+        const IVariableDomain* domain = nullptr; //nullptr for a ConditionDomain of the script
+        unsigned threadCount = 0; //0 for one per hardware thread
+        size_t maxStates = 4000000; //exploring stops once this many states were reached, see Report::isComplete
+        uint32_t maxVisitCount = 4; //visit counts compared against something other than a number are clamped to this
+    };
+
+    /*! A line, or a single variant of a % group, that has content to present */
+    struct LineCoverage
+    {
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned variantIndex; //DialogueNode::k_noVariant unless the line is a % group
+        uint64_t lineId;
+        uint64_t states = 0; //distinct states presenting the line, 0 if unreachable
+        uint64_t noOptionStates = 0; //dead ends: states where options were presented but none of their conditions pass
+        uint64_t stuckStates = 0; //dead ends: states where progressing did nothing, without ending or presenting options, e.g. paused by an action
+    };
+
+    struct OptionCoverage
+    {
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned variantIndex;
+        size_t optionIndex;
+        uint64_t states = 0; //distinct states where the option's conditions pass, 0 if it can never be selected
+    };
+
+    struct Report
+    {
+        std::vector<std::string> nodeNames; //indexed by node id
+        std::vector<LineCoverage> lines; //in node id and line order
+        std::vector<OptionCoverage> options;
+        uint64_t states = 0;
+        uint64_t steps = 0; //start, progressDialogue and selectOption calls made
+        bool isComplete = false; //false if maxStates was reached, lines and options may then be reachable yet not covered
+    };
+
+public:
+    DialogueExplorer();
+    ~DialogueExplorer();
+
+    DialogueExplorer(const DialogueExplorer&) = delete;
+    DialogueExplorer& operator=(const DialogueExplorer&) = delete;
+
+    /*! Explore every path from the start nodes, replacing the last report
+     @return false if the script couldn't be loaded or a start node doesn't exist */
+    bool explore(const Loader& _loader, const Settings& _settings);
+
+    /*! Explore a script given as top level node sources, parsed on each thread */
+    bool explore(const std::vector<DialogueController::NodeSource>& _sources, const Settings& _settings);
+
+    const Report& getReport() const;
+
+    /*! Append the report as JSON: totals, coverage per node and per line, then unreachable lines and options and dead ends */
+    void writeJson(std::string& out_text) const;
+
+    /*! Append the report as CSV, a row per line or variant followed by a row per option */
+    void writeCsv(std::string& out_text) const;
+
+protected:
+    enum class Action : uint8_t
+    {
+        Start,
+        Progress,
+        SelectOption,
+        PresentVariant //present another variant of the % line on top of the stack
+    };
+
+    /*! A point to explore from. Dialogue hasn't started if conversation is empty */
+    struct State
+    {
+        DialogueController::StateBuffer conversation;
+        std::vector<uint8_t> world; //relevant variables and clamped visit counts
+    };
+
+    struct Item
+    {
+        std::shared_ptr<const State> state;
+        Action action;
+        uint32_t argument; //start node, option or variant index
+        uint32_t priority; //queue the item is explored from, lowest first
+    };
+
+    /*! A variable conditions depend on */
+    struct Variable
+    {
+        std::string name;
+        std::vector<double> bounds; //sorted numbers conditions compare against, numbers between two bounds are the same state
+        bool isExact = false; //compared against other variables or computed by expressions, numbers are compared exactly
+        std::vector<DialogueValue> candidates;
+    };
+
+    /*! A node tested by visited() or visits() */
+    struct VisitedNode
+    {
+        DialogueNode::Id nodeId;
+        uint32_t maxCount; //counts above this are the same state
+    };
+
+    /*! Coverage slot of a line or variant, indexed by m_lineSlots */
+    struct Slot
+    {
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned variantIndex;
+        uint64_t lineId;
+        size_t optionBegin; //into Report::options
+        size_t lineCoverage; //into Report::lines, k_notCovered for lines without content, which are never presented
+    };
+    static constexpr size_t k_notCovered = ~size_t(0);
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_set<uint64_t> hashes;
+    };
+    static constexpr size_t k_shardCount = 64;
+
+    class Worker;
+
+    Report m_report;
+
+    //script analysis, read only while exploring
+    std::vector<Variable> m_variables; //sorted by name, a variable's index is also its id in each thread's variable store
+    std::vector<VisitedNode> m_visitedNodes;
+    std::vector<Slot> m_slots;
+    std::vector<std::vector<uint32_t>> m_lineSlots; //[node id][line index] first slot, a % group's variants follow
+    std::vector<std::string> m_startNodes;
+
+    //bits of the variables, then the visited nodes, a condition or <<set>> expression may read from a line on
+    std::vector<uint64_t> m_liveBits; //m_liveWords per line of each node and one past its last line, which reads nothing
+    std::vector<uint64_t> m_readBits; //laid out like m_liveBits, what each line's own conditions and <<set>> expressions read
+    std::vector<size_t> m_liveLines; //[node id] first line, a node's lines end where the next node's begin
+    size_t m_liveWords;
+
+    //frontier shared by all threads
+    size_t m_maxStates;
+    unsigned m_threadCount;
+    std::vector<std::deque<Item>> m_queues; //by priority
+    size_t m_queuedCount;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueChanged;
+    unsigned m_activeWorkers;
+    Shard m_shards[k_shardCount];
+    std::atomic<uint64_t> m_stateCount;
+    std::atomic<bool> m_isTruncated;
+    std::vector<std::atomic<uint64_t>> m_slotStates; //states presenting each slot, shared so every thread orders items by what all have covered
+
+    bool analyze(const DialogueController& _controller, const Settings& _settings);
+    void analyzeLiveness(const DialogueController& _controller);
+
+    /*! @param out_live receives the bits of the variables and visited nodes the stack's frames may still read */
+    void getLive(const DialogueController::NodeStack& _nodeStack, std::vector<uint64_t>& out_live) const;
+    const uint64_t* getLive(DialogueNode::Id _nodeId, size_t _lineIndex) const;
+    bool isRead(DialogueNode::Id _nodeId, size_t _lineIndex, size_t _bit) const;
+
+    void run(Worker& _worker);
+
+    /*! @return true if the state wasn't reached before. Fails once maxStates were reached */
+    bool insertState(uint64_t _hash);
+};
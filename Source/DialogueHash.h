@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+const uint64_t k_dialogueHashBasis = 14695981039346656037ULL;
+const uint64_t k_dialogueHashPrime = 1099511628211ULL;
+
+/*! 64bit FNV-1a. Stable across platforms and runs so it is safe to persist */
+inline uint64_t hashDialogueData(const void* _data, size_t _size, uint64_t _hash = k_dialogueHashBasis)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(_data);
+    for(size_t i = 0; i < _size; ++i)
+    {
+        _hash ^= bytes[i];
+        _hash *= k_dialogueHashPrime;
+    }
+    return _hash;
+}
+
+inline uint64_t hashDialogueString(const std::string& _string, uint64_t _hash = k_dialogueHashBasis)
+{
+    return hashDialogueData(_string.data(), _string.size(), _hash);
+}
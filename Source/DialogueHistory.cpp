@@ -0,0 +1,105 @@
+#include "DialogueHistory.h"
+
+DialogueHistory::DialogueHistory(size_t _capacity, std::pmr::memory_resource* _memoryResource)
+: m_capacity(_capacity)
+, m_entries(_memoryResource ? _memoryResource : std::pmr::get_default_resource())
+, m_lastFrames(m_entries.get_allocator())
+{
+
+}
+
+void DialogueHistory::setCapacity(size_t _capacity)
+{
+    m_capacity = _capacity;
+    while(m_entries.size() > m_capacity)
+    {
+        m_entries.pop_front();
+    }
+}
+
+size_t DialogueHistory::getCapacity() const
+{
+    return m_capacity;
+}
+
+size_t DialogueHistory::getSize() const
+{
+    return m_entries.size();
+}
+
+void DialogueHistory::record(const DialogueController::NodeStack& _nodeStack, size_t _optionCount, uint64_t _randomCounter)
+{
+    if(m_capacity == 0) return;
+
+    //reuse frames from the last recorded stack until the first one that differs
+    size_t depth = 0;
+    while(depth < _nodeStack.size() && depth < m_lastFrames.size()
+          && m_lastFrames[depth]->nodeId == _nodeStack[depth].nodeId
+          && m_lastFrames[depth]->lineIndex == _nodeStack[depth].lineIndex
+          && m_lastFrames[depth]->variantIndex == _nodeStack[depth].variantIndex)
+    {
+        depth++;
+    }
+    m_lastFrames.resize(depth);
+    for(; depth < _nodeStack.size(); ++depth)
+    {
+        FramePtr parent = depth > 0 ? m_lastFrames[depth - 1] : nullptr;
+        m_lastFrames.push_back(std::allocate_shared<Frame>(std::pmr::polymorphic_allocator<Frame>(m_entries.get_allocator()),
+                                                           Frame{ _nodeStack[depth].nodeId, _nodeStack[depth].lineIndex, _nodeStack[depth].variantIndex, parent }));
+    }
+
+    if(m_entries.size() >= m_capacity)
+    {
+        m_entries.pop_front();
+    }
+    m_entries.push_back({ m_lastFrames.empty() ? nullptr : m_lastFrames.back(),
+                          static_cast<uint32_t>(_nodeStack.size()),
+                          static_cast<uint32_t>(_optionCount),
+                          _randomCounter });
+}
+
+const DialogueHistory::Entry* DialogueHistory::getEntry(size_t _stepsBack) const
+{
+    if(_stepsBack < m_entries.size())
+    {
+        return &m_entries[m_entries.size() - 1 - _stepsBack];
+    }
+    return nullptr;
+}
+
+void DialogueHistory::drop(size_t _count)
+{
+    while(_count-- > 0 && m_entries.empty() == false)
+    {
+        m_entries.pop_back();
+    }
+
+    //continue sharing frames with the entry that is now the most recent
+    m_lastFrames.clear();
+    if(m_entries.empty() == false)
+    {
+        const auto& entry = m_entries.back();
+        m_lastFrames.resize(entry.depth);
+        size_t depth = entry.depth;
+        for(auto frame = entry.top; frame != nullptr && depth > 0; frame = frame->parent)
+        {
+            m_lastFrames[--depth] = frame;
+        }
+    }
+}
+
+void DialogueHistory::clear()
+{
+    m_entries.clear();
+    m_lastFrames.clear();
+}
+
+void DialogueHistory::toNodeStack(const Entry& _entry, DialogueController::NodeStack& out_nodeStack)
+{
+    out_nodeStack.resize(_entry.depth);
+    size_t depth = _entry.depth;
+    for(auto frame = _entry.top.get(); frame != nullptr && depth > 0; frame = frame->parent.get())
+    {
+        out_nodeStack[--depth] = { frame->nodeId, frame->lineIndex, frame->variantIndex };
+    }
+}
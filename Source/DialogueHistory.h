@@ -0,0 +1,59 @@
+#pragma once
+
+#include "DialogueController.h"
+
+#include <deque>
+#include <memory>
+#include <memory_resource>
+
+/*! Bounded history of presented lines used to rewind a conversation.
+ Node stacks are stored as persistent linked frames, so consecutive entries share every frame
+ below the one that changed and an entry costs a few words rather than a copy of the stack */
+class DialogueHistory
+{
+public:
+    struct Frame
+    {
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned variantIndex;
+        std::shared_ptr<const Frame> parent;
+    };
+    typedef std::shared_ptr<const Frame> FramePtr;
+
+    struct Entry
+    {
+        FramePtr top;
+        uint32_t depth;
+        uint32_t optionCount;
+        uint64_t randomCounter;
+    };
+
+public:
+    /*! @param _memoryResource resource for entries and frames, the default resource if nullptr */
+    DialogueHistory(size_t _capacity, std::pmr::memory_resource* _memoryResource = nullptr);
+
+    void setCapacity(size_t _capacity);
+    size_t getCapacity() const;
+    size_t getSize() const;
+
+    /*! Record the current state, dropping the oldest entry if full */
+    void record(const DialogueController::NodeStack& _nodeStack, size_t _optionCount, uint64_t _randomCounter);
+
+    /*! @param _stepsBack 0 is the most recent entry
+     @return the entry or nullptr if there is no entry that far back */
+    const Entry* getEntry(size_t _stepsBack) const;
+
+    /*! Drop the most recent _count entries */
+    void drop(size_t _count);
+
+    void clear();
+
+    /*! Rebuild a node stack from an entry */
+    static void toNodeStack(const Entry& _entry, DialogueController::NodeStack& out_nodeStack);
+
+protected:
+    size_t m_capacity;
+    std::pmr::deque<Entry> m_entries;
+    std::pmr::vector<FramePtr> m_lastFrames; //frames of the last recorded stack by depth, used to share structure
+};
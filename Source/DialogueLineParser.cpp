@@ -3,10 +3,18 @@
 #include "DialogueMacros.h"
 #include "DialogueNode.h"
 #include "IDialogueResolver.h"
+#include "DialogueVisitTracker.h"
+#include "DialogueHash.h"
+#include "DialogueTrace.h"
 
 #include <sstream>
-#include <regex>
+#include <map>
+#include <unordered_map>
 #include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
 
 using namespace std;
 
@@ -19,6 +27,11 @@ const string k_gotoBegin = "[[", k_gotoEnd = "]]";
 const string k_variableBegin = "$(", k_variableEnd = ")";
 const string k_optionShortcut = "->";
 const string k_potentialLine = "%";
+const string k_potentialWeightStart = "(", k_potentialWeightEnd = ")";
+const string k_visitedFunction = "visited(", k_visitsFunction = "visits(", k_functionEnd = ")";
+const string k_lineIdTag = "#line:";
+const string k_endlineToken = "\\n";
+const int k_maxIndentLevel = 32; //deeper lines are treated as this deep, each level recurses while parsing
 
 //------------------------------------
 //HELPER FUNCTIONS
@@ -84,12 +97,81 @@ T fromString(const std::string &str)
     return t;
 }
 
+//conditions compare numbers on every evaluation, parse them without constructing a stream or depending on the locale
+template <>
+float fromString<float>(const std::string &str)
+{
+    float t = 0;
+    if (DialogueLineParser::parseNumber(str, t) == false) throw std::invalid_argument("");
+    return t;
+}
+
+//remove a #line:id tag from the end of a line, #line: anywhere else is text
+//@return the line id or 0 if there is no tag
+uint64_t parseLineIdTag(string& s)
+{
+    const auto end = s.find_last_not_of(" \t") + 1;
+    const auto separator = s.find_last_of(" \t", end == 0 ? 0 : end - 1);
+    const auto start = separator == string::npos ? 0 : separator + 1;
+    if(end <= start + k_lineIdTag.size() || s.compare(start, k_lineIdTag.size(), k_lineIdTag) != 0) return 0;
+
+    const auto tag = s.substr(start + k_lineIdTag.size(), end - start - k_lineIdTag.size());
+    s.erase(start);
+    return DialogueLineParser::makeLineId(tag);
+}
+
+//an operand that is exactly one $(variable) is resolved with the name compiled into the condition rather than a copy
+//@return the name from _variables or nullptr if the operand is anything else
+const string* getSingleVariable(const string& _operand, const vector<string>& _variables)
+{
+    if(_operand.size() <= k_variableBegin.size() + k_variableEnd.size()
+       || _operand.compare(0, k_variableBegin.size(), k_variableBegin) != 0
+       || _operand.find(k_variableEnd) != _operand.size() - k_variableEnd.size())
+    {
+        return nullptr;
+    }
+    const std::string_view name(_operand.data() + k_variableBegin.size(), _operand.size() - k_variableBegin.size() - k_variableEnd.size());
+    for(const auto& variable : _variables)
+    {
+        if(name == variable) return &variable;
+    }
+    return nullptr;
+}
+
+bool equalsIgnoreCase(const string& _string, const char* _other)
+{
+    size_t i = 0;
+    for(; i < _string.size() && _other[i] != '\0'; ++i)
+    {
+        if(tolower(static_cast<unsigned char>(_string[i])) != _other[i]) return false;
+    }
+    return i == _string.size() && _other[i] == '\0';
+}
+
 //------------------------------------
 //DialogueLineParser implementation
-DialogueLineParser::DialogueLineParser(const IDialogueResolver* _resolver)
+DialogueLineParser::DialogueLineParser(const IDialogueResolver* _resolver, const DialogueVisitTracker* _visits)
 : m_resolver(_resolver)
+, m_visits(_visits)
+, m_isMarkupEnabled(false)
+{
+
+}
+
+void DialogueLineParser::setResolver(const IDialogueResolver* _resolver, const DialogueVisitTracker* _visits)
 {
+    m_resolver = _resolver;
+    m_visits = _visits;
+}
 
+void DialogueLineParser::setMarkupEnabled(bool _isEnabled)
+{
+    m_isMarkupEnabled = _isEnabled;
+}
+
+bool DialogueLineParser::isMarkupEnabled() const
+{
+    return m_isMarkupEnabled;
 }
 
 DialogueLineParser::~DialogueLineParser()
@@ -100,11 +182,9 @@ DialogueLineParser::~DialogueLineParser()
 void DialogueLineParser::parse(const string& _name,
                                const string& _tags,
                                const string& _body,
-                               unsigned _seed,
+                               unsigned /*_seed*/,
                                std::vector<DialogueNode>& out_nodes)
 {
-    srand(_seed);
-
     istringstream stream(_body);
     string lineString;
     vector<string> lines;
@@ -117,19 +197,72 @@ void DialogueLineParser::parse(const string& _name,
             lineString = lineString.substr(0, lineCommentStartIndex);
         }
         //replace endline tokens
+        if(lineString.find(k_endlineToken) != string::npos)
         {
-            size_t pos = 0;
-            std::string token("\\n");
-            while ((pos = lineString.find(token, pos)) != std::string::npos) {
-                lineString.replace(pos, token.length(), "\n");
-                pos += 1;
+            string replaced;
+            size_t pos = 0, tokenPos = 0;
+            while ((tokenPos = lineString.find(k_endlineToken, pos)) != std::string::npos) {
+                replaced.append(lineString, pos, tokenPos - pos);
+                replaced += '\n';
+                pos = tokenPos + k_endlineToken.size();
             }
+            replaced.append(lineString, pos, string::npos);
+            lineString.swap(replaced);
         }
         //add line
         lines.push_back(lineString);
     }
 
+    const size_t firstNode = out_nodes.size();
     parseNodes(_name, _tags, lines, 0, 0, out_nodes);
+
+    //untagged lines are identified by their text, keyed by the top level name so ids don't depend on line numbers.
+    //Text repeated under the same name, e.g. two "OK" options, mixes in how many times it was seen before.
+    //Tagged lines keep their tag, a tag used twice is reported
+    //markup, if enabled, is parsed once here rather than each time a line is shown
+    std::unordered_map<uint64_t, unsigned> lineIdCounts;
+    const auto assignLineId = [&](uint64_t& _lineId, const std::string& _actorKey, const std::string& _content)
+    {
+        if(_lineId != 0)
+        {
+            if(lineIdCounts[_lineId]++ > 0)
+            {
+                LOGERROR("Line id of '%s' in node '%s' is used by another line", _content.c_str(), _name.c_str());
+            }
+            return;
+        }
+        if(_content.empty()) return;
+
+        const auto contentId = makeContentLineId(_name, _actorKey, _content);
+        auto& count = lineIdCounts[contentId];
+        _lineId = count == 0 ? contentId : makeContentLineId(_name, _actorKey, _content, count);
+        count++;
+    };
+    const auto assignLineIds = [&](DialogueNode::Line& _line)
+    {
+        assignLineId(_line.lineId, _line.actorKey, _line.content);
+        if(m_isMarkupEnabled) parseMarkup(_line.content, _line.markup);
+        for(auto& option : _line.options)
+        {
+            assignLineId(option.lineId, std::string(), option.content);
+            if(m_isMarkupEnabled) parseMarkup(option.content, option.markup);
+        }
+    };
+    for(size_t i = firstNode; i < out_nodes.size(); ++i)
+    {
+        if(out_nodes[i].name != _name)
+        {
+            out_nodes[i].parent = _name;
+        }
+        for(auto& line : out_nodes[i].lines)
+        {
+            assignLineIds(line);
+            for(auto& variant : line.variants)
+            {
+                assignLineIds(variant);
+            }
+        }
+    }
 }
 
 size_t DialogueLineParser::parseNodes(const string& _name,
@@ -148,8 +281,16 @@ size_t DialogueLineParser::parseNodes(const string& _name,
     {
         if(potentialNode.lines.empty() == false)
         {
-            const auto& resolvedLine = potentialNode.lines[rand() % potentialNode.lines.size()];
-            node.lines.push_back(resolvedLine);
+            //keep every variant, one is picked each time the line is presented. The group line only holds the variants
+            if(potentialNode.lines.size() > 1)
+            {
+                node.lines.emplace_back();
+                node.lines.back().variants.swap(potentialNode.lines);
+            }
+            else
+            {
+                node.lines.push_back(std::move(potentialNode.lines.front()));
+            }
             potentialNode.lines.clear();
         }
     };
@@ -158,7 +299,7 @@ size_t DialogueLineParser::parseNodes(const string& _name,
     for(; i < _lines.size();)
     {
         string lineString = _lines[i];
-        int lineIndent = calulateIndentLevel(lineString);
+        int lineIndent = std::min(calulateIndentLevel(lineString), k_maxIndentLevel);
         trim(lineString);
 
         //if this line is an option and we're processing potentials then parse this into the potential node
@@ -223,7 +364,32 @@ size_t DialogueLineParser::parseNodes(const string& _name,
         //if this line is is a potential remove the potential symbol and parse into the potential node
         if(startsWith(lineString, k_potentialLine))
         {
-            parseLine(lineString.substr(k_potentialLine.size()), potentialNode);
+            //optional weight in brackets directly after the symbol, e.g. %(3) Actor: text. Text such as "%3 apples" is left as is
+            auto potentialString = lineString.substr(k_potentialLine.size());
+            float weight = 1;
+            if(startsWith(potentialString, k_potentialWeightStart))
+            {
+                const auto end = potentialString.find(k_potentialWeightEnd);
+                if(end != string::npos)
+                {
+                    const char* numberEnd = potentialString.data() + end;
+                    float parsedWeight = 0;
+                    const auto result = std::from_chars(potentialString.data() + k_potentialWeightStart.size(), numberEnd, parsedWeight);
+                    if(result.ec == std::errc() && result.ptr == numberEnd && std::isfinite(parsedWeight))
+                    {
+                        weight = parsedWeight;
+                        potentialString.erase(0, end + k_potentialWeightEnd.size());
+                        trim(potentialString);
+                    }
+                }
+            }
+
+            const auto lineCount = potentialNode.lines.size();
+            parseLine(potentialString, potentialNode);
+            if(potentialNode.lines.size() > lineCount)
+            {
+                potentialNode.lines.back().weight = weight;
+            }
         }
         //else this line is not potential, so flush and parse as usual
         else
@@ -235,7 +401,7 @@ size_t DialogueLineParser::parseNodes(const string& _name,
 
     flushPotentialLines();
 
-    _nodeSet.push_back(node);
+    _nodeSet.push_back(std::move(node));
 
     return i;
 }
@@ -246,7 +412,7 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
 
     if(lineString.empty()) return false;
 
-    const auto parseOutCommon = [this, &lineString](vector<string>* out_conditions,
+    const auto parseOutCommon = [this, &lineString](vector<DialogueNode::Condition>* out_conditions,
                                                     vector<DialogueNode::Action>* out_actions,
                                                     string* out_goto)
     {
@@ -257,7 +423,9 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
             parseGroups(lineString, k_ifBegin, k_ifEnd, groupContents);
             for (const auto& content : groupContents)
             {
-                out_conditions->push_back(content);
+                DialogueNode::Condition condition;
+                compileCondition(content, condition);
+                out_conditions->push_back(condition);
             }
         }
 
@@ -270,13 +438,13 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
             {
                 if(action.empty())
                 {
-                    CCLOGERROR("Failed to parse empty action");
+                    LOGERROR("Failed to parse empty action");
                 }
                 else
                 {
                     string name = action[0];
                     vector<string> params(action.begin() + 1, action.end());
-                    DialogueNode::Action action = { name, params };
+                    DialogueNode::Action action = { name, params, DialogueNode::Action::Binding::Unlinked, ~0u, {}, {}, {} };
                     out_actions->push_back(action);
                 }
             }
@@ -300,6 +468,7 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
 
         DialogueNode::Option option;
         option.isShortcut = true;
+        option.lineId = parseLineIdTag(lineString);
 
         parseOutCommon(&option.conditions, &option.actions, &option.gotoNode);
 
@@ -317,6 +486,7 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
     }
 
     DialogueNode::Line newLine;
+    newLine.lineId = parseLineIdTag(lineString);
 
     //parse out gotos
     if (lineString.empty() == false)
@@ -332,7 +502,7 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
             }
             else if(params.size() > 1)
             {
-                DialogueNode::Option option = { params[0], params[1], false };
+                DialogueNode::Option option = { params[0], params[1], false, {}, {}, 0, {} };
                 newLine.options.push_back(option);
             }
         }
@@ -360,80 +530,355 @@ bool DialogueLineParser::parseLine(const std::string &_lineString, DialogueNode
     return true;
 }
 
-bool DialogueLineParser::resolveCondition(const std::string &_string)
+bool DialogueLineParser::compileCondition(const std::string& _string, DialogueNode::Condition& out_condition)
 {
-    LOG("Resolving condition if(%s)", _string.c_str());
-
-    std::string conditionString = _string;
-    trim(conditionString);
+    out_condition.source = _string;
+    trim(out_condition.source);
 
-    conditionString = substituteVariables(conditionString);
-
-    //parse operator
-    enum class OperatorType
+    const std::pair<std::string, DialogueNode::Condition::Operator> ops[] =
     {
-        Equals,
-        NotEquals,
-        GreaterThan,
-        LessThan,
-        GreaterThanOrEqualTo,
-        LessThanOrEqualTo,
-        None
-    };
-    std::vector<std::pair<std::string, OperatorType>> ops =
-    {
-        {"==", OperatorType::Equals},
-        {"!=", OperatorType::NotEquals},
-        {">=", OperatorType::GreaterThanOrEqualTo},
-        {"<=", OperatorType::LessThanOrEqualTo},
-        {">", OperatorType::GreaterThan},
-        {"<", OperatorType::LessThan}
+        {"==", DialogueNode::Condition::Operator::Equals},
+        {"!=", DialogueNode::Condition::Operator::NotEquals},
+        {">=", DialogueNode::Condition::Operator::GreaterThanOrEqualTo},
+        {"<=", DialogueNode::Condition::Operator::LessThanOrEqualTo},
+        {">", DialogueNode::Condition::Operator::GreaterThan},
+        {"<", DialogueNode::Condition::Operator::LessThan}
     };
 
     //find the operator
-    std::string lvalue(conditionString), rvalue;
-    OperatorType op = OperatorType::None;
+    std::string lvalue(out_condition.source), rvalue;
+    out_condition.op = DialogueNode::Condition::Operator::None;
     for(auto& opPair : ops)
     {
-        auto index = conditionString.find(opPair.first);
+        auto index = out_condition.source.find(opPair.first);
         if(index != string::npos)
         {
-            lvalue = conditionString.substr(0, index);
-            rvalue = conditionString.substr(index + opPair.first.size(), string::npos);
-            op = opPair.second;
+            lvalue = out_condition.source.substr(0, index);
+            rvalue = out_condition.source.substr(index + opPair.first.size(), string::npos);
+            out_condition.op = opPair.second;
             break;
         }
     }
 
-    //trim
-    trim(lvalue);
-    trim(rvalue);
+    const auto compileOperand = [](std::string& _value, DialogueNode::Condition::Operand& out_operand)
+    {
+        trim(_value);
+        out_operand.type = DialogueNode::Condition::Operand::Type::Text;
+        out_operand.nodeId = DialogueNode::k_invalidId;
+
+        //parse out visit queries, the argument is a node name which may be quoted
+        const std::string* function = nullptr;
+        if(startsWith(_value, k_visitedFunction))
+        {
+            function = &k_visitedFunction;
+            out_operand.type = DialogueNode::Condition::Operand::Type::Visited;
+        }
+        else if(startsWith(_value, k_visitsFunction))
+        {
+            function = &k_visitsFunction;
+            out_operand.type = DialogueNode::Condition::Operand::Type::Visits;
+        }
+        if(function && _value.size() > function->size() && _value.back() == k_functionEnd.back())
+        {
+            _value = _value.substr(function->size(), _value.size() - function->size() - k_functionEnd.size());
+            trim(_value);
+            if(_value.size() >= 2 && _value.front() == '"' && _value.back() == '"')
+            {
+                _value = _value.substr(1, _value.size() - 2);
+            }
+        }
+        else
+        {
+            out_operand.type = DialogueNode::Condition::Operand::Type::Text;
+        }
+        out_operand.value = _value;
+    };
+    compileOperand(lvalue, out_condition.lvalue);
+    compileOperand(rvalue, out_condition.rvalue);
+
+    out_condition.variables.clear();
+    for(auto operand : { &out_condition.lvalue, &out_condition.rvalue })
+    {
+        if(operand->type == DialogueNode::Condition::Operand::Type::Text)
+        {
+            findVariables(operand->value, out_condition.variables);
+        }
+    }
+
+    return out_condition.source.empty() == false;
+}
+
+void DialogueLineParser::findVariables(const std::string& _string, std::vector<std::string>& out_variables)
+{
+    auto startPos = _string.find(k_variableBegin);
+    while(startPos != string::npos)
+    {
+        startPos += k_variableBegin.size();
+        const auto endPos = _string.find(k_variableEnd, startPos);
+        if(endPos == string::npos) break;
+
+        const auto varName = _string.substr(startPos, endPos - startPos);
+        if(std::find(out_variables.begin(), out_variables.end(), varName) == out_variables.end())
+        {
+            out_variables.push_back(varName);
+        }
+        startPos = _string.find(k_variableBegin, endPos + k_variableEnd.size());
+    }
+}
+
+bool DialogueLineParser::parseNumber(const std::string& _text, float& out_number)
+{
+    //like the stream this replaced, a number prefix is enough
+    const char* begin = _text.data();
+    const char* end = _text.data() + _text.size();
+    if(begin != end && *begin == '+') ++begin;
+    float number = 0;
+    const auto result = std::from_chars(begin, end, number);
+    if(result.ec != std::errc() || std::isfinite(number) == false) return false;
+    out_number = number;
+    return true;
+}
+
+void DialogueLineParser::parseMarkup(std::string& _text, std::vector<DialogueNode::Markup>& out_markup)
+{
+    if(_text.find_first_of("[]\\") == string::npos) return;
+
+    struct Tag
+    {
+        size_t begin, end; //[begin, end) in _text including brackets
+        string name, value;
+        bool isClose, isMarker, isMatched;
+        size_t match; //index of the matching open tag for close tags
+    };
 
-    //represent empty strings as false
-    if(lvalue.empty()) lvalue = "false";
-    if(rvalue.empty()) rvalue = "false";
+    //find tags
+    vector<Tag> tags;
+    size_t nextClose = 0; //reused while it lies ahead, so runs of [ without a ] aren't rescanned
+    for(size_t i = 0; i < _text.size(); ++i)
+    {
+        if(_text[i] == '\\' && i + 1 < _text.size() && (_text[i + 1] == '[' || _text[i + 1] == ']'))
+        {
+            i++;
+            continue;
+        }
+        if(_text[i] != '[') continue;
+
+        if(nextClose <= i)
+        {
+            nextClose = _text.find(']', i + 1);
+        }
+        const auto end = nextClose;
+        if(end == string::npos) break;
+
+        //reject bad names before copying, runs of [ would otherwise each copy up to the same ]
+        const bool opensClose = _text[i + 1] == '/';
+        size_t nameEnd = opensClose ? i + 2 : i + 1;
+        while(nameEnd < end && (isalnum(static_cast<unsigned char>(_text[nameEnd])) || _text[nameEnd] == '_' || _text[nameEnd] == '-'))
+        {
+            nameEnd++;
+        }
+        const bool validEnd = nameEnd == end || (_text[nameEnd] == '=' && opensClose == false) ||
+                              (_text[nameEnd] == '/' && nameEnd + 1 == end && opensClose == false);
+        if(validEnd == false) continue;
+
+        string body = _text.substr(i + 1, end - i - 1);
+        Tag tag = { i, end + 1, string(), string(), false, false, false, 0 };
+        if(body.empty() == false && body[0] == '/')
+        {
+            tag.isClose = true;
+            body.erase(0, 1);
+        }
+        else if(body.empty() == false && body.back() == '/')
+        {
+            tag.isMarker = true;
+            body.pop_back();
+        }
+        const auto equals = body.find('=');
+        tag.name = body.substr(0, equals);
+        if(equals != string::npos) tag.value = body.substr(equals + 1);
+
+        const bool isWord = tag.name.empty() == false && std::all_of(tag.name.begin(), tag.name.end(), [](char _c)
+        {
+            return isalnum(static_cast<unsigned char>(_c)) || _c == '_' || _c == '-';
+        });
+        if(isWord && (tag.isClose == false || tag.value.empty()))
+        {
+            tags.push_back(tag);
+            i = end;
+        }
+    }
+
+    //match close tags to the nearest open tag of the same name
+    std::map<string, vector<size_t>> openTags;
+    for(size_t i = 0; i < tags.size(); ++i)
+    {
+        auto& tag = tags[i];
+        if(tag.isMarker)
+        {
+            tag.isMatched = true;
+        }
+        else if(tag.isClose == false)
+        {
+            openTags[tag.name].push_back(i);
+        }
+        else
+        {
+            auto it = openTags.find(tag.name);
+            if(it != openTags.end() && it->second.empty() == false)
+            {
+                tag.isMatched = tags[it->second.back()].isMatched = true;
+                tag.match = it->second.back();
+                it->second.pop_back();
+            }
+        }
+    }
+
+    //rebuild the text without matched tags or escapes
+    string text;
+    vector<size_t> openStarts(tags.size(), 0);
+    size_t tagIndex = 0;
+    for(size_t i = 0; i < _text.size();)
+    {
+        if(tagIndex < tags.size() && tags[tagIndex].begin == i)
+        {
+            const auto& tag = tags[tagIndex];
+            if(tag.isMatched)
+            {
+                if(tag.isMarker)
+                {
+                    out_markup.push_back({ tag.name, tag.value, static_cast<uint32_t>(text.size()), 0 });
+                }
+                else if(tag.isClose)
+                {
+                    const auto& open = tags[tag.match];
+                    const auto start = openStarts[tag.match];
+                    out_markup.push_back({ open.name, open.value, static_cast<uint32_t>(start), static_cast<uint32_t>(text.size() - start) });
+                }
+                else
+                {
+                    openStarts[tagIndex] = text.size();
+                }
+            }
+            else
+            {
+                text.append(_text, tag.begin, tag.end - tag.begin);
+            }
+            i = tag.end;
+            tagIndex++;
+            continue;
+        }
+        if(_text[i] == '\\' && i + 1 < _text.size() && (_text[i + 1] == '[' || _text[i + 1] == ']'))
+        {
+            i++;
+        }
+        text.push_back(_text[i++]);
+    }
+
+    std::stable_sort(out_markup.begin(), out_markup.end(), [](const DialogueNode::Markup& _a, const DialogueNode::Markup& _b)
+    {
+        //outer spans first when nested spans start together
+        return _a.start != _b.start ? _a.start < _b.start : _a.length > _b.length;
+    });
+    _text.swap(text);
+}
+
+uint64_t DialogueLineParser::makeLineId(const std::string& _tag)
+{
+    return hashDialogueString(_tag);
+}
+
+uint64_t DialogueLineParser::makeContentLineId(const std::string& _nodeName, const std::string& _actorKey, const std::string& _content, unsigned _repeat)
+{
+    const char separator = '\0';
+    auto hash = hashDialogueString(_nodeName);
+    hash = hashDialogueData(&separator, 1, hash);
+    hash = hashDialogueString(_actorKey, hash);
+    hash = hashDialogueData(&separator, 1, hash);
+    hash = hashDialogueString(_content, hash);
+    return _repeat == 0 ? hash : hashDialogueData(&_repeat, sizeof(_repeat), hash);
+}
+
+bool DialogueLineParser::resolveCondition(const std::string &_string)
+{
+    DialogueNode::Condition condition;
+    compileCondition(_string, condition);
+    return resolveCondition(condition);
+}
+
+bool DialogueLineParser::resolveCondition(const DialogueNode::Condition& _condition)
+{
+    const bool result = evaluateCondition(_condition);
+    TRACE_VERBOSE(ConditionResolved, _condition.cacheIndex, result);
+    return result;
+}
+
+bool DialogueLineParser::evaluateCondition(const DialogueNode::Condition& _condition)
+{
+    //visit counts are numeric, everything else is resolved to text
+    const auto resolveOperand = [this, &_condition](const DialogueNode::Condition::Operand& _operand, std::string& out_text, float& out_number) -> bool
+    {
+        switch(_operand.type)
+        {
+            case DialogueNode::Condition::Operand::Type::Visited:
+                out_text = (m_visits && m_visits->isVisited(_operand.nodeId)) ? "true" : "false";
+                return false;
+            case DialogueNode::Condition::Operand::Type::Visits:
+                out_number = m_visits ? static_cast<float>(m_visits->getVisitCount(_operand.nodeId)) : 0.0f;
+                return true;
+            case DialogueNode::Condition::Operand::Type::Text:
+            default:
+            {
+                out_text.clear();
+                const auto* name = m_resolver ? getSingleVariable(_operand.value, _condition.variables) : nullptr;
+                if(name)
+                {
+                    m_resolver->resolveVariable(*name, out_text);
+                }
+                else
+                {
+                    substituteVariables(_operand.value, out_text);
+                }
+                trim(out_text);
+                //represent empty strings as false
+                if(out_text.empty()) out_text = "false";
+                return false;
+            }
+        }
+    };
+
+    //the operands' text is kept in the parser, so evaluating conditions reuses the same storage
+    std::string& lvalue = m_lvalue;
+    std::string& rvalue = m_rvalue;
+    float lnumber = 0, rnumber = 0;
+    const bool lisNumber = resolveOperand(_condition.lvalue, lvalue, lnumber);
+    const bool risNumber = resolveOperand(_condition.rvalue, rvalue, rnumber);
 
     try {
-        switch(op)
-        {
-            case OperatorType::Equals:
-                return lvalue == rvalue;
-            case OperatorType::NotEquals:
-                return lvalue != rvalue;
-            case OperatorType::GreaterThanOrEqualTo:
-                return fromString<float>(lvalue) >= fromString<float>(rvalue);
-            case OperatorType::LessThanOrEqualTo:
-                return fromString<float>(lvalue) <= fromString<float>(rvalue);
-            case OperatorType::GreaterThan:
-                return fromString<float>(lvalue) > fromString<float>(rvalue);
-            case OperatorType::LessThan:
-                return fromString<float>(lvalue) < fromString<float>(rvalue);
-            case OperatorType::None:
+        //compare numerically if either side is a number, otherwise compare as text
+        const bool isNumeric = lisNumber || risNumber;
+        const auto lnum = [&]() { return lisNumber ? lnumber : fromString<float>(lvalue); };
+        const auto rnum = [&]() { return risNumber ? rnumber : fromString<float>(rvalue); };
+
+        switch(_condition.op)
+        {
+            case DialogueNode::Condition::Operator::Equals:
+                return isNumeric ? lnum() == rnum() : lvalue == rvalue;
+            case DialogueNode::Condition::Operator::NotEquals:
+                return isNumeric ? lnum() != rnum() : lvalue != rvalue;
+            case DialogueNode::Condition::Operator::GreaterThanOrEqualTo:
+                return lnum() >= rnum();
+            case DialogueNode::Condition::Operator::LessThanOrEqualTo:
+                return lnum() <= rnum();
+            case DialogueNode::Condition::Operator::GreaterThan:
+                return lnum() > rnum();
+            case DialogueNode::Condition::Operator::LessThan:
+                return lnum() < rnum();
+            case DialogueNode::Condition::Operator::None:
             {
-                string lvalueLower = lvalue;
-                transform(lvalueLower.begin(), lvalueLower.end(), lvalueLower.begin(), ::tolower);
-                if(lvalueLower == "true") return true;
-                if(lvalueLower == "false") return false;
+                if(lisNumber) return lnumber != 0;
+
+                if(equalsIgnoreCase(lvalue, "true")) return true;
+                if(equalsIgnoreCase(lvalue, "false")) return false;
 
                 return fromString<float>(lvalue) != 0;
             }
@@ -443,7 +888,7 @@ bool DialogueLineParser::resolveCondition(const std::string &_string)
         }
     } catch (std::invalid_argument e)
     {
-        LOGERROR("Failed to resolve: '%s'", _string.c_str());
+        LOGERROR("Failed to resolve: '%s'", _condition.source.c_str());
         LOGERROR("%s", e.what());
         return false;
     }
@@ -454,28 +899,93 @@ bool DialogueLineParser::resolveCondition(const std::string &_string)
 }
 
 std::string DialogueLineParser::substituteVariables(const std::string& _string)
+{
+    string s;
+    substituteVariables(_string, s);
+    return s;
+}
+
+void DialogueLineParser::substituteVariables(std::string_view _string, std::string& out_result)
+{
+    substituteVariables(_string, out_result, nullptr);
+}
+
+void DialogueLineParser::substituteVariables(std::string_view _string,
+                                             const std::vector<DialogueNode::Markup>& _markup,
+                                             std::string& out_result,
+                                             std::vector<DialogueNode::Markup>& out_markup)
+{
+    out_result.clear();
+    out_markup.assign(_markup.begin(), _markup.end());
+    if(_markup.empty())
+    {
+        substituteVariables(_string, out_result, nullptr);
+        return;
+    }
+
+    vector<Substitution> substitutions;
+    substituteVariables(_string, out_result, &substitutions);
+    if(substitutions.empty()) return;
+
+    //move an offset in the source to the result, offsets inside a variable snap to the start or end of its value
+    const auto remap = [&substitutions](size_t _offset, bool _isEnd) -> size_t
+    {
+        //substitutions are in source order, only the last one starting before the offset matters
+        const auto next = std::upper_bound(substitutions.begin(), substitutions.end(), _offset, [](size_t _value, const Substitution& _substitution)
+        {
+            return _value <= _substitution.sourceBegin;
+        });
+        if(next == substitutions.begin()) return _offset;
+
+        const auto& substitution = *(next - 1);
+        if(_offset < substitution.sourceEnd) return _isEnd ? substitution.resultEnd : substitution.resultBegin;
+        return _offset - substitution.sourceEnd + substitution.resultEnd;
+    };
+    for(auto& markup : out_markup)
+    {
+        const auto start = remap(markup.start, false);
+        const auto end = markup.length == 0 ? start : remap(markup.start + markup.length, true);
+        markup.start = static_cast<uint32_t>(start);
+        markup.length = static_cast<uint32_t>(end - start);
+    }
+}
+
+void DialogueLineParser::substituteVariables(std::string_view _string, std::string& out_result, std::vector<Substitution>* out_substitutions)
 {
     if(m_resolver == nullptr)
     {
         LOGERROR("Failed to substitute variables: Invalid resolver");
-        return _string;
+        out_result.append(_string);
+        return;
     }
 
-    string s(_string);
-    auto startPos = _string.find(k_variableBegin) + k_variableBegin.size();
-    auto endPos = _string.find(k_variableEnd);
-    while (startPos != string::npos && endPos != string::npos)
+    string& s = out_result;
+    size_t pos = 0;
+    while (pos < _string.size())
     {
-        string varName = s.substr(startPos, endPos - startPos);
-        string value;
-        m_resolver->resolveVariable(varName, value);
-        s.replace(startPos - k_variableBegin.size(), k_variableBegin.size() + varName.size() + k_variableEnd.size(), value);
-
-        auto nextSearchIndex = startPos + value.size();
-        startPos = s.find(k_variableBegin, nextSearchIndex) + k_variableBegin.size();
-        endPos = s.find(k_variableEnd, nextSearchIndex);
+        const auto startPos = _string.find(k_variableBegin, pos);
+        if (startPos == string::npos) break;
+        const auto nameBegin = startPos + k_variableBegin.size();
+        const auto endPos = _string.find(k_variableEnd, nameBegin);
+        if (endPos == string::npos) break;
+
+        //the resolver takes a string, the name and value buffers are reused between variables
+        m_variableName.assign(_string, nameBegin, endPos - nameBegin);
+        m_variableValue.clear();
+        m_resolver->resolveVariable(m_variableName, m_variableValue);
+        s.append(_string, pos, startPos - pos);
+        const auto resultBegin = s.size();
+        s.append(m_variableValue);
+        pos = endPos + k_variableEnd.size();
+        if(out_substitutions)
+        {
+            out_substitutions->push_back({ startPos, pos, resultBegin, s.size() });
+        }
+    }
+    if (pos < _string.size())
+    {
+        s.append(_string, pos, string::npos);
     }
-    return s;
 }
 
 void DialogueLineParser::parseGroups(std::string& s,
@@ -483,20 +993,28 @@ void DialogueLineParser::parseGroups(std::string& s,
                                      const std::string _end,
                                      std::vector<std::string>& out_contents)
 {
+    //one pass, keeping the text between groups. Ends are only searched for after their start
+    string remainder;
+    size_t pos = 0;
     auto startPos = s.find(_start);
-    auto endPos = s.find(_end);
-    string prefix = s.substr(0, startPos);
-    while (startPos != string::npos && endPos != string::npos)
+    while (startPos != string::npos)
     {
-        startPos += _start.size(); //don't include start
-        string content = s.substr(startPos, endPos - startPos);
-        trim(content);
+        const auto contentPos = startPos + _start.size(); //don't include start
+        const auto endPos = s.find(_end, contentPos);
+        if (endPos == string::npos) break;
 
+        string content = s.substr(contentPos, endPos - contentPos);
+        trim(content);
         out_contents.push_back(content);
 
-        s = prefix + s.substr(endPos + _end.size());
-        startPos = s.find(_start);
-        endPos = s.find(_end);
+        remainder.append(s, pos, startPos - pos);
+        pos = endPos + _end.size();
+        startPos = s.find(_start, pos);
+    }
+    if (pos > 0)
+    {
+        remainder.append(s, pos, string::npos);
+        s.swap(remainder);
     }
 }
 
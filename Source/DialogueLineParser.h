@@ -1,36 +1,103 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
 #include <functional>
+#include <string_view>
+
+#include "DialogueNode.h"
 
-struct DialogueNode;
 struct DialogueLine;
 class IDialogueResolver;
+class DialogueVisitTracker;
 
 class DialogueLineParser
 {
 public:
     typedef std::function<std::string(std::string)> VariableResolverFunc;
+
+    /*! Bump when parse output changes, invalidating DialogueParseCache entries */
+    static constexpr uint32_t k_version = 2;
 public:
     virtual ~DialogueLineParser();
-    DialogueLineParser(const IDialogueResolver* _resolver);
+    DialogueLineParser(const IDialogueResolver* _resolver, const DialogueVisitTracker* _visits = nullptr);
+
+    /*! Resolve with another resolver and visits, keeping the scratch storage of previous conditions and substitutions */
+    void setResolver(const IDialogueResolver* _resolver, const DialogueVisitTracker* _visits = nullptr);
+
+    /*! If true parse splits inline markup out of line and option text (see parseMarkup). Off by default,
+     so scripts written without markup keep [brackets] and backslashes as text */
+    void setMarkupEnabled(bool _isEnabled);
+    bool isMarkupEnabled() const;
 
+    /*! Parse a node body into nodes, indented blocks become generated Name:N nodes
+     @param _seed unused, % variants are kept and picked between when presented. A variant may be weighted with %(N) */
     void parse(const std::string& _title,
                const std::string& _tags,
                const std::string& _body,
                unsigned _seed,
                std::vector<DialogueNode>& out_nodes);
 
+    /*! Compile a condition string (the contents of <<if ...>>) ready to be resolved
+     @return false if the condition could not be compiled*/
+    static bool compileCondition(const std::string& _string, DialogueNode::Condition& out_condition);
+
+    /*! Line ids from explicit #line:id tags, e.g. for export tools building a DialogueLocaleTable */
+    static uint64_t makeLineId(const std::string& _tag);
+
+    /*! Line ids for untagged lines, a hash of the top level node name, actor and text. Changes if the text is edited
+     @param _repeat how many lines with the same name, actor and text came before this one, 0 for the first */
+    static uint64_t makeContentLineId(const std::string& _nodeName, const std::string& _actorKey, const std::string& _content, unsigned _repeat = 0);
+
+    /*! Find the names of all $(variables) in a string */
+    static void findVariables(const std::string& _string, std::vector<std::string>& out_variables);
+
+    /*! Parse a number the way conditions compare them, independent of the locale. A number prefix is enough, an optional leading +
+     is allowed, and text, out of range numbers, nan and inf fail
+     @return false if _text doesn't start with a finite number */
+    static bool parseNumber(const std::string& _text, float& out_number);
+
     bool resolveCondition(const std::string& _string);
+    bool resolveCondition(const DialogueNode::Condition& _condition);
     std::string substituteVariables(const std::string& _string);
 
+    /*! Substitute variables appending the result, reusing out_result's storage */
+    void substituteVariables(std::string_view _string, std::string& out_result);
+
+    /*! Substitute variables and move markup spans to match the substituted text. Spans covering a variable cover its value
+     @param out_result receives the text, cleared first
+     @param out_markup receives the remapped spans, cleared first */
+    void substituteVariables(std::string_view _string,
+                             const std::vector<DialogueNode::Markup>& _markup,
+                             std::string& out_result,
+                             std::vector<DialogueNode::Markup>& out_markup);
+
+    /*! Remove inline markup from text, recording it as spans: [name]text[/name], [name=value]text[/name] and markers [name=value/].
+     Tags without a matching close, or with names that aren't a single word, are left as text. \[ and \] escape brackets */
+    static void parseMarkup(std::string& _text, std::vector<DialogueNode::Markup>& out_markup);
+
 protected:
 
     const IDialogueResolver* m_resolver;
+    const DialogueVisitTracker* m_visits;
+    bool m_isMarkupEnabled;
+
+    //scratch storage reused by every condition and substitution made with this parser
+    std::string m_lvalue, m_rvalue;
+    std::string m_variableName, m_variableValue;
+
+    //a variable replaced by its value, [begin, end) byte ranges
+    struct Substitution
+    {
+        size_t sourceBegin, sourceEnd;
+        size_t resultBegin, resultEnd;
+    };
+    void substituteVariables(std::string_view _string, std::string& out_result, std::vector<Substitution>* out_substitutions);
 
     bool parseLine(const std::string& _string, DialogueNode& out_line);
+    bool evaluateCondition(const DialogueNode::Condition& _condition);
 
     void parseGroups(std::string& s,
                      const std::string& _start,
@@ -0,0 +1,266 @@
+#include "DialogueLocaleTable.h"
+
+#include "DialogueMacros.h"
+#include "DialogueBinaryIO.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char k_magic[4] = { 'Y', 'K', 'L', 'T' };
+    const uint32_t k_version = 1;
+    const size_t k_headerSize = 16;
+    const size_t k_recordSize = 16;
+
+    uint32_t readUInt32(const uint8_t* _data)
+    {
+        return static_cast<uint32_t>(_data[0]) | static_cast<uint32_t>(_data[1]) << 8
+             | static_cast<uint32_t>(_data[2]) << 16 | static_cast<uint32_t>(_data[3]) << 24;
+    }
+
+    uint64_t readUInt64(const uint8_t* _data)
+    {
+        return static_cast<uint64_t>(readUInt32(_data)) | static_cast<uint64_t>(readUInt32(_data + 4)) << 32;
+    }
+}
+
+DialogueLocaleTable::DialogueLocaleTable()
+: m_data(nullptr)
+, m_size(0)
+, m_count(0)
+, m_records(nullptr)
+, m_strings(nullptr)
+, m_stringsSize(0)
+, m_mapping(nullptr)
+, m_mappingSize(0)
+#ifdef _WIN32
+, m_fileHandle(nullptr)
+, m_mappingHandle(nullptr)
+#endif
+{
+
+}
+
+DialogueLocaleTable::~DialogueLocaleTable()
+{
+    close();
+}
+
+void DialogueLocaleTable::build(std::vector<std::pair<uint64_t, std::string>> _strings, std::vector<uint8_t>& out_data)
+{
+    std::stable_sort(_strings.begin(), _strings.end(), [](const std::pair<uint64_t, std::string>& _a, const std::pair<uint64_t, std::string>& _b)
+    {
+        return _a.first < _b.first;
+    });
+    _strings.erase(std::unique(_strings.begin(), _strings.end(), [](const std::pair<uint64_t, std::string>& _a, const std::pair<uint64_t, std::string>& _b)
+    {
+        return _a.first == _b.first;
+    }), _strings.end());
+
+    out_data.clear();
+    DialogueBinaryWriter writer(out_data);
+    writer.writeBytes(k_magic, sizeof(k_magic));
+    writer.writeUInt32(k_version);
+    writer.writeUInt32(static_cast<uint32_t>(_strings.size()));
+    writer.writeUInt32(0);
+
+    uint32_t offset = 0;
+    for(const auto& string : _strings)
+    {
+        writer.writeUInt64(string.first);
+        writer.writeUInt32(offset);
+        writer.writeUInt32(static_cast<uint32_t>(string.second.size()));
+        offset += static_cast<uint32_t>(string.second.size());
+    }
+    for(const auto& string : _strings)
+    {
+        writer.writeBytes(string.second.data(), string.second.size());
+    }
+}
+
+bool DialogueLocaleTable::openFile(const std::string& _path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        LOGERROR("Failed to open locale table '%s'", _path.c_str());
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    void* view = nullptr;
+    if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    }
+    if(view == nullptr)
+    {
+        if(mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        LOGERROR("Failed to map locale table '%s'", _path.c_str());
+        return false;
+    }
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_mapping = view;
+    m_mappingSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    const int file = ::open(_path.c_str(), O_RDONLY);
+    if(file < 0)
+    {
+        LOGERROR("Failed to open locale table '%s'", _path.c_str());
+        return false;
+    }
+    struct stat fileStat;
+    void* view = MAP_FAILED;
+    if(fstat(file, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file); //the mapping keeps the file alive
+    if(view == MAP_FAILED)
+    {
+        LOGERROR("Failed to map locale table '%s'", _path.c_str());
+        return false;
+    }
+    m_mapping = view;
+    m_mappingSize = static_cast<size_t>(fileStat.st_size);
+#endif
+
+    if(validate(static_cast<const uint8_t*>(m_mapping), m_mappingSize) == false)
+    {
+        LOGERROR("Failed to open locale table '%s': invalid data", _path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool DialogueLocaleTable::openMemory(const uint8_t* _data, size_t _size)
+{
+    close();
+    if(validate(_data, _size) == false)
+    {
+        LOGERROR("Failed to open locale table: invalid data");
+        close();
+        return false;
+    }
+    return true;
+}
+
+void DialogueLocaleTable::close()
+{
+    if(m_mapping)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_mapping);
+        CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        m_mappingHandle = nullptr;
+        m_fileHandle = nullptr;
+#else
+        munmap(m_mapping, m_mappingSize);
+#endif
+        m_mapping = nullptr;
+        m_mappingSize = 0;
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+    m_records = nullptr;
+    m_strings = nullptr;
+    m_stringsSize = 0;
+}
+
+bool DialogueLocaleTable::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+bool DialogueLocaleTable::find(uint64_t _lineId, std::string_view& out_text) const
+{
+    uint32_t first = 0, count = m_count;
+    while(count > 0)
+    {
+        const uint32_t step = count / 2;
+        if(getRecordId(first + step) < _lineId)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+    if(first == m_count || getRecordId(first) != _lineId)
+    {
+        return false;
+    }
+
+    //a record pointing outside the string data is treated as missing
+    const auto record = m_records + static_cast<size_t>(first) * k_recordSize;
+    const uint64_t offset = readUInt32(record + 8), length = readUInt32(record + 12);
+    if(offset + length > m_stringsSize)
+    {
+        LOGERROR("Locale table text for line id %016llx is out of range", static_cast<unsigned long long>(_lineId));
+        return false;
+    }
+    out_text = std::string_view(reinterpret_cast<const char*>(m_strings) + offset, length);
+    return true;
+}
+
+size_t DialogueLocaleTable::getSize() const
+{
+    return m_count;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Internal Helpers
+//-------------------------------------------------------------------------------------------------------------------
+
+bool DialogueLocaleTable::validate(const uint8_t* _data, size_t _size)
+{
+    if(_data == nullptr || _size < k_headerSize || memcmp(_data, k_magic, sizeof(k_magic)) != 0 || readUInt32(_data + 4) != k_version)
+    {
+        return false;
+    }
+
+    const uint32_t count = readUInt32(_data + 8);
+    if(count > (_size - k_headerSize) / k_recordSize)
+    {
+        return false;
+    }
+
+    //records are checked when they are found rather than all here, so opening doesn't read the whole table
+    const uint8_t* records = _data + k_headerSize;
+    const uint8_t* strings = records + static_cast<size_t>(count) * k_recordSize;
+    const size_t stringsSize = _size - (strings - _data);
+
+    m_data = _data;
+    m_size = _size;
+    m_count = count;
+    m_records = records;
+    m_strings = strings;
+    m_stringsSize = stringsSize;
+    return true;
+}
+
+uint64_t DialogueLocaleTable::getRecordId(uint32_t _index) const
+{
+    return readUInt64(m_records + static_cast<size_t>(_index) * k_recordSize);
+}
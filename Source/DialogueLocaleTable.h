@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*! Read only table of localized line text keyed by line id (see DialogueNode::Line::lineId).
+ The file is memory mapped and searched in place, so opening a table only checks the header and
+ only the pages holding searched records and looked up strings are ever read. Each record is checked when it is found,
+ records out of order make lookups miss. Switch language by giving the controller another table.
+
+ Layout, little endian:
+   "YKLT" u32 version u32 count u32 reserved
+   count x { u64 lineId, u32 offset, u32 length } sorted by lineId
+   string data, offsets are relative to its start */
+class DialogueLocaleTable
+{
+public:
+    DialogueLocaleTable();
+    ~DialogueLocaleTable();
+
+    DialogueLocaleTable(const DialogueLocaleTable&) = delete;
+    DialogueLocaleTable& operator=(const DialogueLocaleTable&) = delete;
+
+    /*! Build a table from (line id, text) pairs, e.g. in an export tool. Later duplicates of an id are ignored
+     @param out_data receives the table, write it to a file to open with openFile */
+    static void build(std::vector<std::pair<uint64_t, std::string>> _strings, std::vector<uint8_t>& out_data);
+
+    /*! Memory map a table file, closing any open table
+     @return false if the file couldn't be mapped or its header isn't valid */
+    bool openFile(const std::string& _path);
+
+    /*! Use a table already in memory, e.g. embedded or loaded by the engine. The data must outlive the table
+     @return false if the data's header isn't valid */
+    bool openMemory(const uint8_t* _data, size_t _size);
+
+    void close();
+    bool isOpen() const;
+
+    /*! Find the text for a line id. Binary search over the mapped records
+     @return false if the table has no text for the id */
+    bool find(uint64_t _lineId, std::string_view& out_text) const;
+
+    size_t getSize() const;
+
+protected:
+    const uint8_t* m_data;
+    size_t m_size;
+    uint32_t m_count;
+    const uint8_t* m_records;
+    const uint8_t* m_strings;
+    size_t m_stringsSize;
+
+    //mapping owned by openFile
+    void* m_mapping;
+    size_t m_mappingSize;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#endif
+
+    bool validate(const uint8_t* _data, size_t _size);
+    uint64_t getRecordId(uint32_t _index) const;
+};
@@ -0,0 +1,271 @@
+#include "DialogueLookahead.h"
+
+#include "DialogueLineParser.h"
+
+namespace
+{
+    const unsigned k_noFrame = ~0u;
+    const unsigned k_noOption = ~0u;
+    const unsigned k_maxFramesPerLine = 8; //stacks a line is looked through with, see visit
+
+    bool hasStopAction(const std::vector<DialogueNode::Action>& _actions)
+    {
+        for(const auto& action : _actions)
+        {
+            if(action.binding == DialogueNode::Action::Binding::Stop) return true;
+        }
+        return false;
+    }
+
+    bool conditionsMet(DialogueLineParser& _parser, const std::vector<DialogueNode::Condition>& _conditions)
+    {
+        for(const auto& condition : _conditions)
+        {
+            if(_parser.resolveCondition(condition) == false) return false;
+        }
+        return true;
+    }
+}
+
+DialogueLookahead::DialogueLookahead(const DialogueController& _controller)
+: m_controller(_controller)
+{
+
+}
+
+void DialogueLookahead::update(const DialogueController::NodeStack& _nodeStack,
+                               size_t _steps,
+                               const IDialogueResolver* _resolver,
+                               std::vector<Entry>* out_newEntries)
+{
+    m_frames.clear();
+    m_frameIds.clear();
+    m_visited.clear();
+    m_lineFrames.clear();
+    m_queue.clear();
+    m_foundKeys.clear();
+
+    DialogueLineParser parser(_resolver, &m_controller.getVisits());
+    DialogueLineParser* conditionParser = _resolver ? &parser : nullptr;
+
+    std::vector<Entry> entries;
+    const auto top = _nodeStack.empty() ? nullptr : m_controller.getNodeById(_nodeStack.back().nodeId);
+    if(top && _nodeStack.back().lineIndex < top->lines.size())
+    {
+        //lower frames already point at the line to return to
+        unsigned frame = k_noFrame;
+        for(size_t i = 0; i + 1 < _nodeStack.size(); ++i)
+        {
+            frame = pushFrame(_nodeStack[i].nodeId, _nodeStack[i].lineIndex, frame);
+        }
+
+        const auto& state = _nodeStack.back();
+        expand(*top, state.lineIndex, state.variantIndex, DialogueController::getLine(*top, state), frame, 0, _steps, conditionParser);
+
+        //0-1 breadth first: moves that don't present a line are pushed to the front, so entries are found in order of steps
+        while(m_queue.empty() == false)
+        {
+            const auto next = m_queue.front();
+            m_queue.pop_front();
+            visit(next, _steps, conditionParser, entries);
+        }
+    }
+
+    //report what changed since the last update
+    if(out_newEntries)
+    {
+        out_newEntries->clear();
+        for(const auto& entry : entries)
+        {
+            if(m_entryKeys.count(LineKey(entry.line.nodeId, entry.line.lineIndex, entry.line.variantIndex)) == 0)
+            {
+                out_newEntries->push_back(entry);
+            }
+        }
+    }
+    m_entries.swap(entries);
+    m_entryKeys.swap(m_foundKeys);
+}
+
+const std::vector<DialogueLookahead::Entry>& DialogueLookahead::getEntries() const
+{
+    return m_entries;
+}
+
+void DialogueLookahead::clear()
+{
+    m_successors.clear();
+    m_entries.clear();
+    m_entryKeys.clear();
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Internal Helpers
+//-------------------------------------------------------------------------------------------------------------------
+
+const std::vector<DialogueLookahead::Successor>& DialogueLookahead::getSuccessors(const LineKey& _key, const DialogueNode::Line& _line)
+{
+    auto it = m_successors.find(_key);
+    if(it != m_successors.end())
+    {
+        return it->second;
+    }
+
+    auto& successors = m_successors[_key];
+
+    //mirrors DialogueController: options that don't goto fall through to the line's actions and goto
+    const auto addAfterLine = [this, &_line, &successors](unsigned _optionIndex)
+    {
+        if(hasStopAction(_line.actions)) return;
+        if(_line.gotoNode.empty())
+        {
+            successors.push_back({ DialogueNode::k_invalidId, _optionIndex });
+        }
+        else
+        {
+            const auto nodeId = m_controller.getNodeId(_line.gotoNode);
+            if(nodeId != DialogueNode::k_invalidId) successors.push_back({ nodeId, _optionIndex });
+        }
+    };
+
+    if(_line.options.empty())
+    {
+        addAfterLine(k_noOption);
+    }
+    for(unsigned optionIndex = 0; optionIndex < _line.options.size(); ++optionIndex)
+    {
+        const auto& option = _line.options[optionIndex];
+        if(hasStopAction(option.actions)) continue;
+        if(option.gotoNode.empty())
+        {
+            addAfterLine(optionIndex);
+        }
+        else
+        {
+            const auto nodeId = m_controller.getNodeId(option.gotoNode);
+            if(nodeId != DialogueNode::k_invalidId) successors.push_back({ nodeId, optionIndex });
+        }
+    }
+    return successors;
+}
+
+unsigned DialogueLookahead::pushFrame(DialogueNode::Id _nodeId, size_t _lineIndex, unsigned _parent)
+{
+    const auto key = std::make_tuple(_nodeId, _lineIndex, _parent);
+    auto it = m_frameIds.find(key);
+    if(it != m_frameIds.end())
+    {
+        return it->second;
+    }
+    const auto frame = static_cast<unsigned>(m_frames.size());
+    m_frames.push_back({ _nodeId, _lineIndex, _parent });
+    m_frameIds[key] = frame;
+    return frame;
+}
+
+void DialogueLookahead::expand(const DialogueNode& _node, size_t _lineIndex, unsigned _variantIndex, const DialogueNode::Line& _line,
+                               unsigned _frame, unsigned _steps, size_t _maxSteps, DialogueLineParser* _parser)
+{
+    if(_steps >= _maxSteps) return;
+
+    for(const auto& successor : getSuccessors(LineKey(_node.id, _lineIndex, _variantIndex), _line))
+    {
+        if(_parser && successor.optionIndex != k_noOption && conditionsMet(*_parser, _line.options[successor.optionIndex].conditions) == false)
+        {
+            continue;
+        }
+
+        //_steps is one more than anything queued, so these go to the back
+        if(successor.enterNodeId == DialogueNode::k_invalidId)
+        {
+            m_queue.push_back({ _node.id, _lineIndex + 1, _frame, _steps, 0 });
+        }
+        else
+        {
+            m_queue.push_back({ successor.enterNodeId, 0, pushFrame(_node.id, _lineIndex + 1, _frame), _steps, 1 });
+        }
+    }
+}
+
+void DialogueLookahead::visit(const Visit& _visit, size_t _maxSteps, DialogueLineParser* _parser, std::vector<Entry>& out_entries)
+{
+    if(m_visited.insert(std::make_tuple(_visit.nodeId, _visit.lineIndex, _visit.frame)).second == false)
+    {
+        return;
+    }
+    //options going back into their own node reach each line with a new stack every step, so stacks multiply with the steps.
+    //Visits come in order of steps, past the first few stacks a line is assumed to continue like it did with those
+    if(++m_lineFrames[std::make_pair(_visit.nodeId, _visit.lineIndex)] > k_maxFramesPerLine)
+    {
+        return;
+    }
+
+    const auto node = m_controller.getNodeById(_visit.nodeId);
+    if(node == nullptr) return;
+
+    //end of the node, return to the frame below
+    if(_visit.lineIndex >= node->lines.size())
+    {
+        if(_visit.frame != k_noFrame)
+        {
+            const auto frame = m_frames[_visit.frame];
+            m_queue.push_front({ frame.nodeId, frame.lineIndex, frame.parent, _visit.steps, _visit.nodesWithoutLine > 0 ? _visit.nodesWithoutLine - 1 : 0 });
+        }
+        return;
+    }
+
+    const auto& line = node->lines[_visit.lineIndex];
+    const unsigned candidateCount = line.variants.empty() ? 1 : static_cast<unsigned>(line.variants.size());
+    bool canSkip = false;
+    bool isAnyPresentable = false;
+    for(unsigned i = 0; i < candidateCount; ++i)
+    {
+        const unsigned variantIndex = line.variants.empty() ? DialogueNode::k_noVariant : i;
+        const auto& candidate = line.variants.empty() ? line : line.variants[i];
+        if(line.variants.empty() == false && candidate.weight <= 0) continue;
+
+        if(candidate.conditions.empty() == false)
+        {
+            if(_parser == nullptr)
+            {
+                canSkip = true;
+            }
+            else if(conditionsMet(*_parser, candidate.conditions) == false)
+            {
+                continue;
+            }
+        }
+        isAnyPresentable = true;
+
+        //nothing to present, the runtime follows the goto or moves on
+        if(candidate.actorId == DialogueNode::k_invalidId && candidate.content.empty())
+        {
+            //each goto pushes a new frame, so a goto cycle without a line never repeats a visit. The runtime stops it, stop looking too
+            const auto gotoId = candidate.gotoNode.empty() ? DialogueNode::k_invalidId : m_controller.getNodeId(candidate.gotoNode);
+            if(gotoId != DialogueNode::k_invalidId && _visit.nodesWithoutLine < DialogueController::k_maxNodesWithoutLine)
+            {
+                m_queue.push_front({ gotoId, 0, pushFrame(node->id, _visit.lineIndex + 1, _visit.frame), _visit.steps, _visit.nodesWithoutLine + 1 });
+            }
+            else if(candidate.gotoNode.empty())
+            {
+                canSkip = true;
+            }
+            continue;
+        }
+
+        const auto steps = _visit.steps + 1;
+        if(steps > _maxSteps) continue;
+
+        //a line reached with different stacks is reported once, but each stack continues differently
+        if(m_foundKeys.insert(LineKey(node->id, _visit.lineIndex, variantIndex)).second)
+        {
+            out_entries.push_back({ { node->id, _visit.lineIndex, variantIndex }, candidate.lineId, candidate.actorId, steps });
+        }
+        expand(*node, _visit.lineIndex, variantIndex, candidate, _visit.frame, steps, _maxSteps, _parser);
+    }
+
+    if(canSkip || isAnyPresentable == false)
+    {
+        m_queue.push_front({ node->id, _visit.lineIndex + 1, _visit.frame, _visit.steps, _visit.nodesWithoutLine });
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "DialogueController.h"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+class IDialogueResolver;
+
+/*! Finds the lines that could be presented within the next few steps of a conversation, across every option
+ branch and goto, so voice over and other assets can be streamed in before the line is shown.
+ The branches leaving each line are cached, and each update reports which entries are new since the previous one,
+ so calling update after every presented line only does work for the newly reachable lines */
+class DialogueLookahead
+{
+public:
+    struct Entry
+    {
+        DialogueController::NodeState line; //node, line index and % variant
+        uint64_t lineId; //stable id, e.g. to locate voice over
+        DialogueNode::ActorId actorId;
+        unsigned steps; //number of lines presented to reach this one, 1 for the next line
+    };
+
+public:
+    /*! ctor
+     @param _controller controller owning the nodes, must outlive the lookahead. In paged mode only resident nodes are looked through */
+    DialogueLookahead(const DialogueController& _controller);
+
+    /*! Find the lines reachable from the line at the top of a node stack
+     @param _nodeStack the stack to look ahead from, usually DialogueController::getNodeStack()
+     @param _steps maximum number of lines ahead
+     @param _resolver if set, line and option conditions are evaluated against current state and failing branches are pruned.
+                      If null conditions are ignored and every branch is considered
+     @param out_newEntries if set, receives the entries that weren't returned by the previous update */
+    void update(const DialogueController::NodeStack& _nodeStack,
+                size_t _steps,
+                const IDialogueResolver* _resolver,
+                std::vector<Entry>* out_newEntries = nullptr);
+
+    /*! @return the entries found by the last update, in order of steps */
+    const std::vector<Entry>& getEntries() const;
+
+    /*! Forget cached branches and entries, call after nodes are added, removed or reloaded */
+    void clear();
+
+protected:
+    typedef std::tuple<DialogueNode::Id, size_t, unsigned> LineKey; //node id, line index, variant
+
+    //a branch leaving a presented line
+    struct Successor
+    {
+        DialogueNode::Id enterNodeId; //node entered, k_invalidId to continue at the next line
+        unsigned optionIndex; //option selected to take this branch, ~0u if none
+    };
+
+    //a return point on the node stack, interned so identical stacks share an index
+    struct Frame
+    {
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned parent;
+    };
+
+    //the runtime is about to try presenting a line
+    struct Visit
+    {
+        DialogueNode::Id nodeId;
+        size_t lineIndex;
+        unsigned frame;
+        unsigned steps;
+        unsigned nodesWithoutLine; //nodes entered and not exited since the last line, as DialogueController counts them
+    };
+
+    const DialogueController& m_controller;
+    std::map<LineKey, std::vector<Successor>> m_successors;
+    std::vector<Entry> m_entries;
+    std::set<LineKey> m_entryKeys;
+
+    //per update scratch
+    std::vector<Frame> m_frames;
+    std::map<std::tuple<DialogueNode::Id, size_t, unsigned>, unsigned> m_frameIds;
+    std::set<std::tuple<DialogueNode::Id, size_t, unsigned>> m_visited;
+    std::map<std::pair<DialogueNode::Id, size_t>, unsigned> m_lineFrames; //number of stacks each line was visited with
+    std::deque<Visit> m_queue;
+    std::set<LineKey> m_foundKeys;
+
+    const std::vector<Successor>& getSuccessors(const LineKey& _key, const DialogueNode::Line& _line);
+    unsigned pushFrame(DialogueNode::Id _nodeId, size_t _lineIndex, unsigned _parent);
+    void expand(const DialogueNode& _node, size_t _lineIndex, unsigned _variantIndex, const DialogueNode::Line& _line,
+                unsigned _frame, unsigned _steps, size_t _maxSteps, DialogueLineParser* _parser);
+    void visit(const Visit& _visit, size_t _maxSteps, DialogueLineParser* _parser, std::vector<Entry>& out_entries);
+};
@@ -23,10 +23,16 @@
 
 /* Default defines */
 #ifndef ASSERT
+    #include <cassert>
+    #define ASSERT(x) assert(x)
 #endif
 
 #ifndef LOG
+    #include <cstdio>
+    #define LOG(format, ...) printf(format "\n", ##__VA_ARGS__)
 #endif
 
 #ifndef LOGERROR
+    #include <cstdio>
+    #define LOGERROR(format, ...) fprintf(stderr, format "\n", ##__VA_ARGS__)
 #endif
@@ -0,0 +1,107 @@
+#include "DialogueMemory.h"
+
+DialogueCountingResource::ScopedPhase::ScopedPhase(DialogueCountingResource* _resource, Phase _phase)
+: m_resource(_resource)
+, m_previousPhase(Phase::Other)
+{
+    if(m_resource)
+    {
+        m_previousPhase = m_resource->getPhase();
+        m_resource->setPhase(_phase);
+    }
+}
+
+DialogueCountingResource::ScopedPhase::~ScopedPhase()
+{
+    if(m_resource)
+    {
+        m_resource->setPhase(m_previousPhase);
+    }
+}
+
+DialogueCountingResource::DialogueCountingResource(std::pmr::memory_resource* _upstream)
+: m_upstream(_upstream ? _upstream : std::pmr::get_default_resource())
+, m_phase(Phase::Other)
+, m_bytesInUse(0)
+, m_peakBytesInUse(0)
+{
+
+}
+
+std::pmr::memory_resource* DialogueCountingResource::getUpstream() const
+{
+    return m_upstream;
+}
+
+void DialogueCountingResource::setPhase(Phase _phase)
+{
+    m_phase = _phase;
+}
+
+DialogueCountingResource::Phase DialogueCountingResource::getPhase() const
+{
+    return m_phase;
+}
+
+const DialogueCountingResource::Stats& DialogueCountingResource::getStats(Phase _phase) const
+{
+    return m_stats[static_cast<size_t>(_phase < Phase::Count ? _phase : Phase::Other)];
+}
+
+size_t DialogueCountingResource::getBytesInUse() const
+{
+    return m_bytesInUse;
+}
+
+size_t DialogueCountingResource::getPeakBytesInUse() const
+{
+    return m_peakBytesInUse;
+}
+
+void DialogueCountingResource::resetStats()
+{
+    for(auto& stats : m_stats)
+    {
+        stats = Stats();
+    }
+    m_peakBytesInUse = m_bytesInUse;
+}
+
+const char* DialogueCountingResource::getPhaseName(Phase _phase)
+{
+    switch(_phase)
+    {
+        case Phase::Parse: return "parse";
+        case Phase::Link: return "link";
+        case Phase::Run: return "run";
+        default: return "other";
+    }
+}
+
+void* DialogueCountingResource::do_allocate(size_t _bytes, size_t _alignment)
+{
+    void* pointer = m_upstream->allocate(_bytes, _alignment);
+    auto& stats = m_stats[static_cast<size_t>(m_phase)];
+    ++stats.allocations;
+    stats.bytesAllocated += _bytes;
+    m_bytesInUse += _bytes;
+    if(m_bytesInUse > m_peakBytesInUse)
+    {
+        m_peakBytesInUse = m_bytesInUse;
+    }
+    return pointer;
+}
+
+void DialogueCountingResource::do_deallocate(void* _pointer, size_t _bytes, size_t _alignment)
+{
+    m_upstream->deallocate(_pointer, _bytes, _alignment);
+    auto& stats = m_stats[static_cast<size_t>(m_phase)];
+    ++stats.deallocations;
+    stats.bytesDeallocated += _bytes;
+    m_bytesInUse -= _bytes;
+}
+
+bool DialogueCountingResource::do_is_equal(const std::pmr::memory_resource& _other) const noexcept
+{
+    return this == &_other;
+}
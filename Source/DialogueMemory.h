@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory_resource>
+
+/*! Memory resource that counts allocations per phase and forwards them to another resource.
+ Give it to DialogueController to see what parsing, linking and running dialogue allocate. The controller switches phases itself */
+class DialogueCountingResource : public std::pmr::memory_resource
+{
+public:
+    enum class Phase
+    {
+        Other,
+        Parse, //parsing node bodies. Stays at zero until DialogueLineParser allocates from the resource, see DialogueController
+        Link,  //adding parsed nodes to the controller, including nodes paged in from an archive
+        Run,   //starting, progressing and restoring dialogue
+        Count
+    };
+
+    struct Stats
+    {
+        uint64_t allocations = 0;
+        uint64_t deallocations = 0;
+        uint64_t bytesAllocated = 0;
+        uint64_t bytesDeallocated = 0;
+    };
+
+    /*! Switch phase for the lifetime of the scope. Does nothing if the resource is nullptr, so callers needn't check */
+    class ScopedPhase
+    {
+    public:
+        ScopedPhase(DialogueCountingResource* _resource, Phase _phase);
+        ~ScopedPhase();
+
+        ScopedPhase(const ScopedPhase&) = delete;
+        ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    protected:
+        DialogueCountingResource* m_resource;
+        Phase m_previousPhase;
+    };
+
+public:
+    /*! @param _upstream resource allocations are forwarded to, the default resource if nullptr */
+    DialogueCountingResource(std::pmr::memory_resource* _upstream = nullptr);
+
+    std::pmr::memory_resource* getUpstream() const;
+
+    void setPhase(Phase _phase);
+    Phase getPhase() const;
+
+    const Stats& getStats(Phase _phase) const;
+    size_t getBytesInUse() const;
+    size_t getPeakBytesInUse() const;
+
+    /*! Reset all counters, bytes in use are kept */
+    void resetStats();
+
+    static const char* getPhaseName(Phase _phase);
+
+protected:
+    std::pmr::memory_resource* m_upstream;
+    Phase m_phase;
+    Stats m_stats[static_cast<size_t>(Phase::Count)];
+    size_t m_bytesInUse;
+    size_t m_peakBytesInUse;
+
+    void* do_allocate(size_t _bytes, size_t _alignment) override;
+    void do_deallocate(void* _pointer, size_t _bytes, size_t _alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& _other) const noexcept override;
+};
@@ -0,0 +1,450 @@
+#include "DialogueMetrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+namespace
+{
+    const DialogueMetrics::Counters k_noCounters;
+    const uint32_t k_minLineRange = 4;
+
+    bool hasActivity(const DialogueMetrics::Counters& _counters)
+    {
+        return _counters.visits > 0 || _counters.presentations > 0 || _counters.conditionEvaluations > 0
+            || _counters.actionsDispatched > 0 || _counters.resolverCalls > 0 || _counters.delegateCalls > 0;
+    }
+
+    std::string getName(const std::vector<std::string>* _nodeNames, DialogueNode::Id _nodeId)
+    {
+        if(_nodeNames && _nodeId < _nodeNames->size())
+        {
+            return (*_nodeNames)[_nodeId];
+        }
+        return std::to_string(_nodeId);
+    }
+
+    void appendJsonString(std::string& out_text, const std::string& _string)
+    {
+        out_text += '"';
+        for(const char c : _string)
+        {
+            if(c == '"' || c == '\\')
+            {
+                out_text += '\\';
+                out_text += c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                out_text += escaped;
+            }
+            else
+            {
+                out_text += c;
+            }
+        }
+        out_text += '"';
+    }
+
+    void appendCsvString(std::string& out_text, const std::string& _string)
+    {
+        if(_string.find_first_of(",\"\n\r") == std::string::npos)
+        {
+            out_text += _string;
+            return;
+        }
+        out_text += '"';
+        for(const char c : _string)
+        {
+            if(c == '"') out_text += '"';
+            out_text += c;
+        }
+        out_text += '"';
+    }
+
+    void appendJsonCounters(std::string& out_text, const DialogueMetrics::Counters& _counters)
+    {
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer),
+                 "\"visits\":%" PRIu64 ",\"presentations\":%" PRIu64 ",\"conditionEvaluations\":%" PRIu64 ",\"conditionFailures\":%" PRIu64
+                 ",\"actionsDispatched\":%" PRIu64 ",\"resolverCalls\":%" PRIu64 ",\"resolverNanoseconds\":%" PRIu64
+                 ",\"delegateCalls\":%" PRIu64 ",\"delegateNanoseconds\":%" PRIu64,
+                 _counters.visits, _counters.presentations, _counters.conditionEvaluations, _counters.conditionFailures,
+                 _counters.actionsDispatched, _counters.resolverCalls, _counters.resolverNanoseconds,
+                 _counters.delegateCalls, _counters.delegateNanoseconds);
+        out_text += buffer;
+    }
+
+    void appendCsvCounters(std::string& out_text, const DialogueMetrics::Counters& _counters)
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer),
+                 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                 _counters.visits, _counters.presentations, _counters.conditionEvaluations, _counters.conditionFailures,
+                 _counters.actionsDispatched, _counters.resolverCalls, _counters.resolverNanoseconds,
+                 _counters.delegateCalls, _counters.delegateNanoseconds);
+        out_text += buffer;
+    }
+}
+
+void DialogueMetrics::Counters::add(const Counters& _other)
+{
+    visits += _other.visits;
+    presentations += _other.presentations;
+    conditionEvaluations += _other.conditionEvaluations;
+    conditionFailures += _other.conditionFailures;
+    actionsDispatched += _other.actionsDispatched;
+    resolverCalls += _other.resolverCalls;
+    resolverNanoseconds += _other.resolverNanoseconds;
+    delegateCalls += _other.delegateCalls;
+    delegateNanoseconds += _other.delegateNanoseconds;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//TimedResolver
+//-------------------------------------------------------------------------------------------------------------------
+DialogueMetrics::TimedResolver::TimedResolver()
+: m_resolver(nullptr)
+, m_metrics(nullptr)
+{
+
+}
+
+void DialogueMetrics::TimedResolver::set(const IDialogueResolver* _resolver, DialogueMetrics* _metrics)
+{
+    m_resolver = _resolver;
+    m_metrics = _metrics;
+}
+
+bool DialogueMetrics::TimedResolver::resolveVariable(const std::string& _varName, std::string& out_value) const
+{
+    const auto start = getTime();
+    const bool result = m_resolver->resolveVariable(_varName, out_value);
+    m_metrics->recordResolverCall(getTime() - start);
+    return result;
+}
+
+bool DialogueMetrics::TimedResolver::resolveAction(const std::string& _name, const std::vector<std::string>& _params) const
+{
+    const auto start = getTime();
+    const bool result = m_resolver->resolveAction(_name, _params);
+    m_metrics->recordResolverCall(getTime() - start);
+    return result;
+}
+
+bool DialogueMetrics::TimedResolver::getVariableVersion(const std::string& _varName, uint64_t& out_version) const
+{
+    const auto start = getTime();
+    const bool result = m_resolver->getVariableVersion(_varName, out_version);
+    m_metrics->recordResolverCall(getTime() - start);
+    return result;
+}
+
+uint64_t DialogueMetrics::TimedResolver::getVariablesVersion() const
+{
+    const auto start = getTime();
+    const auto version = m_resolver->getVariablesVersion();
+    m_metrics->recordResolverCall(getTime() - start);
+    return version;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//ScopedDelegateTimer
+//-------------------------------------------------------------------------------------------------------------------
+DialogueMetrics::ScopedDelegateTimer::ScopedDelegateTimer(DialogueMetrics* _metrics)
+: m_metrics(_metrics)
+, m_parent(_metrics ? _metrics->m_delegateTimer : nullptr)
+, m_nodeId(_metrics ? _metrics->m_contextNode : DialogueNode::k_invalidId)
+, m_lineIndex(_metrics ? _metrics->m_contextLine : 0)
+, m_start(_metrics ? getTime() : 0)
+, m_nestedNanoseconds(0)
+{
+    if(m_metrics)
+    {
+        m_metrics->m_delegateTimer = this;
+    }
+}
+
+DialogueMetrics::ScopedDelegateTimer::~ScopedDelegateTimer()
+{
+    if(m_metrics)
+    {
+        const auto nanoseconds = getTime() - m_start;
+        m_metrics->m_delegateTimer = m_parent;
+        if(m_parent)
+        {
+            m_parent->m_nestedNanoseconds += nanoseconds;
+        }
+        m_metrics->recordDelegateCall(m_nodeId, m_lineIndex, nanoseconds - std::min(m_nestedNanoseconds, nanoseconds));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//DialogueMetrics
+//-------------------------------------------------------------------------------------------------------------------
+DialogueMetrics::DialogueMetrics()
+: m_contextNode(DialogueNode::k_invalidId)
+, m_contextLine(0)
+, m_delegateTimer(nullptr)
+{
+
+}
+
+DialogueMetrics::DialogueMetrics(const DialogueMetrics& _other)
+: m_nodes(_other.m_nodes)
+, m_lineRanges(_other.m_lineRanges)
+, m_lines(_other.m_lines)
+, m_unattributed(_other.m_unattributed)
+, m_contextNode(_other.m_contextNode)
+, m_contextLine(_other.m_contextLine)
+, m_delegateTimer(nullptr)
+{
+
+}
+
+DialogueMetrics& DialogueMetrics::operator=(const DialogueMetrics& _other)
+{
+    m_nodes = _other.m_nodes;
+    m_lineRanges = _other.m_lineRanges;
+    m_lines = _other.m_lines;
+    m_unattributed = _other.m_unattributed;
+    m_contextNode = _other.m_contextNode;
+    m_contextLine = _other.m_contextLine;
+    return *this;
+}
+
+void DialogueMetrics::setContext(DialogueNode::Id _nodeId, size_t _lineIndex)
+{
+    m_contextNode = _nodeId;
+    m_contextLine = _lineIndex;
+}
+
+void DialogueMetrics::recordVisit(DialogueNode::Id _nodeId)
+{
+    ++getNodeCounters(_nodeId).visits;
+}
+
+void DialogueMetrics::recordPresentation()
+{
+    ++getContextNode().presentations;
+    if(auto line = getContextLine())
+    {
+        ++line->presentations;
+    }
+}
+
+void DialogueMetrics::recordCondition(bool _result)
+{
+    auto& node = getContextNode();
+    ++node.conditionEvaluations;
+    node.conditionFailures += _result ? 0 : 1;
+    if(auto line = getContextLine())
+    {
+        ++line->conditionEvaluations;
+        line->conditionFailures += _result ? 0 : 1;
+    }
+}
+
+void DialogueMetrics::recordAction()
+{
+    ++getContextNode().actionsDispatched;
+    if(auto line = getContextLine())
+    {
+        ++line->actionsDispatched;
+    }
+}
+
+void DialogueMetrics::recordResolverCall(uint64_t _nanoseconds)
+{
+    if(m_delegateTimer)
+    {
+        m_delegateTimer->m_nestedNanoseconds += _nanoseconds;
+    }
+    auto& node = getContextNode();
+    ++node.resolverCalls;
+    node.resolverNanoseconds += _nanoseconds;
+    if(auto line = getContextLine())
+    {
+        ++line->resolverCalls;
+        line->resolverNanoseconds += _nanoseconds;
+    }
+}
+
+void DialogueMetrics::recordDelegateCall(DialogueNode::Id _nodeId, size_t _lineIndex, uint64_t _nanoseconds)
+{
+    auto& node = getNodeCounters(_nodeId);
+    ++node.delegateCalls;
+    node.delegateNanoseconds += _nanoseconds;
+    if(auto line = getLineCounters(_nodeId, _lineIndex))
+    {
+        ++line->delegateCalls;
+        line->delegateNanoseconds += _nanoseconds;
+    }
+}
+
+uint64_t DialogueMetrics::getTime()
+{
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+}
+
+size_t DialogueMetrics::getNodeCount() const
+{
+    return m_nodes.size();
+}
+
+const DialogueMetrics::Counters& DialogueMetrics::getNode(DialogueNode::Id _nodeId) const
+{
+    return _nodeId < m_nodes.size() ? m_nodes[_nodeId] : k_noCounters;
+}
+
+size_t DialogueMetrics::getLineCount(DialogueNode::Id _nodeId) const
+{
+    return _nodeId < m_lineRanges.size() ? m_lineRanges[_nodeId].count : 0;
+}
+
+const DialogueMetrics::Counters& DialogueMetrics::getLine(DialogueNode::Id _nodeId, size_t _lineIndex) const
+{
+    if(_lineIndex >= getLineCount(_nodeId))
+    {
+        return k_noCounters;
+    }
+    return m_lines[m_lineRanges[_nodeId].begin + _lineIndex];
+}
+
+DialogueMetrics::Counters DialogueMetrics::getTotals() const
+{
+    Counters totals = m_unattributed;
+    for(const auto& node : m_nodes)
+    {
+        totals.add(node);
+    }
+    return totals;
+}
+
+void DialogueMetrics::reset()
+{
+    m_nodes.clear();
+    m_lineRanges.clear();
+    m_lines.clear();
+    m_unattributed = Counters();
+}
+
+void DialogueMetrics::writeJson(std::string& out_text, const std::vector<std::string>* _nodeNames) const
+{
+    out_text += "{\"totals\":{";
+    appendJsonCounters(out_text, getTotals());
+    out_text += "},\n\"nodes\":[";
+    bool isFirstNode = true;
+    for(DialogueNode::Id id = 0; id < m_nodes.size(); ++id)
+    {
+        if(hasActivity(m_nodes[id]) == false)
+        {
+            continue;
+        }
+        out_text += isFirstNode ? "\n" : ",\n";
+        isFirstNode = false;
+        out_text += "{\"id\":" + std::to_string(id) + ",\"name\":";
+        appendJsonString(out_text, getName(_nodeNames, id));
+        out_text += ',';
+        appendJsonCounters(out_text, m_nodes[id]);
+        out_text += ",\"lines\":[";
+        bool isFirstLine = true;
+        for(size_t lineIndex = 0; lineIndex < getLineCount(id); ++lineIndex)
+        {
+            const auto& line = getLine(id, lineIndex);
+            if(hasActivity(line) == false)
+            {
+                continue;
+            }
+            out_text += isFirstLine ? "{\"line\":" : ",{\"line\":";
+            isFirstLine = false;
+            out_text += std::to_string(lineIndex) + ',';
+            appendJsonCounters(out_text, line);
+            out_text += '}';
+        }
+        out_text += "]}";
+    }
+    out_text += "\n]}\n";
+}
+
+void DialogueMetrics::writeCsv(std::string& out_text, const std::vector<std::string>* _nodeNames) const
+{
+    out_text += "id,name,line,visits,presentations,conditionEvaluations,conditionFailures,actionsDispatched,"
+                "resolverCalls,resolverNanoseconds,delegateCalls,delegateNanoseconds\n";
+    for(DialogueNode::Id id = 0; id < m_nodes.size(); ++id)
+    {
+        if(hasActivity(m_nodes[id]) == false)
+        {
+            continue;
+        }
+        const auto name = getName(_nodeNames, id);
+        out_text += std::to_string(id) + ',';
+        appendCsvString(out_text, name);
+        out_text += ',';
+        appendCsvCounters(out_text, m_nodes[id]);
+        for(size_t lineIndex = 0; lineIndex < getLineCount(id); ++lineIndex)
+        {
+            const auto& line = getLine(id, lineIndex);
+            if(hasActivity(line))
+            {
+                out_text += std::to_string(id) + ',';
+                appendCsvString(out_text, name);
+                out_text += ',' + std::to_string(lineIndex);
+                appendCsvCounters(out_text, line);
+            }
+        }
+    }
+}
+
+//----
+//Internal Helpers
+DialogueMetrics::Counters& DialogueMetrics::getNodeCounters(DialogueNode::Id _nodeId)
+{
+    if(_nodeId == DialogueNode::k_invalidId)
+    {
+        return m_unattributed;
+    }
+    if(_nodeId >= m_nodes.size())
+    {
+        m_nodes.resize(_nodeId + 1);
+    }
+    return m_nodes[_nodeId];
+}
+
+DialogueMetrics::Counters* DialogueMetrics::getLineCounters(DialogueNode::Id _nodeId, size_t _lineIndex)
+{
+    if(_nodeId == DialogueNode::k_invalidId)
+    {
+        return nullptr;
+    }
+    if(_nodeId >= m_lineRanges.size())
+    {
+        m_lineRanges.resize(_nodeId + 1, { 0, 0 });
+    }
+
+    //move the node's lines to the end of the array when they outgrow their range
+    auto& range = m_lineRanges[_nodeId];
+    if(_lineIndex >= range.count)
+    {
+        const auto count = std::max<uint32_t>({ static_cast<uint32_t>(_lineIndex + 1), range.count * 2, k_minLineRange });
+        const auto begin = static_cast<uint32_t>(m_lines.size());
+        m_lines.resize(m_lines.size() + count);
+        std::copy(m_lines.begin() + range.begin, m_lines.begin() + range.begin + range.count, m_lines.begin() + begin);
+        range = { begin, count };
+    }
+    return &m_lines[range.begin + _lineIndex];
+}
+
+DialogueMetrics::Counters* DialogueMetrics::getContextLine()
+{
+    return getLineCounters(m_contextNode, m_contextLine);
+}
+
+DialogueMetrics::Counters& DialogueMetrics::getContextNode()
+{
+    return getNodeCounters(m_contextNode);
+}
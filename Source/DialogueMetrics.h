@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "DialogueNode.h"
+#include "IDialogueResolver.h"
+
+/* DialogueController only records metrics when built with DIALOGUE_METRICS=1, otherwise its hooks compile to nothing */
+#ifndef DIALOGUE_METRICS
+    #define DIALOGUE_METRICS 0
+#endif
+
+/*! Runtime counters per node and per line, held in flat arrays indexed by node id.
+ Set on a DialogueController with setMetrics. Conditions, actions and callback time are attributed to the line being processed.
+ Copy the object to take a snapshot */
+class DialogueMetrics
+{
+public:
+    struct Counters
+    {
+        uint64_t visits = 0; //times the node was entered, always 0 for lines
+        uint64_t presentations = 0;
+        uint64_t conditionEvaluations = 0;
+        uint64_t conditionFailures = 0;
+        uint64_t actionsDispatched = 0;
+        uint64_t resolverCalls = 0;
+        uint64_t resolverNanoseconds = 0;
+        uint64_t delegateCalls = 0;
+        uint64_t delegateNanoseconds = 0;
+
+        void add(const Counters& _other);
+    };
+
+    /*! Forwards to another resolver, timing each call */
+    class TimedResolver : public IDialogueResolver
+    {
+    public:
+        TimedResolver();
+
+        void set(const IDialogueResolver* _resolver, DialogueMetrics* _metrics);
+
+        bool resolveVariable(const std::string& _varName, std::string& out_value) const override;
+        bool resolveAction(const std::string& _name, const std::vector<std::string>& _params) const override;
+        bool getVariableVersion(const std::string& _varName, uint64_t& out_version) const override;
+        uint64_t getVariablesVersion() const override;
+
+    protected:
+        const IDialogueResolver* m_resolver;
+        DialogueMetrics* m_metrics;
+    };
+
+    /*! Time a delegate callback for the lifetime of the scope, charged to the line current when the scope starts.
+     Time spent in nested delegate callbacks and resolver calls is charged to those instead, so nothing is counted twice.
+     Does nothing if the metrics are nullptr */
+    class ScopedDelegateTimer
+    {
+    public:
+        ScopedDelegateTimer(DialogueMetrics* _metrics);
+        ~ScopedDelegateTimer();
+
+        ScopedDelegateTimer(const ScopedDelegateTimer&) = delete;
+        ScopedDelegateTimer& operator=(const ScopedDelegateTimer&) = delete;
+
+    protected:
+        friend class DialogueMetrics; //adds resolver time to m_nestedNanoseconds
+
+        DialogueMetrics* m_metrics;
+        ScopedDelegateTimer* m_parent; //enclosing timer, if the callback is nested
+        DialogueNode::Id m_nodeId;
+        size_t m_lineIndex;
+        uint64_t m_start;
+        uint64_t m_nestedNanoseconds; //spent in nested timers and resolver calls
+    };
+
+public:
+    DialogueMetrics();
+
+    /*! Copies the counters, running delegate timers stay with the original */
+    DialogueMetrics(const DialogueMetrics& _other);
+    DialogueMetrics& operator=(const DialogueMetrics& _other);
+
+    //-------------------------------------------
+    //Recording, called by DialogueController
+
+    /*! Attribute following events to a line */
+    void setContext(DialogueNode::Id _nodeId, size_t _lineIndex);
+    void recordVisit(DialogueNode::Id _nodeId);
+    void recordPresentation();
+    void recordCondition(bool _result);
+    void recordAction();
+    void recordResolverCall(uint64_t _nanoseconds);
+    void recordDelegateCall(DialogueNode::Id _nodeId, size_t _lineIndex, uint64_t _nanoseconds);
+
+    static uint64_t getTime();
+
+    //-------------------------------------------
+    //Queries
+
+    /*! @return one past the highest node id with counters */
+    size_t getNodeCount() const;
+
+    /*! @return the node's counters, including all of its lines. Zero if nothing was recorded */
+    const Counters& getNode(DialogueNode::Id _nodeId) const;
+
+    /*! @return the number of line slots held for the node, slots for lines without activity are zero */
+    size_t getLineCount(DialogueNode::Id _nodeId) const;
+    const Counters& getLine(DialogueNode::Id _nodeId, size_t _lineIndex) const;
+
+    /*! @return the sum of all nodes, plus anything recorded outside of a node */
+    Counters getTotals() const;
+
+    void reset();
+
+    //-------------------------------------------
+    //Export
+
+    /*! Append the counters of every node and line with activity as JSON
+     @param _nodeNames names indexed by node id, see DialogueController::getNodeNames. Ids are used if nullptr or missing */
+    void writeJson(std::string& out_text, const std::vector<std::string>* _nodeNames = nullptr) const;
+
+    /*! Append the counters as CSV, one row per node followed by a row per line with activity */
+    void writeCsv(std::string& out_text, const std::vector<std::string>* _nodeNames = nullptr) const;
+
+protected:
+    struct LineRange
+    {
+        uint32_t begin;
+        uint32_t count;
+    };
+
+    std::vector<Counters> m_nodes; //indexed by node id
+    std::vector<LineRange> m_lineRanges; //indexed by node id, into m_lines
+    std::vector<Counters> m_lines;
+    Counters m_unattributed; //recorded before any line was processed
+    DialogueNode::Id m_contextNode;
+    size_t m_contextLine;
+    ScopedDelegateTimer* m_delegateTimer; //innermost running timer, nullptr outside of delegate callbacks
+
+    Counters& getNodeCounters(DialogueNode::Id _nodeId);
+    Counters* getLineCounters(DialogueNode::Id _nodeId, size_t _lineIndex);
+    Counters* getContextLine();
+    Counters& getContextNode();
+};
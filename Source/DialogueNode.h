@@ -2,13 +2,85 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+
+#include "DialogueValue.h"
 
 struct DialogueNode
 {
+    /*! Dense id assigned by DialogueController when a node name is first seen.
+     Ids are never reused for a different name, so they remain valid across removeNode/clearNodes */
+    typedef unsigned Id;
+    static constexpr Id k_invalidId = ~0u;
+
+    /*! Index into Line::variants, k_noVariant for lines that aren't a % group */
+    static constexpr unsigned k_noVariant = ~0u;
+
+    /*! Actor keys are interned by DialogueController, lines without an actor have k_invalidId */
+    typedef unsigned ActorId;
+
+    /*! Inline markup parsed out of line and option text, e.g. [b]bold[/b], [color=red]red[/color] or a [pause=500/] marker */
+    struct Markup
+    {
+        std::string name;
+        std::string value; //empty if the tag had no =value
+        uint32_t start; //byte offset into the text
+        uint32_t length; //0 for markers
+    };
+
+    struct Condition
+    {
+        enum class Operator
+        {
+            Equals,
+            NotEquals,
+            GreaterThan,
+            LessThan,
+            GreaterThanOrEqualTo,
+            LessThanOrEqualTo,
+            None
+        };
+
+        struct Operand
+        {
+            enum class Type
+            {
+                Text,    //literal text, may contain $(variables)
+                Visited, //visited("Node")
+                Visits   //visits("Node")
+            };
+            Type type = Type::Text;
+            std::string value; //the text, or the node name for visit queries
+            Id nodeId = k_invalidId; //resolved by DialogueController when the node is added
+        };
+
+        std::string source;
+        Operand lvalue;
+        Operand rvalue;
+        Operator op = Operator::None;
+        std::vector<std::string> variables; //names of all $(variables) read by the operands
+        unsigned cacheIndex = ~0u; //slot in DialogueController's result cache, assigned when linked
+    };
+
     struct Action
     {
+        enum class Binding : unsigned char
+        {
+            Unlinked,
+            Stop,     //built in stop/end/fin/exit
+            Handler,  //handler in a DialogueActionRegistry
+            Resolver  //passed to IDialogueResolver::resolveAction
+        };
+
         std::string name;
         std::vector<std::string> params;
+
+        //resolved by DialogueController when the node is added
+        Binding binding = Binding::Unlinked;
+        unsigned handlerId = ~0u;
+        std::vector<std::string> handlerParams; //params as passed to the handler, a <<name arguments>> form's arguments first
+        std::vector<DialogueValue> args; //handlerParams converted to the handler's parameter types
+        std::vector<unsigned> dynamicParams; //indices of params, or handlerParams if bound to a handler, containing $(variables), resolved when run
     };
 
     struct Option
@@ -16,21 +88,32 @@ struct DialogueNode
         std::string content;
         std::string gotoNode;
         bool isShortcut;
-        std::vector<std::string> conditions;
+        std::vector<Condition> conditions;
         std::vector<Action> actions;
+        uint64_t lineId = 0; //stable id used to look up localized text, see Line::lineId
+        std::vector<Markup> markup; //spans over content
     };
 
     struct Line
     {
-        std::string actorKey;
+        std::string actorKey; //as parsed, moved to the actor table when the node is added to a DialogueController, see getActorKey
+        ActorId actorId = k_invalidId; //set when added to a DialogueController, k_invalidId if the line has no actor
         std::string content;
-        std::vector<std::string> conditions;
+        uint64_t lineId = 0; //stable id used to look up localized text and voice over, from a #line:id tag or a hash of the node name and text
+        std::vector<Markup> markup; //spans over content, sorted by start then outermost first
+        std::vector<Condition> conditions;
         std::vector<Option> options;
         std::vector<Action> actions;
         std::string gotoNode;
+        float weight = 1; //relative chance of being picked as a % variant, e.g. "%(3) Actor: text"
+        std::vector<Line> variants; //every alternative of a % group, picked between when presented. A group line has nothing else set
     };
 
+    Id id = k_invalidId;
     std::string name;
+    std::string parent; //name of the node whose body generated this node (Name:N), empty for top level nodes
     std::string tags;
+    std::vector<unsigned> tagIds; //sorted interned tags, filled when added to a DialogueController
     std::vector<Line> lines;
+    std::vector<ActorId> actorIds; //sorted unique actors of all lines, filled when added to a DialogueController
 };
@@ -0,0 +1,249 @@
+#include "DialogueNodeArchive.h"
+
+#include "DialogueBinaryIO.h"
+#include "DialogueMacros.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    const char k_magic[4] = { 'Y', 'K', 'N', 'A' };
+    const uint32_t k_version = 2;
+    const size_t k_headerSize = 24;
+}
+
+DialogueNodeArchive::DialogueNodeArchive()
+: m_data(nullptr)
+, m_size(0)
+{
+
+}
+
+void DialogueNodeArchive::build(const std::vector<DialogueNode>& _nodes, std::vector<uint8_t>& out_data)
+{
+    out_data.clear();
+    DialogueBinaryWriter writer(out_data);
+    writer.writeBytes(k_magic, sizeof(k_magic));
+    writer.writeUInt32(k_version);
+    writer.writeUInt32(static_cast<uint32_t>(_nodes.size()));
+    writer.writeUInt32(0);
+    writer.writeUInt64(0); //index offset, patched below
+
+    std::vector<std::pair<uint64_t, uint32_t>> records;
+    records.reserve(_nodes.size());
+    for(const auto& node : _nodes)
+    {
+        const auto offset = writer.getSize();
+        writeNode(writer, node);
+        records.push_back(std::make_pair(offset, static_cast<uint32_t>(writer.getSize() - offset)));
+    }
+
+    const uint64_t indexOffset = writer.getSize();
+    for(size_t i = 0; i < _nodes.size(); ++i)
+    {
+        writer.writeString(_nodes[i].name);
+        writer.writeString(_nodes[i].parent);
+        writer.writeString(_nodes[i].tags);
+        writer.writeVarUInt(records[i].first);
+        writer.writeVarUInt(records[i].second);
+    }
+
+    for(unsigned i = 0; i < 8; ++i)
+    {
+        out_data[16 + i] = static_cast<uint8_t>(indexOffset >> (i * 8));
+    }
+}
+
+void DialogueNodeArchive::writeNode(DialogueBinaryWriter& _writer, const DialogueNode& _node)
+{
+    DialogueCompactScript script;
+    script.add(_node);
+    script.write(_writer);
+}
+
+bool DialogueNodeArchive::readNode(DialogueBinaryReader& _reader, DialogueNode& out_node)
+{
+    DialogueCompactScript script;
+    return readNode(_reader, script, out_node);
+}
+
+bool DialogueNodeArchive::readNode(DialogueBinaryReader& _reader, DialogueCompactScript& _script, DialogueNode& out_node)
+{
+    return _script.read(_reader) && _script.getNodeCount() == 1 && _script.expand(0, out_node);
+}
+
+bool DialogueNodeArchive::openFile(const std::string& _path)
+{
+    close();
+
+    m_file.open(_path, std::ios::binary);
+    uint8_t header[k_headerSize];
+    if(m_file.read(reinterpret_cast<char*>(header), k_headerSize).fail())
+    {
+        LOGERROR("Failed to open node archive '%s'", _path.c_str());
+        close();
+        return false;
+    }
+
+    DialogueBinaryReader reader(header, k_headerSize);
+    char magic[4];
+    uint32_t version = 0, count = 0, reserved = 0;
+    uint64_t indexOffset = 0;
+    reader.readBytes(magic, sizeof(magic));
+    reader.readUInt32(version);
+    reader.readUInt32(count);
+    reader.readUInt32(reserved);
+    reader.readUInt64(indexOffset);
+
+    m_file.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(m_file.tellg());
+    if(memcmp(magic, k_magic, sizeof(magic)) != 0 || version != k_version || indexOffset < k_headerSize || indexOffset > fileSize)
+    {
+        LOGERROR("Failed to open node archive '%s': Invalid header", _path.c_str());
+        close();
+        return false;
+    }
+
+    std::vector<uint8_t> index(static_cast<size_t>(fileSize - indexOffset));
+    m_file.seekg(static_cast<std::streamoff>(indexOffset));
+    if(m_file.read(reinterpret_cast<char*>(index.data()), static_cast<std::streamsize>(index.size())).fail()
+       || readIndex(index.data(), index.size(), count, indexOffset) == false)
+    {
+        LOGERROR("Failed to open node archive '%s': Invalid index", _path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool DialogueNodeArchive::openMemory(const uint8_t* _data, size_t _size)
+{
+    close();
+
+    if(_data == nullptr || _size < k_headerSize)
+    {
+        return false;
+    }
+
+    DialogueBinaryReader reader(_data, k_headerSize);
+    char magic[4];
+    uint32_t version = 0, count = 0, reserved = 0;
+    uint64_t indexOffset = 0;
+    reader.readBytes(magic, sizeof(magic));
+    reader.readUInt32(version);
+    reader.readUInt32(count);
+    reader.readUInt32(reserved);
+    reader.readUInt64(indexOffset);
+    if(memcmp(magic, k_magic, sizeof(magic)) != 0 || version != k_version || indexOffset < k_headerSize || indexOffset > _size
+       || readIndex(_data + indexOffset, static_cast<size_t>(_size - indexOffset), count, indexOffset) == false)
+    {
+        return false;
+    }
+
+    m_data = _data;
+    m_size = _size;
+    return true;
+}
+
+void DialogueNodeArchive::close()
+{
+    if(m_file.is_open())
+    {
+        m_file.close();
+    }
+    m_file.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_entries.clear();
+    std::vector<uint8_t>().swap(m_buffer);
+    m_record.clear();
+    m_record.shrinkToFit();
+}
+
+bool DialogueNodeArchive::isOpen() const
+{
+    return m_data != nullptr || m_file.is_open();
+}
+
+size_t DialogueNodeArchive::getNodeCount() const
+{
+    return m_entries.size();
+}
+
+const DialogueNodeArchive::Entry& DialogueNodeArchive::getEntry(size_t _index) const
+{
+    return m_entries[_index];
+}
+
+bool DialogueNodeArchive::loadNode(size_t _index, DialogueNode& out_node)
+{
+    if(_index >= m_entries.size())
+    {
+        return false;
+    }
+
+    const auto& entry = m_entries[_index];
+    const uint8_t* record = nullptr;
+    if(m_data)
+    {
+        record = m_data + entry.offset;
+    }
+    else if(m_file.is_open())
+    {
+        m_buffer.resize(entry.size);
+        m_file.clear();
+        m_file.seekg(static_cast<std::streamoff>(entry.offset));
+        if(m_file.read(reinterpret_cast<char*>(m_buffer.data()), entry.size).fail())
+        {
+            LOGERROR("Failed to read node '%s' from archive", entry.name.c_str());
+            return false;
+        }
+        record = m_buffer.data();
+    }
+    else
+    {
+        return false;
+    }
+
+    DialogueBinaryReader reader(record, entry.size);
+    if(readNode(reader, m_record, out_node) == false || reader.isAtEnd() == false || out_node.name != entry.name)
+    {
+        LOGERROR("Failed to read node '%s' from archive: Invalid record", entry.name.c_str());
+        return false;
+    }
+    return true;
+}
+
+//----
+//Internal Helpers
+bool DialogueNodeArchive::readIndex(const uint8_t* _index, size_t _indexSize, uint32_t _count, uint64_t _indexOffset)
+{
+    DialogueBinaryReader reader(_index, _indexSize);
+    if(_count > _indexSize)
+    {
+        return false;
+    }
+
+    m_entries.resize(_count);
+    for(auto& entry : m_entries)
+    {
+        uint64_t offset = 0, size = 0;
+        if(reader.readString(entry.name) == false || reader.readString(entry.parent) == false
+           || reader.readString(entry.tags) == false || reader.readVarUInt(offset) == false || reader.readVarUInt(size) == false
+           || offset < k_headerSize || size > UINT32_MAX || size > _indexOffset || offset > _indexOffset - size)
+        {
+            m_entries.clear();
+            return false;
+        }
+        entry.offset = offset;
+        entry.size = static_cast<uint32_t>(size);
+    }
+
+    if(reader.isAtEnd() == false)
+    {
+        m_entries.clear();
+        return false;
+    }
+    return true;
+}
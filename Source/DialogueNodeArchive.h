@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "DialogueCompactScript.h"
+#include "DialogueNode.h"
+
+class DialogueBinaryWriter;
+class DialogueBinaryReader;
+
+/*! Indexed file of parsed nodes. Only the index is read when opened, nodes are read and decoded one at a time,
+ so DialogueController can page them in on demand (see DialogueController::setNodeArchive).
+
+ Layout, little endian:
+   "YKNA" u32 version u32 count u32 reserved u64 indexOffset
+   node records, each a DialogueCompactScript holding one node, written by writeNode
+   index at indexOffset: count x { string name, string parent, string tags, varuint offset, varuint size } */
+class DialogueNodeArchive
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        std::string parent;
+        std::string tags;
+        uint64_t offset; //from the start of the archive
+        uint32_t size;
+    };
+
+public:
+    DialogueNodeArchive();
+
+    DialogueNodeArchive(const DialogueNodeArchive&) = delete;
+    DialogueNodeArchive& operator=(const DialogueNodeArchive&) = delete;
+
+    /*! Build an archive from parsed nodes, e.g. in an export tool
+     @param out_data receives the archive, write it to a file to open with openFile */
+    static void build(const std::vector<DialogueNode>& _nodes, std::vector<uint8_t>& out_data);
+
+    /*! Encode a node as a DialogueCompactScript, without its link time data (ids, actor ids, condition cache slots, action bindings) */
+    static void writeNode(DialogueBinaryWriter& _writer, const DialogueNode& _node);
+
+    /*! Decode a node written by writeNode, recompiling its conditions. The result is unlinked, as if just parsed
+     @return false if the data is malformed */
+    static bool readNode(DialogueBinaryReader& _reader, DialogueNode& out_node);
+
+    /*! Open an archive file and read its index, closing any open archive. The file stays open to read nodes from
+     @return false if the file couldn't be read or isn't a valid archive */
+    bool openFile(const std::string& _path);
+
+    /*! Use an archive already in memory. The data must outlive the archive
+     @return false if the data isn't a valid archive */
+    bool openMemory(const uint8_t* _data, size_t _size);
+
+    void close();
+    bool isOpen() const;
+
+    size_t getNodeCount() const;
+    const Entry& getEntry(size_t _index) const;
+
+    /*! Read and decode a node
+     @return false if the index is invalid or the record couldn't be read */
+    bool loadNode(size_t _index, DialogueNode& out_node);
+
+protected:
+    std::ifstream m_file;
+    const uint8_t* m_data; //set by openMemory
+    size_t m_size;
+    std::vector<Entry> m_entries;
+    std::vector<uint8_t> m_buffer; //record read from the file
+    DialogueCompactScript m_record; //record being decoded, kept to reuse its storage
+
+    static bool readNode(DialogueBinaryReader& _reader, DialogueCompactScript& _script, DialogueNode& out_node);
+    bool readIndex(const uint8_t* _index, size_t _indexSize, uint32_t _count, uint64_t _indexOffset);
+};
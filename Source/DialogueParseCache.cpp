@@ -0,0 +1,321 @@
+#include "DialogueParseCache.h"
+
+#include "DialogueBinaryIO.h"
+#include "DialogueHash.h"
+#include "DialogueLineParser.h"
+#include "DialogueMacros.h"
+#include "DialogueNodeArchive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char k_magic[4] = { 'Y', 'K', 'P', 'C' };
+    const uint32_t k_version = 2;
+    const size_t k_headerSize = 32;
+    const char* k_extension = ".ykpc";
+    const char* k_tempExtension = ".tmp";
+    const auto k_staleTempAge = std::chrono::hours(1); //temporary files this old were left by a process that didn't finish writing
+}
+
+double DialogueParseCache::Stats::getHitRate() const
+{
+    const auto lookups = hits + misses;
+    return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+}
+
+DialogueParseCache::DialogueParseCache()
+: m_maxBytes(0)
+, m_size(0)
+, m_tempCounter(0)
+{
+
+}
+
+bool DialogueParseCache::open(const std::string& _directory, uint64_t _maxBytes)
+{
+    close();
+
+    std::error_code error;
+    fs::create_directories(_directory, error);
+    if(fs::is_directory(_directory, error) == false)
+    {
+        LOGERROR("Failed to open parse cache '%s'", _directory.c_str());
+        return false;
+    }
+
+    m_directory = _directory;
+    m_maxBytes = _maxBytes;
+
+    //temporary names only need to be unique between processes sharing the directory
+    m_tempCounter = static_cast<uint64_t>(std::random_device()()) << 32;
+
+    trim();
+    return true;
+}
+
+void DialogueParseCache::close()
+{
+    m_directory.clear();
+    m_size = 0;
+}
+
+bool DialogueParseCache::isOpen() const
+{
+    return m_directory.empty() == false;
+}
+
+uint64_t DialogueParseCache::makeKey(const std::string& _name, const std::string& _tags, const std::string& _body, unsigned _seed, bool _isMarkupEnabled)
+{
+    const char separator = 0;
+    const uint32_t versions[2] = { k_version, DialogueLineParser::k_version };
+    const uint8_t isMarkupEnabled = _isMarkupEnabled ? 1 : 0;
+    auto hash = hashDialogueData(versions, sizeof(versions));
+    hash = hashDialogueData(&_seed, sizeof(_seed), hash);
+    hash = hashDialogueData(&isMarkupEnabled, sizeof(isMarkupEnabled), hash);
+    for(const auto string : { &_name, &_tags, &_body })
+    {
+        hash = hashDialogueString(*string, hash);
+        hash = hashDialogueData(&separator, 1, hash);
+    }
+    return hash;
+}
+
+bool DialogueParseCache::load(uint64_t _key, std::vector<DialogueNode>& out_nodes)
+{
+    out_nodes.clear();
+    if(isOpen() == false)
+    {
+        return false;
+    }
+
+    const auto path = getPath(_key);
+    std::error_code error;
+    const auto fileSize = fs::file_size(path, error);
+    std::ifstream file(path, std::ios::binary);
+    uint8_t header[k_headerSize];
+    if(error || file.read(reinterpret_cast<char*>(header), k_headerSize).fail())
+    {
+        ++m_stats.misses;
+        return false;
+    }
+
+    DialogueBinaryReader headerReader(header, k_headerSize);
+    char magic[4];
+    uint32_t version = 0, size = 0, reserved = 0;
+    uint64_t key = 0, hash = 0;
+    headerReader.readBytes(magic, sizeof(magic));
+    headerReader.readUInt32(version);
+    headerReader.readUInt64(key);
+    headerReader.readUInt32(size);
+    headerReader.readUInt32(reserved);
+    headerReader.readUInt64(hash);
+
+    bool isValid = memcmp(magic, k_magic, sizeof(magic)) == 0 && version == k_version && key == _key && size == fileSize - k_headerSize;
+    if(isValid)
+    {
+        m_buffer.resize(size);
+        isValid = file.read(reinterpret_cast<char*>(m_buffer.data()), size).fail() == false
+                  && hashDialogueData(m_buffer.data(), m_buffer.size()) == hash;
+    }
+
+    uint64_t count = 0;
+    DialogueBinaryReader reader(m_buffer.data(), m_buffer.size());
+    if(isValid && reader.readVarUInt(count) && count <= m_buffer.size())
+    {
+        out_nodes.resize(static_cast<size_t>(count));
+        for(auto& node : out_nodes)
+        {
+            isValid = isValid && DialogueNodeArchive::readNode(reader, node);
+        }
+        isValid = isValid && reader.isAtEnd();
+    }
+    else
+    {
+        isValid = false;
+    }
+
+    if(isValid == false)
+    {
+        LOG("Ignoring invalid parse cache entry '%s'", path.c_str());
+        out_nodes.clear();
+        ++m_stats.misses;
+        return false;
+    }
+
+    //the write time orders entries for eviction
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    ++m_stats.hits;
+    return true;
+}
+
+bool DialogueParseCache::store(uint64_t _key, const std::vector<DialogueNode>& _nodes)
+{
+    if(isOpen() == false)
+    {
+        return false;
+    }
+
+    //body first after room for the header, the header needs its size and hash
+    m_buffer.assign(k_headerSize, 0);
+    DialogueBinaryWriter writer(m_buffer);
+    writer.writeVarUInt(_nodes.size());
+    for(const auto& node : _nodes)
+    {
+        DialogueNodeArchive::writeNode(writer, node);
+    }
+
+    const uint32_t size = static_cast<uint32_t>(m_buffer.size() - k_headerSize);
+    std::vector<uint8_t> header;
+    header.reserve(k_headerSize);
+    DialogueBinaryWriter headerWriter(header);
+    headerWriter.writeBytes(k_magic, sizeof(k_magic));
+    headerWriter.writeUInt32(k_version);
+    headerWriter.writeUInt64(_key);
+    headerWriter.writeUInt32(size);
+    headerWriter.writeUInt32(0);
+    headerWriter.writeUInt64(hashDialogueData(m_buffer.data() + k_headerSize, size));
+    std::copy(header.begin(), header.end(), m_buffer.begin());
+
+    //write aside and rename into place so readers never see a partial entry
+    char tempName[48];
+    snprintf(tempName, sizeof(tempName), "%016" PRIx64 "%s", m_tempCounter++, k_tempExtension);
+    const auto tempPath = (fs::path(m_directory) / tempName).string();
+    const auto path = getPath(_key);
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+        file.close();
+        if(file.fail())
+        {
+            std::error_code error;
+            fs::remove(tempPath, error);
+            LOGERROR("Failed to write parse cache entry '%s'", path.c_str());
+            ++m_stats.failedWrites;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(tempPath, path, error);
+    if(error)
+    {
+        fs::remove(tempPath, error);
+        LOGERROR("Failed to write parse cache entry '%s'", path.c_str());
+        ++m_stats.failedWrites;
+        return false;
+    }
+
+    ++m_stats.stores;
+    m_size += m_buffer.size();
+    if(m_maxBytes > 0 && m_size > m_maxBytes)
+    {
+        trim();
+    }
+    return true;
+}
+
+void DialogueParseCache::parse(DialogueLineParser& _parser,
+                               const std::string& _name,
+                               const std::string& _tags,
+                               const std::string& _body,
+                               unsigned _seed,
+                               std::vector<DialogueNode>& out_nodes)
+{
+    const auto key = makeKey(_name, _tags, _body, _seed, _parser.isMarkupEnabled());
+    if(load(key, m_nodes) == false)
+    {
+        m_nodes.clear();
+        _parser.parse(_name, _tags, _body, _seed, m_nodes);
+        store(key, m_nodes);
+    }
+    out_nodes.insert(out_nodes.end(), std::make_move_iterator(m_nodes.begin()), std::make_move_iterator(m_nodes.end()));
+    m_nodes.clear();
+}
+
+void DialogueParseCache::trim()
+{
+    if(isOpen() == false)
+    {
+        return;
+    }
+
+    struct Entry
+    {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+    std::vector<Entry> entries;
+
+    //recount, other processes may have added or removed entries
+    std::error_code error;
+    m_size = 0;
+    const auto staleTime = fs::file_time_type::clock::now() - k_staleTempAge;
+    for(fs::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error))
+    {
+        std::error_code entryError;
+        if(it->path().extension() == k_tempExtension && it->is_regular_file(entryError) && it->last_write_time(entryError) < staleTime && !entryError)
+        {
+            fs::remove(it->path(), entryError);
+            continue;
+        }
+        if(it->path().extension() != k_extension || it->is_regular_file(entryError) == false)
+        {
+            continue;
+        }
+        Entry entry = { it->path(), it->last_write_time(entryError), it->file_size(entryError) };
+        if(!entryError)
+        {
+            m_size += entry.size;
+            entries.push_back(entry);
+        }
+    }
+
+    if(m_maxBytes == 0 || m_size <= m_maxBytes)
+    {
+        return;
+    }
+
+    //trim below the cap so stores don't rescan the directory every time it is reached
+    const uint64_t target = m_maxBytes - m_maxBytes / 4;
+    std::sort(entries.begin(), entries.end(), [](const Entry& _a, const Entry& _b) { return _a.time < _b.time; });
+    for(const auto& entry : entries)
+    {
+        if(m_size <= target) break;
+        if(fs::remove(entry.path, error))
+        {
+            m_size -= entry.size;
+            ++m_stats.evictions;
+        }
+    }
+}
+
+const DialogueParseCache::Stats& DialogueParseCache::getStats() const
+{
+    return m_stats;
+}
+
+void DialogueParseCache::resetStats()
+{
+    m_stats = Stats();
+}
+
+//----
+//Internal Helpers
+std::string DialogueParseCache::getPath(uint64_t _key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 "%s", _key, k_extension);
+    return (fs::path(m_directory) / name).string();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "DialogueNode.h"
+
+class DialogueLineParser;
+
+/*! On disk cache of parsed nodes for tools and editors that parse a whole project on every save.
+ Entries are keyed by a hash of the node's name, tags, body, seed, whether markup is parsed and DialogueLineParser::k_version, one file per entry.
+ Entries are written to a temporary file and renamed into place, so any number of processes can read and write
+ the same directory and a reader only ever sees a complete entry. Entries carry a hash of their contents and are ignored if it doesn't match.
+ Once the directory grows past the size cap the least recently used entries are deleted, trim also deletes stale temporary files */
+class DialogueParseCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+        uint64_t evictions = 0;
+        uint64_t failedWrites = 0;
+
+        double getHitRate() const;
+    };
+
+public:
+    DialogueParseCache();
+
+    /*! @param _directory created if missing
+     @param _maxBytes size cap for the directory, 0 for no cap
+     @return false if the directory couldn't be created */
+    bool open(const std::string& _directory, uint64_t _maxBytes);
+    void close();
+    bool isOpen() const;
+
+    static uint64_t makeKey(const std::string& _name, const std::string& _tags, const std::string& _body, unsigned _seed, bool _isMarkupEnabled);
+
+    /*! Read the nodes stored for a key
+     @param out_nodes receives the nodes, cleared first
+     @return false on a miss or an invalid entry */
+    bool load(uint64_t _key, std::vector<DialogueNode>& out_nodes);
+
+    /*! Store nodes for a key, replacing any existing entry
+     @return false if the entry couldn't be written */
+    bool store(uint64_t _key, const std::vector<DialogueNode>& _nodes);
+
+    /*! Parse a node through the cache, only running the parser on a miss. Nodes are appended to out_nodes, as DialogueLineParser::parse does */
+    void parse(DialogueLineParser& _parser,
+               const std::string& _name,
+               const std::string& _tags,
+               const std::string& _body,
+               unsigned _seed,
+               std::vector<DialogueNode>& out_nodes);
+
+    /*! Delete least recently used entries until the directory is within three quarters of the size cap, if it is over it.
+     Temporary files over an hour old, left by a process that stopped while writing, are deleted too */
+    void trim();
+
+    const Stats& getStats() const;
+    void resetStats();
+
+protected:
+    std::string m_directory;
+    uint64_t m_maxBytes;
+    uint64_t m_size; //estimated size of the directory, recounted by trim
+    uint64_t m_tempCounter;
+    Stats m_stats;
+    std::vector<uint8_t> m_buffer;
+    std::vector<DialogueNode> m_nodes; //parse results while storing
+
+    std::string getPath(uint64_t _key) const;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+/*! Counter based random number generator.
+ The full state is the seed and the number of values drawn, so it can be saved, restored
+ and shared between conversations without any hidden global state (unlike rand()) */
+struct DialogueRandom
+{
+    uint64_t seed;
+    uint64_t counter;
+
+    DialogueRandom(uint64_t _seed = 0)
+    : seed(_seed)
+    , counter(0)
+    {
+    }
+
+    /*! @return the next 32bit value in the sequence */
+    uint32_t next()
+    {
+        //splitmix64 of (seed, counter)
+        uint64_t z = seed + (++counter) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+    }
+
+    /*! @return a value in the range [0, _count). _count must be greater than 0 */
+    uint32_t nextIndex(uint32_t _count)
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(next()) * _count) >> 32);
+    }
+};
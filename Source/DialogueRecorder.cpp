@@ -0,0 +1,217 @@
+#include "DialogueRecorder.h"
+
+#include "DialogueBinaryIO.h"
+
+//-------------------------------------------
+//ScopedCall
+
+DialogueRecorder::ScopedCall::~ScopedCall()
+{
+    if(m_recorder)
+    {
+        m_recorder->writeEvent(Event::CallEnd);
+        m_recorder->m_isInCall = false;
+    }
+}
+
+//-------------------------------------------
+//ScopedCallback
+
+DialogueRecorder::ScopedCallback::~ScopedCallback()
+{
+    if(m_recorder)
+    {
+        m_recorder->writeEvent(Event::Return);
+        m_recorder->write(m_result);
+        m_recorder->m_isInCall = true;
+    }
+}
+
+void DialogueRecorder::ScopedCallback::setResult(bool _result)
+{
+    m_result = _result;
+}
+
+//-------------------------------------------
+//Resolver
+
+DialogueRecorder::Resolver::Resolver(DialogueRecorder* _recorder)
+: m_resolver(nullptr)
+, m_recorder(_recorder)
+{
+}
+
+void DialogueRecorder::Resolver::set(const IDialogueResolver* _resolver)
+{
+    m_resolver = _resolver;
+}
+
+bool DialogueRecorder::Resolver::resolveVariable(const std::string& _varName, std::string& out_value) const
+{
+    const bool isFound = m_resolver->resolveVariable(_varName, out_value);
+    if(m_recorder->m_isInCall)
+    {
+        m_recorder->writeEvent(Event::Variable);
+        m_recorder->write(_varName);
+        m_recorder->write(isFound);
+        if(isFound)
+        {
+            m_recorder->write(out_value);
+        }
+    }
+    return isFound;
+}
+
+bool DialogueRecorder::Resolver::resolveAction(const std::string& _name, const std::vector<std::string>& _params) const
+{
+    ScopedCallback callback(m_recorder, Event::Action, _name);
+    const bool result = m_resolver->resolveAction(_name, _params);
+    callback.setResult(result);
+    return result;
+}
+
+bool DialogueRecorder::Resolver::getVariableVersion(const std::string& _varName, uint64_t& out_version) const
+{
+    const bool isVersioned = m_resolver->getVariableVersion(_varName, out_version);
+    if(m_recorder->m_isInCall)
+    {
+        m_recorder->writeEvent(Event::VariableVersion);
+        m_recorder->write(_varName);
+        m_recorder->write(isVersioned);
+        if(isVersioned)
+        {
+            m_recorder->write(out_version);
+        }
+    }
+    return isVersioned;
+}
+
+uint64_t DialogueRecorder::Resolver::getVariablesVersion() const
+{
+    const uint64_t version = m_resolver->getVariablesVersion();
+    if(m_recorder->m_isInCall)
+    {
+        m_recorder->writeEvent(Event::VariablesVersion);
+        m_recorder->write(version);
+    }
+    return version;
+}
+
+//-------------------------------------------
+//DialogueRecorder
+
+DialogueRecorder::DialogueRecorder()
+: m_resolver(this)
+, m_callCount(0)
+, m_isInCall(false)
+{
+}
+
+void DialogueRecorder::begin(const DialogueController::StateBuffer& _state,
+                             const DialogueController::StateBuffer& _visits,
+                             size_t _historyCapacity,
+                             bool _avoidRepeatedVariants)
+{
+    m_data.clear();
+    m_names = DialogueStringTable();
+    m_callCount = 0;
+    m_isInCall = false;
+
+    DialogueBinaryWriter writer(m_data);
+    writer.writeBytes(k_magic, sizeof(k_magic));
+    writer.writeUInt32(k_version);
+    writer.writeVarUInt(_historyCapacity);
+    writer.writeUInt8(_avoidRepeatedVariants ? 1 : 0);
+    writer.writeVarUInt(_state.size());
+    writer.writeBytes(_state.data(), _state.size());
+    writer.writeVarUInt(_visits.size());
+    writer.writeBytes(_visits.data(), _visits.size());
+}
+
+const IDialogueResolver* DialogueRecorder::wrapResolver(const IDialogueResolver* _resolver)
+{
+    m_resolver.set(_resolver);
+    return &m_resolver;
+}
+
+const std::vector<uint8_t>& DialogueRecorder::getData() const
+{
+    return m_data;
+}
+
+size_t DialogueRecorder::getCallCount() const
+{
+    return m_callCount;
+}
+
+const char* DialogueRecorder::getEventName(Event _event)
+{
+    static const char* s_names[] =
+    {
+        "Start",
+        "StartStack",
+        "Stop",
+        "SetIsPaused",
+        "SelectOption",
+        "ProgressDialogue",
+        "SkipDialogue",
+        "RestoreState",
+        "Rewind",
+        "SetRandomSeed",
+        "ResetVisits",
+        "RestoreVisits",
+        "CallEnd",
+        "Variable",
+        "VariableVersion",
+        "VariablesVersion",
+        "Action",
+        "Progress",
+        "End",
+        "Paused",
+        "Return"
+    };
+    static_assert(sizeof(s_names) / sizeof(s_names[0]) == static_cast<size_t>(Event::Count), "every event needs a name");
+    return _event < Event::Count ? s_names[static_cast<size_t>(_event)] : "Unknown";
+}
+
+void DialogueRecorder::writeEvent(Event _event)
+{
+    m_data.push_back(static_cast<uint8_t>(_event));
+}
+
+void DialogueRecorder::write(const std::string& _name)
+{
+    const auto nameCount = m_names.getSize();
+    const auto id = m_names.intern(_name);
+    writeVarUInt(id);
+    if(id == nameCount)
+    {
+        DialogueBinaryWriter writer(m_data);
+        writer.writeString(_name);
+    }
+}
+
+void DialogueRecorder::write(const DialogueController::NodeStack& _nodeStack)
+{
+    //variant indices are written +1 so k_noVariant wraps to 0, as in saved states
+    writeVarUInt(_nodeStack.size());
+    for(const auto& state : _nodeStack)
+    {
+        writeVarUInt(state.nodeId);
+        writeVarUInt(state.lineIndex);
+        writeVarUInt(static_cast<uint32_t>(state.variantIndex + 1));
+    }
+}
+
+void DialogueRecorder::write(const Bytes& _bytes)
+{
+    DialogueBinaryWriter writer(m_data);
+    writer.writeVarUInt(_bytes.size);
+    writer.writeBytes(_bytes.data, _bytes.size);
+}
+
+void DialogueRecorder::writeVarUInt(uint64_t _value)
+{
+    DialogueBinaryWriter writer(m_data);
+    writer.writeVarUInt(_value);
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "DialogueController.h"
+#include "DialogueStringTable.h"
+#include "IDialogueResolver.h"
+
+/*! Records a dialogue session to a compact binary log, set on a DialogueController with setRecorder.
+ The log starts with the controller's conversation state and visits, followed by every call the game made to the controller,
+ every result the resolver returned and the delegate callbacks and actions the game handled, along with any calls made back into
+ the controller from them. DialogueReplay re-executes a log against the same script without the game attached.
+ Calls the controller makes to itself, e.g. skipDialogue progressing, aren't logged.
+
+ Layout, little endian:
+   "YKRS" u32 version varuint historyCapacity u8 avoidRepeatedVariants string state string visits
+   events, each a u8 Event followed by its arguments:
+     Start name varuint line u8 force       StartStack varuint depth { varuint node varuint line varuint variant+1 } u8 force
+     Stop, ProgressDialogue, SkipDialogue   SetIsPaused u8 paused          SelectOption varuint index
+     RestoreState string state u8 notify    Rewind varuint steps           SetRandomSeed varuint seed
+     ResetVisits                            RestoreVisits string visits    CallEnd, closing every call
+     Variable name u8 found [name value]    VariableVersion name u8 found [varuint version]
+     VariablesVersion varuint version
+     Action name, Progress varuint lineId varuint options, End, Paused: callbacks, followed by the calls made from them and Return
+     Return u8 result
+   names are a varuint index into the names read so far, followed by the string if the index is new.
+   Variable values are stored as names, so repeated values cost a byte or two */
+class DialogueRecorder
+{
+public:
+    enum class Event : uint8_t
+    {
+        //calls into the controller
+        Start,
+        StartStack,
+        Stop,
+        SetIsPaused,
+        SelectOption,
+        ProgressDialogue,
+        SkipDialogue,
+        RestoreState,
+        Rewind,
+        SetRandomSeed,
+        ResetVisits,
+        RestoreVisits,
+        CallEnd,
+
+        //resolver results
+        Variable,
+        VariableVersion,
+        VariablesVersion,
+
+        //callbacks into the game
+        Action,
+        Progress,
+        End,
+        Paused,
+        Return,
+        Count
+    };
+
+    /*! Binary argument, e.g. a state buffer */
+    struct Bytes
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    /*! Log a call into the controller for the lifetime of the scope. Does nothing if the recorder is nullptr,
+     or if the controller is already running a logged call and isn't inside a callback into the game */
+    class ScopedCall
+    {
+    public:
+        template <typename... Args>
+        ScopedCall(DialogueRecorder* _recorder, Event _call, const Args&... _args)
+        : m_recorder(_recorder && _recorder->m_isInCall == false ? _recorder : nullptr)
+        {
+            if(m_recorder)
+            {
+                m_recorder->writeEvent(_call);
+                (m_recorder->write(_args), ...);
+                m_recorder->m_isInCall = true;
+                m_recorder->m_callCount++;
+            }
+        }
+        ~ScopedCall();
+
+        ScopedCall(const ScopedCall&) = delete;
+        ScopedCall& operator=(const ScopedCall&) = delete;
+
+    protected:
+        DialogueRecorder* m_recorder;
+    };
+
+    /*! Log a callback into the game for the lifetime of the scope, so calls made from it are logged. Only logs inside a logged call */
+    class ScopedCallback
+    {
+    public:
+        template <typename... Args>
+        ScopedCallback(DialogueRecorder* _recorder, Event _callback, const Args&... _args)
+        : m_recorder(_recorder && _recorder->m_isInCall ? _recorder : nullptr)
+        , m_result(true)
+        {
+            if(m_recorder)
+            {
+                m_recorder->writeEvent(_callback);
+                (m_recorder->write(_args), ...);
+                m_recorder->m_isInCall = false;
+            }
+        }
+        ~ScopedCallback();
+
+        ScopedCallback(const ScopedCallback&) = delete;
+        ScopedCallback& operator=(const ScopedCallback&) = delete;
+
+        void setResult(bool _result);
+
+    protected:
+        DialogueRecorder* m_recorder;
+        bool m_result;
+    };
+
+    /*! Forwards to another resolver, logging each result */
+    class Resolver : public IDialogueResolver
+    {
+    public:
+        Resolver(DialogueRecorder* _recorder);
+
+        void set(const IDialogueResolver* _resolver);
+
+        bool resolveVariable(const std::string& _varName, std::string& out_value) const override;
+        bool resolveAction(const std::string& _name, const std::vector<std::string>& _params) const override;
+        bool getVariableVersion(const std::string& _varName, uint64_t& out_version) const override;
+        uint64_t getVariablesVersion() const override;
+
+    protected:
+        const IDialogueResolver* m_resolver;
+        DialogueRecorder* m_recorder;
+    };
+
+    static constexpr char k_magic[4] = { 'Y', 'K', 'R', 'S' };
+    static constexpr uint32_t k_version = 1;
+
+public:
+    DialogueRecorder();
+
+    DialogueRecorder(const DialogueRecorder&) = delete;
+    DialogueRecorder& operator=(const DialogueRecorder&) = delete;
+
+    /*! Clear the log and write the starting state, called by DialogueController::setRecorder */
+    void begin(const DialogueController::StateBuffer& _state,
+               const DialogueController::StateBuffer& _visits,
+               size_t _historyCapacity,
+               bool _avoidRepeatedVariants);
+
+    /*! @return a resolver forwarding to _resolver that logs its results */
+    const IDialogueResolver* wrapResolver(const IDialogueResolver* _resolver);
+
+    /*! @return the log, write it to a file to replay later */
+    const std::vector<uint8_t>& getData() const;
+
+    /*! @return the number of calls logged since begin */
+    size_t getCallCount() const;
+
+    static const char* getEventName(Event _event);
+
+protected:
+    std::vector<uint8_t> m_data;
+    DialogueStringTable m_names;
+    Resolver m_resolver;
+    size_t m_callCount;
+    bool m_isInCall; //inside a logged call and not in a callback from it
+
+    void writeEvent(Event _event);
+    void write(const std::string& _name);
+    void write(const DialogueController::NodeStack& _nodeStack);
+    void write(const Bytes& _bytes);
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type write(T _value)
+    {
+        writeVarUInt(static_cast<uint64_t>(_value));
+    }
+    void writeVarUInt(uint64_t _value);
+};
@@ -0,0 +1,490 @@
+#include "DialogueReplay.h"
+
+#include "DialogueContent.h"
+#include "DialogueMacros.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    typedef DialogueRecorder::Event Event;
+
+    bool isCall(Event _event)
+    {
+        return _event < Event::CallEnd;
+    }
+
+    bool readBuffer(DialogueBinaryReader& _reader, DialogueController::StateBuffer& out_buffer)
+    {
+        uint64_t size = 0;
+        if(_reader.readVarUInt(size) == false || size > _reader.getRemaining()) return false;
+        out_buffer.resize(static_cast<size_t>(size));
+        return _reader.readBytes(out_buffer.data(), out_buffer.size());
+    }
+
+    uint64_t getTime()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+}
+
+//-------------------------------------------
+//Resolver
+
+DialogueReplay::Resolver::Resolver(DialogueReplay* _replay)
+: m_replay(_replay)
+{
+}
+
+bool DialogueReplay::Resolver::resolveVariable(const std::string& _varName, std::string& out_value) const
+{
+    const ScopedCallback callback(m_replay);
+    std::string name;
+    bool isFound = false;
+    if(m_replay->expect(Event::Variable) == false || m_replay->readName(name) == false || m_replay->readFlag(isFound) == false)
+    {
+        return false;
+    }
+    if(name != _varName)
+    {
+        return m_replay->fail("resolved a different variable", _varName + ", log has " + name);
+    }
+    return isFound && m_replay->readName(out_value);
+}
+
+bool DialogueReplay::Resolver::resolveAction(const std::string& _name, const std::vector<std::string>& /*_params*/) const
+{
+    const ScopedCallback callback(m_replay);
+    std::string name;
+    if(m_replay->expect(Event::Action) == false || m_replay->readName(name) == false)
+    {
+        return false;
+    }
+    if(name != _name)
+    {
+        return m_replay->fail("ran a different action", _name + ", log has " + name);
+    }
+    bool result = false;
+    return m_replay->replayCallback(result) && result;
+}
+
+bool DialogueReplay::Resolver::getVariableVersion(const std::string& _varName, uint64_t& out_version) const
+{
+    const ScopedCallback callback(m_replay);
+    std::string name;
+    bool isVersioned = false;
+    if(m_replay->expect(Event::VariableVersion) == false || m_replay->readName(name) == false || m_replay->readFlag(isVersioned) == false)
+    {
+        return false;
+    }
+    if(name != _varName)
+    {
+        return m_replay->fail("versioned a different variable", _varName + ", log has " + name);
+    }
+    if(isVersioned && m_replay->m_reader.readVarUInt(out_version) == false)
+    {
+        return m_replay->fail("truncated log");
+    }
+    return isVersioned;
+}
+
+uint64_t DialogueReplay::Resolver::getVariablesVersion() const
+{
+    const ScopedCallback callback(m_replay);
+    uint64_t version = 0;
+    if(m_replay->expect(Event::VariablesVersion) && m_replay->m_reader.readVarUInt(version) == false)
+    {
+        m_replay->fail("truncated log");
+    }
+    return version;
+}
+
+//-------------------------------------------
+//ScopedCallback
+
+DialogueReplay::ScopedCallback::ScopedCallback(DialogueReplay* _replay)
+: m_replay(_replay)
+, m_wasTiming(_replay->m_isTiming)
+{
+    if(m_wasTiming)
+    {
+        m_replay->stopTiming();
+    }
+}
+
+DialogueReplay::ScopedCallback::~ScopedCallback()
+{
+    if(m_wasTiming)
+    {
+        m_replay->startTiming();
+    }
+}
+
+//-------------------------------------------
+//Delegate
+
+DialogueReplay::Delegate::Delegate(DialogueReplay* _replay)
+: m_replay(_replay)
+{
+}
+
+void DialogueReplay::Delegate::onProgress(const DialogueContent& _content)
+{
+    const ScopedCallback callback(m_replay);
+    uint64_t lineId = 0, optionCount = 0;
+    if(m_replay->expect(Event::Progress) == false) return;
+    if(m_replay->m_reader.readVarUInt(lineId) == false || m_replay->m_reader.readVarUInt(optionCount) == false)
+    {
+        m_replay->fail("truncated log");
+        return;
+    }
+    if(lineId != _content.lineId || optionCount != _content.options.size())
+    {
+        m_replay->fail("presented a different line");
+        return;
+    }
+    bool result = false;
+    m_replay->replayCallback(result);
+}
+
+void DialogueReplay::Delegate::onEnd()
+{
+    const ScopedCallback callback(m_replay);
+    bool result = false;
+    if(m_replay->expect(Event::End))
+    {
+        m_replay->replayCallback(result);
+    }
+}
+
+void DialogueReplay::Delegate::onPaused()
+{
+    const ScopedCallback callback(m_replay);
+    bool result = false;
+    if(m_replay->expect(Event::Paused))
+    {
+        m_replay->replayCallback(result);
+    }
+}
+
+//-------------------------------------------
+//DialogueReplay
+
+DialogueReplay::DialogueReplay()
+: m_historyCapacity(0)
+, m_avoidRepeatedVariants(false)
+, m_eventsOffset(0)
+, m_resolver(this)
+, m_delegate(this)
+, m_controller(nullptr)
+, m_reader(nullptr, 0)
+, m_hasFailed(false)
+, m_isTiming(false)
+, m_timingStart(0)
+, m_controllerNanoseconds(0)
+{
+}
+
+bool DialogueReplay::load(const std::vector<uint8_t>& _data)
+{
+    return load(_data.data(), _data.size());
+}
+
+bool DialogueReplay::load(const uint8_t* _data, size_t _size)
+{
+    m_data.clear();
+    m_steps.clear();
+    m_error.clear();
+
+    DialogueBinaryReader reader(_data, _size);
+    char magic[sizeof(DialogueRecorder::k_magic)] = {};
+    uint32_t version = 0;
+    if(reader.readBytes(magic, sizeof(magic)) == false || memcmp(magic, DialogueRecorder::k_magic, sizeof(magic)) != 0
+       || reader.readUInt32(version) == false || version != DialogueRecorder::k_version)
+    {
+        m_error = "not a session log or unsupported version";
+        LOGERROR("Failed to load replay: %s", m_error.c_str());
+        return false;
+    }
+
+    uint64_t historyCapacity = 0;
+    uint8_t avoidRepeatedVariants = 0;
+    if(reader.readVarUInt(historyCapacity) == false
+       || reader.readUInt8(avoidRepeatedVariants) == false
+       || readBuffer(reader, m_state) == false
+       || readBuffer(reader, m_visits) == false)
+    {
+        m_error = "truncated data";
+        LOGERROR("Failed to load replay: %s", m_error.c_str());
+        return false;
+    }
+    m_historyCapacity = static_cast<size_t>(historyCapacity);
+    m_avoidRepeatedVariants = avoidRepeatedVariants != 0;
+    m_eventsOffset = reader.getOffset();
+    m_data.assign(_data, _data + _size);
+    return true;
+}
+
+bool DialogueReplay::run(DialogueController& _controller)
+{
+    m_steps.clear();
+    m_error.clear();
+    if(m_data.empty())
+    {
+        m_error = "no log loaded";
+        LOGERROR("Failed to replay: %s", m_error.c_str());
+        return false;
+    }
+
+    m_controller = &_controller;
+    m_reader = DialogueBinaryReader(m_data.data() + m_eventsOffset, m_data.size() - m_eventsOffset);
+    m_names.clear();
+    m_hasFailed = false;
+    m_isTiming = false;
+    m_controllerNanoseconds = 0;
+
+    const auto previousResolver = _controller.getDialogueResolver();
+    const auto previousDelegate = _controller.getDialogueDelegate();
+    _controller.setDialogueResolver(&m_resolver);
+    _controller.setDialogueDelegate(&m_delegate);
+    _controller.setHistoryCapacity(m_historyCapacity);
+    _controller.setAvoidRepeatedVariants(m_avoidRepeatedVariants);
+    if(_controller.restoreVisits(m_visits) == false || _controller.restoreState(m_state) == false)
+    {
+        fail("the controller's nodes don't match the recording");
+    }
+
+    uint8_t event = 0;
+    while(m_hasFailed == false && m_reader.readUInt8(event))
+    {
+        const auto call = static_cast<Event>(event);
+        if(isCall(call) == false)
+        {
+            fail("expected a call, log has", DialogueRecorder::getEventName(call));
+            break;
+        }
+        const auto start = m_controllerNanoseconds;
+        replayCall(call);
+        m_steps.push_back({ call, m_controllerNanoseconds - start });
+    }
+
+    _controller.setDialogueDelegate(previousDelegate);
+    _controller.setDialogueResolver(previousResolver);
+    m_controller = nullptr;
+    return m_hasFailed == false;
+}
+
+const std::vector<DialogueReplay::Step>& DialogueReplay::getSteps() const
+{
+    return m_steps;
+}
+
+const std::string& DialogueReplay::getError() const
+{
+    return m_error;
+}
+
+void DialogueReplay::startTiming()
+{
+    m_isTiming = true;
+    m_timingStart = getTime();
+}
+
+void DialogueReplay::stopTiming()
+{
+    m_controllerNanoseconds += getTime() - m_timingStart;
+    m_isTiming = false;
+}
+
+bool DialogueReplay::fail(const char* _reason, const std::string& _detail)
+{
+    if(m_hasFailed == false)
+    {
+        char location[64];
+        snprintf(location, sizeof(location), "step %zu at byte %zu: ", m_steps.size(), m_eventsOffset + m_reader.getOffset());
+        m_error = location;
+        m_error += _reason;
+        if(_detail.empty() == false)
+        {
+            m_error += ' ';
+            m_error += _detail;
+        }
+        LOGERROR("Failed to replay %s", m_error.c_str());
+        m_hasFailed = true;
+    }
+    return false;
+}
+
+bool DialogueReplay::expect(Event _event)
+{
+    if(m_hasFailed) return false;
+
+    uint8_t event = 0;
+    if(m_reader.readUInt8(event) == false)
+    {
+        return fail("log ended, the controller asked for", DialogueRecorder::getEventName(_event));
+    }
+    if(static_cast<Event>(event) != _event)
+    {
+        return fail("diverged, the controller asked for",
+                    std::string(DialogueRecorder::getEventName(_event)) + ", log has " + DialogueRecorder::getEventName(static_cast<Event>(event)));
+    }
+    return true;
+}
+
+bool DialogueReplay::readName(std::string& out_name)
+{
+    uint64_t index = 0;
+    if(m_reader.readVarUInt(index) == false || index > m_names.size())
+    {
+        return fail("malformed name");
+    }
+    if(index == m_names.size())
+    {
+        m_names.emplace_back();
+        if(m_reader.readString(m_names.back()) == false)
+        {
+            return fail("truncated log");
+        }
+    }
+    out_name = m_names[static_cast<size_t>(index)];
+    return true;
+}
+
+bool DialogueReplay::readFlag(bool& out_flag)
+{
+    uint64_t flag = 0;
+    if(m_reader.readVarUInt(flag) == false)
+    {
+        return fail("truncated log");
+    }
+    out_flag = flag != 0;
+    return true;
+}
+
+bool DialogueReplay::readBytes(DialogueController::StateBuffer& out_bytes)
+{
+    return readBuffer(m_reader, out_bytes) || fail("truncated log");
+}
+
+bool DialogueReplay::replayCall(Event _call)
+{
+    uint64_t value = 0;
+    bool flag = false;
+    std::string name;
+    DialogueController::StateBuffer bytes;
+    switch(_call)
+    {
+        case Event::Start:
+            if(readName(name) == false || m_reader.readVarUInt(value) == false || readFlag(flag) == false) return fail("truncated log");
+            startTiming();
+            m_controller->start(name, static_cast<unsigned>(value), flag);
+            stopTiming();
+            break;
+        case Event::StartStack:
+        {
+            DialogueController::NodeStack nodeStack;
+            if(m_reader.readVarUInt(value) == false || value > m_reader.getRemaining()) return fail("truncated log");
+            nodeStack.resize(static_cast<size_t>(value));
+            for(auto& state : nodeStack)
+            {
+                uint64_t nodeId = 0, lineIndex = 0, variant = 0;
+                if(m_reader.readVarUInt(nodeId) == false || m_reader.readVarUInt(lineIndex) == false || m_reader.readVarUInt(variant) == false)
+                {
+                    return fail("truncated log");
+                }
+                state = { static_cast<DialogueNode::Id>(nodeId), static_cast<size_t>(lineIndex), static_cast<unsigned>(variant - 1) };
+            }
+            if(readFlag(flag) == false) return false;
+            startTiming();
+            m_controller->start(nodeStack, flag);
+            stopTiming();
+            break;
+        }
+        case Event::Stop:
+            startTiming();
+            m_controller->stop();
+            stopTiming();
+            break;
+        case Event::SetIsPaused:
+            if(readFlag(flag) == false) return false;
+            startTiming();
+            m_controller->setIsPaused(flag);
+            stopTiming();
+            break;
+        case Event::SelectOption:
+            if(m_reader.readVarUInt(value) == false) return fail("truncated log");
+            startTiming();
+            m_controller->selectOption(static_cast<size_t>(value));
+            stopTiming();
+            break;
+        case Event::ProgressDialogue:
+            startTiming();
+            m_controller->progressDialogue();
+            stopTiming();
+            break;
+        case Event::SkipDialogue:
+            startTiming();
+            m_controller->skipDialogue();
+            stopTiming();
+            break;
+        case Event::RestoreState:
+            if(readBytes(bytes) == false || readFlag(flag) == false) return false;
+            startTiming();
+            m_controller->restoreState(bytes, flag);
+            stopTiming();
+            break;
+        case Event::Rewind:
+            if(m_reader.readVarUInt(value) == false) return fail("truncated log");
+            startTiming();
+            m_controller->rewind(static_cast<size_t>(value));
+            stopTiming();
+            break;
+        case Event::SetRandomSeed:
+            if(m_reader.readVarUInt(value) == false) return fail("truncated log");
+            startTiming();
+            m_controller->setRandomSeed(value);
+            stopTiming();
+            break;
+        case Event::ResetVisits:
+            startTiming();
+            m_controller->resetVisits();
+            stopTiming();
+            break;
+        case Event::RestoreVisits:
+            if(readBytes(bytes) == false) return false;
+            startTiming();
+            m_controller->restoreVisits(bytes);
+            stopTiming();
+            break;
+        default:
+            return fail("expected a call, log has", DialogueRecorder::getEventName(_call));
+    }
+    return expect(Event::CallEnd);
+}
+
+bool DialogueReplay::replayCallback(bool& out_result)
+{
+    //calls the game made from the callback, up to its return
+    uint8_t event = 0;
+    while(m_hasFailed == false)
+    {
+        if(m_reader.readUInt8(event) == false)
+        {
+            return fail("log ended inside a callback");
+        }
+        const auto recorded = static_cast<Event>(event);
+        if(recorded == Event::Return)
+        {
+            return readFlag(out_result);
+        }
+        if(isCall(recorded) == false)
+        {
+            return fail("diverged, the controller returned from a callback, log has", DialogueRecorder::getEventName(recorded));
+        }
+        replayCall(recorded);
+    }
+    return false;
+}
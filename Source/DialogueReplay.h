@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "DialogueBinaryIO.h"
+#include "DialogueController.h"
+#include "DialogueRecorder.h"
+#include "IDialogueDelegate.h"
+#include "IDialogueResolver.h"
+
+/*! Re-executes a session logged by DialogueRecorder against a controller, without the game attached.
+ The controller must have the same nodes, in the same order, as when the session was recorded.
+ The resolver answers from the log and the delegate and actions make the calls the game made from them, so any difference
+ in what the controller asks for is reported as a divergence. Each call the game made is timed as a step, counting only time in the controller */
+class DialogueReplay
+{
+public:
+    struct Step
+    {
+        DialogueRecorder::Event call;
+        uint64_t nanoseconds; //in the controller, including calls made from callbacks but not the replay decoding and checking the log
+    };
+
+public:
+    DialogueReplay();
+
+    DialogueReplay(const DialogueReplay&) = delete;
+    DialogueReplay& operator=(const DialogueReplay&) = delete;
+
+    /*! Load a log written by DialogueRecorder, the data is copied
+     @return false if the data isn't a valid log */
+    bool load(const uint8_t* _data, size_t _size);
+    bool load(const std::vector<uint8_t>& _data);
+
+    /*! Restore the recorded starting state on the controller and replay every call. The controller's resolver and delegate
+     are replaced while replaying and restored afterwards. A log can be replayed any number of times
+     @return false if the log is malformed, the controller's nodes don't match or the controller diverged from the recording */
+    bool run(DialogueController& _controller);
+
+    /*! @return the timing of every call replayed by the last run, in order */
+    const std::vector<Step>& getSteps() const;
+
+    /*! @return why the last load or run failed, empty if it succeeded */
+    const std::string& getError() const;
+
+protected:
+    class Resolver : public IDialogueResolver
+    {
+    public:
+        Resolver(DialogueReplay* _replay);
+
+        bool resolveVariable(const std::string& _varName, std::string& out_value) const override;
+        bool resolveAction(const std::string& _name, const std::vector<std::string>& _params) const override;
+        bool getVariableVersion(const std::string& _varName, uint64_t& out_version) const override;
+        uint64_t getVariablesVersion() const override;
+
+    protected:
+        DialogueReplay* m_replay;
+    };
+
+    //stops the controller's clock while the replay answers a callback
+    class ScopedCallback
+    {
+    public:
+        ScopedCallback(DialogueReplay* _replay);
+        ~ScopedCallback();
+
+        ScopedCallback(const ScopedCallback&) = delete;
+        ScopedCallback& operator=(const ScopedCallback&) = delete;
+
+    protected:
+        DialogueReplay* m_replay;
+        bool m_wasTiming;
+    };
+
+    class Delegate : public IDialogueDelegate
+    {
+    public:
+        Delegate(DialogueReplay* _replay);
+
+        void onProgress(const DialogueContent& _content) override;
+        void onEnd() override;
+        void onPaused() override;
+
+    protected:
+        DialogueReplay* m_replay;
+    };
+
+    std::vector<uint8_t> m_data;
+    size_t m_historyCapacity;
+    bool m_avoidRepeatedVariants;
+    DialogueController::StateBuffer m_state;
+    DialogueController::StateBuffer m_visits;
+    size_t m_eventsOffset;
+
+    Resolver m_resolver;
+    Delegate m_delegate;
+    DialogueController* m_controller; //while running
+    DialogueBinaryReader m_reader;
+    std::vector<std::string> m_names;
+    std::vector<Step> m_steps;
+    bool m_hasFailed;
+    std::string m_error;
+    bool m_isTiming; //the controller has control
+    uint64_t m_timingStart;
+    uint64_t m_controllerNanoseconds; //total of the current run
+
+    void startTiming();
+    void stopTiming();
+
+    bool fail(const char* _reason, const std::string& _detail = std::string());
+    bool expect(DialogueRecorder::Event _event);
+    bool readName(std::string& out_name);
+    bool readFlag(bool& out_flag);
+    bool readBytes(DialogueController::StateBuffer& out_bytes);
+    bool replayCall(DialogueRecorder::Event _call);
+    bool replayCallback(bool& out_result);
+};
@@ -0,0 +1,413 @@
+#include "DialogueStoryletSelector.h"
+
+#include "DialogueController.h"
+#include "DialogueLineParser.h"
+#include "DialogueRandom.h"
+#include "IDialogueResolver.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+    const std::string k_salienceTag = "salience";
+    const size_t k_notEligible = SIZE_MAX;
+
+    std::string trimmed(const std::string& _string)
+    {
+        const char* whitespace = " \f\n\r\t\v";
+        const auto begin = _string.find_first_not_of(whitespace);
+        if(begin == std::string::npos) return std::string();
+        return _string.substr(begin, _string.find_last_not_of(whitespace) + 1 - begin);
+    }
+
+    //@return true if the operand is exactly one variable reference, writing its name
+    bool isSingleVariable(const DialogueNode::Condition::Operand& _operand, std::string& out_name)
+    {
+        const auto& value = _operand.value;
+        if(_operand.type != DialogueNode::Condition::Operand::Type::Text
+           || value.size() < 4 || value.compare(0, 2, "$(") != 0 || value.back() != ')'
+           || value.find_first_of("$()", 2) != value.size() - 1)
+        {
+            return false;
+        }
+        out_name = value.substr(2, value.size() - 3);
+        return true;
+    }
+
+    bool isLiteral(const DialogueNode::Condition::Operand& _operand)
+    {
+        return _operand.type == DialogueNode::Condition::Operand::Type::Text && _operand.value.find("$(") == std::string::npos;
+    }
+
+    //mirror a comparison so the operands can be swapped
+    DialogueNode::Condition::Operator mirror(DialogueNode::Condition::Operator _op)
+    {
+        switch(_op)
+        {
+            case DialogueNode::Condition::Operator::GreaterThan: return DialogueNode::Condition::Operator::LessThan;
+            case DialogueNode::Condition::Operator::LessThan: return DialogueNode::Condition::Operator::GreaterThan;
+            case DialogueNode::Condition::Operator::GreaterThanOrEqualTo: return DialogueNode::Condition::Operator::LessThanOrEqualTo;
+            case DialogueNode::Condition::Operator::LessThanOrEqualTo: return DialogueNode::Condition::Operator::GreaterThanOrEqualTo;
+            default: return _op;
+        }
+    }
+}
+
+DialogueStoryletSelector::DialogueStoryletSelector(DialogueController& _controller, const IDialogueResolver* _resolver)
+: m_controller(_controller)
+, m_resolver(_resolver)
+, m_visitVersion(0)
+, m_needsRefresh(false)
+{
+
+}
+
+void DialogueStoryletSelector::addCandidate(DialogueNode::Id _nodeId, float _weight)
+{
+    const auto node = m_controller.loadNodeById(_nodeId);
+    if(node == nullptr)
+    {
+        return;
+    }
+
+    const auto candidate = static_cast<unsigned>(m_candidates.size());
+    m_candidates.push_back({ _nodeId, _weight, 0, k_notEligible });
+    if(node->lines.empty() == false)
+    {
+        for(const auto& condition : node->lines.front().conditions)
+        {
+            indexCondition(candidate, condition);
+        }
+    }
+    m_needsRefresh = true;
+}
+
+void DialogueStoryletSelector::addCandidates(const std::vector<DialogueNode::Id>& _nodeIds)
+{
+    const auto& tagIndex = m_controller.getTagIndex();
+    for(const auto nodeId : _nodeIds)
+    {
+        const auto node = m_controller.loadNodeById(nodeId);
+        if(node == nullptr) continue;
+
+        float weight = 1;
+        for(const auto tagId : node->tagIds)
+        {
+            const auto& tag = tagIndex.getTag(tagId);
+            if(tag.size() > k_salienceTag.size() + 1 && tag.compare(0, k_salienceTag.size(), k_salienceTag) == 0
+               && (tag[k_salienceTag.size()] == '=' || tag[k_salienceTag.size()] == ':'))
+            {
+                DialogueLineParser::parseNumber(tag.substr(k_salienceTag.size() + 1), weight);
+            }
+        }
+        addCandidate(nodeId, weight);
+    }
+}
+
+void DialogueStoryletSelector::clear()
+{
+    m_candidates.clear();
+    m_conditions.clear();
+    m_variables.clear();
+    m_visitConditions.clear();
+    m_eligible.clear();
+    m_needsRefresh = false;
+}
+
+void DialogueStoryletSelector::refresh()
+{
+    for(auto& pair : m_variables)
+    {
+        readVariable(pair.first, pair.second);
+    }
+
+    for(auto& candidate : m_candidates)
+    {
+        candidate.failingCount = 0;
+    }
+    for(auto& condition : m_conditions)
+    {
+        const VariableIndex* index = nullptr;
+        if(condition.kind != ConditionKind::General)
+        {
+            index = &m_variables[condition.condition.variables.front()];
+        }
+        condition.passes = evaluate(condition, index);
+        if(condition.passes == false)
+        {
+            m_candidates[condition.candidate].failingCount++;
+        }
+    }
+
+    m_eligible.clear();
+    for(unsigned i = 0; i < m_candidates.size(); ++i)
+    {
+        m_candidates[i].eligibleIndex = k_notEligible;
+        setEligible(i, m_candidates[i].failingCount == 0);
+    }
+
+    m_visitVersion = m_controller.getVisits().getVersion();
+    m_needsRefresh = false;
+}
+
+void DialogueStoryletSelector::onVariableChanged(const std::string& _varName)
+{
+    if(m_needsRefresh) return; //everything is re-evaluated on the next query anyway
+
+    auto it = m_variables.find(_varName);
+    if(it == m_variables.end()) return;
+
+    auto& index = it->second;
+    const auto oldValue = index.value;
+    const bool oldIsNumber = index.isNumber;
+    const float oldNumber = index.number;
+    readVariable(_varName, index);
+
+    //equality results can only change for the buckets of the old and new value
+    if(oldValue != index.value)
+    {
+        const std::string* values[] = { &oldValue, &index.value };
+        for(const auto* value : values)
+        {
+            auto bucket = index.equalityBuckets.find(*value);
+            if(bucket != index.equalityBuckets.end())
+            {
+                for(const auto conditionIndex : bucket->second)
+                {
+                    update(conditionIndex, &index);
+                }
+            }
+        }
+    }
+
+    //range results can only change for thresholds between the old and new value
+    if(oldIsNumber && index.isNumber)
+    {
+        const auto low = std::min(oldNumber, index.number), high = std::max(oldNumber, index.number);
+        auto begin = std::lower_bound(index.thresholds.begin(), index.thresholds.end(), std::make_pair(low, 0u));
+        for(auto threshold = begin; threshold != index.thresholds.end() && threshold->first <= high; ++threshold)
+        {
+            update(threshold->second, &index);
+        }
+    }
+    else if(oldIsNumber != index.isNumber)
+    {
+        for(const auto& threshold : index.thresholds)
+        {
+            update(threshold.second, &index);
+        }
+    }
+
+    for(const auto conditionIndex : index.general)
+    {
+        update(conditionIndex, nullptr);
+    }
+}
+
+void DialogueStoryletSelector::selectTop(size_t _count, std::vector<Result>& out_results)
+{
+    if(m_needsRefresh) refresh();
+    refreshVisits();
+
+    out_results.clear();
+    for(const auto candidateIndex : m_eligible)
+    {
+        const auto& candidate = m_candidates[candidateIndex];
+        out_results.push_back({ candidate.nodeId, candidate.weight });
+    }
+
+    const auto count = std::min(_count, out_results.size());
+    std::partial_sort(out_results.begin(), out_results.begin() + count, out_results.end(), [](const Result& _a, const Result& _b)
+    {
+        return _a.weight != _b.weight ? _a.weight > _b.weight : _a.nodeId < _b.nodeId;
+    });
+    out_results.resize(count);
+}
+
+bool DialogueStoryletSelector::pickWeighted(DialogueRandom& _random, DialogueNode::Id& out_nodeId)
+{
+    if(m_needsRefresh) refresh();
+    refreshVisits();
+
+    double totalWeight = 0;
+    for(const auto candidateIndex : m_eligible)
+    {
+        totalWeight += std::max(0.0f, m_candidates[candidateIndex].weight);
+    }
+    if(m_eligible.empty() || totalWeight <= 0)
+    {
+        return false;
+    }
+
+    double target = totalWeight * (_random.next() / 4294967296.0);
+    for(const auto candidateIndex : m_eligible)
+    {
+        target -= std::max(0.0f, m_candidates[candidateIndex].weight);
+        if(target < 0)
+        {
+            out_nodeId = m_candidates[candidateIndex].nodeId;
+            return true;
+        }
+    }
+    out_nodeId = m_candidates[m_eligible.back()].nodeId;
+    return true;
+}
+
+size_t DialogueStoryletSelector::getCandidateCount() const
+{
+    return m_candidates.size();
+}
+
+size_t DialogueStoryletSelector::getEligibleCount()
+{
+    if(m_needsRefresh) refresh();
+    refreshVisits();
+    return m_eligible.size();
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Internal Helpers
+//-------------------------------------------------------------------------------------------------------------------
+
+void DialogueStoryletSelector::indexCondition(unsigned _candidate, const DialogueNode::Condition& _condition)
+{
+    const auto conditionIndex = static_cast<unsigned>(m_conditions.size());
+    IndexedCondition indexed = { _candidate, ConditionKind::General, _condition.op, std::string(), 0, false, _condition };
+
+    //normalise to "$(var) op literal"
+    std::string varName;
+    const DialogueNode::Condition::Operand* literal = nullptr;
+    if(isSingleVariable(_condition.lvalue, varName) && isLiteral(_condition.rvalue))
+    {
+        literal = &_condition.rvalue;
+    }
+    else if(isSingleVariable(_condition.rvalue, varName) && isLiteral(_condition.lvalue))
+    {
+        literal = &_condition.lvalue;
+        indexed.op = mirror(_condition.op);
+    }
+
+    if(literal)
+    {
+        //empty operands resolve to false, as in DialogueLineParser::resolveCondition
+        indexed.literal = trimmed(literal->value);
+        if(indexed.literal.empty()) indexed.literal = "false";
+
+        if(indexed.op == DialogueNode::Condition::Operator::Equals || indexed.op == DialogueNode::Condition::Operator::NotEquals)
+        {
+            indexed.kind = ConditionKind::Equality;
+            m_variables[varName].equalityBuckets[indexed.literal].push_back(conditionIndex);
+        }
+        else if(indexed.op != DialogueNode::Condition::Operator::None && DialogueLineParser::parseNumber(indexed.literal, indexed.threshold))
+        {
+            indexed.kind = ConditionKind::Range;
+            auto& thresholds = m_variables[varName].thresholds;
+            const auto entry = std::make_pair(indexed.threshold, conditionIndex);
+            thresholds.insert(std::upper_bound(thresholds.begin(), thresholds.end(), entry), entry);
+        }
+    }
+
+    if(indexed.kind == ConditionKind::General)
+    {
+        for(const auto& variable : _condition.variables)
+        {
+            m_variables[variable].general.push_back(conditionIndex);
+        }
+        if(_condition.lvalue.type != DialogueNode::Condition::Operand::Type::Text
+           || _condition.rvalue.type != DialogueNode::Condition::Operand::Type::Text)
+        {
+            m_visitConditions.push_back(conditionIndex);
+        }
+    }
+    else
+    {
+        //indexed conditions read exactly one variable, keep it first so it can be found again
+        indexed.condition.variables.assign(1, varName);
+    }
+
+    m_conditions.push_back(indexed);
+}
+
+void DialogueStoryletSelector::readVariable(const std::string& _varName, VariableIndex& _index) const
+{
+    std::string value;
+    if(m_resolver)
+    {
+        m_resolver->resolveVariable(_varName, value);
+    }
+    _index.value = trimmed(value);
+    if(_index.value.empty()) _index.value = "false";
+    _index.isNumber = DialogueLineParser::parseNumber(_index.value, _index.number);
+}
+
+bool DialogueStoryletSelector::evaluate(const IndexedCondition& _condition, const VariableIndex* _index) const
+{
+    switch(_condition.kind)
+    {
+        case ConditionKind::Equality:
+            return (_index->value == _condition.literal) == (_condition.op == DialogueNode::Condition::Operator::Equals);
+        case ConditionKind::Range:
+            if(_index->isNumber == false) return false;
+            switch(_condition.op)
+            {
+                case DialogueNode::Condition::Operator::GreaterThan: return _index->number > _condition.threshold;
+                case DialogueNode::Condition::Operator::LessThan: return _index->number < _condition.threshold;
+                case DialogueNode::Condition::Operator::GreaterThanOrEqualTo: return _index->number >= _condition.threshold;
+                case DialogueNode::Condition::Operator::LessThanOrEqualTo: return _index->number <= _condition.threshold;
+                default: return false;
+            }
+        case ConditionKind::General:
+        default:
+        {
+            DialogueLineParser parser(m_resolver, &m_controller.getVisits());
+            return parser.resolveCondition(_condition.condition);
+        }
+    }
+}
+
+void DialogueStoryletSelector::update(unsigned _conditionIndex, const VariableIndex* _index)
+{
+    auto& condition = m_conditions[_conditionIndex];
+    const bool passes = evaluate(condition, _index);
+    if(passes == condition.passes) return;
+
+    condition.passes = passes;
+    auto& candidate = m_candidates[condition.candidate];
+    candidate.failingCount = passes ? candidate.failingCount - 1 : candidate.failingCount + 1;
+    setEligible(condition.candidate, candidate.failingCount == 0);
+}
+
+void DialogueStoryletSelector::setEligible(unsigned _candidate, bool _isEligible)
+{
+    auto& candidate = m_candidates[_candidate];
+    const bool isEligible = candidate.eligibleIndex != k_notEligible;
+    if(isEligible == _isEligible) return;
+
+    if(_isEligible)
+    {
+        candidate.eligibleIndex = m_eligible.size();
+        m_eligible.push_back(_candidate);
+    }
+    else
+    {
+        //swap remove
+        const auto last = m_eligible.back();
+        m_eligible[candidate.eligibleIndex] = last;
+        m_candidates[last].eligibleIndex = candidate.eligibleIndex;
+        m_eligible.pop_back();
+        candidate.eligibleIndex = k_notEligible;
+    }
+}
+
+void DialogueStoryletSelector::refreshVisits()
+{
+    const auto version = m_controller.getVisits().getVersion();
+    if(version == m_visitVersion) return;
+
+    m_visitVersion = version;
+    for(const auto conditionIndex : m_visitConditions)
+    {
+        update(conditionIndex, nullptr);
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "DialogueNode.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class DialogueController;
+class IDialogueResolver;
+struct DialogueRandom;
+
+/*! Selects eligible nodes (storylets) whose entry conditions currently pass, weighted by salience.
+ Entry conditions are the conditions on a node's first line. They are indexed by the variable they test:
+ equality tests in buckets by value and numeric comparisons in sorted threshold arrays, so when a variable
+ changes only the conditions whose result can flip are re-checked.
+ Conditions that can't be indexed (several variables, visit queries, ...) are re-evaluated when any variable they read changes */
+class DialogueStoryletSelector
+{
+public:
+    struct Result
+    {
+        DialogueNode::Id nodeId;
+        float weight;
+    };
+
+public:
+    /*! ctor
+     @param _controller controller owning the candidate nodes, used to read nodes and visit counts. Candidates are paged in when added in paged mode
+     @param _resolver resolver used to read variable values */
+    DialogueStoryletSelector(DialogueController& _controller, const IDialogueResolver* _resolver);
+
+    /*! Add a candidate node with an explicit weight */
+    void addCandidate(DialogueNode::Id _nodeId, float _weight);
+
+    /*! Add candidate nodes weighted by their "salience=N" (or "salience:N") tag, defaulting to 1 */
+    void addCandidates(const std::vector<DialogueNode::Id>& _nodeIds);
+
+    void clear();
+
+    /*! Re-evaluate every condition from scratch, required after candidates are added or the resolver changes state in bulk */
+    void refresh();
+
+    /*! Notify that a variable changed value. Only conditions that test it are re-checked */
+    void onVariableChanged(const std::string& _varName);
+
+    /*! Retrieve the highest weighted eligible candidates
+     @param _count maximum number of results
+     @param out_results receives the candidates, highest weight first */
+    void selectTop(size_t _count, std::vector<Result>& out_results);
+
+    /*! Pick an eligible candidate at random, proportional to weight
+     @return false if there are no eligible candidates */
+    bool pickWeighted(DialogueRandom& _random, DialogueNode::Id& out_nodeId);
+
+    size_t getCandidateCount() const;
+    size_t getEligibleCount();
+
+protected:
+    enum class ConditionKind : unsigned char
+    {
+        Equality, //$(var) == literal or $(var) != literal
+        Range,    //$(var) compared to a numeric literal
+        General   //anything else, evaluated with DialogueLineParser
+    };
+
+    struct Candidate
+    {
+        DialogueNode::Id nodeId;
+        float weight;
+        unsigned failingCount;
+        size_t eligibleIndex; //position in m_eligible or SIZE_MAX
+    };
+
+    struct IndexedCondition
+    {
+        unsigned candidate;
+        ConditionKind kind;
+        DialogueNode::Condition::Operator op; //normalised so the variable is on the left
+        std::string literal;
+        float threshold;
+        bool passes;
+        DialogueNode::Condition condition;
+    };
+
+    struct VariableIndex
+    {
+        std::string value;
+        bool isNumber = false;
+        float number = 0;
+        std::map<std::string, std::vector<unsigned>> equalityBuckets; //literal -> conditions
+        std::vector<std::pair<float, unsigned>> thresholds; //sorted threshold -> condition
+        std::vector<unsigned> general;
+    };
+
+    DialogueController& m_controller;
+    const IDialogueResolver* m_resolver;
+
+    std::vector<Candidate> m_candidates;
+    std::vector<IndexedCondition> m_conditions;
+    std::map<std::string, VariableIndex> m_variables;
+    std::vector<unsigned> m_visitConditions; //general conditions using visited()/visits()
+    std::vector<unsigned> m_eligible; //candidate indices
+    uint64_t m_visitVersion;
+    bool m_needsRefresh;
+
+    void indexCondition(unsigned _candidate, const DialogueNode::Condition& _condition);
+    void readVariable(const std::string& _varName, VariableIndex& _index) const;
+    bool evaluate(const IndexedCondition& _condition, const VariableIndex* _index) const;
+    void update(unsigned _conditionIndex, const VariableIndex* _index);
+    void setEligible(unsigned _candidate, bool _isEligible);
+    void refreshVisits();
+};
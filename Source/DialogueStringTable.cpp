@@ -0,0 +1,36 @@
+#include "DialogueStringTable.h"
+
+DialogueStringTable::Id DialogueStringTable::intern(const std::string& _string)
+{
+    auto it = m_ids.find(_string);
+    if(it != m_ids.end())
+    {
+        return it->second;
+    }
+
+    const auto id = static_cast<Id>(m_strings.size());
+    m_strings.push_back(_string);
+    m_ids.insert(std::make_pair(_string, id));
+    return id;
+}
+
+DialogueStringTable::Id DialogueStringTable::find(const std::string& _string) const
+{
+    auto it = m_ids.find(_string);
+    if(it != m_ids.end())
+    {
+        return it->second;
+    }
+    return k_invalidId;
+}
+
+const std::string& DialogueStringTable::getString(Id _id) const
+{
+    static const std::string s_empty;
+    return _id < m_strings.size() ? m_strings[_id] : s_empty;
+}
+
+size_t DialogueStringTable::getSize() const
+{
+    return m_strings.size();
+}
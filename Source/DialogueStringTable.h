@@ -0,0 +1,29 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+
+/*! Interns strings to dense ids. Strings are never removed and their addresses are stable */
+class DialogueStringTable
+{
+public:
+    typedef unsigned Id;
+    static constexpr Id k_invalidId = ~0u;
+
+public:
+    /*! @return the id for the string, adding it if necessary */
+    Id intern(const std::string& _string);
+
+    /*! @return the id for the string or k_invalidId if it has not been interned */
+    Id find(const std::string& _string) const;
+
+    /*! @return the string for an id, or an empty string if the id is invalid */
+    const std::string& getString(Id _id) const;
+
+    size_t getSize() const;
+
+protected:
+    std::map<std::string, Id> m_ids;
+    std::deque<std::string> m_strings;
+};
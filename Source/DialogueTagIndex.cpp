@@ -0,0 +1,168 @@
+#include "DialogueTagIndex.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    void insertSorted(std::vector<DialogueNode::Id>& _ids, DialogueNode::Id _id)
+    {
+        //ids are mostly added in increasing order
+        if(_ids.empty() || _ids.back() < _id)
+        {
+            _ids.push_back(_id);
+            return;
+        }
+        auto it = std::lower_bound(_ids.begin(), _ids.end(), _id);
+        if(it == _ids.end() || *it != _id)
+        {
+            _ids.insert(it, _id);
+        }
+    }
+
+    void eraseSorted(std::vector<DialogueNode::Id>& _ids, DialogueNode::Id _id)
+    {
+        auto it = std::lower_bound(_ids.begin(), _ids.end(), _id);
+        if(it != _ids.end() && *it == _id)
+        {
+            _ids.erase(it);
+        }
+    }
+}
+
+void DialogueTagIndex::parseTags(const std::string& _tags, std::vector<std::string>& out_tags)
+{
+    const char* delimiters = " ,\f\n\r\t\v";
+    auto start = _tags.find_first_not_of(delimiters);
+    while(start != std::string::npos)
+    {
+        const auto end = _tags.find_first_of(delimiters, start);
+        out_tags.push_back(_tags.substr(start, end - start));
+        start = _tags.find_first_not_of(delimiters, end);
+    }
+}
+
+DialogueTagIndex::TagId DialogueTagIndex::intern(const std::string& _tag)
+{
+    const auto tagId = m_tags.intern(_tag);
+    if(tagId >= m_tagNodes.size())
+    {
+        m_tagNodes.resize(tagId + 1);
+    }
+    return tagId;
+}
+
+DialogueTagIndex::TagId DialogueTagIndex::find(const std::string& _tag) const
+{
+    return m_tags.find(_tag);
+}
+
+const std::string& DialogueTagIndex::getTag(TagId _tagId) const
+{
+    return m_tags.getString(_tagId);
+}
+
+void DialogueTagIndex::addNode(DialogueNode::Id _nodeId, const std::vector<TagId>& _tagIds)
+{
+    insertSorted(m_allNodes, _nodeId);
+    for(const auto tagId : _tagIds)
+    {
+        if(tagId < m_tagNodes.size())
+        {
+            insertSorted(m_tagNodes[tagId], _nodeId);
+        }
+    }
+}
+
+void DialogueTagIndex::removeNode(DialogueNode::Id _nodeId, const std::vector<TagId>& _tagIds)
+{
+    eraseSorted(m_allNodes, _nodeId);
+    for(const auto tagId : _tagIds)
+    {
+        if(tagId < m_tagNodes.size())
+        {
+            eraseSorted(m_tagNodes[tagId], _nodeId);
+        }
+    }
+}
+
+void DialogueTagIndex::clear()
+{
+    for(auto& nodes : m_tagNodes)
+    {
+        nodes.clear();
+    }
+    m_allNodes.clear();
+}
+
+const std::vector<DialogueNode::Id>& DialogueTagIndex::getNodes(TagId _tagId) const
+{
+    static const std::vector<DialogueNode::Id> s_noNodes;
+    return _tagId < m_tagNodes.size() ? m_tagNodes[_tagId] : s_noNodes;
+}
+
+void DialogueTagIndex::query(const Query& _query, std::vector<DialogueNode::Id>& out_nodeIds) const
+{
+    out_nodeIds.clear();
+    std::vector<DialogueNode::Id> scratch;
+
+    //AND: intersect starting from the smallest set
+    std::vector<const std::vector<DialogueNode::Id>*> allSets;
+    for(const auto tagId : _query.all)
+    {
+        allSets.push_back(&getNodes(tagId));
+    }
+    std::sort(allSets.begin(), allSets.end(), [](const std::vector<DialogueNode::Id>* _a, const std::vector<DialogueNode::Id>* _b) { return _a->size() < _b->size(); });
+
+    bool hasResult = false;
+    if(allSets.empty() == false)
+    {
+        out_nodeIds = *allSets.front();
+        for(size_t i = 1; i < allSets.size() && out_nodeIds.empty() == false; ++i)
+        {
+            scratch.clear();
+            std::set_intersection(out_nodeIds.begin(), out_nodeIds.end(), allSets[i]->begin(), allSets[i]->end(), std::back_inserter(scratch));
+            out_nodeIds.swap(scratch);
+        }
+        hasResult = true;
+    }
+
+    //OR: union of the any sets, then intersect with the result so far
+    if(_query.any.empty() == false && (hasResult == false || out_nodeIds.empty() == false))
+    {
+        std::vector<DialogueNode::Id> anyNodes;
+        for(const auto tagId : _query.any)
+        {
+            const auto& nodes = getNodes(tagId);
+            scratch.clear();
+            std::set_union(anyNodes.begin(), anyNodes.end(), nodes.begin(), nodes.end(), std::back_inserter(scratch));
+            anyNodes.swap(scratch);
+        }
+        if(hasResult)
+        {
+            scratch.clear();
+            std::set_intersection(out_nodeIds.begin(), out_nodeIds.end(), anyNodes.begin(), anyNodes.end(), std::back_inserter(scratch));
+            out_nodeIds.swap(scratch);
+        }
+        else
+        {
+            out_nodeIds.swap(anyNodes);
+        }
+        hasResult = true;
+    }
+
+    if(hasResult == false)
+    {
+        out_nodeIds = m_allNodes;
+    }
+
+    //NOT: subtract each excluded set
+    for(const auto tagId : _query.none)
+    {
+        if(out_nodeIds.empty()) break;
+        const auto& nodes = getNodes(tagId);
+        scratch.clear();
+        std::set_difference(out_nodeIds.begin(), out_nodeIds.end(), nodes.begin(), nodes.end(), std::back_inserter(scratch));
+        out_nodeIds.swap(scratch);
+    }
+}
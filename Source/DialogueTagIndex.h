@@ -0,0 +1,48 @@
+#pragma once
+
+#include "DialogueNode.h"
+#include "DialogueStringTable.h"
+
+#include <string>
+#include <vector>
+
+/*! Inverted index from interned tags to the sorted ids of nodes carrying them.
+ Queries combine tags with AND/OR/NOT as set operations over the sorted id arrays */
+class DialogueTagIndex
+{
+public:
+    typedef DialogueStringTable::Id TagId;
+
+    struct Query
+    {
+        std::vector<TagId> all;  //nodes must have every one of these tags
+        std::vector<TagId> any;  //and at least one of these, if not empty
+        std::vector<TagId> none; //and none of these
+    };
+
+public:
+    /*! Split a node's tag string on whitespace and commas */
+    static void parseTags(const std::string& _tags, std::vector<std::string>& out_tags);
+
+    TagId intern(const std::string& _tag);
+    TagId find(const std::string& _tag) const;
+    const std::string& getTag(TagId _tagId) const;
+
+    void addNode(DialogueNode::Id _nodeId, const std::vector<TagId>& _tagIds);
+    void removeNode(DialogueNode::Id _nodeId, const std::vector<TagId>& _tagIds);
+
+    /*! Remove all nodes. Tags stay interned */
+    void clear();
+
+    /*! @return the sorted ids of nodes with the tag */
+    const std::vector<DialogueNode::Id>& getNodes(TagId _tagId) const;
+
+    /*! Find nodes matching a query
+     @param out_nodeIds receives the matching node ids, sorted */
+    void query(const Query& _query, std::vector<DialogueNode::Id>& out_nodeIds) const;
+
+protected:
+    DialogueStringTable m_tags;
+    std::vector<std::vector<DialogueNode::Id>> m_tagNodes; //indexed by tag id
+    std::vector<DialogueNode::Id> m_allNodes; //every indexed node, the universe for queries with no positive terms
+};
@@ -0,0 +1,477 @@
+#include "DialogueTrace.h"
+
+#include "DialogueBinaryIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    const char k_magic[4] = { 'Y', 'K', 'T', 'R' };
+    const uint32_t k_version = 1;
+    const size_t k_defaultCapacity = 4096;
+    const unsigned k_maxArgs = 3;
+
+    struct EventInfo
+    {
+        const char* name;
+        char phase; //Chrome trace phase, B and E open and close a span
+        const char* args[k_maxArgs];
+    };
+
+    const EventInfo k_events[] =
+    {
+        { "DialogueStarted", 'B', { "node", "line", nullptr } },
+        { "DialogueEnded", 'E', { nullptr, nullptr, nullptr } },
+        { "NodeEntered", 'i', { "node", "line", nullptr } },
+        { "NodeExited", 'i', { "node", nullptr, nullptr } },
+        { "LinePresented", 'i', { "node", "line", "options" } },
+        { "OptionSelected", 'i', { "option", nullptr, nullptr } },
+        { "ConditionResolved", 'i', { "slot", "result", nullptr } },
+        { "ConditionCacheHit", 'i', { "slot", "result", nullptr } },
+        { "NodePagedIn", 'i', { "node", "bytes", nullptr } },
+        { "NodeEvicted", 'i', { "node", nullptr, nullptr } },
+        { "NodesReloaded", 'i', { "reloaded", "removed", nullptr } },
+        { "InvalidLineIndex", 'i', { "node", "line", nullptr } },
+        { "InvalidOption", 'i', { "option", "options", nullptr } },
+    };
+    static_assert(sizeof(k_events) / sizeof(k_events[0]) == static_cast<size_t>(DialogueTrace::Event::Count), "missing event info");
+
+    struct Record
+    {
+        uint64_t time; //nanoseconds, steady clock
+        uint32_t args[k_maxArgs];
+        DialogueTrace::Event event;
+        DialogueTrace::Level level;
+    };
+
+    //a record in a ring, guarded by a sequence lock so readers on other threads drop records that are being overwritten
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence; //write index + 1 once written, 0 while being written
+        std::atomic<uint64_t> time;
+        std::atomic<uint64_t> args; //arg0, arg1
+        std::atomic<uint64_t> event; //arg2, event, level
+
+        void write(uint64_t _index, const Record& _record)
+        {
+            sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            time.store(_record.time, std::memory_order_relaxed);
+            args.store(_record.args[0] | static_cast<uint64_t>(_record.args[1]) << 32, std::memory_order_relaxed);
+            event.store(_record.args[2] | static_cast<uint64_t>(_record.event) << 32 | static_cast<uint64_t>(_record.level) << 48, std::memory_order_relaxed);
+            sequence.store(_index + 1, std::memory_order_release);
+        }
+
+        bool read(uint64_t _index, Record& out_record) const
+        {
+            if(sequence.load(std::memory_order_acquire) != _index + 1)
+            {
+                return false;
+            }
+            const auto recordArgs = args.load(std::memory_order_relaxed);
+            const auto recordEvent = event.load(std::memory_order_relaxed);
+            out_record.time = time.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(sequence.load(std::memory_order_relaxed) != _index + 1)
+            {
+                return false;
+            }
+            out_record.args[0] = static_cast<uint32_t>(recordArgs);
+            out_record.args[1] = static_cast<uint32_t>(recordArgs >> 32);
+            out_record.args[2] = static_cast<uint32_t>(recordEvent);
+            out_record.event = static_cast<DialogueTrace::Event>(static_cast<uint16_t>(recordEvent >> 32));
+            out_record.level = static_cast<DialogueTrace::Level>(static_cast<uint8_t>(recordEvent >> 48));
+            return true;
+        }
+    };
+
+    //written by its thread only
+    struct Ring
+    {
+        uint32_t threadIndex;
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+        std::atomic<uint64_t> written;
+        std::atomic<uint64_t> cleared; //write count at the last clear()
+        bool isReleased; //its thread exited, events are kept until clear() or another thread reuses it
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Ring>> rings;
+        size_t capacity = k_defaultCapacity;
+        uint32_t threadCount = 0;
+    };
+
+    std::atomic<bool> s_isEnabled(false);
+
+    Registry& getRegistry()
+    {
+        static Registry s_registry;
+        return s_registry;
+    }
+
+    Ring* createRing()
+    {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        size_t capacity = 1;
+        while(capacity < registry.capacity)
+        {
+            capacity <<= 1;
+        }
+
+        //reuse the ring of an exited thread so threads that come and go don't grow memory
+        for(const auto& ring : registry.rings)
+        {
+            if(ring->isReleased && ring->mask == capacity - 1)
+            {
+                ring->threadIndex = registry.threadCount++;
+                ring->cleared.store(ring->written.load());
+                ring->isReleased = false;
+                return ring.get();
+            }
+        }
+
+        std::unique_ptr<Ring> ring(new Ring());
+        ring->threadIndex = registry.threadCount++;
+        ring->mask = capacity - 1;
+        ring->slots.reset(new Slot[capacity]);
+        for(size_t i = 0; i < capacity; ++i)
+        {
+            ring->slots[i].sequence.store(0);
+        }
+        ring->written.store(0);
+        ring->cleared.store(0);
+        ring->isReleased = false;
+        registry.rings.push_back(std::move(ring));
+        return registry.rings.back().get();
+    }
+
+    //releases the thread's ring when the thread exits
+    struct RingOwner
+    {
+        Ring* ring = nullptr;
+
+        ~RingOwner()
+        {
+            if(ring)
+            {
+                auto& registry = getRegistry();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                ring->isReleased = true;
+            }
+        }
+    };
+
+    uint64_t getTime()
+    {
+        const auto time = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+    }
+
+    struct DecodedEvent
+    {
+        uint64_t time;
+        uint32_t threadIndex;
+        uint32_t event;
+        uint8_t level;
+        uint32_t args[k_maxArgs];
+    };
+
+    struct DecodedEventInfo
+    {
+        std::string name;
+        char phase;
+        std::vector<std::string> args;
+    };
+
+    void appendFormat(std::string& out_text, const char* _format, ...)
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, _format);
+        const int length = vsnprintf(buffer, sizeof(buffer), _format, args);
+        va_end(args);
+        if(length > 0)
+        {
+            out_text.append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+        }
+    }
+
+    //event and argument names are written by the library, escape anyway in case of a malformed capture
+    void appendJsonString(std::string& out_text, const std::string& _string)
+    {
+        out_text += '"';
+        for(const char c : _string)
+        {
+            if(c == '"' || c == '\\')
+            {
+                out_text += '\\';
+                out_text += c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                appendFormat(out_text, "\\u%04x", static_cast<unsigned>(c));
+            }
+            else
+            {
+                out_text += c;
+            }
+        }
+        out_text += '"';
+    }
+}
+
+void DialogueTrace::record(Level _level, Event _event, uint32_t _arg0, uint32_t _arg1, uint32_t _arg2)
+{
+    if(s_isEnabled.load(std::memory_order_relaxed) == false)
+    {
+        return;
+    }
+
+    static thread_local RingOwner s_owner;
+    if(s_owner.ring == nullptr)
+    {
+        s_owner.ring = createRing();
+    }
+
+    auto& ring = *s_owner.ring;
+    const auto index = ring.written.load(std::memory_order_relaxed);
+    ring.slots[index & ring.mask].write(index, { getTime(), { _arg0, _arg1, _arg2 }, _event, _level });
+    ring.written.store(index + 1, std::memory_order_release);
+}
+
+void DialogueTrace::setEnabled(bool _isEnabled)
+{
+    s_isEnabled.store(_isEnabled);
+}
+
+bool DialogueTrace::getIsEnabled()
+{
+    return s_isEnabled.load();
+}
+
+void DialogueTrace::setCapacity(size_t _events)
+{
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.capacity = std::max<size_t>(_events, 1);
+}
+
+void DialogueTrace::capture(std::vector<uint8_t>& out_data)
+{
+    DialogueBinaryWriter writer(out_data);
+    writer.writeBytes(k_magic, sizeof(k_magic));
+    writer.writeUInt32(k_version);
+
+    //describe the events so captures decode without this build
+    writer.writeVarUInt(static_cast<size_t>(Event::Count));
+    for(const auto& info : k_events)
+    {
+        writer.writeString(info.name);
+        writer.writeUInt8(static_cast<uint8_t>(info.phase));
+        unsigned argCount = 0;
+        while(argCount < k_maxArgs && info.args[argCount])
+        {
+            ++argCount;
+        }
+        writer.writeUInt8(static_cast<uint8_t>(argCount));
+        for(unsigned i = 0; i < argCount; ++i)
+        {
+            writer.writeString(info.args[i]);
+        }
+    }
+
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<Record> records;
+    writer.writeVarUInt(registry.rings.size());
+    for(const auto& ring : registry.rings)
+    {
+        const uint64_t capacity = ring->mask + 1;
+        const auto end = ring->written.load(std::memory_order_acquire);
+        auto begin = std::max(end > capacity ? end - capacity : 0, ring->cleared.load());
+        records.clear();
+        for(auto index = begin; index < end; ++index)
+        {
+            //a record the thread is overwriting while it is copied fails to read and is dropped
+            Record record;
+            if(ring->slots[index & ring->mask].read(index, record))
+            {
+                records.push_back(record);
+            }
+        }
+
+        writer.writeVarUInt(ring->threadIndex);
+        writer.writeVarUInt(records.size());
+        for(const auto& record : records)
+        {
+            writer.writeUInt64(record.time);
+            writer.writeVarUInt(static_cast<uint16_t>(record.event));
+            writer.writeUInt8(static_cast<uint8_t>(record.level));
+            for(const auto arg : record.args)
+            {
+                writer.writeVarUInt(arg);
+            }
+        }
+    }
+}
+
+void DialogueTrace::clear()
+{
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for(const auto& ring : registry.rings)
+    {
+        ring->cleared.store(ring->written.load(std::memory_order_acquire));
+    }
+
+    //free the rings of exited threads, nothing is left to capture from them
+    registry.rings.erase(std::remove_if(registry.rings.begin(), registry.rings.end(), [](const std::unique_ptr<Ring>& _ring) { return _ring->isReleased; }),
+                         registry.rings.end());
+}
+
+bool DialogueTrace::decode(const uint8_t* _data, size_t _size, Format _format, std::string& out_text)
+{
+    DialogueBinaryReader reader(_data, _size);
+    char magic[4];
+    uint32_t version = 0;
+    if(reader.readBytes(magic, sizeof(magic)) == false || memcmp(magic, k_magic, sizeof(magic)) != 0
+       || reader.readUInt32(version) == false || version != k_version)
+    {
+        return false;
+    }
+
+    uint64_t eventCount = 0;
+    if(reader.readVarUInt(eventCount) == false || eventCount > reader.getRemaining())
+    {
+        return false;
+    }
+    std::vector<DecodedEventInfo> infos(static_cast<size_t>(eventCount));
+    for(auto& info : infos)
+    {
+        uint8_t phase = 0, argCount = 0;
+        if(reader.readString(info.name) == false || reader.readUInt8(phase) == false
+           || reader.readUInt8(argCount) == false || argCount > k_maxArgs)
+        {
+            return false;
+        }
+        info.phase = static_cast<char>(phase);
+        info.args.resize(argCount);
+        for(auto& arg : info.args)
+        {
+            if(reader.readString(arg) == false) return false;
+        }
+    }
+
+    uint64_t ringCount = 0;
+    if(reader.readVarUInt(ringCount) == false || ringCount > reader.getRemaining())
+    {
+        return false;
+    }
+    std::vector<DecodedEvent> events;
+    for(uint64_t ringIndex = 0; ringIndex < ringCount; ++ringIndex)
+    {
+        uint64_t threadIndex = 0, recordCount = 0;
+        if(reader.readVarUInt(threadIndex) == false || reader.readVarUInt(recordCount) == false
+           || recordCount > reader.getRemaining())
+        {
+            return false;
+        }
+        for(uint64_t i = 0; i < recordCount; ++i)
+        {
+            DecodedEvent event;
+            uint64_t id = 0;
+            if(reader.readUInt64(event.time) == false || reader.readVarUInt(id) == false
+               || id >= infos.size() || reader.readUInt8(event.level) == false)
+            {
+                return false;
+            }
+            for(auto& arg : event.args)
+            {
+                uint64_t value = 0;
+                if(reader.readVarUInt(value) == false) return false;
+                arg = static_cast<uint32_t>(value);
+            }
+            event.threadIndex = static_cast<uint32_t>(threadIndex);
+            event.event = static_cast<uint32_t>(id);
+            events.push_back(event);
+        }
+    }
+    if(reader.isAtEnd() == false)
+    {
+        return false;
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const DecodedEvent& _a, const DecodedEvent& _b) { return _a.time < _b.time; });
+    const uint64_t startTime = events.empty() ? 0 : events.front().time;
+
+    if(_format == Format::Text)
+    {
+        for(const auto& event : events)
+        {
+            const auto& info = infos[event.event];
+            appendFormat(out_text, "%12.3f us [%u] %-7s %s", (event.time - startTime) / 1000.0, event.threadIndex,
+                         getLevelName(static_cast<Level>(event.level)), info.name.c_str());
+            for(size_t i = 0; i < info.args.size(); ++i)
+            {
+                appendFormat(out_text, " %s=%u", info.args[i].c_str(), event.args[i]);
+            }
+            out_text += '\n';
+        }
+    }
+    else
+    {
+        out_text += "{\"traceEvents\":[";
+        for(size_t index = 0; index < events.size(); ++index)
+        {
+            const auto& event = events[index];
+            const auto& info = infos[event.event];
+            out_text += index > 0 ? ",\n" : "\n";
+            out_text += "{\"name\":";
+            appendJsonString(out_text, info.name);
+            appendFormat(out_text, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,\"tid\":%u",
+                         getLevelName(static_cast<Level>(event.level)), info.phase == 'B' || info.phase == 'E' ? info.phase : 'i',
+                         (event.time - startTime) / 1000.0, event.threadIndex);
+            if(info.phase != 'B' && info.phase != 'E')
+            {
+                out_text += ",\"s\":\"t\"";
+            }
+            out_text += ",\"args\":{";
+            for(size_t i = 0; i < info.args.size(); ++i)
+            {
+                out_text += i > 0 ? "," : "";
+                appendJsonString(out_text, info.args[i]);
+                appendFormat(out_text, ":%u", event.args[i]);
+            }
+            out_text += "}}";
+        }
+        out_text += "\n]}\n";
+    }
+    return true;
+}
+
+const char* DialogueTrace::getEventName(Event _event)
+{
+    return _event < Event::Count ? k_events[static_cast<size_t>(_event)].name : "Unknown";
+}
+
+const char* DialogueTrace::getLevelName(Level _level)
+{
+    switch(_level)
+    {
+        case Level::Error: return "error";
+        case Level::Info: return "info";
+        case Level::Verbose: return "verbose";
+        default: return "off";
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Trace levels, events above DIALOGUE_TRACE_LEVEL are compiled out along with their arguments */
+#define DIALOGUE_TRACE_LEVEL_OFF 0
+#define DIALOGUE_TRACE_LEVEL_ERROR 1
+#define DIALOGUE_TRACE_LEVEL_INFO 2
+#define DIALOGUE_TRACE_LEVEL_VERBOSE 3
+
+#ifndef DIALOGUE_TRACE_LEVEL
+    #define DIALOGUE_TRACE_LEVEL DIALOGUE_TRACE_LEVEL_INFO
+#endif
+
+#if DIALOGUE_TRACE_LEVEL >= DIALOGUE_TRACE_LEVEL_ERROR
+    #define TRACE_ERROR(event, ...) DialogueTrace::record(DialogueTrace::Level::Error, DialogueTrace::Event::event, ##__VA_ARGS__)
+#else
+    #define TRACE_ERROR(event, ...) ((void)0)
+#endif
+
+#if DIALOGUE_TRACE_LEVEL >= DIALOGUE_TRACE_LEVEL_INFO
+    #define TRACE_INFO(event, ...) DialogueTrace::record(DialogueTrace::Level::Info, DialogueTrace::Event::event, ##__VA_ARGS__)
+#else
+    #define TRACE_INFO(event, ...) ((void)0)
+#endif
+
+#if DIALOGUE_TRACE_LEVEL >= DIALOGUE_TRACE_LEVEL_VERBOSE
+    #define TRACE_VERBOSE(event, ...) DialogueTrace::record(DialogueTrace::Level::Verbose, DialogueTrace::Event::event, ##__VA_ARGS__)
+#else
+    #define TRACE_VERBOSE(event, ...) ((void)0)
+#endif
+
+/*! Binary event tracing. Each event is an id, a level, a timestamp and up to three integer arguments,
+ written to a ring buffer owned by the calling thread, so recording never formats, locks or allocates after a thread's first event.
+ A thread's ring is reused by a later thread once it exits, or freed by clear().
+ capture() copies every thread's ring into a self describing buffer that decode() turns into text or Chrome trace JSON,
+ in process or offline with Tools/TraceDecoder.cpp. Recording is off until setEnabled(true) */
+class DialogueTrace
+{
+public:
+    enum class Level : uint8_t
+    {
+        Off,
+        Error,
+        Info,
+        Verbose
+    };
+
+    enum class Event : uint16_t
+    {
+        DialogueStarted,   //node, line
+        DialogueEnded,
+        NodeEntered,       //node, line
+        NodeExited,        //node
+        LinePresented,     //node, line, options
+        OptionSelected,    //option
+        ConditionResolved, //slot, result
+        ConditionCacheHit, //slot, result
+        NodePagedIn,       //node, bytes
+        NodeEvicted,       //node
+        NodesReloaded,     //reloaded, removed
+        InvalidLineIndex,  //node, line
+        InvalidOption,     //option, options
+        Count
+    };
+
+    enum class Format
+    {
+        Text,
+        ChromeJson
+    };
+
+public:
+    /*! Record an event on the calling thread's ring. Use the TRACE_ macros so events above DIALOGUE_TRACE_LEVEL are compiled out */
+    static void record(Level _level, Event _event, uint32_t _arg0 = 0, uint32_t _arg1 = 0, uint32_t _arg2 = 0);
+
+    /*! Recording is disabled by default, leaving a single check per event */
+    static void setEnabled(bool _isEnabled);
+    static bool getIsEnabled();
+
+    /*! Events kept per thread, rounded up to a power of two. Only affects threads that record their first event afterwards */
+    static void setCapacity(size_t _events);
+
+    /*! Append every thread's events to out_data, oldest first per thread.
+     Threads may keep recording, events they overwrite while being copied are dropped */
+    static void capture(std::vector<uint8_t>& out_data);
+
+    /*! Drop all events recorded so far, from every thread, and free the rings of threads that exited */
+    static void clear();
+
+    /*! Turn captured data into readable text or Chrome trace JSON (chrome://tracing, Perfetto)
+     @return false if the data is malformed */
+    static bool decode(const uint8_t* _data, size_t _size, Format _format, std::string& out_text);
+
+    static const char* getEventName(Event _event);
+    static const char* getLevelName(Level _level);
+};
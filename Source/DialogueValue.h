@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <charconv>
+#include <cmath>
+
+/*! A typed variable value. Converts to and from the text representation used by conditions and substitution */
+struct DialogueValue
+{
+    enum class Type : unsigned char
+    {
+        None,
+        Bool,
+        Number,
+        String
+    };
+
+    Type type = Type::None;
+    bool boolValue = false;
+    double number = 0;
+    std::string string;
+
+    static DialogueValue fromBool(bool _value)
+    {
+        DialogueValue value;
+        value.type = Type::Bool;
+        value.boolValue = _value;
+        return value;
+    }
+
+    static DialogueValue fromNumber(double _value)
+    {
+        DialogueValue value;
+        value.type = Type::Number;
+        value.number = _value;
+        return value;
+    }
+
+    static DialogueValue fromString(const std::string& _value)
+    {
+        DialogueValue value;
+        value.type = Type::String;
+        value.string = _value;
+        return value;
+    }
+
+    /*! Infer the type from text: true/false are bools, anything that fully parses as a finite decimal number is a number, otherwise a string.
+     Parsing doesn't depend on the locale, and nan, inf and hex numbers are strings */
+    static DialogueValue parse(const std::string& _text)
+    {
+        if(_text == "true" || _text == "True" || _text == "TRUE") return fromBool(true);
+        if(_text == "false" || _text == "False" || _text == "FALSE") return fromBool(false);
+
+        const char* begin = _text.data();
+        const char* end = _text.data() + _text.size();
+        if(begin != end && *begin == '+') ++begin;
+        double number = 0;
+        const auto result = std::from_chars(begin, end, number, std::chars_format::general);
+        if(begin != end && result.ec == std::errc() && result.ptr == end && std::isfinite(number))
+        {
+            return fromNumber(number);
+        }
+        return fromString(_text);
+    }
+
+    bool asBool() const
+    {
+        switch(type)
+        {
+            case Type::Bool: return boolValue;
+            case Type::Number: return number != 0;
+            case Type::String: return string.empty() == false && parse(string).asBool();
+            default: return false;
+        }
+    }
+
+    double asNumber() const
+    {
+        switch(type)
+        {
+            case Type::Bool: return boolValue ? 1 : 0;
+            case Type::Number: return number;
+            case Type::String:
+            {
+                const auto value = parse(string);
+                return value.type == Type::Number ? value.number : 0;
+            }
+            default: return 0;
+        }
+    }
+
+    /*! Append the text representation. Numbers are written in the shortest form parse reads back exactly, integral ones without a fractional part */
+    void appendTo(std::string& out_string) const
+    {
+        switch(type)
+        {
+            case Type::Bool:
+                out_string += boolValue ? "true" : "false";
+                break;
+            case Type::Number:
+            {
+                //shortest text that parses back to the same number, independent of the locale
+                char buffer[32];
+                const auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+                out_string.append(buffer, result.ec == std::errc() ? static_cast<size_t>(result.ptr - buffer) : 0);
+                break;
+            }
+            case Type::String:
+                out_string += string;
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::string toString() const
+    {
+        std::string string;
+        appendTo(string);
+        return string;
+    }
+
+    bool operator==(const DialogueValue& _other) const
+    {
+        if(type != _other.type) return false;
+        switch(type)
+        {
+            case Type::Bool: return boolValue == _other.boolValue;
+            case Type::Number: return number == _other.number;
+            case Type::String: return string == _other.string;
+            default: return true;
+        }
+    }
+
+    bool operator!=(const DialogueValue& _other) const
+    {
+        return !(*this == _other);
+    }
+};
@@ -0,0 +1,585 @@
+#include "DialogueVariableStore.h"
+
+#include "DialogueMacros.h"
+#include "DialogueBinaryIO.h"
+#include "DialogueHash.h"
+#include "DialogueActionRegistry.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace
+{
+    const size_t k_initialSlotCount = 64;
+    const size_t k_removedListener = ~size_t(0); //handle of a listener removed while notifying
+
+    uint32_t hashName(const char* _name, size_t _length)
+    {
+        const auto hash = hashDialogueData(_name, _length);
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    //strip "$" or "$( )" from a variable reference
+    void stripVariableName(const char*& _name, size_t& _length)
+    {
+        if(_length > 0 && _name[0] == '$')
+        {
+            _name++;
+            _length--;
+            if(_length >= 2 && _name[0] == '(' && _name[_length - 1] == ')')
+            {
+                _name++;
+                _length -= 2;
+            }
+        }
+    }
+
+    std::string trimmed(const std::string& _string)
+    {
+        const char* whitespace = " \f\n\r\t\v";
+        const auto begin = _string.find_first_not_of(whitespace);
+        if(begin == std::string::npos) return std::string();
+        return _string.substr(begin, _string.find_last_not_of(whitespace) + 1 - begin);
+    }
+}
+
+DialogueVariableStore::DialogueVariableStore(const IDialogueResolver* _fallbackResolver)
+: m_actionTarget(this)
+, m_fallbackResolver(_fallbackResolver)
+, m_slots(k_initialSlotCount, Slot{ 0, k_invalidId })
+, m_version(1)
+, m_nextListenerHandle(0)
+, m_notifyDepth(0)
+, m_hasRemovedListeners(false)
+{
+
+}
+
+DialogueVariableStore::~DialogueVariableStore()
+{
+
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Variables
+//-------------------------------------------------------------------------------------------------------------------
+
+DialogueVariableStore::VariableId DialogueVariableStore::intern(const std::string& _name)
+{
+    const char* name = _name.data();
+    size_t length = _name.size();
+    stripVariableName(name, length);
+
+    const uint32_t hash = hashName(name, length);
+    size_t slot = 0;
+    auto id = findSlot(name, length, hash, slot);
+    if(id != k_invalidId)
+    {
+        return id;
+    }
+
+    id = static_cast<VariableId>(m_names.size());
+    m_names.emplace_back(name, length);
+    m_values.emplace_back();
+    m_texts.emplace_back();
+    m_versions.push_back(0);
+    m_slots[slot] = { hash, id };
+
+    //keep load factor under 1/2
+    if(m_names.size() * 2 > m_slots.size())
+    {
+        grow();
+    }
+    return id;
+}
+
+DialogueVariableStore::VariableId DialogueVariableStore::find(const std::string& _name) const
+{
+    const char* name = _name.data();
+    size_t length = _name.size();
+    stripVariableName(name, length);
+
+    size_t slot = 0;
+    return findSlot(name, length, hashName(name, length), slot);
+}
+
+const std::string& DialogueVariableStore::getName(VariableId _id) const
+{
+    return m_names[_id];
+}
+
+size_t DialogueVariableStore::getVariableCount() const
+{
+    return m_names.size();
+}
+
+const DialogueValue* DialogueVariableStore::getValue(VariableId _id) const
+{
+    if(_id < m_values.size() && m_values[_id].type != DialogueValue::Type::None)
+    {
+        return &m_values[_id];
+    }
+    return nullptr;
+}
+
+const DialogueValue* DialogueVariableStore::getValue(const std::string& _name) const
+{
+    return getValue(find(_name));
+}
+
+void DialogueVariableStore::setValue(VariableId _id, const DialogueValue& _value)
+{
+    if(_id >= m_values.size())
+    {
+        LOGERROR("Failed to set variable: invalid id (%u)", _id);
+        return;
+    }
+    if(m_values[_id] == _value)
+    {
+        return;
+    }
+
+    m_values[_id] = _value;
+    m_texts[_id].clear();
+    _value.appendTo(m_texts[_id]);
+    m_versions[_id]++;
+    m_version++;
+
+    if(m_listeners.empty())
+    {
+        return;
+    }
+
+    //listeners may set variables, interning new ones moves m_values
+    const DialogueValue value = m_values[_id];
+    const size_t count = m_listeners.size();
+    m_notifyDepth++;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(m_listeners[i].first != k_removedListener)
+        {
+            m_listeners[i].second(_id, value);
+        }
+    }
+    if(--m_notifyDepth == 0 && m_hasRemovedListeners)
+    {
+        m_listeners.erase(std::remove_if(m_listeners.begin(), m_listeners.end(),
+                                         [](const std::pair<size_t, ChangeListener>& _listener) { return _listener.first == k_removedListener; }),
+                          m_listeners.end());
+        m_hasRemovedListeners = false;
+    }
+}
+
+void DialogueVariableStore::setValue(const std::string& _name, const DialogueValue& _value)
+{
+    setValue(intern(_name), _value);
+}
+
+void DialogueVariableStore::clear()
+{
+    for(VariableId id = 0; id < m_values.size(); ++id)
+    {
+        setValue(id, DialogueValue());
+    }
+}
+
+uint64_t DialogueVariableStore::getVersion(VariableId _id) const
+{
+    return _id < m_versions.size() ? m_versions[_id] : 0;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Set Expressions
+//-------------------------------------------------------------------------------------------------------------------
+
+bool DialogueVariableStore::executeSet(const std::string& _assignment)
+{
+    //split "<variable> to|= <expression>"
+    std::string assignment = trimmed(_assignment);
+    auto nameEnd = assignment.find_first_of(" \t=");
+    if(assignment.empty() || assignment[0] != '$' || nameEnd == std::string::npos)
+    {
+        LOGERROR("Failed to set: invalid assignment '%s'", _assignment.c_str());
+        return false;
+    }
+    const std::string name = assignment.substr(0, nameEnd);
+    std::string expression = trimmed(assignment.substr(nameEnd));
+    if(expression.compare(0, 2, "to") == 0 && (expression.size() == 2 || isspace(static_cast<unsigned char>(expression[2]))))
+    {
+        expression = trimmed(expression.substr(2));
+    }
+    else if(expression.empty() == false && expression[0] == '=')
+    {
+        expression = trimmed(expression.substr(1));
+    }
+    else
+    {
+        LOGERROR("Failed to set: expected 'to' or '=' in '%s'", _assignment.c_str());
+        return false;
+    }
+
+    //evaluate operands left to right, operators must be surrounded by whitespace so they don't collide with negative numbers or text
+    DialogueValue result;
+    char pendingOperator = 0;
+    size_t pos = 0;
+    while(pos <= expression.size())
+    {
+        //find the next operator token
+        size_t operatorPos = std::string::npos;
+        bool inQuotes = false;
+        for(size_t i = pos; i < expression.size(); ++i)
+        {
+            if(expression[i] == '"') inQuotes = !inQuotes;
+            if(inQuotes == false && i > pos && i + 1 < expression.size()
+               && strchr("+-*/", expression[i]) != nullptr
+               && isspace(static_cast<unsigned char>(expression[i - 1]))
+               && isspace(static_cast<unsigned char>(expression[i + 1])))
+            {
+                operatorPos = i;
+                break;
+            }
+        }
+
+        DialogueValue operand;
+        const auto operandEnd = operatorPos == std::string::npos ? expression.size() : operatorPos;
+        if(evaluateOperand(trimmed(expression.substr(pos, operandEnd - pos)), operand) == false)
+        {
+            LOGERROR("Failed to set: invalid operand in '%s'", _assignment.c_str());
+            return false;
+        }
+
+        switch(pendingOperator)
+        {
+            case 0: result = operand; break;
+            case '+':
+                if(result.type == DialogueValue::Type::String || operand.type == DialogueValue::Type::String)
+                {
+                    result = DialogueValue::fromString(result.toString() + operand.toString());
+                }
+                else
+                {
+                    result = DialogueValue::fromNumber(result.asNumber() + operand.asNumber());
+                }
+                break;
+            case '-': result = DialogueValue::fromNumber(result.asNumber() - operand.asNumber()); break;
+            case '*': result = DialogueValue::fromNumber(result.asNumber() * operand.asNumber()); break;
+            case '/': result = DialogueValue::fromNumber(result.asNumber() / operand.asNumber()); break;
+        }
+
+        if(operatorPos == std::string::npos) break;
+        pendingOperator = expression[operatorPos];
+        pos = operatorPos + 1;
+    }
+
+    setValue(name, result);
+    return true;
+}
+
+void DialogueVariableStore::registerActions(DialogueActionRegistry& _registry)
+{
+    _registry.registerAction("set", {}, [this](const DialogueValue* _args, size_t _count)
+    {
+        if(_count == 1)
+        {
+            executeSet(_args[0].string);
+        }
+        else if(_count == 2)
+        {
+            const auto& name = _args[0].string;
+            executeSet((name.empty() == false && name[0] == '$' ? name : "$" + name) + " = " + _args[1].string);
+        }
+        else
+        {
+            LOGERROR("Failed to set: expected <<set $name to value>> or <<set|name|value>>");
+        }
+    }, true);
+}
+
+bool DialogueVariableStore::evaluateOperand(const std::string& _text, DialogueValue& out_value) const
+{
+    if(_text.empty())
+    {
+        return false;
+    }
+    if(_text[0] == '$')
+    {
+        const auto value = getValue(_text);
+        if(value)
+        {
+            out_value = *value;
+        }
+        else
+        {
+            //fall back to the external resolver as text
+            const char* name = _text.data();
+            size_t length = _text.size();
+            stripVariableName(name, length);
+            std::string text;
+            if(m_fallbackResolver == nullptr || m_fallbackResolver->resolveVariable(std::string(name, length), text) == false)
+            {
+                LOGERROR("Failed to set: unknown variable '%s'", _text.c_str());
+                return false;
+            }
+            out_value = DialogueValue::parse(text);
+        }
+        return true;
+    }
+    if(_text.size() >= 2 && _text.front() == '"' && _text.back() == '"')
+    {
+        out_value = DialogueValue::fromString(_text.substr(1, _text.size() - 2));
+        return true;
+    }
+    out_value = DialogueValue::parse(_text);
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Change Notification
+//-------------------------------------------------------------------------------------------------------------------
+
+size_t DialogueVariableStore::addChangeListener(const ChangeListener& _listener)
+{
+    m_listeners.push_back({ m_nextListenerHandle, _listener });
+    return m_nextListenerHandle++;
+}
+
+void DialogueVariableStore::removeChangeListener(size_t _handle)
+{
+    if(m_notifyDepth > 0)
+    {
+        for(auto& listener : m_listeners)
+        {
+            //the listener may be the one running, it is destroyed once notifying ends
+            if(listener.first == _handle)
+            {
+                listener.first = k_removedListener;
+                m_hasRemovedListeners = true;
+            }
+        }
+        return;
+    }
+    m_listeners.erase(std::remove_if(m_listeners.begin(), m_listeners.end(),
+                                     [_handle](const std::pair<size_t, ChangeListener>& _listener) { return _listener.first == _handle; }),
+                      m_listeners.end());
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Snapshots
+//-------------------------------------------------------------------------------------------------------------------
+
+void DialogueVariableStore::saveSnapshot(std::vector<uint8_t>& out_snapshot) const
+{
+    out_snapshot.clear();
+    DialogueBinaryWriter writer(out_snapshot);
+
+    size_t count = 0;
+    for(const auto& value : m_values)
+    {
+        if(value.type != DialogueValue::Type::None) count++;
+    }
+    writer.writeVarUInt(count);
+
+    for(VariableId id = 0; id < m_values.size(); ++id)
+    {
+        const auto& value = m_values[id];
+        if(value.type == DialogueValue::Type::None) continue;
+
+        writer.writeString(m_names[id]);
+        writer.writeUInt8(static_cast<uint8_t>(value.type));
+        switch(value.type)
+        {
+            case DialogueValue::Type::Bool: writer.writeUInt8(value.boolValue ? 1 : 0); break;
+            case DialogueValue::Type::Number: writer.writeBytes(&value.number, sizeof(value.number)); break;
+            case DialogueValue::Type::String: writer.writeString(value.string); break;
+            default: break;
+        }
+    }
+}
+
+bool DialogueVariableStore::restoreSnapshot(const std::vector<uint8_t>& _snapshot)
+{
+    return restoreSnapshot(_snapshot.data(), _snapshot.size());
+}
+
+bool DialogueVariableStore::restoreSnapshot(const uint8_t* _data, size_t _size)
+{
+    DialogueBinaryReader reader(_data, _size);
+
+    uint64_t count = 0;
+    if(reader.readVarUInt(count) == false || count > _size)
+    {
+        LOGERROR("Failed to restore variables: malformed data");
+        return false;
+    }
+
+    //decode everything before changing any state
+    std::vector<std::pair<std::string, DialogueValue>> entries(static_cast<size_t>(count));
+    for(auto& entry : entries)
+    {
+        uint8_t type = 0;
+        bool isValid = reader.readString(entry.first) && reader.readUInt8(type);
+        entry.second.type = static_cast<DialogueValue::Type>(type);
+        switch(entry.second.type)
+        {
+            case DialogueValue::Type::Bool:
+            {
+                uint8_t boolValue = 0;
+                isValid = isValid && reader.readUInt8(boolValue);
+                entry.second.boolValue = boolValue != 0;
+                break;
+            }
+            case DialogueValue::Type::Number:
+                isValid = isValid && reader.readBytes(&entry.second.number, sizeof(entry.second.number));
+                break;
+            case DialogueValue::Type::String:
+                isValid = isValid && reader.readString(entry.second.string);
+                break;
+            default:
+                isValid = false;
+                break;
+        }
+        if(isValid == false)
+        {
+            LOGERROR("Failed to restore variables: malformed data");
+            return false;
+        }
+    }
+
+    std::vector<bool> isRestored(m_values.size(), false);
+    for(const auto& entry : entries)
+    {
+        const auto id = intern(entry.first);
+        isRestored.resize(m_values.size(), false);
+        isRestored[id] = true;
+        setValue(id, entry.second);
+    }
+    for(VariableId id = 0; id < isRestored.size(); ++id)
+    {
+        if(isRestored[id] == false)
+        {
+            setValue(id, DialogueValue());
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//IDialogueResolver
+//-------------------------------------------------------------------------------------------------------------------
+
+bool DialogueVariableStore::resolveVariable(const std::string& _varName, std::string& out_value) const
+{
+    const auto id = find(_varName);
+    if(id != k_invalidId && m_values[id].type != DialogueValue::Type::None)
+    {
+        out_value = m_texts[id];
+        return true;
+    }
+    return m_fallbackResolver ? m_fallbackResolver->resolveVariable(_varName, out_value) : false;
+}
+
+bool DialogueVariableStore::resolveAction(const std::string& _name, const std::vector<std::string>& _params) const
+{
+    //<<set $x to 1>> arrives as a single name, <<set|x|1>> as name and params
+    const bool isSet = _name.size() >= 3
+        && tolower(static_cast<unsigned char>(_name[0])) == 's'
+        && tolower(static_cast<unsigned char>(_name[1])) == 'e'
+        && tolower(static_cast<unsigned char>(_name[2])) == 't'
+        && (_name.size() == 3 || isspace(static_cast<unsigned char>(_name[3])));
+    if(isSet)
+    {
+        //resolveAction is const in the interface, but the store owns the state it is asked to modify
+        const auto store = m_actionTarget;
+        if(_name.size() > 3)
+        {
+            return store->executeSet(_name.substr(4));
+        }
+        if(_params.size() == 1)
+        {
+            return store->executeSet(_params[0]);
+        }
+        if(_params.size() == 2)
+        {
+            const auto& name = _params[0];
+            return store->executeSet((name.empty() == false && name[0] == '$' ? name : "$" + name) + " = " + _params[1]);
+        }
+        LOGERROR("Failed to set: expected <<set|name|value>>");
+        return false;
+    }
+    return m_fallbackResolver ? m_fallbackResolver->resolveAction(_name, _params) : false;
+}
+
+bool DialogueVariableStore::getVariableVersion(const std::string& _varName, uint64_t& out_version) const
+{
+    //mirrors resolveVariable: unset and unknown names read the fallback's value, so they carry its version.
+    //Even versions are the store's own and odd ones the fallback's, so setting a variable over a fallback value never reads as unchanged
+    const auto id = find(_varName);
+    if(m_fallbackResolver && (id == k_invalidId || m_values[id].type == DialogueValue::Type::None))
+    {
+        uint64_t fallbackVersion = 0;
+        if(m_fallbackResolver->getVariableVersion(_varName, fallbackVersion) == false)
+        {
+            return false;
+        }
+        out_version = fallbackVersion * 2 + 1;
+        return true;
+    }
+    //without a fallback only the store changes the value
+    out_version = id != k_invalidId ? m_versions[id] * 2 : 0;
+    return true;
+}
+
+uint64_t DialogueVariableStore::getVariablesVersion() const
+{
+    //any fallback without a global version makes the global fast path unusable
+    if(m_fallbackResolver && m_fallbackResolver->getVariablesVersion() == 0)
+    {
+        return 0;
+    }
+    return m_fallbackResolver ? m_version + m_fallbackResolver->getVariablesVersion() : m_version;
+}
+
+//-------------------------------------------------------------------------------------------------------------------
+//Internal Helpers
+//-------------------------------------------------------------------------------------------------------------------
+
+DialogueVariableStore::VariableId DialogueVariableStore::findSlot(const char* _name, size_t _length, uint32_t _hash, size_t& out_slot) const
+{
+    const size_t mask = m_slots.size() - 1;
+    for(size_t slot = _hash & mask;; slot = (slot + 1) & mask)
+    {
+        const auto& entry = m_slots[slot];
+        if(entry.id == k_invalidId)
+        {
+            out_slot = slot;
+            return k_invalidId;
+        }
+        if(entry.hash == _hash)
+        {
+            const auto& name = m_names[entry.id];
+            if(name.size() == _length && memcmp(name.data(), _name, _length) == 0)
+            {
+                out_slot = slot;
+                return entry.id;
+            }
+        }
+    }
+}
+
+void DialogueVariableStore::grow()
+{
+    std::vector<Slot> slots(m_slots.size() * 2, Slot{ 0, k_invalidId });
+    const size_t mask = slots.size() - 1;
+    for(const auto& entry : m_slots)
+    {
+        if(entry.id == k_invalidId) continue;
+        size_t slot = entry.hash & mask;
+        while(slots[slot].id != k_invalidId)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = entry;
+    }
+    m_slots.swap(slots);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "IDialogueResolver.h"
+#include "DialogueValue.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+class DialogueActionRegistry;
+
+/*! Reference variable store implementing IDialogueResolver.
+ Variable names are interned into an open addressing table and values are stored typed in dense arrays indexed by VariableId.
+ Handles <<set $x to ...>> actions and forwards any other action to an optional fallback resolver */
+class DialogueVariableStore : public IDialogueResolver
+{
+public:
+    typedef uint32_t VariableId;
+    static constexpr VariableId k_invalidId = ~0u;
+
+    /*! Called after a variable changes value */
+    typedef std::function<void(VariableId _id, const DialogueValue& _value)> ChangeListener;
+
+public:
+    virtual ~DialogueVariableStore();
+    /*! ctor
+     @param _fallbackResolver resolver used for actions other than set, and for variables not in the store. May be nullptr */
+    DialogueVariableStore(const IDialogueResolver* _fallbackResolver = nullptr);
+
+    DialogueVariableStore(const DialogueVariableStore&) = delete;
+    DialogueVariableStore& operator=(const DialogueVariableStore&) = delete;
+
+    //-------------------------------------------
+    //Variables
+
+    /*! Find or create the id for a variable name. A leading '$' is ignored */
+    VariableId intern(const std::string& _name);
+
+    /*! @return the id for a variable name or k_invalidId if it has never been interned */
+    VariableId find(const std::string& _name) const;
+
+    const std::string& getName(VariableId _id) const;
+    size_t getVariableCount() const;
+
+    /*! @return the value or nullptr if the variable has not been set */
+    const DialogueValue* getValue(VariableId _id) const;
+    const DialogueValue* getValue(const std::string& _name) const;
+
+    /*! Set a value, notifying listeners if it changed */
+    void setValue(VariableId _id, const DialogueValue& _value);
+    void setValue(const std::string& _name, const DialogueValue& _value);
+
+    /*! Unset every variable. Names stay interned */
+    void clear();
+
+    /*! Per variable counter, incremented every time the value changes */
+    uint64_t getVersion(VariableId _id) const;
+
+    //-------------------------------------------
+    //Set Expressions
+
+    /*! Execute an assignment of the form "$x to <expr>" or "$x = <expr>".
+     <expr> is a literal (number, true/false, "string") or a variable ($y or $(y)), optionally combined left to right with + - * /
+     @return true if the assignment was valid */
+    bool executeSet(const std::string& _assignment);
+
+    /*! Register the set action with a registry so <<set ...>> is bound when nodes are added rather than dispatched through resolveAction */
+    void registerActions(DialogueActionRegistry& _registry);
+
+    //-------------------------------------------
+    //Change Notification
+
+    /*! Listeners may add and remove listeners and set variables from the callback. A listener added while notifying is first called
+     for the next change, one removed while notifying isn't called again
+     @return a handle that can be passed to removeChangeListener */
+    size_t addChangeListener(const ChangeListener& _listener);
+    void removeChangeListener(size_t _handle);
+
+    //-------------------------------------------
+    //Snapshots
+
+    /*! Write every set variable (name and typed value) to a buffer, cleared first */
+    void saveSnapshot(std::vector<uint8_t>& out_snapshot) const;
+
+    /*! Replace all values with those from a snapshot. Listeners are notified of every value that changed
+     @return true if the snapshot was valid. Values are unchanged on failure */
+    bool restoreSnapshot(const uint8_t* _data, size_t _size);
+    bool restoreSnapshot(const std::vector<uint8_t>& _snapshot);
+
+    //-------------------------------------------
+    //IDialogueResolver
+    bool resolveVariable(const std::string& _varName, std::string& out_value) const override;
+    bool resolveAction(const std::string& _name, const std::vector<std::string>& _params) const override;
+    bool getVariableVersion(const std::string& _varName, uint64_t& out_version) const override;
+    uint64_t getVariablesVersion() const override;
+
+protected:
+    struct Slot
+    {
+        uint32_t hash;
+        VariableId id; //k_invalidId if empty
+    };
+
+    DialogueVariableStore* const m_actionTarget; //this, <<set>> arrives through resolveAction which the interface declares const
+    const IDialogueResolver* m_fallbackResolver;
+
+    std::vector<Slot> m_slots; //power of two sized, linear probing
+    std::vector<std::string> m_names;
+    std::vector<DialogueValue> m_values;
+    std::vector<std::string> m_texts; //text form of each value, formatted once on set so resolving is a copy
+    std::vector<uint64_t> m_versions;
+    uint64_t m_version;
+
+    std::deque<std::pair<size_t, ChangeListener>> m_listeners; //a deque so listeners added while notifying don't move the one running
+    size_t m_nextListenerHandle;
+    unsigned m_notifyDepth; //removals are deferred while notifying
+    bool m_hasRemovedListeners;
+
+    VariableId findSlot(const char* _name, size_t _length, uint32_t _hash, size_t& out_slot) const;
+    void grow();
+    bool evaluateOperand(const std::string& _text, DialogueValue& out_value) const;
+};
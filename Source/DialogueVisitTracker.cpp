@@ -0,0 +1,87 @@
+#include "DialogueVisitTracker.h"
+
+#include "DialogueBinaryIO.h"
+
+DialogueVisitTracker::DialogueVisitTracker()
+: m_version(0)
+{
+
+}
+
+void DialogueVisitTracker::markVisited(DialogueNode::Id _nodeId)
+{
+    if(_nodeId == DialogueNode::k_invalidId) return;
+
+    if(_nodeId >= m_visitCounts.size())
+    {
+        m_visitCounts.resize(_nodeId + 1, 0);
+        m_visitedBits.resize(_nodeId / 64 + 1, 0);
+    }
+    m_visitedBits[_nodeId / 64] |= uint64_t(1) << (_nodeId % 64);
+    if(m_visitCounts[_nodeId] != UINT32_MAX)
+    {
+        m_visitCounts[_nodeId]++;
+    }
+    m_version++;
+}
+
+void DialogueVisitTracker::reset()
+{
+    m_visitedBits.clear();
+    m_visitCounts.clear();
+    m_version++;
+}
+
+void DialogueVisitTracker::save(std::vector<uint8_t>& out_buffer) const
+{
+    DialogueBinaryWriter writer(out_buffer);
+    writer.writeVarUInt(m_visitCounts.size());
+    for(const auto bits : m_visitedBits)
+    {
+        writer.writeUInt64(bits);
+    }
+    for(const auto count : m_visitCounts)
+    {
+        if(count > 0)
+        {
+            writer.writeVarUInt(count);
+        }
+    }
+}
+
+bool DialogueVisitTracker::restore(const uint8_t* _data, size_t _size)
+{
+    DialogueBinaryReader reader(_data, _size);
+
+    uint64_t nodeCount = 0;
+    if(reader.readVarUInt(nodeCount) == false || nodeCount / 64 > _size)
+    {
+        return false;
+    }
+
+    std::vector<uint64_t> visitedBits((static_cast<size_t>(nodeCount) + 63) / 64, 0);
+    for(auto& bits : visitedBits)
+    {
+        if(reader.readUInt64(bits) == false) return false;
+    }
+
+    std::vector<uint32_t> visitCounts(static_cast<size_t>(nodeCount), 0);
+    for(size_t i = 0; i < visitCounts.size(); ++i)
+    {
+        if((visitedBits[i / 64] >> (i % 64) & 1) != 0)
+        {
+            uint64_t count = 0;
+            if(reader.readVarUInt(count) == false || count == 0 || count > UINT32_MAX) return false;
+            visitCounts[i] = static_cast<uint32_t>(count);
+        }
+    }
+    if(reader.isAtEnd() == false)
+    {
+        return false;
+    }
+
+    m_visitedBits.swap(visitedBits);
+    m_visitCounts.swap(visitCounts);
+    m_version++;
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "DialogueNode.h"
+
+#include <cstdint>
+#include <vector>
+
+/*! Tracks which nodes have been entered and how many times, in dense arrays indexed by node id.
+ Queries are a single array load so they can be used freely from conditions via visited("Node") and visits("Node") */
+class DialogueVisitTracker
+{
+public:
+    DialogueVisitTracker();
+
+    void markVisited(DialogueNode::Id _nodeId);
+
+    bool isVisited(DialogueNode::Id _nodeId) const
+    {
+        const size_t word = _nodeId / 64;
+        return word < m_visitedBits.size() && (m_visitedBits[word] >> (_nodeId % 64) & 1) != 0;
+    }
+
+    uint32_t getVisitCount(DialogueNode::Id _nodeId) const
+    {
+        return _nodeId < m_visitCounts.size() ? m_visitCounts[_nodeId] : 0;
+    }
+
+    /*! Incremented on every visit, allows callers to detect that any visit state changed */
+    uint64_t getVersion() const
+    {
+        return m_version;
+    }
+
+    void reset();
+
+    /*! Append visit state to a buffer: a bitset of visited nodes followed by the counts of visited nodes only */
+    void save(std::vector<uint8_t>& out_buffer) const;
+
+    /*! Restore visit state written by save
+     @return true if the data was valid. State is unchanged on failure*/
+    bool restore(const uint8_t* _data, size_t _size);
+
+protected:
+    std::vector<uint64_t> m_visitedBits;
+    std::vector<uint32_t> m_visitCounts;
+    uint64_t m_version;
+};
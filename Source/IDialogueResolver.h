@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 class DialogueController;
 
@@ -12,4 +13,12 @@ public:
 
     virtual bool resolveVariable(const std::string& _varName, std::string& out_value) const = 0;
     virtual bool resolveAction(const std::string& _name, const std::vector<std::string>& _params) const = 0;
+
+    /*! Optional. Provide a counter that changes whenever the variable's value changes, allowing condition results to be cached
+     @return false if the variable is not versioned, conditions reading it are then always re-evaluated */
+    virtual bool getVariableVersion(const std::string& /*_varName*/, uint64_t& /*out_version*/) const { return false; }
+
+    /*! Optional. A counter that changes whenever any variable changes, used to skip checking individual versions.
+     @return 0 if not supported */
+    virtual uint64_t getVariablesVersion() const { return 0; }
 };
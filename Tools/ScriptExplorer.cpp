@@ -0,0 +1,138 @@
+/*
+ Explores every path through the nodes of an archive with DialogueExplorer and reports line and option coverage for QA.
+ Usage: ScriptExplorer [--threads N] [--max-states N] [--start Node]... [--csv] [--out report.json] script.ykna
+ Variables read before the script sets them take values derived from the script's conditions. The report is written as JSON,
+ or CSV with --csv, to stdout or the --out file, with a summary on stderr. See README.md for build instructions.
+ */
+
+#include "DialogueController.h"
+#include "DialogueExplorer.h"
+#include "DialogueNode.h"
+#include "DialogueNodeArchive.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+int main(int _argc, char** _argv)
+{
+    DialogueExplorer::Settings settings;
+    bool isCsv = false;
+    std::string outputPath;
+    std::vector<const char*> paths;
+    for(int i = 1; i < _argc; ++i)
+    {
+        if(strcmp(_argv[i], "--threads") == 0 && i + 1 < _argc)
+        {
+            settings.threadCount = static_cast<unsigned>(strtoul(_argv[++i], nullptr, 10));
+        }
+        else if(strcmp(_argv[i], "--max-states") == 0 && i + 1 < _argc)
+        {
+            settings.maxStates = strtoull(_argv[++i], nullptr, 10);
+        }
+        else if(strcmp(_argv[i], "--start") == 0 && i + 1 < _argc)
+        {
+            settings.startNodes.push_back(_argv[++i]);
+        }
+        else if(strcmp(_argv[i], "--csv") == 0)
+        {
+            isCsv = true;
+        }
+        else if(strcmp(_argv[i], "--out") == 0 && i + 1 < _argc)
+        {
+            outputPath = _argv[++i];
+        }
+        else
+        {
+            paths.push_back(_argv[i]);
+        }
+    }
+    if(paths.size() != 1)
+    {
+        fprintf(stderr, "Usage: %s [--threads N] [--max-states N] [--start Node]... [--csv] [--out report.json] script.ykna\n", _argv[0]);
+        return 1;
+    }
+
+    //decode once, every thread adds its own copy
+    DialogueNodeArchive archive;
+    if(archive.openFile(paths[0]) == false)
+    {
+        fprintf(stderr, "Failed to open archive '%s'\n", paths[0]);
+        return 1;
+    }
+    std::vector<DialogueNode> nodes(archive.getNodeCount());
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        if(archive.loadNode(i, nodes[i]) == false)
+        {
+            fprintf(stderr, "Failed to read node '%s'\n", archive.getEntry(i).name.c_str());
+            return 1;
+        }
+    }
+    archive.close();
+
+    const auto loader = [&nodes](DialogueController& _controller)
+    {
+        for(const auto& node : nodes)
+        {
+            if(_controller.addNode(node) == false) return false;
+        }
+        return true;
+    };
+
+    DialogueExplorer explorer;
+    const auto start = std::chrono::steady_clock::now();
+    if(explorer.explore(loader, settings) == false)
+    {
+        fprintf(stderr, "Failed to explore '%s'\n", paths[0]);
+        return 1;
+    }
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    //summary
+    const auto& report = explorer.getReport();
+    size_t coveredLines = 0, coveredOptions = 0;
+    uint64_t deadEnds = 0;
+    for(const auto& line : report.lines)
+    {
+        if(line.states > 0) coveredLines++;
+        deadEnds += line.noOptionStates + line.stuckStates;
+    }
+    for(const auto& option : report.options)
+    {
+        if(option.states > 0) coveredOptions++;
+    }
+    fprintf(stderr, "%zu/%zu lines, %zu/%zu options covered, %" PRIu64 " dead end states\n",
+            coveredLines, report.lines.size(), coveredOptions, report.options.size(), deadEnds);
+    fprintf(stderr, "%" PRIu64 " states, %" PRIu64 " steps in %.2fs%s\n",
+            report.states, report.steps, seconds, report.isComplete ? "" : ", stopped at --max-states, coverage is incomplete");
+
+    std::string text;
+    if(isCsv)
+    {
+        explorer.writeCsv(text);
+    }
+    else
+    {
+        explorer.writeJson(text);
+    }
+    if(outputPath.empty())
+    {
+        fwrite(text.data(), 1, text.size(), stdout);
+        return 0;
+    }
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    output.write(text.data(), static_cast<std::streamsize>(text.size()));
+    if(output.fail())
+    {
+        fprintf(stderr, "Failed to write '%s'\n", outputPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ Replays a session recorded with DialogueRecorder against a node archive, without the game, and reports the time of each call.
+ Usage: SessionReplay [--repetitions N] [--out steps.json] script.ykna session.bin
+ Every node is loaded before replaying so paging isn't timed. Each step reports the fastest of the repetitions,
+ written as JSON to stdout or the --out file with a summary per call on stderr. See README.md for build instructions.
+ */
+
+#include "DialogueController.h"
+#include "DialogueNodeArchive.h"
+#include "DialogueRecorder.h"
+#include "DialogueReplay.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+    bool replay(DialogueNodeArchive& _archive, DialogueReplay& _replay, std::vector<DialogueReplay::Step>& out_steps)
+    {
+        DialogueController controller;
+        if(controller.setNodeArchive(&_archive, SIZE_MAX) == false)
+        {
+            return false;
+        }
+        for(size_t i = 0; i < _archive.getNodeCount(); ++i)
+        {
+            controller.loadNodeByName(_archive.getEntry(i).name);
+        }
+
+        const bool isReplayed = _replay.run(controller);
+        out_steps = _replay.getSteps();
+        controller.setNodeArchive(nullptr, 0);
+        return isReplayed;
+    }
+
+    void writeJson(const std::vector<DialogueReplay::Step>& _steps, std::string& out_text)
+    {
+        char buffer[128];
+        out_text += "{\"steps\":[";
+        for(size_t i = 0; i < _steps.size(); ++i)
+        {
+            snprintf(buffer, sizeof(buffer), "%s{\"call\":\"%s\",\"nanoseconds\":%" PRIu64 "}",
+                     i > 0 ? "," : "", DialogueRecorder::getEventName(_steps[i].call), _steps[i].nanoseconds);
+            out_text += buffer;
+        }
+        out_text += "]}\n";
+    }
+}
+
+int main(int _argc, char** _argv)
+{
+    size_t repetitions = 5;
+    std::string outputPath;
+    std::vector<const char*> paths;
+    for(int i = 1; i < _argc; ++i)
+    {
+        if(strcmp(_argv[i], "--repetitions") == 0 && i + 1 < _argc)
+        {
+            repetitions = std::max<size_t>(1, strtoul(_argv[++i], nullptr, 10));
+        }
+        else if(strcmp(_argv[i], "--out") == 0 && i + 1 < _argc)
+        {
+            outputPath = _argv[++i];
+        }
+        else
+        {
+            paths.push_back(_argv[i]);
+        }
+    }
+    if(paths.size() != 2)
+    {
+        fprintf(stderr, "Usage: %s [--repetitions N] [--out steps.json] script.ykna session.bin\n", _argv[0]);
+        return 1;
+    }
+
+    DialogueNodeArchive archive;
+    if(archive.openFile(paths[0]) == false)
+    {
+        fprintf(stderr, "Failed to open archive '%s'\n", paths[0]);
+        return 1;
+    }
+
+    std::ifstream file(paths[1], std::ios::binary);
+    if(file.fail())
+    {
+        fprintf(stderr, "Failed to open session '%s'\n", paths[1]);
+        return 1;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    DialogueReplay replayer;
+    if(replayer.load(data) == false)
+    {
+        fprintf(stderr, "'%s' is not a valid session log\n", paths[1]);
+        return 1;
+    }
+
+    std::vector<DialogueReplay::Step> fastest, steps;
+    for(size_t repetition = 0; repetition < repetitions; ++repetition)
+    {
+        if(replay(archive, replayer, steps) == false)
+        {
+            fprintf(stderr, "Replay failed after %zu steps: %s\n", steps.size(), replayer.getError().c_str());
+            return 1;
+        }
+        if(repetition == 0)
+        {
+            fastest = steps;
+            continue;
+        }
+        for(size_t i = 0; i < steps.size() && i < fastest.size(); ++i)
+        {
+            fastest[i].nanoseconds = std::min(fastest[i].nanoseconds, steps[i].nanoseconds);
+        }
+    }
+
+    //summary per call
+    const size_t callCount = static_cast<size_t>(DialogueRecorder::Event::CallEnd);
+    std::vector<uint64_t> counts(callCount, 0), totals(callCount, 0), slowest(callCount, 0);
+    for(const auto& step : fastest)
+    {
+        const auto call = static_cast<size_t>(step.call);
+        counts[call]++;
+        totals[call] += step.nanoseconds;
+        slowest[call] = std::max(slowest[call], step.nanoseconds);
+    }
+    for(size_t call = 0; call < callCount; ++call)
+    {
+        if(counts[call] == 0) continue;
+        fprintf(stderr, "%-18s %8" PRIu64 " calls %12.1f ns/call %12" PRIu64 " ns slowest\n",
+                DialogueRecorder::getEventName(static_cast<DialogueRecorder::Event>(call)),
+                counts[call], static_cast<double>(totals[call]) / counts[call], slowest[call]);
+    }
+
+    std::string json;
+    writeJson(fastest, json);
+    if(outputPath.empty())
+    {
+        fwrite(json.data(), 1, json.size(), stdout);
+        return 0;
+    }
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    output.write(json.data(), static_cast<std::streamsize>(json.size()));
+    if(output.fail())
+    {
+        fprintf(stderr, "Failed to write '%s'\n", outputPath.c_str());
+        return 1;
+    }
+    return 0;
+}
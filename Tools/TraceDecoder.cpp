@@ -0,0 +1,67 @@
+/*
+ Decodes a capture written by DialogueTrace::capture into readable text or Chrome trace JSON.
+ Usage: TraceDecoder [--json] capture.bin [output]
+ Writes to stdout if no output file is given. See README.md for build instructions.
+ */
+
+#include "DialogueTrace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+int main(int _argc, char** _argv)
+{
+    auto format = DialogueTrace::Format::Text;
+    std::vector<const char*> paths;
+    for(int i = 1; i < _argc; ++i)
+    {
+        if(strcmp(_argv[i], "--json") == 0)
+        {
+            format = DialogueTrace::Format::ChromeJson;
+        }
+        else
+        {
+            paths.push_back(_argv[i]);
+        }
+    }
+    if(paths.empty() || paths.size() > 2)
+    {
+        fprintf(stderr, "Usage: %s [--json] capture.bin [output]\n", _argv[0]);
+        return 1;
+    }
+
+    std::ifstream file(paths[0], std::ios::binary);
+    if(file.fail())
+    {
+        fprintf(stderr, "Failed to open '%s'\n", paths[0]);
+        return 1;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::string text;
+    if(DialogueTrace::decode(data.data(), data.size(), format, text) == false)
+    {
+        fprintf(stderr, "'%s' is not a valid trace capture\n", paths[0]);
+        return 1;
+    }
+
+    if(paths.size() == 2)
+    {
+        std::ofstream output(paths[1], std::ios::binary | std::ios::trunc);
+        output.write(text.data(), static_cast<std::streamsize>(text.size()));
+        if(output.fail())
+        {
+            fprintf(stderr, "Failed to write '%s'\n", paths[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        fwrite(text.data(), 1, text.size(), stdout);
+    }
+    return 0;
+}